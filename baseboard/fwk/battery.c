@@ -11,14 +11,19 @@
 #include "battery.h"
 #include "battery_smart.h"
 #include "charge_state.h"
+#include "charge_state_v2.h"
+#include "charger.h"
 #include "console.h"
 #include "ec_commands.h"
+#include "extpower.h"
 #include "host_command.h"
 #include "host_command_customization.h"
 #include "system.h"
 #include "i2c.h"
 #include "string.h"
 #include "system.h"
+#include "task.h"
+#include "timer.h"
 #include "util.h"
 #include "hooks.h"
 
@@ -411,3 +416,216 @@ static enum ec_status cmd_charging_limit_control(struct host_cmd_handler_args *a
 }
 DECLARE_HOST_COMMAND(EC_CMD_CHARGE_LIMIT_CONTROL, cmd_charging_limit_control,
 			EC_VER_MASK(0));
+
+#ifdef CONFIG_BATTERY_HISTORY
+/*****************************************************************************/
+/* Battery telemetry history */
+
+/*
+ * Ring of delta-encoded samples, oldest at batt_hist_head. batt_hist_base is
+ * the sample the oldest entry is relative to, batt_hist_last is the sample
+ * the host rebuilds from the newest entry. Deltas are taken against
+ * batt_hist_last rather than the previous measurement, so a step too large
+ * for one entry is carried into the following entries instead of leaving a
+ * permanent error.
+ */
+static struct ec_battery_history_entry
+	batt_hist[CONFIG_BATTERY_HISTORY_ENTRIES];
+static int batt_hist_head;
+static int batt_hist_count;
+static struct ec_battery_history_sample batt_hist_base;
+static struct ec_battery_history_sample batt_hist_last;
+static timestamp_t batt_hist_time;
+static struct mutex batt_hist_lock;
+
+static int8_t batt_hist_delta(int *recon, int value, int unit)
+{
+	int delta = value - *recon;
+
+	/* Round to the nearest unit */
+	delta = (delta + (delta < 0 ? -unit : unit) / 2) / unit;
+	delta = CLAMP(delta, -128, 127);
+	*recon += delta * unit;
+
+	return delta;
+}
+
+static void batt_hist_apply(struct ec_battery_history_sample *s,
+			    const struct ec_battery_history_entry *e)
+{
+	s->state = e->state;
+	s->rsoc = e->rsoc;
+	s->voltage += e->voltage * EC_BATT_HIST_MV_UNIT;
+	s->current += e->current * EC_BATT_HIST_MA_UNIT;
+	s->temperature += e->temperature * EC_BATT_HIST_DK_UNIT;
+	s->input_current += e->input_current * EC_BATT_HIST_INPUT_MA_UNIT;
+}
+
+static void batt_hist_sample(void)
+{
+	static int ticks;
+	const struct batt_params *batt = charger_current_battery_params();
+	struct ec_battery_history_sample *last = &batt_hist_last;
+	struct ec_battery_history_entry *e;
+	int input_current = 0;
+	int state;
+	int v;
+
+	if (++ticks < CONFIG_BATTERY_HISTORY_INTERVAL)
+		return;
+	ticks = 0;
+
+	charger_get_input_current(charge_get_active_chg_chip(),
+				  &input_current);
+
+	state = charge_get_state() & EC_BATT_HIST_STATE_MASK;
+	if (extpower_is_present())
+		state |= EC_BATT_HIST_AC_PRESENT;
+	if (batt->is_present != BP_YES)
+		state |= EC_BATT_HIST_NO_BATTERY;
+
+	mutex_lock(&batt_hist_lock);
+
+	if (!batt_hist_count) {
+		/* The first entry is relative to itself */
+		last->voltage = batt->voltage;
+		last->current = batt->current;
+		last->temperature = batt->temperature;
+		last->input_current = input_current;
+		batt_hist_base = *last;
+	} else if (batt_hist_count == CONFIG_BATTERY_HISTORY_ENTRIES) {
+		/* Drop the oldest entry */
+		batt_hist_apply(&batt_hist_base, &batt_hist[batt_hist_head]);
+		batt_hist_head = (batt_hist_head + 1) %
+				 CONFIG_BATTERY_HISTORY_ENTRIES;
+		batt_hist_count--;
+	}
+
+	e = &batt_hist[(batt_hist_head + batt_hist_count) %
+		       CONFIG_BATTERY_HISTORY_ENTRIES];
+	e->state = state;
+	e->rsoc = batt->state_of_charge;
+
+	v = last->voltage;
+	e->voltage = batt_hist_delta(&v, batt->voltage, EC_BATT_HIST_MV_UNIT);
+	last->voltage = v;
+	v = last->current;
+	e->current = batt_hist_delta(&v, batt->current, EC_BATT_HIST_MA_UNIT);
+	last->current = v;
+	v = last->temperature;
+	e->temperature = batt_hist_delta(&v, batt->temperature,
+					 EC_BATT_HIST_DK_UNIT);
+	last->temperature = v;
+	v = last->input_current;
+	e->input_current = batt_hist_delta(&v, input_current,
+					   EC_BATT_HIST_INPUT_MA_UNIT);
+	last->input_current = v;
+	last->state = e->state;
+	last->rsoc = e->rsoc;
+
+	batt_hist_count++;
+	batt_hist_time = get_time();
+
+	mutex_unlock(&batt_hist_lock);
+}
+DECLARE_HOOK(HOOK_SECOND, batt_hist_sample, HOOK_PRIO_DEFAULT);
+
+/*
+ * Find the sample the entry at window index @start is relative to, where
+ * the window is the newest @total entries.
+ */
+static const struct ec_battery_history_entry *batt_hist_seek(
+	int total, int start, struct ec_battery_history_sample *base)
+{
+	int i, n = batt_hist_count - total + start;
+
+	*base = batt_hist_base;
+	for (i = 0; i < n; i++)
+		batt_hist_apply(base, &batt_hist[(batt_hist_head + i) %
+					CONFIG_BATTERY_HISTORY_ENTRIES]);
+
+	return &batt_hist[(batt_hist_head + n) %
+			  CONFIG_BATTERY_HISTORY_ENTRIES];
+}
+
+static enum ec_status
+cmd_battery_history(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_battery_history *p = args->params;
+	struct ec_response_battery_history *r = args->response;
+	int total, count, i, idx;
+
+	if (args->response_max < sizeof(*r))
+		return EC_RES_INVALID_PARAM;
+
+	mutex_lock(&batt_hist_lock);
+
+	total = batt_hist_count;
+	if (p->minutes)
+		total = MIN(total, p->minutes * 60 /
+			    CONFIG_BATTERY_HISTORY_INTERVAL);
+	if (p->offset > total) {
+		mutex_unlock(&batt_hist_lock);
+		return EC_RES_INVALID_PARAM;
+	}
+
+	count = MIN(total - p->offset,
+		    (int)((args->response_max - sizeof(*r)) /
+			  sizeof(r->entries[0])));
+
+	r->interval = CONFIG_BATTERY_HISTORY_INTERVAL;
+	r->total = total;
+	r->offset = p->offset;
+	r->count = count;
+	r->age = batt_hist_count ?
+		 (get_time().val - batt_hist_time.val) / SECOND : 0;
+
+	batt_hist_seek(total, p->offset, &r->base);
+	idx = batt_hist_count - total + p->offset;
+	for (i = 0; i < count; i++)
+		r->entries[i] = batt_hist[(batt_hist_head + idx + i) %
+					  CONFIG_BATTERY_HISTORY_ENTRIES];
+
+	mutex_unlock(&batt_hist_lock);
+
+	args->response_size = sizeof(*r) + count * sizeof(r->entries[0]);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_BATTERY_HISTORY, cmd_battery_history,
+			EC_VER_MASK(0));
+
+static int cmd_batthist(int argc, char **argv)
+{
+	struct ec_battery_history_sample s;
+	const struct ec_battery_history_entry *e;
+	int n = 10, i;
+	char *tail;
+
+	if (argc > 1) {
+		n = strtoi(argv[1], &tail, 0);
+		if (*tail || n <= 0)
+			return EC_ERROR_PARAM1;
+	}
+
+	mutex_lock(&batt_hist_lock);
+
+	n = MIN(n, batt_hist_count);
+	ccprintf("%d of %d samples, every %ds\n", n, batt_hist_count,
+		 CONFIG_BATTERY_HISTORY_INTERVAL);
+	e = batt_hist_seek(n, 0, &s);
+	for (i = 0; i < n; i++) {
+		batt_hist_apply(&s, &batt_hist[(e - batt_hist + i) %
+					       CONFIG_BATTERY_HISTORY_ENTRIES]);
+		ccprintf("%4d: %5dmV %6dmA %4ddK %3d%% in %5dmA st 0x%02x\n",
+			 i - n + 1, s.voltage, s.current, s.temperature,
+			 s.rsoc, s.input_current, s.state);
+	}
+
+	mutex_unlock(&batt_hist_lock);
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(batthist, cmd_batthist, "[count]",
+			"Print the most recent battery history samples");
+#endif /* CONFIG_BATTERY_HISTORY */
@@ -11,6 +11,7 @@
 #include "common.h"
 #include "console.h"
 #include "fan.h"
+#include "fan_pid.h"
 #include "gpio.h"
 #include "hooks.h"
 #include "host_command.h"
@@ -278,3 +279,59 @@ hc_pwm_get_fan_actual_rpm(struct host_cmd_handler_args *args)
 DECLARE_HOST_COMMAND(EC_CMD_PWM_GET_FAN_ACTUAL_RPM,
 		     hc_pwm_get_fan_actual_rpm,
 		     EC_VER_MASK(0));
+
+#ifdef CONFIG_FAN_PID_CONTROL
+BUILD_ASSERT(EC_FAN_PID_MAP_SIZE == FAN_PID_MAP_SIZE);
+
+static enum ec_status
+hc_fan_pid_control(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_fan_pid_control *p = args->params;
+	struct ec_response_fan_pid_control *r = args->response;
+	struct fan_pid_tunables *t = &fan_pid_tunables;
+	const struct fan_pid *pid;
+	int i;
+
+	if (FAN_CH_COUNT == 0)
+		return EC_RES_UNAVAILABLE;
+
+	if ((p->flags & EC_FAN_PID_DISABLE) && (p->flags & EC_FAN_PID_ENABLE))
+		return EC_RES_INVALID_PARAM;
+
+	if (p->flags & EC_FAN_PID_SET_TUNABLES) {
+		if (p->tunables.kp < 0 || p->tunables.ki < 0 ||
+		    p->tunables.kd < 0 || p->tunables.duty_min > 100)
+			return EC_RES_INVALID_PARAM;
+		t->setpoint = p->tunables.setpoint;
+		t->kp = p->tunables.kp;
+		t->ki = p->tunables.ki;
+		t->kd = p->tunables.kd;
+		t->duty_min = p->tunables.duty_min;
+		t->learn_settle = p->tunables.learn_settle;
+	}
+
+	if (p->flags & EC_FAN_PID_DISABLE)
+		fan_pid_enable(0);
+	else if (p->flags & EC_FAN_PID_ENABLE)
+		fan_pid_enable(1);
+
+	pid = fan_pid_get(0);
+	r->enabled = fan_pid_is_enabled();
+	r->duty = pid->duty;
+	r->rpm_target = pid->rpm_target;
+	r->tunables.setpoint = t->setpoint;
+	r->tunables.kp = t->kp;
+	r->tunables.ki = t->ki;
+	r->tunables.kd = t->kd;
+	r->tunables.duty_min = t->duty_min;
+	r->tunables.learn_settle = t->learn_settle;
+	for (i = 0; i < FAN_PID_MAP_SIZE; i++)
+		r->rpm_map[i] = pid->rpm_map[i];
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_FAN_PID_CONTROL,
+		     hc_fan_pid_control,
+		     EC_VER_MASK(0));
+#endif /* CONFIG_FAN_PID_CONTROL */
@@ -3,69 +3,252 @@
  * found in the LICENSE file.
  */
 
+/*
+ * Flags are kept as a log of records over a ring of SPI flash sectors.
+ * A commit appends one record per changed flag to the newest sector, a
+ * single page program. Once the newest sector is full, the oldest one is
+ * erased and started with a snapshot of the flags, so that only the newest
+ * sector has to be replayed and the erases go round the ring.
+ */
+
 #include "util.h"
 #include "hooks.h"
+#include "task.h"
+#include "timer.h"
 
 #include "board.h"
 #include "gpio.h"
 
 #include "spi.h"
-#include "spi_chip.h"
 #include "spi_flash.h"
 
 #include "flash_storage.h"
 
+#define CPRINTS(format, args...) cprints(CC_SYSTEM, format, ## args)
+#define CPRINTF(format, args...) cprintf(CC_SYSTEM, format, ## args)
 
+#define LOG_SECTOR_ADDR(i) (SPI_FLAGS_REGION + (i) * SPI_FLAGS_SECTOR_SIZE)
 
+/* The log stays clear of the EC images and within the SPI flash */
+#ifdef CONFIG_SPI_FLASH
+BUILD_ASSERT(SPI_FLAGS_REGION >= CONFIG_EC_WRITABLE_STORAGE_OFF +
+				 CONFIG_EC_WRITABLE_STORAGE_SIZE);
+BUILD_ASSERT(SPI_FLAGS_REGION + SPI_FLAGS_REGION_SIZE <= CONFIG_FLASH_SIZE);
+#endif
+#define LOG_RECORD_SIZE sizeof(struct ec_flash_log_record)
+/* Records read per SPI transaction while replaying */
+#define LOG_READ_RECORDS 32
 
+/* Flags as updated, and as last committed to the log */
+static uint8_t flags[FLASH_FLAGS_MAX];
+static uint8_t flash_flags[FLASH_FLAGS_MAX];
+static bool flags_loaded;
 
+/* Newest log sector, its sequence number and where the next record goes */
+static int log_sector;
+static uint32_t log_seq;
+static int log_ofs;
 
-#define CPRINTS(format, args...) cprints(CC_SYSTEM, format, ## args)
-#define CPRINTF(format, args...) cprintf(CC_SYSTEM, format, ## args)
+static struct ec_flash_log_record records[FLASH_FLAGS_MAX];
+static struct mutex flash_storage_lock;
 
-static struct ec_flash_flags_info current_flags;
-bool flash_storage_dirty;
+static bool record_valid(const struct ec_flash_log_record *rec)
+{
+	return rec->idx < FLASH_FLAGS_MAX &&
+		rec->idx_inv == (uint8_t)~rec->idx &&
+		rec->value_inv == (uint8_t)~rec->value;
+}
 
-bool check_flags_valid_header(void)
+static bool record_erased(const struct ec_flash_log_record *rec)
 {
-	if (current_flags.magic != FLASH_FLAGS_MAGIC ||
-		current_flags.length != (sizeof(current_flags) - 8) ||
-		current_flags.version != FLASH_FLAGS_VERSION) {
-		return false;
-	} else {
-		return true;
+	return rec->idx == 0xFF && rec->value == 0xFF &&
+		rec->idx_inv == 0xFF && rec->value_inv == 0xFF;
+}
+
+static void record_set(struct ec_flash_log_record *rec, int idx, uint8_t v)
+{
+	rec->idx = idx;
+	rec->value = v;
+	rec->idx_inv = ~idx;
+	rec->value_inv = ~v;
+}
+
+/*
+ * Apply the records of the newest sector on top of the defaults. Torn
+ * records are skipped, and so are erased ones: a failed append may have
+ * left a gap before the records of its retry. The next record goes after
+ * the last one that is not erased.
+ */
+static int flash_log_replay(void)
+{
+	struct ec_flash_log_record rec[LOG_READ_RECORDS];
+	int ofs, n, i, rv;
+
+	log_ofs = sizeof(struct ec_flash_log_header);
+
+	for (ofs = sizeof(struct ec_flash_log_header);
+	     ofs < SPI_FLAGS_SECTOR_SIZE; ofs += n * LOG_RECORD_SIZE) {
+		n = MIN(LOG_READ_RECORDS,
+			(SPI_FLAGS_SECTOR_SIZE - ofs) / LOG_RECORD_SIZE);
+		rv = spi_flash_read((void *)rec,
+				    LOG_SECTOR_ADDR(log_sector) + ofs,
+				    n * LOG_RECORD_SIZE);
+		if (rv != EC_SUCCESS)
+			return rv;
+
+		for (i = 0; i < n; i++) {
+			if (record_erased(&rec[i]))
+				continue;
+			if (record_valid(&rec[i]))
+				flash_flags[rec[i].idx] = rec[i].value;
+			log_ofs = ofs + (i + 1) * LOG_RECORD_SIZE;
+		}
 	}
+
+	return EC_SUCCESS;
 }
 
-void flash_storage_load_defaults(void)
+/*
+ * No log yet: carry over the flags from the old single sector structure.
+ * The log starts in the sector after it, as if that one was full.
+ */
+static int flash_log_import(void)
 {
+	struct ec_flash_flags_info old;
+	int rv;
+
+	log_sector = 0;
+	log_seq = 0;
+	log_ofs = SPI_FLAGS_SECTOR_SIZE;
+
+	rv = spi_flash_read((void *)&old, SPI_FLAGS_REGION, sizeof(old));
+	if (rv != EC_SUCCESS)
+		return rv;
+
+	if (old.magic == FLASH_FLAGS_MAGIC &&
+		old.length == (sizeof(old) - 8) &&
+		old.version == FLASH_FLAGS_VERSION) {
+		CPRINTS("Importing flash flags, update:%d", old.update_number);
+		memcpy(flags, old.flags, sizeof(flags));
+	} else {
 		CPRINTS("Init flash storage to defaults");
-		memset(&current_flags, 0x00, sizeof(current_flags));
-		current_flags.magic = FLASH_FLAGS_MAGIC;
-		current_flags.length = (sizeof(current_flags) - 8);
-		current_flags.version = FLASH_FLAGS_VERSION;
-		flash_storage_dirty = true;
+	}
+
+	return EC_SUCCESS;
 }
 
-int flash_storage_initialize(void)
+/*
+ * Start the next sector of the ring with a snapshot of the flags. Its header
+ * goes last, until then the sector is ignored and the old one stays newest.
+ */
+static int flash_log_compact(void)
 {
+	struct ec_flash_log_header hdr;
+	int next = (log_sector + 1) % SPI_FLAGS_SECTORS;
+	int n = 0;
+	int i, rv;
+
+	rv = spi_flash_erase(LOG_SECTOR_ADDR(next), SPI_FLAGS_SECTOR_SIZE);
+	if (rv != EC_SUCCESS) {
+		CPRINTS("SPI fail to erase");
+		return rv;
+	}
 
-	int rv;
+	/* Defaults are 0 and need no record */
+	for (i = 0; i < FLASH_FLAGS_MAX; i++) {
+		if (flags[i])
+			record_set(&records[n++], i, flags[i]);
+	}
+	if (n) {
+		rv = spi_flash_write(LOG_SECTOR_ADDR(next) + sizeof(hdr),
+				     n * LOG_RECORD_SIZE, (void *)records);
+		if (rv != EC_SUCCESS)
+			goto fail;
+	}
+
+	hdr.magic = FLASH_LOG_MAGIC;
+	hdr.seq = log_seq + 1;
+	hdr.seq_inv = ~hdr.seq;
+	hdr.reserved = 0xFFFFFFFF;
+	rv = spi_flash_write(LOG_SECTOR_ADDR(next), sizeof(hdr), (void *)&hdr);
+	if (rv != EC_SUCCESS)
+		goto fail;
+
+	log_sector = next;
+	log_seq = hdr.seq;
+	log_ofs = sizeof(hdr) + n * LOG_RECORD_SIZE;
+	return EC_SUCCESS;
+
+fail:
+	CPRINTS("SPI fail to write");
+	return rv;
+}
+
+/* Called with flash_storage_lock held */
+static int flash_storage_load(void)
+{
+	struct ec_flash_log_header hdr;
+	int rv = EC_SUCCESS;
+	int i;
+
+	memset(flags, 0x00, sizeof(flags));
+	memset(flash_flags, 0x00, sizeof(flash_flags));
+	log_sector = -1;
 
 	spi_mux_control(1);
 
-	rv = spi_flash_read((void *)&current_flags, SPI_FLAGS_REGION, sizeof(current_flags));
-	if (rv != EC_SUCCESS)
-		CPRINTS("Could not load flash storage");
+	for (i = 0; i < SPI_FLAGS_SECTORS; i++) {
+		rv = spi_flash_read((void *)&hdr, LOG_SECTOR_ADDR(i),
+				    sizeof(hdr));
+		if (rv != EC_SUCCESS)
+			break;
+		if (hdr.magic != FLASH_LOG_MAGIC || hdr.seq != ~hdr.seq_inv)
+			continue;
+		if (log_sector < 0 || (int32_t)(hdr.seq - log_seq) > 0) {
+			log_sector = i;
+			log_seq = hdr.seq;
+		}
+	}
+
+	if (rv == EC_SUCCESS && log_sector >= 0) {
+		rv = flash_log_replay();
+		memcpy(flags, flash_flags, sizeof(flags));
+	} else if (rv == EC_SUCCESS) {
+		rv = flash_log_import();
+	}
 
 	spi_mux_control(0);
 
-	/*Check structure is valid*/
-	if (check_flags_valid_header() == false) {
-		CPRINTS("loading flash default flags");
-		flash_storage_load_defaults();
+	if (rv != EC_SUCCESS) {
+		/* The next commit starts a new sector from the defaults */
+		CPRINTS("Could not load flash storage");
+		memset(flags, 0x00, sizeof(flags));
+		log_sector = 0;
+		log_ofs = SPI_FLAGS_SECTOR_SIZE;
 	}
 
+	flags_loaded = true;
+	return rv;
+}
+
+void flash_storage_load_defaults(void)
+{
+	mutex_lock(&flash_storage_lock);
+	if (!flags_loaded)
+		flash_storage_load();
+	CPRINTS("Init flash storage to defaults");
+	memset(flags, 0x00, sizeof(flags));
+	mutex_unlock(&flash_storage_lock);
+}
+
+int flash_storage_initialize(void)
+{
+	int rv;
+
+	mutex_lock(&flash_storage_lock);
+	rv = flash_storage_load();
+	mutex_unlock(&flash_storage_lock);
+
 	return rv;
 }
 
@@ -74,67 +257,75 @@ int flash_storage_update(enum ec_flash_flags_idx idx, uint8_t v)
 	if (idx >= FLASH_FLAGS_MAX)
 		return EC_ERROR_PARAM1;
 
-	if (check_flags_valid_header() == false)
-		flash_storage_initialize();
+	mutex_lock(&flash_storage_lock);
+	if (!flags_loaded)
+		flash_storage_load();
+	flags[idx] = v;
+	mutex_unlock(&flash_storage_lock);
 
-	if (current_flags.flags[idx] != v) {
-		current_flags.flags[idx] = v;
-		flash_storage_dirty = true;
-	}
 	return EC_SUCCESS;
 }
 
 int flash_storage_commit(void)
 {
+	timestamp_t start = get_time();
 	int rv = EC_SUCCESS;
+	int n = 0;
+	int i;
 
-	if (check_flags_valid_header() == false)
-		flash_storage_initialize();
-
-	if (flash_storage_dirty) {
-
-		spi_mux_control(1);
+	mutex_lock(&flash_storage_lock);
 
-		rv = spi_flash_erase(SPI_FLAGS_REGION, 0x1000);
+	if (!flags_loaded)
+		flash_storage_load();
 
-		if (rv != EC_SUCCESS) {
-			CPRINTS("SPI fail to erase");
-			goto fail;
-		}
-
-		current_flags.update_number += 1;
+	for (i = 0; i < FLASH_FLAGS_MAX; i++) {
+		if (flags[i] != flash_flags[i])
+			record_set(&records[n++], i, flags[i]);
+	}
+	if (!n)
+		goto out;
 
-		rv = spi_flash_write(SPI_FLAGS_REGION,
-								sizeof(current_flags),
-								(void *)&current_flags);
+	spi_mux_control(1);
 
-		if (rv != EC_SUCCESS) {
+	if (log_ofs + n * LOG_RECORD_SIZE > SPI_FLAGS_SECTOR_SIZE) {
+		rv = flash_log_compact();
+	} else {
+		rv = spi_flash_write(LOG_SECTOR_ADDR(log_sector) + log_ofs,
+				     n * LOG_RECORD_SIZE, (void *)records);
+		if (rv != EC_SUCCESS)
 			CPRINTS("SPI fail to write");
-			goto fail;
-		}
+		/* Skip whatever got programmed, even on failure */
+		log_ofs += n * LOG_RECORD_SIZE;
+	}
 
-		CPRINTS("%s, update:%d", __func__, current_flags.update_number);
+	spi_mux_control(0);
 
-		spi_mux_control(0);
-		flash_storage_dirty = false;
+	if (rv == EC_SUCCESS) {
+		memcpy(flash_flags, flags, sizeof(flash_flags));
+		CPRINTS("%s, sector:%d seq:%d ofs:%d, %d us", __func__,
+			log_sector, log_seq, log_ofs,
+			(int)(get_time().val - start.val));
 	}
 
-	return rv;
-
-fail:
-	spi_mux_control(0);
+out:
+	mutex_unlock(&flash_storage_lock);
 	return rv;
 }
 
 int flash_storage_get(enum ec_flash_flags_idx idx)
 {
+	int v;
+
 	if (idx >= FLASH_FLAGS_MAX)
 		return -1;
 
-	if (check_flags_valid_header() == false)
-		flash_storage_initialize();
+	mutex_lock(&flash_storage_lock);
+	if (!flags_loaded)
+		flash_storage_load();
+	v = flags[idx];
+	mutex_unlock(&flash_storage_lock);
 
-	return current_flags.flags[idx];
+	return v;
 }
 
 static int cmd_flash_flags(int argc, char **argv)
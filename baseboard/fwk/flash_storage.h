@@ -8,7 +8,16 @@
 #ifndef __CROS_EC_FLASHSTORAGE_H
 #define __CROS_EC_FLASHSTORAGE_H
 
+/*
+ * The flags log is a ring of sectors from SPI_FLAGS_REGION, 0x80000-0x83FFF.
+ * The EC images take the first half of the 1 MB SPI flash, up to the end of
+ * CONFIG_EC_WRITABLE_STORAGE; the flags are the only data the EC keeps in
+ * the second half, and it is not shared with the host.
+ */
 #define SPI_FLAGS_REGION (0x80000)
+#define SPI_FLAGS_SECTOR_SIZE (0x1000)
+#define SPI_FLAGS_SECTORS (4)
+#define SPI_FLAGS_REGION_SIZE (SPI_FLAGS_SECTORS * SPI_FLAGS_SECTOR_SIZE)
 
 enum ec_flash_flags_idx {
 	FLASH_FLAGS_ACPOWERON = 0,
@@ -19,6 +28,10 @@ enum ec_flash_flags_idx {
 #define FLASH_FLAGS_MAGIC (0xF1A3)
 #define FLASH_FLAGS_VERSION (0x1)
 
+/*
+ * Flags as stored before the log, in the first sector of SPI_FLAGS_REGION.
+ * Only read to carry the flags over into the log.
+ */
 struct ec_flash_flags_info {
 	/* Header */
 	uint32_t magic; /* 0xF1A3 */
@@ -34,6 +47,36 @@ struct ec_flash_flags_info {
 
 } __ec_align1;
 
+#define FLASH_LOG_MAGIC (0x464C4F47) /* "FLOG" */
+
+/* Start of a log sector, written once the snapshot after it is complete */
+struct ec_flash_log_header {
+	uint32_t magic; /* FLASH_LOG_MAGIC */
+	/* Incremented for each new sector, the highest is the newest */
+	uint32_t seq;
+	uint32_t seq_inv; /* ~seq */
+	uint32_t reserved;
+} __ec_align1;
+
+/*
+ * A flag update. The second half is the complement of the first, so a
+ * record whose page program was cut short does not check out.
+ */
+struct ec_flash_log_record {
+	uint8_t idx;
+	uint8_t value;
+	uint8_t idx_inv;
+	uint8_t value_inv;
+} __ec_align1;
+
+/**
+ * @brief Load the flags from flash, replaying the newest log sector
+ *
+ * @return int EC_SUCCESS, or the SPI flash error; the flags are then the
+ * defaults
+ */
+int flash_storage_initialize(void);
+
 /**
  * @brief Update flags value at idx, but does not write to flash
  *
@@ -44,9 +87,14 @@ struct ec_flash_flags_info {
 int flash_storage_update(enum ec_flash_flags_idx idx, uint8_t v);
 
 /**
- * @brief Commits storage if dirty
+ * @brief Commits storage if dirty, appending a record per changed flag
+ * to the flash log
  *
- * @return int EC_SUCCESS
+ * Called from the hook task while the host erases or writes the SPI flash
+ * asynchronously, this fails with EC_ERROR_BUSY; the flags stay dirty and
+ * go out with the next commit.
+ *
+ * @return int EC_SUCCESS, or the SPI flash error
  */
 int flash_storage_commit(void);
 
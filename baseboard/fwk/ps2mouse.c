@@ -19,6 +19,7 @@
 #include "i2c.h"
 #include "timer.h"
 #include "keyboard_8042.h"
+#include "math_util.h"
 #include "ps2mouse.h"
 #include "power.h"
 #include "diagnostics.h"
@@ -42,6 +43,38 @@ static uint8_t ec_mode_disabled;
 static uint8_t detected_host_packet = true;
 static uint8_t emumouse_task_id;
 static uint8_t aux_data;
+/*
+ * Time of the touchpad interrupt behind the next input report, or 0. Only
+ * stamped while the EC owns the touchpad; see tp_int_claim().
+ */
+static uint64_t tp_int_time;
+
+/*
+ * Movement packets decoded from touchpad reports, waiting for room in the aux
+ * queue. Only used from the mouse task.
+ */
+struct ps2m_packet {
+	int16_t x;
+	int16_t y;
+	uint8_t buttons;
+	/* Touchpad interrupt of the oldest report in the packet */
+	uint64_t time;
+};
+static struct ps2m_packet ps2m_ring[PS2M_RING_SIZE];
+static uint8_t ps2m_head;
+static uint8_t ps2m_tail;
+
+static struct {
+	uint32_t reports;	/* Input reports read */
+	uint32_t errors;	/* Input report reads failed */
+	uint32_t packets;	/* Packets sent to the host */
+	uint32_t coalesced;	/* Reports merged into a waiting packet */
+	uint32_t dropped;	/* Packets dropped, host too far behind */
+	uint32_t lat_max;	/* Interrupt to aux queue, us */
+	uint64_t lat_total;
+	timestamp_t since;
+} ps2m_stats;
+
 void send_data_byte(uint8_t data) {
 	int timeout = 0;
 
@@ -76,6 +109,118 @@ void send_movement_packet(void)
 	}
 }
 
+static int ps2m_count(void)
+{
+	return (uint8_t)(ps2m_tail - ps2m_head);
+}
+
+static void ps2m_flush(void)
+{
+	ps2m_head = ps2m_tail;
+}
+
+static int16_t ps2m_clamp(int v)
+{
+	return MIN(255, MAX(v, -255));
+}
+
+/*
+ * Queue a movement report. While the host is behind, motion is added to the
+ * newest waiting packet as long as the buttons are the same, so the pointer
+ * still ends up in the right place.
+ */
+static void ps2m_queue(uint8_t buttons, int x, int y, uint64_t time)
+{
+	struct ps2m_packet *p;
+
+	if (ps2m_count()) {
+		p = &ps2m_ring[(uint8_t)(ps2m_tail - 1) % PS2M_RING_SIZE];
+		if (p->buttons == buttons &&
+		    (ps2m_count() == PS2M_RING_SIZE ||
+		     (ABS(p->x + x) <= 255 && ABS(p->y + y) <= 255))) {
+			p->x = ps2m_clamp(p->x + x);
+			p->y = ps2m_clamp(p->y + y);
+			ps2m_stats.coalesced++;
+			return;
+		}
+	}
+
+	if (ps2m_count() == PS2M_RING_SIZE) {
+		ps2m_stats.dropped++;
+		return;
+	}
+
+	p = &ps2m_ring[ps2m_tail++ % PS2M_RING_SIZE];
+	p->x = ps2m_clamp(x);
+	p->y = ps2m_clamp(y);
+	p->buttons = buttons;
+	p->time = time;
+}
+
+/*
+ * Send as many waiting packets as fit in the aux queue, back to back.
+ */
+static void ps2m_drain(void)
+{
+	struct ps2m_packet *p;
+	uint64_t now = get_time().val;
+	uint32_t lat;
+	int len = five_button_mode ? 4 : 3;
+	int i;
+
+	/* Let a host command and its response go first */
+	if (*task_get_event_bitmap(emumouse_task_id) & PS2MOUSE_EVT_AUX_DATA)
+		return;
+
+	while (ps2m_count()) {
+		p = &ps2m_ring[ps2m_head % PS2M_RING_SIZE];
+
+		if (now - p->time > PS2M_STALE_US) {
+			/* drop mouse packet - host is too far behind */
+			CPRINTS("PS2M Dropping");
+			ps2m_stats.dropped++;
+			ps2m_head++;
+			continue;
+		}
+
+		if (aux_buffer_available() < len)
+			break;
+
+		current_pos[0] = 0x08 | (p->buttons & 0x03);
+		if (p->x & 0x100)
+			current_pos[0] |= X_SIGN;
+		if (p->y & 0x100)
+			current_pos[0] |= Y_SIGN;
+		current_pos[1] = p->x;
+		current_pos[2] = p->y;
+		for (i = 0; i < len; i++)
+			send_aux_data_to_host_interrupt(current_pos[i]);
+
+		lat = now - p->time;
+		ps2m_stats.lat_max = MAX(ps2m_stats.lat_max, lat);
+		ps2m_stats.lat_total += lat;
+		ps2m_stats.packets++;
+		ps2m_head++;
+	}
+}
+
+/*
+ * Take the touchpad interrupt time for the next report and clear it. Also
+ * used to drop it when the touchpad changes hands, so that a report is not
+ * timed from an interrupt the host took.
+ */
+static uint64_t tp_int_claim(void)
+{
+	uint64_t t;
+
+	interrupt_disable();
+	t = tp_int_time;
+	tp_int_time = 0;
+	interrupt_enable();
+
+	return t;
+}
+
 void send_aux_data_to_device(uint8_t data)
 {
 	aux_data = data;
@@ -87,6 +232,8 @@ void process_request(uint8_t data)
 	if (ec_mode_disabled) {
 		return;
 	}
+	/* Movement not yet sent is stale once the host sends a command */
+	ps2m_flush();
 	switch (mouse_state) {
 	case PS2MSTATE_RESET:
 		send_data_byte(PS2MOUSE_ACKNOWLEDGE);
@@ -227,6 +374,8 @@ void touchpad_interrupt(enum gpio_signal signal)
 		return;
 	}
 	if (!detected_host_packet) {
+		if (!tp_int_time)
+			tp_int_time = now.val;
 		task_set_event(emumouse_task_id, PS2MOUSE_EVT_INTERRUPT, 0);
 		unprocessed_tp_int_count = 0;
 	} else {
@@ -334,13 +483,13 @@ DECLARE_DEFERRED(retry_tp_read_evt_deferred);
 static int inreport_retries;
 void read_touchpad_in_report(void)
 {
+	static uint8_t data[128];
 	int rv = EC_SUCCESS;
 	int need_reset = 0;
-	uint8_t data[128];
 	int xfer_len = 0;
 	int report_mode = PS2MOUSE_REPORT_UNKNOWN;
 	int16_t x, y;
-	uint8_t response_byte = 0x08;
+	uint64_t int_time;
 
 	/* Make sure report id is set to an invalid value */
 	data[2] = 0;
@@ -348,6 +497,10 @@ void read_touchpad_in_report(void)
 	if (power_get_state() == POWER_S5)
 		return;
 
+	int_time = tp_int_claim();
+	if (!int_time)
+		int_time = get_time().val;
+
 	/*dont trigger disable state during our own transactions*/
 	gpio_disable_interrupt(GPIO_EC_I2C_3_SDA);
 	/* need to disable SOC_TP_INT_L if we need to setup touchpad */
@@ -383,6 +536,7 @@ read_failed:
 		/* sometimes we get a read failed for unknown reason to try again in a while
 		 * to recover
 		 */
+		ps2m_stats.errors++;
 		inreport_retries++;
 		if (inreport_retries > 10) {
 			/* try again some other time later if the TP keeps interrupting us */
@@ -400,6 +554,7 @@ read_failed:
 		}
 
 	} else {
+		ps2m_stats.reports++;
 		inreport_retries = 0;
 	}
 	i2c_lock(I2C_PORT_TOUCHPAD, 0);
@@ -431,23 +586,9 @@ read_failed:
 			x = (int16_t)(data[4] + (data[5] << 8));
 			y = -(int16_t)(data[6] + (data[7] << 8));
 		}
-		x = MIN(255, MAX(x, -255));
-		y = MIN(255, MAX(y, -255));
 		/*button data*/
-		response_byte |= data[3] & 0x03;
-		if ((x & 0xFFFFFE00) != 0 && (x & 0xFFFFFE00) != 0xFFFFFE00)
-			response_byte |= X_OVERFLOW;
-		if (x & 0x100)
-			response_byte |= X_SIGN;
-		if ((y & 0xFFFFFE00) != 0 && (y & 0xFFFFFE00) != 0xFFFFFE00)
-			response_byte |= Y_OVERFLOW;
-		if (y & 0x100)
-			response_byte |= Y_SIGN;
-		/*CPRINTS("Mouse Packet: 0x%02x %d, %d", response_byte, x, y);*/
-		current_pos[0] = response_byte;
-		current_pos[1] = x;
-		current_pos[2] = y;
-		send_movement_packet();
+		ps2m_queue(data[3] & 0x03, x, y, int_time);
+		ps2m_drain();
 	}
 
 	if (need_reset) {
@@ -468,8 +609,10 @@ void mouse_interrupt_handler_task(void *p)
 	int i;
 
 	emumouse_task_id = task_get_current();
+	ps2m_stats.since = get_time();
 	while (1) {
-		evt = task_wait_event(-1);
+		/* Poll for room in the aux queue while packets are waiting */
+		evt = task_wait_event(ps2m_count() ? PS2M_DRAIN_POLL_US : -1);
 		/*host disabled this*/
 		if (evt & PS2MOUSE_EVT_HC_DISABLE && ec_mode_disabled == false) {
 			ec_mode_disabled = true;
@@ -524,6 +667,8 @@ void mouse_interrupt_handler_task(void *p)
 					gpio_enable_interrupt(GPIO_SOC_TP_INT_L);
 					gpio_enable_interrupt(GPIO_EC_I2C_3_SDA);
 				}
+				if (power_state == POWER_S3S0)
+					tp_int_claim();
 				if ((power_state == POWER_S3S0) && gpio_get_level(GPIO_SOC_TP_INT_L) == 0) {
 					read_touchpad_in_report();
 				}
@@ -536,12 +681,16 @@ void mouse_interrupt_handler_task(void *p)
 			}
 			if (evt & PS2MOUSE_EVT_REENABLE) {
 				CPRINTS("PS2M renabling");
+				tp_int_claim();
 				set_power(false);
 				set_reset();
 				setup_touchpad();
 				gpio_enable_interrupt(GPIO_SOC_TP_INT_L);
 				gpio_enable_interrupt(GPIO_EC_I2C_3_SDA);
 			}
+			ps2m_drain();
+		} else {
+			ps2m_flush();
 		}
 	}
 }
@@ -562,6 +711,27 @@ static int command_emumouse(int argc, char **argv)
 		detected_host_packet = true;
 		task_set_event(emumouse_task_id, PS2MOUSE_EVT_REENABLE, 0);
 	}
+	if (argc >= 2 && !strncmp(argv[1], "stat", 4)) {
+		uint64_t t = get_time().val - ps2m_stats.since.val;
+		int rate = t ? (uint64_t)ps2m_stats.packets * SECOND / t : 0;
+
+		if (argc == 3 && !strncasecmp(argv[2], "reset", 5)) {
+			memset(&ps2m_stats, 0, sizeof(ps2m_stats));
+			ps2m_stats.since = get_time();
+			return EC_SUCCESS;
+		}
+		ccprintf("reports %d errors %d\n",
+			 ps2m_stats.reports, ps2m_stats.errors);
+		ccprintf("packets %d (%d/s) coalesced %d dropped %d queued %d\n",
+			 ps2m_stats.packets, rate,
+			 ps2m_stats.coalesced, ps2m_stats.dropped,
+			 ps2m_count());
+		ccprintf("latency avg %d max %d us\n",
+			 ps2m_stats.packets ? (int)(ps2m_stats.lat_total /
+						    ps2m_stats.packets) : 0,
+			 ps2m_stats.lat_max);
+		return EC_SUCCESS;
+	}
 	if (argc < 4) {
 		CPRINTS("mouse state 0x%x data_report: 0x%x btn:0x%x", mouse_state, data_report_en, button_state);
 		CPRINTS("X:0x%x Y:0x%x Z:0x%x ", current_pos[0], current_pos[1], current_pos[2]);
@@ -600,5 +770,5 @@ static int command_emumouse(int argc, char **argv)
 	return EC_SUCCESS;
 }
 DECLARE_CONSOLE_COMMAND(emumouse, command_emumouse,
-		"emumouse buttons posx posy",
+		"emumouse [buttons posx posy | stat [reset] | int | res]",
 		"Emulate ps2 mouse events on the 8042 aux channel");
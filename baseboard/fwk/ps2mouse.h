@@ -78,6 +78,13 @@ enum ps2_mouse_report_mode {
 
 #define AUX_BUFFER_FULL_RETRIES 25
 
+/* Movement packets that can wait for the host, a power of two */
+#define PS2M_RING_SIZE 8
+/* How often to retry sending waiting packets while the aux queue is full */
+#define PS2M_DRAIN_POLL_US (2 * MSEC)
+/* Drop packets the host has not taken after this long */
+#define PS2M_STALE_US (250 * MSEC)
+
 enum pixart_pct3854_regs {
 	PCT3854_DESCRIPTOR	= 0x0020,
 	PCT3854_REPORT_DESC	= 0x0021,
@@ -58,6 +58,7 @@
 /* Add commands to read/write ec serial data structure */
 #ifdef CONFIG_CHIPSET_DEBUG
 #define CONFIG_SYSTEMSERIAL_DEBUG
+#define CONFIG_SW_CRC
 #endif
 
 /*
@@ -911,6 +911,8 @@ static void charger_chips_init(void)
 		}
 
 
+	charger_invalidate_set_cache();
+
 	for (chip = 0; chip < board_get_charger_chip_count(); chip++) {
 		if (chg_chips[chip].drv->init)
 			chg_chips[chip].drv->init(chip);
@@ -999,25 +1001,32 @@ const struct temp_sensor_t temp_sensors[] = {
 		.name = "F75303_Local",
 		.type = TEMP_SENSOR_TYPE_BOARD,
 		.read = f75303_get_val,
-		.idx = F75303_IDX_LOCAL
+		.idx = F75303_IDX_LOCAL,
+		.update = f75303_update_val,
 	},
 	[TEMP_SENSOR_CPU] = {
 		.name = "F75303_CPU",
 		.type = TEMP_SENSOR_TYPE_CPU,
 		.read = f75303_get_val,
-		.idx = F75303_IDX_REMOTE2
+		.idx = F75303_IDX_REMOTE2,
+		.update = f75303_update_val,
+		.period_ms = 500,
+		.phase_ms = 150,
 	},
 	[TEMP_SENSOR_DDR] = {
 		.name = "F75303_DDR",
 		.type = TEMP_SENSOR_TYPE_BOARD,
 		.read = f75303_get_val,
-		.idx = F75303_IDX_REMOTE1
+		.idx = F75303_IDX_REMOTE1,
+		.update = f75303_update_val,
+		.phase_ms = 300,
 	},
 	[TEMP_SENSOR_BATTERY] = {
 		.name = "Battery",
 		.type = TEMP_SENSOR_TYPE_BATTERY,
 		.read = charge_get_battery_temp,
-		.idx = 0
+		.idx = 0,
+		.phase_ms = 450,
 	},
 #ifdef CONFIG_PECI
 	[TEMP_SENSOR_PECI] = {
@@ -1025,13 +1034,17 @@ const struct temp_sensor_t temp_sensors[] = {
 		.type = TEMP_SENSOR_TYPE_CPU,
 		.read = peci_over_espi_temp_sensor_get_val,
 		.idx = 0,
+		.update = peci_over_espi_temp_sensor_update,
+		.phase_ms = 600,
 	},
 #endif /* CONFIG_PECI */
 	[TEMP_SENSOR2_REMOTE] = {
 		.name = "F75397_VCCGT",
 		.type = TEMP_SENSOR_TYPE_BOARD,
 		.read = f75397_get_val,
-		.idx = F75397_IDX_REMOTE1
+		.idx = F75397_IDX_REMOTE1,
+		.update = f75397_update_val,
+		.phase_ms = 800,
 	},
 };
 BUILD_ASSERT(ARRAY_SIZE(temp_sensors) == TEMP_SENSOR_COUNT);
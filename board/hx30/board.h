@@ -43,7 +43,11 @@
 #define CONFIG_KEYBOARD_CUSTOMIZATION_COMBINATION_KEY
 
 /* The Fn key function not ready yet undefined it until the function finish */
-#define CONFIG_KEYBOARD_SCANCODE_CALLBACK
+#define CONFIG_KEYBOARD_BOARD_SCANCODES
+#define CONFIG_KEYBOARD_LATENCY
+/* Room for macro playback and typematic repeat while the host is busy */
+#undef CONFIG_KEYBOARD_TO_HOST_QUEUE_SIZE
+#define CONFIG_KEYBOARD_TO_HOST_QUEUE_SIZE 64
 
 #define CONFIG_KEYBOARD_BACKLIGHT
 /*Assume we should move to CONFIG_PWM_KBLIGHT later*/
@@ -58,6 +62,7 @@
 /* Add commands to read/write ec serial data structure */
 #ifdef CONFIG_CHIPSET_DEBUG
 #define CONFIG_SYSTEMSERIAL_DEBUG
+#define CONFIG_SW_CRC
 #endif
 
 /*
@@ -66,6 +71,9 @@
  * #define CONFIG_MCHP_LFW_DEBUG
  */
 
+/* LFW loads EC_RO/RW with quad I/O reads */
+#define CONFIG_MCHP_LFW_QUAD_LOAD
+
 
 /*
  * Override Boot-ROM JTAG mode
@@ -164,6 +172,8 @@
 
 #define CONFIG_BATTERY_CUT_OFF
 #define CONFIG_BATTERY_SMART
+#define CONFIG_BATTERY_SMART_CACHE
+#define CONFIG_BATTERY_HISTORY
 #define CONFIG_BATTERY_PRESENT_CUSTOM
 #define CONFIG_BOARD_VERSION_CUSTOM
 #define CONFIG_CHARGE_MANAGER
@@ -179,6 +189,7 @@
 
 /* Charger parameter */
 #define CONFIG_CHARGER_ISL9241
+#define CONFIG_CHARGER_SKIP_REDUNDANT_WRITES
 #define CONFIG_CHARGER_SENSE_RESISTOR_AC 20 /* BOARD_RS1 */
 #define CONFIG_CHARGER_SENSE_RESISTOR 10    /* BOARD_RS2 */
 #define CONFIG_CHARGER_INPUT_CURRENT 500	/* Minimum for USB - will negociate higher */
@@ -329,6 +340,8 @@
  */
 #define CONFIG_SPI_FLASH_PORT 0
 #define CONFIG_SPI_FLASH
+/* Chain SPI flash reads through the QMSPI descriptors */
+#define CONFIG_SPI_CHAIN
 
 /*
  * MB use W25Q80 SPI ROM
@@ -336,6 +349,12 @@
  */
 #define CONFIG_FLASH_SIZE 0x100000
 #define CONFIG_SPI_FLASH_W25Q80
+
+/* Host async flash erase runs without blocking the HOSTCMD or HOOKS task */
+#define CONFIG_FLASH_DEFERRED_ERASE
+#define CONFIG_SPI_FLASH_ASYNC
+/* Host flash writes are programmed while the next chunk comes in */
+#define CONFIG_FLASH_POSTED_WRITE
 #define SPI_BIOS_SETUP 0x00
 
 #define BIOS_SETUP_AC_BOOT	BIT(0)
@@ -387,6 +406,8 @@
 #undef  CONFIG_BATTERY_CRITICAL_SHUTDOWN_TIMEOUT
 #define CONFIG_BATTERY_CRITICAL_SHUTDOWN_TIMEOUT 5
 #define CHARGE_MAX_SLEEP_USEC (100 * MSEC)
+#define CONFIG_CHARGE_STATE_ADAPTIVE_POLL
+#define CHARGE_ADAPTIVE_MAX_SLEEP_USEC (1 * SECOND)
 
 /*
  * Enable MCHP SHA256 hardware accelerator module.
@@ -406,7 +427,9 @@
 #undef CONFIG_FAN_INIT_SPEED
 #define CONFIG_FAN_INIT_SPEED 15
 #define FAN_HARDARE_MAX 7100
+#define CONFIG_FAN_PID_CONTROL
 #define CONFIG_TEMP_SENSOR
+#define CONFIG_TEMP_SENSOR_SCHEDULE
 #define CONFIG_DPTF
 #define CONFIG_TEMP_SENSOR_F75303
 #define CONFIG_TEMP_SENSOR_F75397
@@ -414,6 +437,7 @@
 #define CONFIG_CHIPSET_CAN_THROTTLE		/* Enable EC_PROCHOT_L control */
 
 #define CONFIG_THROTTLE_AP
+#define CONFIG_THERMAL_HISTORY
 
 /* Factory mode support */
 #define CONFIG_FACTORY_SUPPORT
@@ -763,8 +787,6 @@ void boot_ap_on_g3(void);
 void power_button_enable_led(int enable);
 void s5_power_up_control(int control);
 
-int pos_get_state(void);
-
 int is_non_acpi_mode(void);
 void set_non_acpi_mode(int enable);
 
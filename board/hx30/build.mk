@@ -25,3 +25,16 @@ board-$(CONFIG_POWER_BUTTON_CUSTOM) += power_button_x86.o
 board-$(CONFIG_PECI) += peci_customization.o peci_over_espi.o
 board-$(HAS_TASK_HOSTCMD) += host_command_customization.o
 board-$(CONFIG_I2C_HID_MEDIAKEYS) += i2c_hid_mediakeys.o
+board-$(CONFIG_THERMAL_HISTORY) += thermal_history.o
+
+# Scan code and Fn layer tables. This file is included twice by the top
+# level Makefile, only define the rules once.
+ifndef kb_layers_rules
+kb_layers_rules:=y
+cmd_kb_layers = python3 $< > $@
+$(out)/RO/board/$(BOARD)/keyboard_customization.o \
+$(out)/RW/board/$(BOARD)/keyboard_customization.o: $(out)/keyboard_layers.h
+
+$(out)/keyboard_layers.h: board/$(BOARD)/gen_keyboard_layers.py
+	$(call quiet,kb_layers,GEN    )
+endif
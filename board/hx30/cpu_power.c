@@ -6,6 +6,7 @@
 #include "charge_manager.h"
 #include "chipset.h"
 #include "console.h"
+#include "cpu_power.h"
 #include "extpower.h"
 #include "hooks.h"
 #include "host_command.h"
@@ -90,6 +91,12 @@ void update_soc_power_limit(bool force_update, bool force_no_adapter)
 	}
 }
 
+void get_soc_power_limit(int *pl1, int *pl2)
+{
+	*pl1 = pl1_watt;
+	*pl2 = pl2_watt;
+}
+
 void update_soc_power_limit_hook(void)
 {
 	update_soc_power_limit(false, false);
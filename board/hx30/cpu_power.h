@@ -8,6 +8,11 @@
 #ifndef __CROS_EC_CPU_POWER_H
 #define __CROS_EC_CPU_POWER_H
 
+#include <stdbool.h>
+
 void update_soc_power_limit(bool force_update, bool force_no_adapter);
 
+/* Get the SOC power limits last set, in W */
+void get_soc_power_limit(int *pl1, int *pl2);
+
 #endif	/* __CROS_EC_CPU_POWER_H */
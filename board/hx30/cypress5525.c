@@ -875,7 +875,9 @@ void cypd_update_port_state(int controller, int port)
 	 * 2. Type C active with PD contract
 	 * 3. Not active
 	 * Each of 1 and 2 can be either source or sink
+	 * Apply all the charge updates below as one charge manager refresh.
 	 * */
+	charge_manager_batch_begin();
 
 	if (pd_port_states[port_idx].c_state == CYPD_STATUS_SOURCE) {
 		typec_set_input_current_limit(port_idx, type_c_current, TYPE_C_VOLTAGE);
@@ -923,6 +925,7 @@ void cypd_update_port_state(int controller, int port)
 	if (IS_ENABLED(CONFIG_CHARGE_MANAGER)) {
 		charge_manager_update_dualrole(port_idx, CAP_DEDICATED);
 	}
+	charge_manager_batch_end();
 }
 
 uint8_t *get_pd_version(int controller)
@@ -1267,10 +1270,12 @@ void cypd_interrupt_handler_task(void *p)
 	cypd_int_task_id = task_get_current();
 
 	/* Initialize all charge suppliers to 0 */
+	charge_manager_batch_begin();
 	for (i = 0; i < CHARGE_PORT_COUNT; i++) {
 		for (j = 0; j < CHARGE_SUPPLIER_COUNT; j++)
 			charge_manager_update_charge(j, i, NULL);
 	}
+	charge_manager_batch_end();
 	/* trigger the handle_state to start setup in task */
 	cypd_enque_evt(CYPD_EVT_STATE_CTRL_0 | CYPD_EVT_STATE_CTRL_1, 0);
 
@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+# Copyright 2022 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Generate the hx30 keyboard scan code layers.
+
+Emits a C header with one packed entry per key and layer: the prefix byte,
+the set 2 and set 1 codes and a board action, so that keyboard_customization.c
+can hand out make and break bytes for either code set without translating
+them for every key event.
+
+The base layer is a full matrix. The media layer (the F-row actions, on unless
+Fn or Fn lock flips it) and the Fn layer (keys changed while Fn is held) only
+hold the keys they change, as a per-column mask of rows plus the packed
+entries in column-major order.
+
+Usage: gen_keyboard_layers.py > keyboard_layers.h
+"""
+
+import sys
+
+COLS = 16
+ROWS = 8
+
+# Set 2 make codes, [col][row]
+BASE = [
+    [0x0021, 0x007B, 0x0079, 0x0072, 0x007A, 0x0071, 0x0069, 0xe04A],
+    [0xe071, 0xe070, 0x007D, 0xe01f, 0x006c, 0xe06c, 0xe07d, 0x0077],
+    [0x0015, 0x0070, 0x00ff, 0x000D, 0x000E, 0x0016, 0x0067, 0x001c],
+    [0xe011, 0x0011, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000],
+    [0xe05a, 0x0029, 0x0024, 0x000c, 0x0058, 0x0026, 0x0004, 0xe07a],
+    [0x0022, 0x001a, 0x0006, 0x0005, 0x001b, 0x001e, 0x001d, 0x0076],
+    [0x002A, 0x0032, 0x0034, 0x002c, 0x002e, 0x0025, 0x002d, 0x002b],
+    [0x003a, 0x0031, 0x0033, 0x0035, 0x0036, 0x003d, 0x003c, 0x003b],
+    [0x0049, 0xe072, 0x005d, 0x0044, 0x0009, 0x0046, 0x0078, 0x004b],
+    [0x0059, 0x0012, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000],
+    [0x0041, 0x007c, 0x0083, 0x000b, 0x0003, 0x003e, 0x0043, 0x0042],
+    [0x0013, 0x0064, 0x0075, 0x0001, 0x0051, 0x0061, 0xe06b, 0xe02f],
+    [0xe014, 0x0014, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000],
+    [0x004a, 0xe075, 0x004e, 0x0007, 0x0045, 0x004d, 0x0054, 0x004c],
+    [0x0052, 0x005a, 0xe03c, 0xe069, 0x0055, 0x0066, 0x005b, 0x0023],
+    [0x006a, 0x000a, 0xe074, 0xe054, 0x0000, 0x006b, 0x0073, 0x0074],
+]
+
+SCANCODE_FN = 0x00ff
+
+# Board actions, handled in keyboard_customization.c. Keys with an action
+# other than KB_ACT_NONE are not sent to the host.
+ACTIONS = [
+    'KB_ACT_NONE',
+    'KB_ACT_FN',
+    'KB_ACT_FN_LOCK',
+    'KB_ACT_BREAK',
+    'KB_ACT_PAUSE',
+    'KB_ACT_BACKLIGHT',
+    'KB_ACT_BRIGHTNESS_DOWN',
+    'KB_ACT_BRIGHTNESS_UP',
+    'KB_ACT_PROJECT',
+    'KB_ACT_AIRPLANE',
+]
+
+# Layers over the base layer, as base code -> new code or action
+LAYERS = [
+    ('KB_LAYER_MEDIA', {
+        0x0005: 0xe023,                    # F1: mute
+        0x0006: 0xe021,                    # F2: volume down
+        0x0004: 0xe032,                    # F3: volume up
+        0x000c: 0xe015,                    # F4: previous track
+        0x0003: 0xe034,                    # F5: play/pause
+        0x000b: 0xe04d,                    # F6: next track
+        0x0083: 'KB_ACT_BRIGHTNESS_DOWN',  # F7
+        0x000a: 'KB_ACT_BRIGHTNESS_UP',    # F8
+        0x0001: 'KB_ACT_PROJECT',          # F9: Win+P
+        0x0009: 'KB_ACT_AIRPLANE',         # F10
+        0x0078: 0xe07c,                    # F11: print screen
+        0x0007: 0xe050,                    # F12: media select
+    }),
+    ('KB_LAYER_FN', {
+        0xe071: 0xe070,                    # Delete: insert
+        0x0042: 0x007e,                    # K: scroll lock
+        0xe06b: 0xe06c,                    # Left: home
+        0xe074: 0xe069,                    # Right: end
+        0xe075: 0xe07d,                    # Up: page up
+        0xe072: 0xe07a,                    # Down: page down
+        0x0076: 'KB_ACT_FN_LOCK',          # Esc
+        0x0032: 'KB_ACT_BREAK',            # B
+        0x004d: 'KB_ACT_PAUSE',            # P
+        0x0029: 'KB_ACT_BACKLIGHT',        # Space
+    }),
+]
+
+# Set 2 to set 1, as scancode_translate_table in keyboard_8042_sharedlib.c
+SET2_TO_SET1 = [
+    0xff, 0x43, 0x41, 0x3f, 0x3d, 0x3b, 0x3c, 0x58,
+    0x64, 0x44, 0x42, 0x40, 0x3e, 0x0f, 0x29, 0x59,
+    0x65, 0x38, 0x2a, 0x70, 0x1d, 0x10, 0x02, 0x5a,
+    0x66, 0x71, 0x2c, 0x1f, 0x1e, 0x11, 0x03, 0x5b,
+    0x67, 0x2e, 0x2d, 0x20, 0x12, 0x05, 0x04, 0x5c,
+    0x68, 0x39, 0x2f, 0x21, 0x14, 0x13, 0x06, 0x5d,
+    0x69, 0x31, 0x30, 0x23, 0x22, 0x15, 0x07, 0x5e,
+    0x6a, 0x72, 0x32, 0x24, 0x16, 0x08, 0x09, 0x5f,
+    0x6b, 0x33, 0x25, 0x17, 0x18, 0x0b, 0x0a, 0x60,
+    0x6c, 0x34, 0x35, 0x26, 0x27, 0x19, 0x0c, 0x61,
+    0x6d, 0x73, 0x28, 0x74, 0x1a, 0x0d, 0x62, 0x6e,
+    0x3a, 0x36, 0x1c, 0x1b, 0x75, 0x2b, 0x63, 0x76,
+    0x55, 0x56, 0x77, 0x78, 0x79, 0x7a, 0x0e, 0x7b,
+    0x7c, 0x4f, 0x7d, 0x4b, 0x47, 0x7e, 0x7f, 0x6f,
+    0x52, 0x53, 0x50, 0x4c, 0x4d, 0x48, 0x01, 0x45,
+    0x57, 0x4e, 0x51, 0x4a, 0x37, 0x49, 0x46, 0x54,
+]
+
+
+def set1(code):
+    """Translate a set 2 code byte, as scancode_translate_set2_to_1()."""
+    if code & 0x80:
+        return 0x41 if code == 0x83 else code
+    return SET2_TO_SET1[code]
+
+
+def entry(code, action='KB_ACT_NONE'):
+    """Format one packed key entry."""
+    if code > 0xff and code >> 8 not in (0xe0, 0xe1):
+        raise ValueError('bad scan code 0x%04x' % code)
+    return '{0x%02x, 0x%02x, 0x%02x, %s}' % (code >> 8, code & 0xff,
+                                              set1(code & 0xff), action)
+
+
+def base_entry(code):
+    if code == SCANCODE_FN:
+        return entry(code, 'KB_ACT_FN')
+    return entry(code)
+
+
+def main():
+    out = []
+    w = out.append
+
+    w('/* Generated by board/hx30/gen_keyboard_layers.py, do not edit. */')
+    w('')
+    w('#ifndef __KEYBOARD_LAYERS_H')
+    w('#define __KEYBOARD_LAYERS_H')
+    w('')
+    w('/* One key of a layer */')
+    w('struct kb_key {')
+    w('\t/* Prefix byte of the make code, or 0 */')
+    w('\tuint8_t prefix;')
+    w('\tuint8_t set2;')
+    w('\tuint8_t set1;')
+    w('\t/* enum kb_action */')
+    w('\tuint8_t action;')
+    w('};')
+    w('')
+    w('/*')
+    w(' * A layer over the base layer: the rows it changes in each column, and its')
+    w(' * keys in column-major order, starting at rank[col] for each column.')
+    w(' */')
+    w('struct kb_layer {')
+    w('\tconst uint8_t *mask;')
+    w('\tconst uint8_t *rank;')
+    w('\tconst struct kb_key *keys;')
+    w('};')
+    w('')
+    w('enum kb_action {')
+    for a in ACTIONS:
+        w('\t%s,' % a)
+    w('};')
+    w('')
+    w('enum kb_layer_id {')
+    for name, _ in LAYERS:
+        w('\t%s,' % name)
+    w('\tKB_LAYER_COUNT,')
+    w('};')
+    w('')
+    w('static const struct kb_key kb_layer_base[%d][%d] = {' % (COLS, ROWS))
+    for c in range(COLS):
+        w('\t{')
+        for r in range(ROWS):
+            w('\t\t%s,' % base_entry(BASE[c][r]))
+        w('\t},')
+    w('};')
+
+    for name, remap in LAYERS:
+        ident = name.lower()
+        found = set()
+        mask = [0] * COLS
+        rank = [0] * COLS
+        keys = []
+        for c in range(COLS):
+            rank[c] = len(keys)
+            for r in range(ROWS):
+                code = BASE[c][r]
+                if code not in remap:
+                    continue
+                new = remap[code]
+                if isinstance(new, str):
+                    keys.append(entry(code, new))
+                else:
+                    keys.append(entry(new))
+                mask[c] |= 1 << r
+                found.add(code)
+        missing = set(remap) - found
+        if missing:
+            raise ValueError('%s: no key for %s' % (name, sorted(missing)))
+
+        w('')
+        w('static const uint8_t %s_mask[%d] = {' % (ident, COLS))
+        for c in range(0, COLS, 8):
+            w('\t' + ', '.join('0x%02x' % m for m in mask[c:c + 8]) + ',')
+        w('};')
+        w('static const uint8_t %s_rank[%d] = {' % (ident, COLS))
+        for c in range(0, COLS, 8):
+            w('\t' + ', '.join('%d' % n for n in rank[c:c + 8]) + ',')
+        w('};')
+        w('static const struct kb_key %s_keys[%d] = {' % (ident, len(keys)))
+        for k in keys:
+            w('\t%s,' % k)
+        w('};')
+
+    w('')
+    w('static const struct kb_layer kb_layers[KB_LAYER_COUNT] = {')
+    for name, _ in LAYERS:
+        ident = name.lower()
+        w('\t[%s] = {' % name)
+        w('\t\t%s_mask, %s_rank, %s_keys,' % (ident, ident, ident))
+        w('\t},')
+    w('};')
+    w('')
+    w('#endif /* __KEYBOARD_LAYERS_H */')
+
+    sys.stdout.write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+    main()
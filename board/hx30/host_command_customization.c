@@ -28,6 +28,8 @@
 #include "driver/als_cm32183.h"
 #include "cpu_power.h"
 #include "flash_storage.h"
+#include "flash.h"
+#include "sha256.h"
 #define CPRINTS(format, args...) cprints(CC_SWITCH, format, ## args)
 
 #ifdef CONFIG_EMI_REGION1
@@ -133,6 +135,55 @@ static enum ec_status flash_notified(struct host_cmd_handler_args *args)
 DECLARE_HOST_COMMAND(EC_CMD_FLASH_NOTIFIED, flash_notified,
 			EC_VER_MASK(0));
 
+static enum ec_status flash_block_hash(struct host_cmd_handler_args *args)
+{
+	static uint8_t data[256];
+	const struct ec_params_flash_block_hash *p = args->params;
+	struct ec_response_flash_block_hash *r = args->response;
+	struct sha256_ctx ctx;
+	uint32_t offset = p->offset + EC_FLASH_REGION_START;
+	uint32_t block, left, len, hashed;
+	int max, n;
+
+	if (!p->size || !p->block_size ||
+	    p->block_size > EC_FLASH_BLOCK_HASH_MAX_BYTES)
+		return EC_RES_INVALID_PARAM;
+
+	max = (args->response_max - sizeof(*r)) / EC_FLASH_BLOCK_HASH_SIZE;
+	if (max < 1)
+		return EC_RES_OVERFLOW;
+
+	if (flash_posted_write_wait())
+		return EC_RES_ERROR;
+
+	/* Keep each command short, at least one block */
+	max = MIN(max, EC_FLASH_BLOCK_HASH_MAX_BYTES / p->block_size);
+	max = MAX(max, 1);
+
+	hashed = 0;
+	for (n = 0; n < max && hashed < p->size; n++) {
+		block = MIN(p->block_size, p->size - hashed);
+		SHA256_init(&ctx);
+		for (left = block; left; left -= len) {
+			len = MIN(left, sizeof(data));
+			if (flash_read(offset, len, (char *)data))
+				return EC_RES_ERROR;
+			SHA256_update(&ctx, data, len);
+			offset += len;
+		}
+		memcpy(r->hash[n], SHA256_final(&ctx),
+		       EC_FLASH_BLOCK_HASH_SIZE);
+		hashed += block;
+	}
+
+	r->count = n;
+	args->response_size = sizeof(*r) + n * EC_FLASH_BLOCK_HASH_SIZE;
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_FLASH_BLOCK_HASH, flash_block_hash,
+			EC_VER_MASK(0));
+
 
 #ifdef CONFIG_FACTORY_SUPPORT
 
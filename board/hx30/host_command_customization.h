@@ -222,4 +222,258 @@ struct ec_params_standalone_mode {
 	uint8_t enable;
 } __ec_align1;
 
+/*
+ * Read back the battery telemetry history. Each entry holds the battery
+ * state of charge and charger state, plus the voltage, current, temperature
+ * and input current deltas from the previous entry. The host rebuilds the
+ * samples by adding each entry's deltas, in the units below, to the base
+ * sample. Windows larger than one response are read a page at a time using
+ * the offset parameter.
+ */
+#define EC_CMD_BATTERY_HISTORY 0x3E15
+
+#define EC_BATT_HIST_MV_UNIT		8
+#define EC_BATT_HIST_MA_UNIT		32
+#define EC_BATT_HIST_DK_UNIT		1
+#define EC_BATT_HIST_INPUT_MA_UNIT	64
+
+/* State byte: enum charge_state in the low bits, plus flags */
+#define EC_BATT_HIST_STATE_MASK		0x0F
+#define EC_BATT_HIST_AC_PRESENT		BIT(4)
+#define EC_BATT_HIST_NO_BATTERY		BIT(5)
+
+struct ec_battery_history_sample {
+	uint16_t voltage;	/* mV */
+	int16_t current;	/* mA, negative when discharging */
+	uint16_t temperature;	/* 0.1 K */
+	uint16_t input_current;	/* mA */
+	uint8_t rsoc;		/* % */
+	uint8_t state;
+} __ec_align2;
+
+struct ec_battery_history_entry {
+	uint8_t state;
+	uint8_t rsoc;
+	int8_t voltage;
+	int8_t current;
+	int8_t temperature;
+	int8_t input_current;
+} __ec_align1;
+
+struct ec_params_battery_history {
+	/* Minutes of history to read, up to the newest sample; 0 for all */
+	uint16_t minutes;
+	/* Index in the window of the first entry to return */
+	uint16_t offset;
+} __ec_align2;
+
+struct ec_response_battery_history {
+	/* Seconds between samples */
+	uint16_t interval;
+	/* Entries in the requested window */
+	uint16_t total;
+	/* Index in the window of entries[0] */
+	uint16_t offset;
+	/* Entries in this response */
+	uint16_t count;
+	/* Seconds elapsed since the newest sample */
+	uint32_t age;
+	/* Sample that entries[0] is relative to */
+	struct ec_battery_history_sample base;
+	struct ec_battery_history_entry entries[];
+} __ec_align4;
+
+/*
+ * Get the state of the closed-loop fan controller, and optionally switch it
+ * on or off or replace its tunables. The response reflects the request.
+ */
+#define EC_CMD_FAN_PID_CONTROL 0x3E16
+
+#define EC_FAN_PID_DISABLE		BIT(0)
+#define EC_FAN_PID_ENABLE		BIT(1)
+#define EC_FAN_PID_SET_TUNABLES		BIT(2)
+
+#define EC_FAN_PID_MAP_SIZE		11
+
+struct ec_fan_pid_tunables {
+	/* Normalized temperature to regulate to, in per-mille of fan band */
+	int16_t setpoint;
+	/* Gains, in 1/256 RPM per per-mille (per second) */
+	int16_t kp;
+	int16_t ki;
+	int16_t kd;
+	/* Lowest duty cycle the fan reliably spins at, in % */
+	uint8_t duty_min;
+	/* Seconds a duty cycle must hold before the map learns from it */
+	uint8_t learn_settle;
+} __ec_align2;
+
+struct ec_params_fan_pid_control {
+	uint8_t flags;
+	uint8_t reserved;
+	struct ec_fan_pid_tunables tunables;
+} __ec_align2;
+
+struct ec_response_fan_pid_control {
+	uint8_t enabled;
+	/* Current duty cycle, in % */
+	uint8_t duty;
+	uint16_t rpm_target;
+	struct ec_fan_pid_tunables tunables;
+	/* Learned RPM at each 10% duty cycle step, from 0% */
+	uint16_t rpm_map[EC_FAN_PID_MAP_SIZE];
+} __ec_align2;
+
+/*
+ * Read the thermal history: one entry per second with every sensor, the fan,
+ * the throttle state and the CPU power limits, plus a log of annotated events
+ * such as threshold crossings. Entries or events are read a page at a time
+ * from the oldest, using the offset parameter.
+ */
+#define EC_CMD_THERMAL_HISTORY 0x3E17
+
+#define EC_THERMAL_HIST_SENSORS		6
+/* Temperature of a sensor that could not be read */
+#define EC_THERMAL_HIST_TEMP_INVALID	0xFF
+#define EC_THERMAL_HIST_RPM_UNIT	32
+
+/* Entry flags */
+#define EC_THERMAL_HIST_PROCHOT		BIT(0)	/* PROCHOT# asserted */
+#define EC_THERMAL_HIST_THROTTLE_HARD	BIT(1)	/* EC requests PROCHOT# */
+#define EC_THERMAL_HIST_THROTTLE_SOFT	BIT(2)	/* EC requests host throttle */
+#define EC_THERMAL_HIST_AP_ON		BIT(3)
+
+enum ec_thermal_hist_read {
+	EC_THERMAL_HIST_READ_ENTRIES = 0,
+	EC_THERMAL_HIST_READ_EVENTS = 1,
+};
+
+enum ec_thermal_hist_event_type {
+	/* A sensor crossed a host threshold, enum ec_temp_thresholds */
+	EC_THERMAL_HIST_EVENT_WARN = 0,
+	EC_THERMAL_HIST_EVENT_HIGH = 1,
+	EC_THERMAL_HIST_EVENT_HALT = 2,
+	/* A sensor crossed the bottom or the top of its fan band */
+	EC_THERMAL_HIST_EVENT_FAN_OFF = 3,
+	EC_THERMAL_HIST_EVENT_FAN_MAX = 4,
+	/* An entry flag changed, limit is the flag */
+	EC_THERMAL_HIST_EVENT_FLAG = 5,
+	/* The power limits changed, value is PL1 and limit is PL2 */
+	EC_THERMAL_HIST_EVENT_POWER_LIMIT = 6,
+};
+
+/* Set in type when the condition started, clear when it ended */
+#define EC_THERMAL_HIST_EVENT_RISING	BIT(7)
+#define EC_THERMAL_HIST_EVENT_TYPE_MASK	0x7F
+
+struct ec_thermal_history_entry {
+	uint8_t temp[EC_THERMAL_HIST_SENSORS];	/* C */
+	uint8_t fan_duty;			/* % */
+	uint8_t fan_rpm;			/* EC_THERMAL_HIST_RPM_UNIT */
+	uint8_t flags;
+	uint8_t pl1;				/* W */
+	uint8_t pl2;				/* W */
+	uint8_t reserved;
+} __ec_align1;
+
+struct ec_thermal_history_event {
+	/* Sequence number of the entry the event was seen at */
+	uint32_t seq;
+	uint8_t type;
+	/* Sensor index, or 0xFF */
+	uint8_t sensor;
+	/* Temperature and threshold crossed, in C */
+	uint8_t value;
+	uint8_t limit;
+} __ec_align4;
+
+struct ec_params_thermal_history {
+	/* enum ec_thermal_hist_read */
+	uint8_t read;
+	uint8_t reserved;
+	/* Index of the first entry or event to return, from the oldest */
+	uint16_t offset;
+} __ec_align2;
+
+struct ec_response_thermal_history {
+	/* Sequence number of the newest entry */
+	uint32_t seq;
+	/* Milliseconds elapsed since the newest entry */
+	uint32_t age;
+	/* Entries or events held */
+	uint16_t total;
+	/* Index of the first one in this response */
+	uint16_t offset;
+	/* Entries or events in this response */
+	uint16_t count;
+	/* Seconds between entries */
+	uint8_t interval;
+	/* Sensors recorded in each entry */
+	uint8_t sensor_count;
+	/* struct ec_thermal_history_entry or struct ec_thermal_history_event */
+	uint8_t data[];
+} __ec_align4;
+
+/*
+ * Get the keypress latency statistics, from the matrix edge to each trace
+ * point on the way to the host reading port 0x60, and optionally clear them.
+ */
+#define EC_CMD_KEYBOARD_LATENCY 0x3E18
+
+#define EC_KBLAT_RESET			BIT(0)
+
+/* Trace points, in order */
+#define EC_KBLAT_STAGES			5
+/* Histogram bucket n counts [2^n, 2^(n+1)) us, the last one all above */
+#define EC_KBLAT_HIST_BUCKETS		16
+
+struct ec_params_keyboard_latency {
+	uint8_t flags;
+} __ec_align1;
+
+struct ec_kblat_stage {
+	uint32_t min_us;
+	uint32_t avg_us;
+	uint32_t max_us;
+	uint16_t hist[EC_KBLAT_HIST_BUCKETS];
+} __ec_align4;
+
+struct ec_response_keyboard_latency {
+	/* Keystrokes the host has read */
+	uint32_t count;
+	/* Keystrokes whose trace was lost before the host read them */
+	uint32_t lost;
+	/* Report, scan code, queued, sent, read */
+	struct ec_kblat_stage stage[EC_KBLAT_STAGES];
+} __ec_align4;
+
+/*
+ * Get the SHA256 of each block of a flash region, so that the host only
+ * has to erase and program the blocks that differ from its image, and can
+ * verify them without reading them back. Offsets are as for
+ * EC_CMD_FLASH_READ, the last block may be short. The response holds the
+ * hashes of the first blocks of the region, as many as the EC hashed in
+ * one go; the host asks again for the rest.
+ */
+#define EC_CMD_FLASH_BLOCK_HASH 0x3E19
+
+#define EC_FLASH_BLOCK_HASH_SIZE	32
+/* Largest block, and most bytes hashed per command */
+#define EC_FLASH_BLOCK_HASH_MAX_BYTES	0x10000
+
+struct ec_params_flash_block_hash {
+	uint32_t offset;
+	uint32_t size;
+	uint32_t block_size;
+} __ec_align4;
+
+struct ec_response_flash_block_hash {
+	/* Blocks hashed, from the start of the region */
+	uint32_t count;
+	uint8_t hash[][EC_FLASH_BLOCK_HASH_SIZE];
+} __ec_align4;
+
+/* Whether the host has finished POST, as it flags in the customer memmap */
+int pos_get_state(void);
+
 #endif /* __HOST_COMMAND_CUSTOMIZATION_H */
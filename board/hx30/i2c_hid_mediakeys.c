@@ -17,6 +17,8 @@
 #include "util.h"
 #include "i2c_hid.h"
 #include "i2c_hid_mediakeys.h"
+#include "atomic.h"
+#include "queue.h"
 /* Chip specific */
 #include "registers.h"
 
@@ -40,6 +42,9 @@
 #define EVENT_HID_HOST_IRQ	0x8000
 #define EVENT_REPORT_ILLUMINANCE_VALUE	0x4000
 
+/* Key changes this close together go to the host on one interrupt */
+#define HID_KEY_BATCH_US	(2 * MSEC)
+
 #define CPRINTS(format, args...) cprints(CC_KEYBOARD, format, ## args)
 #define CPRINTF(format, args...) cprintf(CC_KEYBOARD, format, ## args)
 
@@ -75,11 +80,56 @@ struct als_feature_report {
 } __packed;
 
 
-static struct radio_report radio_button;
-static struct consumer_button_report consumer_button;
-static struct als_input_report als_sensor;
+/*
+ * Input reports, kept preformatted with the length and report ID so the
+ * input register can be read straight out of them.
+ */
+struct hid_input_header {
+	uint16_t length;
+	uint8_t report_id;
+} __packed;
+BUILD_ASSERT(sizeof(struct hid_input_header) == I2C_HID_HEADER_SIZE);
+
+#define HID_INPUT_REPORT(name, type, id)				\
+	static struct {							\
+		struct hid_input_header hdr;				\
+		type report;						\
+	} __packed name = {						\
+		.hdr = { I2C_HID_HEADER_SIZE + sizeof(type), id },	\
+	}
+
+HID_INPUT_REPORT(radio_input, struct radio_report, REPORT_ID_RADIO);
+HID_INPUT_REPORT(consumer_input, struct consumer_button_report,
+		 REPORT_ID_CONSUMER);
+HID_INPUT_REPORT(als_input, struct als_input_report, REPORT_ID_SENSOR);
 static struct als_feature_report als_feature;
 
+/*
+ * Latest radio and sensor state. The task changes these with interrupts
+ * disabled and the I2C interrupt copies them into the input reports when it
+ * picks one to send, so a report never changes while the host reads it.
+ */
+static struct radio_report radio_state;
+static struct als_input_report als_state;
+
+/*
+ * Input reports the host has yet to read. Consumer button changes are queued
+ * so a quick press and release both reach the host; the radio and sensor
+ * reports only ever need their latest state.
+ */
+static uint32_t report_pending;
+static struct queue const consumer_queue =
+	QUEUE_NULL(4, struct consumer_button_report);
+
+static struct {
+	uint32_t irqs;		/* Times the host interrupt was asserted */
+	uint32_t reports;	/* Input reports read by the host */
+	uint32_t als_updates;
+	uint32_t als_coalesced;	/* Replaced before the host read them */
+	uint32_t dropped;	/* Dropped, host did not read them */
+	timestamp_t since;
+} hid_stats;
+
 int update_hid_key(enum media_key key, bool pressed)
 {
 	if (key >= HID_KEY_MAX) {
@@ -346,9 +396,18 @@ void i2c_hid_als_init(void)
 	als_feature.maximum = HID_ALS_MAX;
 	als_feature.minimum = HID_ALS_MIN;
 
-	als_sensor.event_type = 0x04; /* HID_DATA_UPDATED */
-	als_sensor.sensor_state = 0x02; /* HID READY */
-	als_sensor.illuminanceValue = 0x0000;
+	interrupt_disable();
+	als_state.event_type = 0x04; /* HID_DATA_UPDATED */
+	als_state.sensor_state = 0x02; /* HID READY */
+	als_state.illuminanceValue = 0x0000;
+	interrupt_enable();
+}
+
+static void set_illuminance(uint16_t value)
+{
+	interrupt_disable();
+	als_state.illuminanceValue = value;
+	interrupt_enable();
 }
 
 static int als_polling_mode_count;
@@ -362,12 +421,12 @@ void report_illuminance_value(void)
 		als_polling_mode_count++; /* time base 100ms */
 
 		/* bypass the EC_MEMMAP_ALS value to input report */
-		als_sensor.illuminanceValue = newIlluminaceValue;
+		set_illuminance(newIlluminaceValue);
 		task_set_event(TASK_ID_HID, ((1 << HID_ALS_REPORT_LUX) |
 			EVENT_REPORT_ILLUMINANCE_VALUE), 0);
 	} else {
-		if (ABS(als_sensor.illuminanceValue - newIlluminaceValue) > granularity) {
-			als_sensor.illuminanceValue = newIlluminaceValue;
+		if (ABS(als_state.illuminanceValue - newIlluminaceValue) > granularity) {
+			set_illuminance(newIlluminaceValue);
 			task_set_event(TASK_ID_HID, ((1 << HID_ALS_REPORT_LUX) |
 				EVENT_REPORT_ILLUMINANCE_VALUE), 0);
 		} else {
@@ -456,20 +515,20 @@ static int i2c_hid_touchpad_command_process(size_t len, uint8_t *buffer)
 		case REPORT_ID_RADIO:
 			response_len =
 				fill_report(buffer, report_id,
-						&radio_button,
+						&radio_state,
 						sizeof(struct radio_report));
 			break;
 		case REPORT_ID_CONSUMER:
 			response_len =
 				fill_report(buffer, report_id,
-						&consumer_button,
+						&consumer_input.report,
 						sizeof(struct consumer_button_report));
 			break;
 		case REPORT_ID_SENSOR:
 			if (report_type == 0x01) {
 				response_len =
 					fill_report(buffer, report_id,
-						&als_sensor,
+						&als_state,
 						sizeof(struct als_input_report));
 			} else if (report_type == 0x03) {
 				response_len =
@@ -515,6 +574,50 @@ static int i2c_hid_touchpad_command_process(size_t len, uint8_t *buffer)
 	return response_len;
 }
 
+/*
+ * Pick the report for an input register read: the oldest key change waiting,
+ * then the sensor, else the last report sent again.
+ */
+static const struct hid_input_header *next_input_report(void)
+{
+	struct consumer_button_report button;
+
+	if (report_pending & BIT(REPORT_ID_RADIO)) {
+		deprecated_atomic_clear_bits(&report_pending,
+					     BIT(REPORT_ID_RADIO));
+		input_mode = REPORT_ID_RADIO;
+	} else if (queue_remove_unit(&consumer_queue, &button)) {
+		consumer_input.report = button;
+		input_mode = REPORT_ID_CONSUMER;
+	} else if (report_pending & BIT(REPORT_ID_SENSOR)) {
+		deprecated_atomic_clear_bits(&report_pending,
+					     BIT(REPORT_ID_SENSOR));
+		input_mode = REPORT_ID_SENSOR;
+	}
+	hid_stats.reports++;
+
+	switch (input_mode) {
+	case REPORT_ID_RADIO:
+		radio_input.report = radio_state;
+		return &radio_input.hdr;
+	case REPORT_ID_CONSUMER:
+		return &consumer_input.hdr;
+	case REPORT_ID_SENSOR:
+		als_input.report = als_state;
+		return &als_input.hdr;
+	default:
+		return NULL;
+	}
+}
+
+static int input_reports_pending(void)
+{
+	return report_pending || !queue_is_empty(&consumer_queue);
+}
+
+/* Input report to send straight from its own buffer, for i2c_set_response */
+static const struct hid_input_header *input_report;
+
 int i2c_hid_process(unsigned int len, uint8_t *buffer)
 {
 	size_t response_len = 0;
@@ -549,22 +652,9 @@ int i2c_hid_process(unsigned int len, uint8_t *buffer)
 			break;
 		}
 		/* Common input report requests. */
-		if (input_mode == REPORT_ID_RADIO) {
-			response_len =
-				fill_report(buffer, REPORT_ID_RADIO,
-						&radio_button,
-						sizeof(struct radio_report));
-		} else if (input_mode == REPORT_ID_CONSUMER) {
-			response_len =
-				fill_report(buffer, REPORT_ID_CONSUMER,
-						&consumer_button,
-						sizeof(struct consumer_button_report));
-		} else if (input_mode == REPORT_ID_SENSOR) {
-			response_len =
-				fill_report(buffer, REPORT_ID_SENSOR,
-						&als_sensor,
-						sizeof(struct als_input_report));
-		}
+		input_report = next_input_report();
+		if (input_report)
+			response_len = input_report->length;
 		break;
 	case I2C_HID_COMMAND_REGISTER:
 		response_len = i2c_hid_touchpad_command_process(len, buffer);
@@ -589,30 +679,103 @@ int i2c_set_response(int port, uint8_t *buf, int len)
 {
 	int ret = 0;
 
+	input_report = NULL;
 	ret = i2c_hid_process(len, buf);
+	if (input_report)
+		i2c_slave_set_response_buffer(port,
+					      (const uint8_t *)input_report);
 
-	gpio_set_level(GPIO_SOC_EC_INT_L, 1);
+	/* Keep the interrupt asserted until the host has read every report */
+	if (!input_reports_pending())
+		gpio_set_level(GPIO_SOC_EC_INT_L, 1);
 
 	task_set_event(TASK_ID_HID, TASK_EVENT_I2C_IDLE, 0);
 	return ret;
 }
 
+/* Forget the reports the host has not read */
+static void hid_drop_reports(void)
+{
+	interrupt_disable();
+	if (report_pending & BIT(REPORT_ID_RADIO))
+		hid_stats.dropped++;
+	if (report_pending & BIT(REPORT_ID_SENSOR))
+		hid_stats.dropped++;
+	hid_stats.dropped += queue_count(&consumer_queue);
+	report_pending = 0;
+	queue_init(&consumer_queue);
+	interrupt_enable();
+}
+
+/*
+ * Turn key and sensor events into pending input reports.
+ *
+ * @return non-zero if a key changed.
+ */
+static int hid_queue_reports(uint32_t event)
+{
+	struct consumer_button_report button;
+	int keys = 0;
+	int i;
+
+	for (i = 0; i < HID_KEY_MAX; i++) {
+		if (!(event & BIT(i)))
+			continue;
+		update_key = i;
+		switch (i) {
+		case HID_KEY_DISPLAY_BRIGHTNESS_UP:
+		case HID_KEY_DISPLAY_BRIGHTNESS_DN:
+			if (!key_states[i])
+				button.button_id = 0;
+			else if (i == HID_KEY_DISPLAY_BRIGHTNESS_UP)
+				button.button_id = BUTTON_ID_BRIGHTNESS_INCREMENT;
+			else
+				button.button_id = BUTTON_ID_BRIGHTNESS_DECREMENT;
+			if (!queue_add_unit(&consumer_queue, &button))
+				hid_stats.dropped++;
+			keys = 1;
+			break;
+		case HID_KEY_AIRPLANE_MODE:
+			interrupt_disable();
+			radio_state.state = key_states[i] ? 1 : 0;
+			interrupt_enable();
+			deprecated_atomic_or(&report_pending,
+					     BIT(REPORT_ID_RADIO));
+			keys = 1;
+			break;
+		case HID_ALS_REPORT_LUX:
+			/* Only the latest value matters */
+			hid_stats.als_updates++;
+			if (report_pending & BIT(REPORT_ID_SENSOR))
+				hid_stats.als_coalesced++;
+			deprecated_atomic_or(&report_pending,
+					     BIT(REPORT_ID_SENSOR));
+			break;
+		}
+	}
+
+	return keys;
+}
+
 void hid_irq_to_host(void)
 {
 	uint32_t i2c_evt;
 	int timeout = 0;
 	gpio_set_level(GPIO_SOC_EC_INT_L, 0);
+	hid_stats.irqs++;
 
 	/* wait for host to perform i2c transaction or timeout
 	 * this happens in an interrupt context, so the interrupt will handle
 	 * the data request and ack a task event signifying we are done.
+	 * The host keeps reading while reports are pending.
 	 */
-	i2c_evt = task_wait_event_mask(TASK_EVENT_I2C_IDLE, 100*MSEC);
+	do {
+		i2c_evt = task_wait_event_mask(TASK_EVENT_I2C_IDLE, 100*MSEC);
+	} while (!(i2c_evt & TASK_EVENT_TIMER) && input_reports_pending());
+
 	if (i2c_evt & TASK_EVENT_TIMER) {
 		CPRINTS("I2CHID no host response");
-	} else {
-		/*CPRINTS("I2CHID host handled response");*/
-
+		hid_drop_reports();
 	}
 	/* wait for bus to be not busy */
 	while (((MCHP_I2C_STATUS(HID_SLAVE_CTRL) & BIT(0)) == 0) && ++timeout < 1000) {
@@ -623,66 +786,77 @@ void hid_irq_to_host(void)
 	usleep(10);
 }
 
+/*
+ * Handle task events.
+ *
+ * @return non-zero if a key changed.
+ */
+static int hid_handle_events(uint32_t event)
+{
+	if (event & TASK_EVENT_I2C_IDLE) {
+		/* TODO host is requesting data from device */
+	}
+	if (event & EVENT_HID_HOST_IRQ) {
+		hid_irq_to_host();
+	}
+
+	if (event & EVENT_REPORT_ILLUMINANCE_VALUE) {
+		/* start reporting illuminance value in S0*/
+		hook_call_deferred(&report_illuminance_value_data,
+				((int) als_feature.report_interval) * MSEC);
+	}
+
+	return hid_queue_reports(event);
+}
+
 void hid_handler_task(void *p)
 {
 	uint32_t event;
-	size_t i;
 	i2c_hid_mediakeys_init();
+	hid_stats.since = get_time();
 	while (1) {
 		event = task_wait_event(-1);
-		if (event & TASK_EVENT_I2C_IDLE) {
-			/* TODO host is requesting data from device */
+
+		/* Give more key changes a moment to join this interrupt */
+		if (hid_handle_events(event)) {
+			while ((event = task_wait_event(HID_KEY_BATCH_US)) !=
+			       TASK_EVENT_TIMER)
+				hid_handle_events(event);
 		}
-		if (event & EVENT_HID_HOST_IRQ) {
+
+		if (!input_reports_pending())
+			continue;
+
+		/* we don't need to assert the interrupt when system state in S0ix */
+		if (chipset_in_state(CHIPSET_STATE_ON))
 			hid_irq_to_host();
-		}
+		else
+			hid_drop_reports();
+	}
+}
 
-		if (event & EVENT_REPORT_ILLUMINANCE_VALUE) {
-			/* start reporting illuminance value in S0*/
-			hook_call_deferred(&report_illuminance_value_data,
-					((int) als_feature.report_interval) * MSEC);
-        }
-
-		if (event & 0xFFFF) {
-
-			for (i = 0; i < 15; i++) {
-				/**
-				 * filter EVENT_REPORT_ILLUMINANCE_VALUE
-				 * this event only call deferred
-				 */
-				if ((event & 0xBFFF) & (1<<i)) {
-					update_key = i;
-					switch (i) {
-					case HID_KEY_DISPLAY_BRIGHTNESS_UP:
-						input_mode = REPORT_ID_CONSUMER;
-						if (key_states[i]) {
-							consumer_button.button_id = BUTTON_ID_BRIGHTNESS_INCREMENT;
-						} else {
-							consumer_button.button_id = 0;
-						}
-						break;
-					case HID_KEY_DISPLAY_BRIGHTNESS_DN:
-						input_mode = REPORT_ID_CONSUMER;
-						if (key_states[i]) {
-							consumer_button.button_id = BUTTON_ID_BRIGHTNESS_DECREMENT;
-						} else {
-							consumer_button.button_id = 0;
-						}
-						break;
-					case HID_KEY_AIRPLANE_MODE:
-						input_mode = REPORT_ID_RADIO;
-							radio_button.state = key_states[i] ? 1 : 0;
-						break;
-					case HID_ALS_REPORT_LUX:
-
-						input_mode = REPORT_ID_SENSOR;
-						break;
-					}
-					/* we don't need to assert the interrupt when system state in S0ix */
-					if (chipset_in_state(CHIPSET_STATE_ON))
-						hid_irq_to_host();
-				}
-			}
-		}
+static int command_hidstat(int argc, char **argv)
+{
+	uint64_t t = get_time().val - hid_stats.since.val;
+	/* IRQs per second, times 100 */
+	int rate = t ? (uint64_t)hid_stats.irqs * SECOND * 100 / t : 0;
+
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "reset"))
+			return EC_ERROR_PARAM1;
+		memset(&hid_stats, 0, sizeof(hid_stats));
+		hid_stats.since = get_time();
+		return EC_SUCCESS;
 	}
-};
+
+	ccprintf("host irqs %d (%d.%02d/s), reports read %d\n",
+		 hid_stats.irqs, rate / 100, rate % 100, hid_stats.reports);
+	ccprintf("als updates %d, coalesced %d; dropped %d\n",
+		 hid_stats.als_updates, hid_stats.als_coalesced,
+		 hid_stats.dropped);
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(hidstat, command_hidstat,
+			"[reset]",
+			"Show or clear I2C HID report statistics");
+
@@ -5,9 +5,12 @@
 
 #include "common.h"
 #include "chipset.h"
+#include "host_command.h"
+#include "host_command_customization.h"
 #include "keyboard_customization.h"
 #include "keyboard_8042_sharedlib.h"
 #include "keyboard_config.h"
+#include "keyboard_latency.h"
 #include "keyboard_protocol.h"
 #include "keyboard_raw.h"
 #include "keyboard_scan.h"
@@ -15,6 +18,7 @@
 #include "pwm.h"
 #include "hooks.h"
 #include "system.h"
+#include "util.h"
 
 #include "i2c_hid_mediakeys.h"
 /* Console output macros */
@@ -22,37 +26,87 @@
 #define CPRINTS(format, args...) cprints(CC_KEYBOARD, format, ## args)
 #define CPRINTF(format, args...) cprintf(CC_KEYBOARD, format, ## args)
 
-uint16_t scancode_set2[KEYBOARD_COLS_MAX][KEYBOARD_ROWS] = {
-		{0x0021, 0x007B, 0x0079, 0x0072, 0x007A, 0x0071, 0x0069, 0xe04A},
-		{0xe071, 0xe070, 0x007D, 0xe01f, 0x006c, 0xe06c, 0xe07d, 0x0077},
-		{0x0015, 0x0070, 0x00ff, 0x000D, 0x000E, 0x0016, 0x0067, 0x001c},
-		{0xe011, 0x0011, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000},
-		{0xe05a, 0x0029, 0x0024, 0x000c, 0x0058, 0x0026, 0x0004, 0xe07a},
-		{0x0022, 0x001a, 0x0006, 0x0005, 0x001b, 0x001e, 0x001d, 0x0076},
-		{0x002A, 0x0032, 0x0034, 0x002c, 0x002e, 0x0025, 0x002d, 0x002b},
-		{0x003a, 0x0031, 0x0033, 0x0035, 0x0036, 0x003d, 0x003c, 0x003b},
-		{0x0049, 0xe072, 0x005d, 0x0044, 0x0009, 0x0046, 0x0078, 0x004b},
-		{0x0059, 0x0012, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000},
-		{0x0041, 0x007c, 0x0083, 0x000b, 0x0003, 0x003e, 0x0043, 0x0042},
-		{0x0013, 0x0064, 0x0075, 0x0001, 0x0051, 0x0061, 0xe06b, 0xe02f},
-		{0xe014, 0x0014, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000},
-		{0x004a, 0xe075, 0x004e, 0x0007, 0x0045, 0x004d, 0x0054, 0x004c},
-		{0x0052, 0x005a, 0xe03c, 0xe069, 0x0055, 0x0066, 0x005b, 0x0023},
-		{0x006a, 0x000a, 0xe074, 0xe054, 0x0000, 0x006b, 0x0073, 0x0074},
-};
+/* Keys and layers, generated at build time by gen_keyboard_layers.py */
+#include "keyboard_layers.h"
+
+/*
+ * Keys changed at runtime, by EC_CMD_UPDATE_KEYBOARD_MATRIX or factory mode,
+ * on top of the base layer.
+ */
+#define KB_PATCH_MAX 32
+
+static struct {
+	uint8_t col;
+	uint8_t row;
+	struct kb_key key;
+} kb_patch[KB_PATCH_MAX];
+static int kb_patch_count;
+/* Rows with a patch in each column, so other keys skip the search */
+static uint8_t kb_patch_mask[KEYBOARD_COLS_MAX];
+
+static const struct kb_key *kb_base_key(uint8_t row, uint8_t col)
+{
+	int i;
+
+	if (kb_patch_mask[col] & BIT(row)) {
+		for (i = 0; i < kb_patch_count; i++)
+			if (kb_patch[i].col == col && kb_patch[i].row == row)
+				return &kb_patch[i].key;
+	}
 
+	return &kb_layer_base[col][row];
+}
 
 uint16_t get_scancode_set2(uint8_t row, uint8_t col)
 {
-	if (col < KEYBOARD_COLS_MAX && row < KEYBOARD_ROWS)
-		return scancode_set2[col][row];
-	return 0;
+	const struct kb_key *k;
+
+	if (col >= KEYBOARD_COLS_MAX || row >= KEYBOARD_ROWS)
+		return 0;
+
+	k = kb_base_key(row, col);
+	return k->prefix << 8 | k->set2;
 }
 
 void set_scancode_set2(uint8_t row, uint8_t col, uint16_t val)
 {
-	if (col < KEYBOARD_COLS_MAX && row < KEYBOARD_ROWS)
-		scancode_set2[col][row] = val;
+	const struct kb_key *base;
+	struct kb_key *k;
+	int i;
+
+	if (col >= KEYBOARD_COLS_MAX || row >= KEYBOARD_ROWS)
+		return;
+
+	for (i = 0; i < kb_patch_count; i++)
+		if (kb_patch[i].col == col && kb_patch[i].row == row)
+			break;
+
+	/* Back to the built-in code: drop the patch */
+	base = &kb_layer_base[col][row];
+	if (val == (base->prefix << 8 | base->set2)) {
+		if (i < kb_patch_count) {
+			kb_patch_mask[col] &= ~BIT(row);
+			kb_patch[i] = kb_patch[--kb_patch_count];
+		}
+		return;
+	}
+
+	if (i == kb_patch_count) {
+		if (kb_patch_count == KB_PATCH_MAX) {
+			CPRINTS("KB patch overlay full, %d:%d not set", row, col);
+			return;
+		}
+		kb_patch_count++;
+	}
+
+	kb_patch[i].col = col;
+	kb_patch[i].row = row;
+	k = &kb_patch[i].key;
+	k->prefix = val >> 8;
+	k->set2 = val & 0xff;
+	k->set1 = scancode_translate_set2_to_1(val & 0xff);
+	k->action = val == SCANCODE_FN ? KB_ACT_FN : KB_ACT_NONE;
+	kb_patch_mask[col] |= BIT(row);
 }
 
 // void board_keyboard_drive_col(int col)
@@ -220,39 +274,18 @@ void board_kblight_init(void)
 #define FN_PRESSED BIT(0)
 #define FN_LOCKED BIT(1)
 static uint8_t Fn_key;
-static uint32_t fn_key_table_media;
-static uint32_t fn_key_table;
-
-int fn_table_media_set(int8_t pressed, uint32_t fn_bit)
-{
-	if (pressed) {
-		fn_key_table_media |= fn_bit;
-		return true;
-	} else if (!pressed && (fn_key_table_media & fn_bit)) {
-		fn_key_table_media &= ~fn_bit;
-		return true;
-	}
-
-	return false;
-}
-
-int fn_table_set(int8_t pressed, uint32_t fn_bit)
-{
-	if (pressed && (Fn_key & FN_PRESSED)) {
-		fn_key_table |= fn_bit;
-		return true;
-	} else if (!pressed && (fn_key_table & fn_bit)) {
-		fn_key_table &= ~fn_bit;
-		return true;
-	}
-
-	return false;
-}
+/*
+ * Keys pressed while a layer was in effect, per layer, so the release goes
+ * through the same layer whatever Fn does in between.
+ */
+static uint8_t kb_latched[KB_LAYER_COUNT][KEYBOARD_COLS_MAX];
 
 void fnkey_shutdown(void) {
 	uint8_t current_kb = 0;
 
+#ifdef CONFIG_KEYBOARD_BACKLIGHT
 	current_kb |= kblight_get() & 0x7F;
+#endif
 
 	if (Fn_key & FN_LOCKED) {
 		current_kb |= 0x80;
@@ -276,255 +309,286 @@ void fnkey_startup(void) {
 }
 DECLARE_HOOK(HOOK_CHIPSET_STARTUP, fnkey_startup, HOOK_PRIO_DEFAULT);
 
-int hotkey_F1_F12(uint16_t *key_code, uint16_t fn, int8_t pressed)
+/*
+ * Layers go by the code a key sends, so a patched key takes the layer
+ * entries of the base key with its code, if there is one.
+ */
+static int kb_layer_home(uint8_t *row, uint8_t *col)
 {
-	const uint16_t prss_key = *key_code;
-
-	if (!(Fn_key & FN_LOCKED) &&
-		(fn & FN_PRESSED))
-		return EC_SUCCESS;
-	else if (Fn_key & FN_LOCKED &&
-		!(fn & FN_PRESSED) &&
-		!fn_key_table_media)
-		return EC_SUCCESS;
-	else if (!fn_key_table_media && !pressed)
-		return EC_SUCCESS;
-
-	switch (prss_key) {
-	case SCANCODE_F1:  /* SPEAKER_MUTE */
-		if (fn_table_media_set(pressed, KB_FN_F1))
-			*key_code = SCANCODE_VOLUME_MUTE;
-		break;
-	case SCANCODE_F2:  /* VOLUME_DOWN */
-		if (fn_table_media_set(pressed, KB_FN_F2))
-			*key_code = SCANCODE_VOLUME_DOWN;
-		break;
-	case SCANCODE_F3:  /* VOLUME_UP */
-		if (fn_table_media_set(pressed, KB_FN_F3))
-			*key_code = SCANCODE_VOLUME_UP;
-		break;
-	case SCANCODE_F4:  /* PREVIOUS_TRACK */
-		if (fn_table_media_set(pressed, KB_FN_F4))
-			*key_code = SCANCODE_PREV_TRACK;
-		break;
-	case SCANCODE_F5:  /* PLAY_PAUSE */
-		if (fn_table_media_set(pressed, KB_FN_F5))
-			*key_code = 0xe034;
-		break;
-	case SCANCODE_F6:  /* NEXT_TRACK */
-		if (fn_table_media_set(pressed, KB_FN_F6))
-			*key_code = SCANCODE_NEXT_TRACK;
-		break;
-	case SCANCODE_F7:  /* TODO: DIM_SCREEN */
-		if (fn_table_media_set(pressed, KB_FN_F7)) {
-			update_hid_key(HID_KEY_DISPLAY_BRIGHTNESS_DN, pressed);
-			return EC_ERROR_UNIMPLEMENTED;
-		}
-		break;
-	case SCANCODE_F8:  /* TODO: BRIGHTEN_SCREEN */
-		if (fn_table_media_set(pressed, KB_FN_F8)) {
-			update_hid_key(HID_KEY_DISPLAY_BRIGHTNESS_UP, pressed);
-			return EC_ERROR_UNIMPLEMENTED;
-		}
-		break;
-	case SCANCODE_F9:  /* EXTERNAL_DISPLAY */
-		if (fn_table_media_set(pressed, KB_FN_F9)) {
-			if (pressed) {
-				simulate_keyboard(SCANCODE_LEFT_WIN, 1);
-				simulate_keyboard(SCANCODE_P, 1);
-			} else {
-				simulate_keyboard(SCANCODE_P, 0);
-				simulate_keyboard(SCANCODE_LEFT_WIN, 0);
+	const struct kb_key *k = kb_base_key(*row, *col);
+	const struct kb_key *b;
+	int c, r;
+
+	for (c = 0; c < KEYBOARD_COLS_MAX; c++) {
+		for (r = 0; r < KEYBOARD_ROWS; r++) {
+			b = &kb_layer_base[c][r];
+			if (b->prefix == k->prefix && b->set2 == k->set2) {
+				*row = r;
+				*col = c;
+				return 1;
 			}
-			return EC_ERROR_UNIMPLEMENTED;
 		}
-		break;
-	case SCANCODE_F10:  /* FLIGHT_MODE */
-		if (fn_table_media_set(pressed, KB_FN_F10)) {
-			update_hid_key(HID_KEY_AIRPLANE_MODE, pressed);
-			return EC_ERROR_UNIMPLEMENTED;
+	}
+
+	return 0;
+}
+
+static const struct kb_key *kb_layer_key(int layer, uint8_t row, uint8_t col)
+{
+	const struct kb_layer *l = &kb_layers[layer];
+	uint8_t mask;
+
+	if ((kb_patch_mask[col] & BIT(row)) && !kb_layer_home(&row, &col))
+		return NULL;
+
+	mask = l->mask[col];
+
+	if (!(mask & BIT(row)))
+		return NULL;
+
+	return &l->keys[l->rank[col] +
+			__builtin_popcount(mask & (BIT(row) - 1))];
+}
+
+static int kb_layer_active(int layer)
+{
+	int fn = !!(Fn_key & FN_PRESSED);
+
+	switch (layer) {
+	case KB_LAYER_FN:
+		return fn;
+	case KB_LAYER_MEDIA:
+		/* The F-row is media keys, unless Fn or Fn lock flips it */
+		return fn == !!(Fn_key & FN_LOCKED);
+	default:
+		return 0;
+	}
+}
+
+/* Layers in order of precedence */
+static const uint8_t kb_layer_order[] = { KB_LAYER_FN, KB_LAYER_MEDIA };
+BUILD_ASSERT(ARRAY_SIZE(kb_layer_order) == KB_LAYER_COUNT);
+
+/* Drop the latch of a key once its release is reported */
+static void kb_layers_release(uint8_t row, uint8_t col)
+{
+	int layer;
+
+	for (layer = 0; layer < KB_LAYER_COUNT; layer++)
+		kb_latched[layer][col] &= ~BIT(row);
+}
+
+/*
+ * Pick the layer for a key press and latch the key in it until its release,
+ * or return NULL to use the base layer.
+ */
+static const struct kb_key *kb_layers_press(uint8_t row, uint8_t col)
+{
+	const struct kb_key *k;
+	int i, layer;
+
+	/* Drop a latch left by a release that was not reported */
+	kb_layers_release(row, col);
+
+	if (factory_status())
+		return NULL;
+
+	/*
+	 * If the system still in preOS
+	 * then we pass through all events without modifying them
+	 */
+	if (!pos_get_state())
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE(kb_layer_order); i++) {
+		layer = kb_layer_order[i];
+		if (!kb_layer_active(layer))
+			continue;
+		k = kb_layer_key(layer, row, col);
+		if (k) {
+			kb_latched[layer][col] |= BIT(row);
+			return k;
 		}
+	}
+
+	return NULL;
+}
+
+/* Get the key from the layer it was latched in, or NULL for the base layer */
+static const struct kb_key *kb_layers_key(uint8_t row, uint8_t col)
+{
+	int layer;
+
+	for (layer = 0; layer < KB_LAYER_COUNT; layer++)
+		if (kb_latched[layer][col] & BIT(row))
+			return kb_layer_key(layer, row, col);
+
+	return NULL;
+}
+
+/*
+ * Follow one debounced edge: latch the layer of a press and track Fn, so
+ * the layers stand as they did at the time of each edge when the 8042 path
+ * turns it into scancodes.
+ */
+static void kb_layers_event(const struct keyboard_scan_event *ev)
+{
+	const struct kb_key *k;
+
+	if (ev->col >= KEYBOARD_COLS_MAX || ev->row >= KEYBOARD_ROWS)
+		return;
+
+	if (ev->pressed)
+		k = kb_layers_press(ev->row, ev->col);
+	else
+		k = kb_layers_key(ev->row, ev->col);
+	if (!k)
+		k = kb_base_key(ev->row, ev->col);
+
+	switch (k->action) {
+	case KB_ACT_FN:
+		if (ev->pressed)
+			Fn_key |= FN_PRESSED;
+		else
+			Fn_key &= ~FN_PRESSED;
 		break;
-	case SCANCODE_F11:
-			/*
-			 * TODO this might need an
-			 * extra key combo of:
-			 * 0xE012 0xE07C to simulate
-			 * PRINT_SCREEN
-			 */
-		if (fn_table_media_set(pressed, KB_FN_F11))
-			*key_code = 0xE07C;
-		break;
-	case SCANCODE_F12:  /* TODO: FRAMEWORK */
-		/* Media Select scan code */
-		if (fn_table_media_set(pressed, KB_FN_F12))
-			*key_code = 0xE050;
+	case KB_ACT_FN_LOCK:
+		if (ev->pressed)
+			Fn_key ^= FN_LOCKED;
 		break;
 	default:
-		return EC_SUCCESS;
+		break;
 	}
-	return EC_SUCCESS;
 }
 
+/* Position of the next key edge for the Fn layer */
+static uint32_t kb_layers_events;
 
-int hotkey_special_key(uint16_t *key_code, int8_t pressed)
+__override void keyboard_board_scan_events(void)
 {
-	const uint16_t prss_key = *key_code;
+	struct keyboard_scan_event ev;
 
-	switch (prss_key) {
-	case SCANCODE_DELETE:  /* TODO: INSERT */
-		if (fn_table_set(pressed, KB_FN_DELETE))
-			*key_code = 0xe070;
-		break;
-	case SCANCODE_K:  /* TODO: SCROLL_LOCK */
-		if (fn_table_set(pressed, KB_FN_K))
-			*key_code = SCANCODE_SCROLL_LOCK;
-		break;
-	case SCANCODE_S:  /* TODO: SYSRQ */
-		/*if (!fn_table_set(pressed, KB_FN_S))*/
+	while (keyboard_scan_get_event(&kb_layers_events, &ev))
+		kb_layers_event(&ev);
+}
 
+#ifdef CONFIG_KEYBOARD_BACKLIGHT
+static void kb_backlight_step(void)
+{
+	uint8_t bl_brightness = kblight_get();
+
+	switch (bl_brightness) {
+	case KEYBOARD_BL_BRIGHTNESS_LOW:
+		bl_brightness = KEYBOARD_BL_BRIGHTNESS_MED;
 		break;
-	case SCANCODE_LEFT:  /* HOME */
-		if (fn_table_set(pressed, KB_FN_LEFT))
-			*key_code = 0xe06c;
-		break;
-	case SCANCODE_RIGHT:  /* END */
-		if (fn_table_set(pressed, KB_FN_RIGHT))
-			*key_code = 0xe069;
-		break;
-	case SCANCODE_UP:  /* PAGE_UP */
-		if (fn_table_set(pressed, KB_FN_UP))
-			*key_code = 0xe07d;
+	case KEYBOARD_BL_BRIGHTNESS_MED:
+		bl_brightness = KEYBOARD_BL_BRIGHTNESS_HIGH;
 		break;
-	case SCANCODE_DOWN:  /* PAGE_DOWN */
-		if (fn_table_set(pressed, KB_FN_DOWN))
-			*key_code = 0xe07a;
+	case KEYBOARD_BL_BRIGHTNESS_HIGH:
+		hx20_kblight_enable(0);
+		bl_brightness = KEYBOARD_BL_BRIGHTNESS_OFF;
 		break;
 	default:
-		return EC_SUCCESS;
+	case KEYBOARD_BL_BRIGHTNESS_OFF:
+		hx20_kblight_enable(1);
+		bl_brightness = KEYBOARD_BL_BRIGHTNESS_LOW;
+		break;
 	}
-
-	return EC_SUCCESS;
+	kblight_set(bl_brightness);
 }
+#endif
 
-int functional_hotkey(uint16_t *key_code, int8_t pressed)
+static void kb_action(enum kb_action action, int8_t pressed)
 {
-	const uint16_t prss_key = *key_code;
-	uint8_t bl_brightness = 0;
-
-	switch (prss_key) {
-	case SCANCODE_ESC: /* TODO: FUNCTION_LOCK */
-		if (fn_table_set(pressed, KB_FN_ESC)) {
-			if (pressed) {
-				if (Fn_key & FN_LOCKED)
-					Fn_key &= ~FN_LOCKED;
-				else
-					Fn_key |= FN_LOCKED;
-			}
-			return EC_ERROR_UNIMPLEMENTED;
+	/* Fn and Fn lock are followed by kb_layers_event() */
+	switch (action) {
+	case KB_ACT_BREAK:
+		if (pressed) {
+			simulate_keyboard(0xe07e, 1);
+			simulate_keyboard(0xe0, 1);
+			simulate_keyboard(0x7e, 0);
 		}
 		break;
-	case SCANCODE_B:
-		/* BREAK_KEY */
-		if (fn_table_set(pressed, KB_FN_B)) {
-			if (pressed) {
-				simulate_keyboard(0xe07e, 1);
-				simulate_keyboard(0xe0, 1);
-				simulate_keyboard(0x7e, 0);
-			}
-			return EC_ERROR_UNIMPLEMENTED;
+	case KB_ACT_PAUSE:
+		if (pressed) {
+			simulate_keyboard(0xe114, 1);
+			simulate_keyboard(0x77, 1);
+			simulate_keyboard(0xe1, 1);
+			simulate_keyboard(0x14, 0);
+			simulate_keyboard(0x77, 0);
 		}
 		break;
-	case SCANCODE_P:
-		/* PAUSE_KEY */
-		if (fn_table_set(pressed, KB_FN_P)) {
-			if (pressed) {
-				simulate_keyboard(0xe114, 1);
-				simulate_keyboard(0x77, 1);
-				simulate_keyboard(0xe1, 1);
-				simulate_keyboard(0x14, 0);
-				simulate_keyboard(0x77, 0);
-			}
-			return EC_ERROR_UNIMPLEMENTED;
-		}
+#ifdef CONFIG_KEYBOARD_BACKLIGHT
+	case KB_ACT_BACKLIGHT:
+		if (pressed)
+			kb_backlight_step();
 		break;
-	case SCANCODE_SPACE:	/* TODO: TOGGLE_KEYBOARD_BACKLIGHT */
-		if (fn_table_set(pressed, KB_FN_SPACE)) {
-			if (pressed) {
-				bl_brightness = kblight_get();
-				switch (bl_brightness) {
-				case KEYBOARD_BL_BRIGHTNESS_LOW:
-					bl_brightness = KEYBOARD_BL_BRIGHTNESS_MED;
-					break;
-				case KEYBOARD_BL_BRIGHTNESS_MED:
-					bl_brightness = KEYBOARD_BL_BRIGHTNESS_HIGH;
-					break;
-				case KEYBOARD_BL_BRIGHTNESS_HIGH:
-					hx20_kblight_enable(0);
-					bl_brightness = KEYBOARD_BL_BRIGHTNESS_OFF;
-					break;
-				default:
-				case KEYBOARD_BL_BRIGHTNESS_OFF:
-					hx20_kblight_enable(1);
-					bl_brightness = KEYBOARD_BL_BRIGHTNESS_LOW;
-					break;
-				}
-				kblight_set(bl_brightness);
-			}
-			/* we dont want to pass the space key event to the OS */
-			return EC_ERROR_UNIMPLEMENTED;
+#endif
+	case KB_ACT_BRIGHTNESS_DOWN:
+		update_hid_key(HID_KEY_DISPLAY_BRIGHTNESS_DN, pressed);
+		break;
+	case KB_ACT_BRIGHTNESS_UP:
+		update_hid_key(HID_KEY_DISPLAY_BRIGHTNESS_UP, pressed);
+		break;
+	case KB_ACT_PROJECT:
+		if (pressed) {
+			simulate_keyboard(SCANCODE_LEFT_WIN, 1);
+			simulate_keyboard(SCANCODE_P, 1);
+		} else {
+			simulate_keyboard(SCANCODE_P, 0);
+			simulate_keyboard(SCANCODE_LEFT_WIN, 0);
 		}
 		break;
+	case KB_ACT_AIRPLANE:
+		update_hid_key(HID_KEY_AIRPLANE_MODE, pressed);
+		break;
+	default:
+		break;
 	}
-	return EC_SUCCESS;
 }
+#endif
 
-enum ec_error_list keyboard_scancode_callback(uint16_t *make_code,
-					      int8_t pressed)
+enum ec_error_list keyboard_board_scancode(int8_t row, int8_t col,
+					   int8_t pressed, int set1,
+					   uint8_t *scan_code, int32_t *len)
 {
-	const uint16_t pressed_key = *make_code;
-	int r = 0;
+	const struct kb_key *k = NULL;
 
-	if (factory_status())
-		return EC_SUCCESS;
+	*len = 0;
 
-	if (pressed_key == SCANCODE_FN && pressed) {
-		Fn_key |= FN_PRESSED;
-		return EC_ERROR_UNIMPLEMENTED;
-	} else if (pressed_key == SCANCODE_FN && !pressed) {
-		Fn_key &= ~FN_PRESSED;
+#ifdef CONFIG_KEYBOARD_CUSTOMIZATION_COMBINATION_KEY
+	k = kb_layers_key(row, col);
+	if (!pressed)
+		kb_layers_release(row, col);
+#endif
+	if (!k)
+		k = kb_base_key(row, col);
+
+	if (k->action != KB_ACT_NONE) {
+#ifdef CONFIG_KEYBOARD_CUSTOMIZATION_COMBINATION_KEY
+		kb_action(k->action, pressed);
+#endif
+		/* Not passed on to the OS */
 		return EC_ERROR_UNIMPLEMENTED;
 	}
 
-	/*
-	 * If the system still in preOS
-	 * then we pass through all events without modifying them
-	 */
-	if (!pos_get_state())
-		return EC_SUCCESS;
-
-	r = hotkey_F1_F12(make_code, Fn_key, pressed);
-	if (r != EC_SUCCESS)
-		return r;
-	/*
-	 * If the function key is not held then
-	 * we pass through all events without modifying them
-	 * but if last time have press FN still need keep that
-	 */
-	if (!(Fn_key & FN_PRESSED) && !fn_key_table)
-		return EC_SUCCESS;
-
-	r = hotkey_special_key(make_code, pressed);
-	if (r != EC_SUCCESS)
-		return r;
+	if (!k->prefix && !k->set2) {
+		CPRINTS("KB scancode %d:%d missing", row, col);
+		return EC_ERROR_UNIMPLEMENTED;
+	}
 
-	r = functional_hotkey(make_code, pressed);
-	if (r != EC_SUCCESS)
-		return r;
+	if (k->prefix)
+		scan_code[(*len)++] = k->prefix;
+	if (set1) {
+		scan_code[(*len)++] = pressed ? k->set1 : k->set1 | 0x80;
+	} else {
+		if (!pressed)
+			scan_code[(*len)++] = 0xf0;
+		scan_code[(*len)++] = k->set2;
+	}
 
 	return EC_SUCCESS;
 }
-#endif
 
 #ifdef CONFIG_FACTORY_SUPPORT
 /* By default the power button is active low */
@@ -574,3 +638,37 @@ int factory_status(void)
 }
 
 #endif
+
+#ifdef CONFIG_KEYBOARD_LATENCY
+BUILD_ASSERT(KBLAT_STAGE_COUNT == EC_KBLAT_STAGES);
+BUILD_ASSERT(KBLAT_HIST_BUCKETS == EC_KBLAT_HIST_BUCKETS);
+
+static enum ec_status
+keyboard_latency_hc(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_keyboard_latency *p = args->params;
+	struct ec_response_keyboard_latency *r = args->response;
+	uint32_t last[KBLAT_STAGE_COUNT];
+	struct kblat_stats s;
+	int i;
+
+	r->count = keyboard_latency_last(last);
+	r->lost = keyboard_latency_lost();
+	for (i = 0; i < KBLAT_STAGE_COUNT; i++) {
+		keyboard_latency_get(i, &s);
+		r->stage[i].min_us = s.min_us;
+		r->stage[i].avg_us = s.count ? s.total_us / s.count : 0;
+		r->stage[i].max_us = s.max_us;
+		memcpy(r->stage[i].hist, s.hist, sizeof(s.hist));
+	}
+
+	if (p->flags & EC_KBLAT_RESET)
+		keyboard_latency_reset();
+
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_KEYBOARD_LATENCY, keyboard_latency_hc,
+			EC_VER_MASK(0));
+#endif
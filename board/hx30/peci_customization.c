@@ -8,6 +8,7 @@
 #include "board.h"
 #include "hooks.h"
 #include "host_command.h"
+#include "host_command_customization.h"
 #include "peci.h"
 #include "peci_customization.h"
 #include "timer.h"
@@ -309,4 +310,13 @@ void read_peci_over_espi_gettemp(void)
 			peci_temp = 0xffff;
 	}
 }
+#ifdef CONFIG_TEMP_SENSOR_SCHEDULE
+int peci_over_espi_temp_sensor_update(int idx)
+{
+	read_peci_over_espi_gettemp();
+
+	return EC_SUCCESS;
+}
+#else
 DECLARE_HOOK(HOOK_SECOND, read_peci_over_espi_gettemp, HOOK_PRIO_DEFAULT);
+#endif
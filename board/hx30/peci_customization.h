@@ -70,3 +70,12 @@ int peci_update_PsysPL2(int watt);
  * @return int		return get value status
  */
 int peci_over_espi_temp_sensor_get_val(int idx, int *temp_ptr);
+
+/**
+ * Read the peci gettemp value used by peci_over_espi_temp_sensor_get_val(),
+ * from the temp sensor sampling schedule.
+ *
+ * @param idx		no used
+ * @return int		always EC_SUCCESS, read errors are kept in the value
+ */
+int peci_over_espi_temp_sensor_update(int idx);
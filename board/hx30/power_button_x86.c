@@ -13,6 +13,7 @@
 #include "gpio.h"
 #include "hooks.h"
 #include "host_command.h"
+#include "host_command_customization.h"
 #include "keyboard_scan.h"
 #include "lid_switch.h"
 #include "power_button.h"
@@ -0,0 +1,282 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Thermal history: the last few minutes of sensor temperatures, fan, throttle
+ * state and CPU power limits, with threshold crossings logged as events, so
+ * a throttling unit can be looked at after the fact.
+ */
+
+#include "chipset.h"
+#include "common.h"
+#include "console.h"
+#include "cpu_power.h"
+#include "ec_commands.h"
+#include "fan.h"
+#include "gpio.h"
+#include "hooks.h"
+#include "host_command.h"
+#include "host_command_customization.h"
+#include "task.h"
+#include "temp_sensor.h"
+#include "thermal.h"
+#include "throttle_ap.h"
+#include "timer.h"
+#include "util.h"
+
+BUILD_ASSERT(TEMP_SENSOR_COUNT <= EC_THERMAL_HIST_SENSORS);
+BUILD_ASSERT(EC_TEMP_THRESH_COUNT == EC_THERMAL_HIST_EVENT_FAN_OFF);
+
+#define THIST_NO_SENSOR 0xFF
+
+/*
+ * Entries are only taken while the AP is up, so the run-up to a thermal
+ * shutdown is still there to read once the system is back on.
+ */
+static struct ec_thermal_history_entry thist[CONFIG_THERMAL_HISTORY_ENTRIES];
+static struct ec_thermal_history_event
+	thist_events[CONFIG_THERMAL_HISTORY_EVENTS];
+/* Entries / events ever recorded */
+static uint32_t thist_seq;
+static uint32_t thist_event_seq;
+static timestamp_t thist_time;
+static struct mutex thist_lock;
+
+/* Conditions at the previous entry, BIT(enum ec_thermal_hist_event_type) */
+static uint8_t thist_sensor_state[TEMP_SENSOR_COUNT];
+static struct ec_thermal_history_entry thist_last;
+
+static void thist_event(int type, int rising, int sensor, int value,
+			int limit)
+{
+	struct ec_thermal_history_event *ev;
+
+	ev = &thist_events[thist_event_seq % CONFIG_THERMAL_HISTORY_EVENTS];
+	ev->seq = thist_seq;
+	ev->type = type | (rising ? EC_THERMAL_HIST_EVENT_RISING : 0);
+	ev->sensor = sensor;
+	ev->value = value;
+	ev->limit = limit;
+	thist_event_seq++;
+}
+
+static int thist_temp(int k)
+{
+	return CLAMP(K_TO_C(k), 0, EC_THERMAL_HIST_TEMP_INVALID - 1);
+}
+
+/*
+ * Work out which conditions hold for a sensor, with the same hysteresis as
+ * thermal_control() for the host thresholds, and log the ones that changed.
+ */
+static void thist_check_sensor(int id, int t)
+{
+	const struct ec_thermal_config *p = &thermal_params[id];
+	uint8_t state = 0, was = thist_sensor_state[id];
+	int limit, release, j;
+
+	for (j = 0; j < EC_TEMP_THRESH_COUNT; j++) {
+		limit = p->temp_host[j];
+		if (!limit)
+			continue;
+		release = p->temp_host_release[j];
+		if (!release)
+			release = limit;
+		if (t > limit || ((was & BIT(j)) && t >= release))
+			state |= BIT(j);
+	}
+	if (p->temp_fan_off && t > p->temp_fan_off)
+		state |= BIT(EC_THERMAL_HIST_EVENT_FAN_OFF);
+	if (p->temp_fan_max && t >= p->temp_fan_max)
+		state |= BIT(EC_THERMAL_HIST_EVENT_FAN_MAX);
+
+	for (j = 0; j <= EC_THERMAL_HIST_EVENT_FAN_MAX; j++) {
+		if (!((state ^ was) & BIT(j)))
+			continue;
+		if (j < EC_TEMP_THRESH_COUNT)
+			limit = p->temp_host[j];
+		else if (j == EC_THERMAL_HIST_EVENT_FAN_OFF)
+			limit = p->temp_fan_off;
+		else
+			limit = p->temp_fan_max;
+		thist_event(j, state & BIT(j), id, thist_temp(t),
+			    thist_temp(limit));
+	}
+
+	thist_sensor_state[id] = state;
+}
+
+static void thist_sample(void)
+{
+	struct ec_thermal_history_entry *e;
+	uint8_t changed;
+	int i, t, pl1, pl2;
+
+	if (chipset_in_state(CHIPSET_STATE_ANY_OFF))
+		return;
+
+	mutex_lock(&thist_lock);
+
+	e = &thist[thist_seq % CONFIG_THERMAL_HISTORY_ENTRIES];
+	memset(e, 0, sizeof(*e));
+
+	for (i = 0; i < EC_THERMAL_HIST_SENSORS; i++) {
+		e->temp[i] = EC_THERMAL_HIST_TEMP_INVALID;
+		if (i >= TEMP_SENSOR_COUNT ||
+		    temp_sensor_read_latest(i, &t) != EC_SUCCESS)
+			continue;
+		e->temp[i] = thist_temp(t);
+		thist_check_sensor(i, t);
+	}
+
+#ifdef CONFIG_FANS
+	e->fan_duty = fan_get_duty(FAN_CH(0));
+	e->fan_rpm = MIN(fan_get_rpm_actual(FAN_CH(0)) /
+			 EC_THERMAL_HIST_RPM_UNIT, 0xFF);
+#endif
+
+	if (!gpio_get_level(GPIO_EC_PROCHOT_L))
+		e->flags |= EC_THERMAL_HIST_PROCHOT;
+	if (throttle_ap_get_request(THROTTLE_HARD))
+		e->flags |= EC_THERMAL_HIST_THROTTLE_HARD;
+	if (throttle_ap_get_request(THROTTLE_SOFT))
+		e->flags |= EC_THERMAL_HIST_THROTTLE_SOFT;
+	if (chipset_in_state(CHIPSET_STATE_ON))
+		e->flags |= EC_THERMAL_HIST_AP_ON;
+
+	get_soc_power_limit(&pl1, &pl2);
+	e->pl1 = MIN(pl1, 0xFF);
+	e->pl2 = MIN(pl2, 0xFF);
+
+	changed = e->flags ^ thist_last.flags;
+	for (i = 0; changed; i++, changed >>= 1)
+		if (changed & 1)
+			thist_event(EC_THERMAL_HIST_EVENT_FLAG,
+				    e->flags & BIT(i), THIST_NO_SENSOR, 0,
+				    BIT(i));
+	if (e->pl1 != thist_last.pl1 || e->pl2 != thist_last.pl2)
+		thist_event(EC_THERMAL_HIST_EVENT_POWER_LIMIT,
+			    e->pl1 > thist_last.pl1, THIST_NO_SENSOR, e->pl1,
+			    e->pl2);
+
+	thist_last = *e;
+	thist_seq++;
+	thist_time = get_time();
+
+	mutex_unlock(&thist_lock);
+}
+/* After thermal_control() has acted on the same readings */
+DECLARE_HOOK(HOOK_SECOND, thist_sample, HOOK_PRIO_TEMP_SENSOR_DONE + 1);
+
+static enum ec_status
+cmd_thermal_history(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_thermal_history *p = args->params;
+	struct ec_response_thermal_history *r = args->response;
+	int total, count, size, depth, i;
+	uint32_t seq;
+
+	if (args->response_max < sizeof(*r))
+		return EC_RES_INVALID_PARAM;
+
+	switch (p->read) {
+	case EC_THERMAL_HIST_READ_ENTRIES:
+		size = sizeof(struct ec_thermal_history_entry);
+		depth = CONFIG_THERMAL_HISTORY_ENTRIES;
+		break;
+	case EC_THERMAL_HIST_READ_EVENTS:
+		size = sizeof(struct ec_thermal_history_event);
+		depth = CONFIG_THERMAL_HISTORY_EVENTS;
+		break;
+	default:
+		return EC_RES_INVALID_PARAM;
+	}
+
+	mutex_lock(&thist_lock);
+
+	seq = p->read == EC_THERMAL_HIST_READ_ENTRIES ? thist_seq :
+							 thist_event_seq;
+	total = MIN(seq, depth);
+	if (p->offset > total) {
+		mutex_unlock(&thist_lock);
+		return EC_RES_INVALID_PARAM;
+	}
+	count = MIN(total - p->offset,
+		    (int)((args->response_max - sizeof(*r)) / size));
+
+	r->seq = thist_seq - 1;
+	r->age = thist_seq ? (get_time().val - thist_time.val) / MSEC : 0;
+	r->total = total;
+	r->offset = p->offset;
+	r->count = count;
+	r->interval = 1;
+	r->sensor_count = TEMP_SENSOR_COUNT;
+
+	/* Index of the oldest one held */
+	seq -= total;
+	for (i = 0; i < count; i++) {
+		if (p->read == EC_THERMAL_HIST_READ_ENTRIES)
+			memcpy(r->data + i * size,
+			       &thist[(seq + p->offset + i) % depth], size);
+		else
+			memcpy(r->data + i * size,
+			       &thist_events[(seq + p->offset + i) % depth],
+			       size);
+	}
+
+	mutex_unlock(&thist_lock);
+
+	args->response_size = sizeof(*r) + count * size;
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_HOST_COMMAND(EC_CMD_THERMAL_HISTORY, cmd_thermal_history,
+			EC_VER_MASK(0));
+
+static int cmd_thermhist(int argc, char **argv)
+{
+	const struct ec_thermal_history_entry *e;
+	const struct ec_thermal_history_event *ev;
+	int n = 10, i, j;
+	uint32_t seq;
+	char *tail;
+
+	if (argc > 1) {
+		n = strtoi(argv[1], &tail, 0);
+		if (*tail || n <= 0)
+			return EC_ERROR_PARAM1;
+	}
+
+	mutex_lock(&thist_lock);
+
+	n = MIN(n, MIN(thist_seq, CONFIG_THERMAL_HISTORY_ENTRIES));
+	ccprintf("seq     temps(C)%*s duty  rpm flags pl1 pl2\n",
+		 4 * TEMP_SENSOR_COUNT - 8, "");
+	for (seq = thist_seq - n; seq != thist_seq; seq++) {
+		e = &thist[seq % CONFIG_THERMAL_HISTORY_ENTRIES];
+		ccprintf("%6d ", seq);
+		for (i = 0; i < TEMP_SENSOR_COUNT; i++)
+			ccprintf(" %3d", e->temp[i]);
+		ccprintf(" %4d%% %4d  0x%02x %3d %3d\n", e->fan_duty,
+			 e->fan_rpm * EC_THERMAL_HIST_RPM_UNIT, e->flags,
+			 e->pl1, e->pl2);
+	}
+
+	j = MIN(thist_event_seq, CONFIG_THERMAL_HISTORY_EVENTS);
+	ccprintf("%d events\n", j);
+	for (seq = thist_event_seq - j; seq != thist_event_seq; seq++) {
+		ev = &thist_events[seq % CONFIG_THERMAL_HISTORY_EVENTS];
+		ccprintf("%6d %c type %d sensor %d value %d limit %d\n",
+			 ev->seq,
+			 ev->type & EC_THERMAL_HIST_EVENT_RISING ? '+' : '-',
+			 ev->type & EC_THERMAL_HIST_EVENT_TYPE_MASK,
+			 ev->sensor == THIST_NO_SENSOR ? -1 : ev->sensor,
+			 ev->value, ev->limit);
+	}
+
+	mutex_unlock(&thist_lock);
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(thermhist, cmd_thermhist, "[count]",
+			"Print the most recent thermal history");
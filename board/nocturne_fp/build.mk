@@ -29,5 +29,7 @@ test-list-y=\
        scratchpad \
        sha256 \
        sha256_unrolled \
+       sha256_full_unroll \
+       sha256bench \
        stm32f_rtc \
        utils \
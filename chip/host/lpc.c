@@ -12,6 +12,11 @@ test_mockable int lpc_keyboard_has_char(void)
 	return 0;
 }
 
+test_mockable int lpc_aux_has_char(void)
+{
+	return 0;
+}
+
 test_mockable int lpc_keyboard_input_pending(void)
 {
 	return 0;
@@ -22,6 +27,11 @@ test_mockable void lpc_keyboard_put_char(uint8_t chr, int send_irq)
 	/* Do nothing */
 }
 
+test_mockable void lpc_aux_put_char(uint8_t chr, int send_irq)
+{
+	/* Do nothing */
+}
+
 test_mockable void lpc_keyboard_clear_buffer(void)
 {
 	/* Do nothing */
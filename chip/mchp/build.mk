@@ -58,6 +58,10 @@ TEST_SPI=
 ifeq ($(CONFIG_MCHP_LFW_DEBUG),y)
 	TEST_SPI=--test_spi
 endif
+# LFW quad load checks the image CRC32
+ifeq ($(CONFIG_MCHP_LFW_QUAD_LOAD),y)
+	TEST_SPI=--test_spi
+endif
 
 # pack_ec.py creates SPI flash image for MEC
 # _rw_size is CONFIG_RW_SIZE
@@ -171,6 +171,9 @@
  */
 #define CONFIG_MCHP_QMSPI_TX_DMA
 
+/* QMSPI reads SPI flash with DMA while the CPU does other work */
+#define CONFIG_SPI_FLASH_READ_ASYNC
+
 /*
  * Board level gpio.inc is using MCHP data sheet GPIO pin
  * numbers which are octal.
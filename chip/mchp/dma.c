@@ -365,7 +365,8 @@ uint32_t dma_is_done_chan(enum dma_channel ch)
  * Data must be aligned >= 4-bytes and number of bytes must
  * be a multiple of 4.
  */
-int dma_crc32_start(const uint8_t *mstart, const uint32_t nbytes, int ien)
+static int dma_crc32_run(const uint8_t *mstart, const uint32_t nbytes,
+			 int ien, int restart)
 {
 	if ((mstart == NULL) || (nbytes == 0))
 		return EC_ERROR_INVAL;
@@ -378,7 +379,8 @@ int dma_crc32_start(const uint8_t *mstart, const uint32_t nbytes, int ien)
 	MCHP_DMA_CH_IEN(0) = 0;
 	MCHP_DMA_CH_ISTS(0) = 0xff;
 	MCHP_DMA_CH0_CRC32_EN = 1;
-	MCHP_DMA_CH0_CRC32_DATA	= 0xfffffffful;
+	if (restart)
+		MCHP_DMA_CH0_CRC32_DATA	= 0xfffffffful;
 	/* program device address to point to read-only register */
 	MCHP_DMA_CH_DEV_ADDR(0) = (uint32_t)(MCHP_DMA_CH_BASE + 0x1c);
 	MCHP_DMA_CH_MEM_START(0) = (uint32_t)mstart;
@@ -391,3 +393,19 @@ int dma_crc32_start(const uint8_t *mstart, const uint32_t nbytes, int ien)
 	MCHP_DMA_CH_CTRL(0) |= MCHP_DMA_SW_GO;
 	return EC_SUCCESS;
 }
+
+int dma_crc32_start(const uint8_t *mstart, const uint32_t nbytes, int ien)
+{
+	return dma_crc32_run(mstart, nbytes, ien, 1);
+}
+
+/*
+ * Run the DMA Channel 0 CRC32 ALU over the next block of data without
+ * reloading the initial value, continuing the CRC32 of the blocks passed
+ * to dma_crc32_start() and dma_crc32_continue() before.
+ * Previous block must be done, same alignment rules as dma_crc32_start().
+ */
+int dma_crc32_continue(const uint8_t *mstart, const uint32_t nbytes, int ien)
+{
+	return dma_crc32_run(mstart, nbytes, ien, 0);
+}
@@ -58,6 +58,8 @@ uint32_t dma_is_done_chan(enum dma_channel ch);
 
 int dma_crc32_start(const uint8_t *mstart, const uint32_t nbytes, int ien);
 
+int dma_crc32_continue(const uint8_t *mstart, const uint32_t nbytes, int ien);
+
 #ifdef __cplusplus
 }
 #endif
@@ -101,6 +101,44 @@ int flash_physical_erase(int offset, int size)
 	return ret;
 }
 
+#ifdef CONFIG_SPI_FLASH_ASYNC
+int flash_physical_erase_async(int offset, int size)
+{
+	if (entire_flash_locked)
+		return EC_ERROR_ACCESS_DENIED;
+
+	trace12(0, FLASH, 0,
+		"flash_phys_erase_async: offset=0x%08X size=0x%08X",
+		offset, size);
+	return spi_flash_erase_async(offset, size);
+}
+
+int flash_physical_erase_result(void)
+{
+	return spi_flash_async_result();
+}
+
+int flash_physical_write_async(int offset, int size, const char *data)
+{
+	if (entire_flash_locked)
+		return EC_ERROR_ACCESS_DENIED;
+
+	/* Fail if offset, size, and data aren't at least word-aligned */
+	if ((offset | size | (uint32_t)(uintptr_t)data) & 3)
+		return EC_ERROR_INVAL;
+
+	trace13(0, FLASH, 0,
+		"flash_phys_write_async: offset=0x%08X size=0x%08X dataptr=0x%08X",
+		offset, size, (uint32_t)data);
+	return spi_flash_write_async(offset, size, (const uint8_t *)data);
+}
+
+int flash_physical_write_result(void)
+{
+	return spi_flash_async_result();
+}
+#endif
+
 /**
  * Read physical write protect setting for a flash bank.
  *
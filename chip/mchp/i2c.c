@@ -161,6 +161,8 @@ static struct {
 	int length;
 	uint8_t addr;
 	uint8_t buffer[I2C_MAX_HOST_PACKET_SIZE_EXTEND];
+	/* Response being sent, buffer unless i2c_set_response() changed it */
+	const uint8_t *tx;
 } slavedata[I2C_SLAVE_CONTROLLER_COUNT];
 
 static const uint16_t i2c_controller_pcr[MCHP_I2C_CTRL_MAX] = {
@@ -1041,6 +1043,30 @@ void i2c_init(void)
  * anything causing PIN 1->0 and I2C IDLE (NBB -> 1).
  * NVIC interrupt disable must clear NVIC pending bit.
  */
+#ifdef CONFIG_I2C_SLAVE
+void i2c_slave_set_response_buffer(int port, const uint8_t *data)
+{
+	int slave_idx = chip_i2c_get_slave_data_idx(port);
+
+	if (slave_idx >= 0)
+		slavedata[slave_idx].tx = data;
+}
+
+/*
+ * Next response byte. A response sent from the caller's own buffer is padded
+ * with zeros past its length rather than read beyond it.
+ */
+static uint8_t slave_tx_byte(int slave_idx)
+{
+	int count = slavedata[slave_idx].count++;
+
+	if (slavedata[slave_idx].tx != slavedata[slave_idx].buffer &&
+	    count >= slavedata[slave_idx].length)
+		return 0;
+	return slavedata[slave_idx].tx[count];
+}
+#endif
+
 static void handle_interrupt(int controller)
 {
 	uint32_t r;
@@ -1073,9 +1099,10 @@ static void handle_interrupt(int controller)
 			slavedata[slave_idx].addr = MCHP_I2C_DATA(controller);
 			if (slavedata[slave_idx].addr & 0x01) {
 				/* Slave TX */
+				slavedata[slave_idx].tx = slavedata[slave_idx].buffer;
 				slavedata[slave_idx].length = i2c_set_response(controller, slavedata[slave_idx].buffer, slavedata[slave_idx].count);
 				slavedata[slave_idx].count = 0;
-				MCHP_I2C_DATA(controller) = slavedata[slave_idx].buffer[slavedata[slave_idx].count++];
+				MCHP_I2C_DATA(controller) = slave_tx_byte(slave_idx);
 			} else {
 				/* Slave RX */
 				slavedata[slave_idx].count = 0;
@@ -1091,8 +1118,7 @@ static void handle_interrupt(int controller)
 				MCHP_I2C_DATA(controller) = 0;
 				slavedata[slave_idx].count = 0;
 			} else {
-				MCHP_I2C_DATA(controller) =
-						slavedata[slave_idx].buffer[slavedata[slave_idx].count++];
+				MCHP_I2C_DATA(controller) = slave_tx_byte(slave_idx);
 			}
 		} else {
 			slavedata[slave_idx].buffer[slavedata[slave_idx].count++] = MCHP_I2C_DATA(controller);
@@ -12,6 +12,7 @@
 #include "gpio.h"
 #include "spi.h"
 #include "spi_flash.h"
+#include "spi_flash_reg.h"
 #include "util.h"
 #include "timer.h"
 #include "dma.h"
@@ -24,9 +25,12 @@
 #include "gpio_list.h"
 #include "tfdp_chip.h"
 
-#ifdef CONFIG_MCHP_LFW_DEBUG
+#if defined(CONFIG_MCHP_LFW_DEBUG) || defined(CONFIG_MCHP_LFW_QUAD_LOAD)
 #include "dma_chip.h"
 #endif
+#ifdef CONFIG_MCHP_LFW_QUAD_LOAD
+#include "qmspi_chip.h"
+#endif
 
 #include "ec_lfw.h"
 
@@ -148,28 +152,17 @@ static int spi_flash_readloc(uint8_t *buf_usr,
 	return spi_transaction(SPI_FLASH_DEVICE, cmd, 4, buf_usr, bytes);
 }
 
-/*
- * Load EC_RO/RW image from local SPI flash.
- * If CONFIG_MEC_TEST_EC_RORW_CRC was define the last 4 bytes
- * of the binary is IEEE 802.3 CRC32 of the previous bytes.
- * Use DMA channel 0 CRC32 HW to check data integrity.
- */
-int spi_image_load(uint32_t offset)
+/* Time spent loading the EC image, reported before jumping to it */
+static uint32_t lfw_load_us;
+
+static void spi_image_load_single(uint8_t *buf, uint32_t offset)
 {
-	uint8_t *buf = (uint8_t *) (CONFIG_RW_MEM_OFF +
-				    CONFIG_PROGRAM_MEMORY_BASE);
 	uint32_t i;
 #ifdef CONFIG_MCHP_LFW_DEBUG
-	uint32_t crc_calc, crc_exp;
 	int rc;
 #endif
 
-	BUILD_ASSERT(CONFIG_RO_SIZE == CONFIG_RW_SIZE);
-
-	/* Why fill all but last 4-bytes? */
-	memset((void *)buf, 0xFF, (CONFIG_RO_SIZE - 4));
-
-	for (i = 0; i < CONFIG_RO_SIZE; i += SPI_CHUNK_SIZE)
+	for (i = 0; i < CONFIG_RO_SIZE; i += SPI_CHUNK_SIZE) {
 #ifdef CONFIG_MCHP_LFW_DEBUG
 		rc = spi_flash_readloc(&buf[i], offset + i, SPI_CHUNK_SIZE);
 		if (rc != EC_SUCCESS) {
@@ -182,13 +175,186 @@ int spi_image_load(uint32_t offset)
 #else
 		spi_flash_readloc(&buf[i], offset + i, SPI_CHUNK_SIZE);
 #endif
+		lfw_load_us += __hw_clock_source_read();
+	}
+}
+
+#if defined(CONFIG_MCHP_LFW_DEBUG) || defined(CONFIG_MCHP_LFW_QUAD_LOAD)
+/*
+ * Wait for the DMA channel 0 CRC32 ALU. Returns an error if it stopped on
+ * a DMA error or did not finish in time.
+ */
+static int lfw_crc32_wait(void)
+{
+	uint32_t t0 = __hw_clock_source_read();
+	uint32_t sts;
 
-#ifdef CONFIG_MCHP_LFW_DEBUG
-	dma_crc32_start(buf, (CONFIG_RO_SIZE - 4), 0);
 	do {
-		MCHP_USEC_DELAY(31); /* delay(stall) CPU by 32 us */
-		i = dma_is_done_chan(0);
-	} while (i == 0);
+		sts = dma_is_done_chan(0);
+		if (sts)
+			return (sts == MCHP_DMA_STS_DONE) ?
+				EC_SUCCESS : EC_ERROR_UNKNOWN;
+	} while (__hw_clock_source_read() - t0 < LFW_CRC32_TIMEOUT_US);
+
+	return EC_ERROR_TIMEOUT;
+}
+#endif
+
+#ifdef CONFIG_MCHP_LFW_QUAD_LOAD
+/*
+ * CRC32 of the image one block at a time, the block at offset 0 starts it.
+ */
+static int lfw_crc32_block(const uint8_t *buf, uint32_t ofs, uint32_t bytes)
+{
+	if (ofs == 0)
+		return dma_crc32_start(buf, bytes, 0);
+
+	return dma_crc32_continue(&buf[ofs], bytes, 0);
+}
+
+/*
+ * Fast read quad output (0x6B) needs the flash Quad Enable bit, which also
+ * turns the flash WP# and HOLD# pins into IO2 and IO3.
+ */
+static int spi_flash_quad_enabled(void)
+{
+	uint8_t cmd = SPI_FLASH_READ_SR2;
+	uint8_t sr2 = 0;
+
+	__hw_clock_source_set(0); /* restart free run timer */
+	if (spi_transaction(SPI_FLASH_DEVICE, &cmd, 1, &sr2, 1))
+		return 0;
+
+	return !!(sr2 & SPI_FLASH_SR2_QE);
+}
+
+/*
+ * Start a fast read quad output of one chunk: opcode, 24-bit address and
+ * the eight dummy clocks on IO0, then data on IO0-3 moved to SRAM by the
+ * QMSPI receive DMA channel. The caller waits for it with
+ * spi_flash_quad_wait().
+ */
+static int spi_flash_quad_start(uint8_t *buf, uint32_t offset, uint32_t bytes)
+{
+	uint8_t cmd[5] = {SPI_FLASH_READ_QUAD_OUT,
+			  (offset >> 16) & 0xFF,
+			  (offset >> 8) & 0xFF,
+			  offset & 0xFF,
+			  0xFF};
+	uint8_t rc;
+
+	if (offset + bytes > CONFIG_FLASH_SIZE)
+		return EC_ERROR_INVAL;
+
+	/* b[0]=1 close on done, b[2]=1 start, 1 tx pin, 4 rx pins */
+	rc = qmspi_xfr(SPI_FLASH_DEVICE, 0x040105, cmd, sizeof(cmd),
+		       buf, bytes);
+
+	return (rc & QMSPI_ERR_ANY) ? EC_ERROR_UNKNOWN : EC_SUCCESS;
+}
+
+static int spi_flash_quad_wait(void)
+{
+	int rc;
+
+	rc = qmspi_transaction_wait(SPI_FLASH_DEVICE);
+	if (qmspi_transaction_flush(SPI_FLASH_DEVICE) != EC_SUCCESS)
+		rc = EC_ERROR_TIMEOUT;
+
+	return rc;
+}
+
+/*
+ * Load the image in SPI_QUAD_CHUNK_SIZE chunks. While a chunk is coming in
+ * from the flash the CRC32 ALU runs over the chunk before it, so that the
+ * CRC32 of the image is ready shortly after its last byte.
+ */
+static int spi_image_load_quad(uint8_t *buf, uint32_t offset)
+{
+	uint32_t mode = MCHP_QMSPI0_MODE;
+	uint32_t i, n, prev = 0;
+	int rc = EC_SUCCESS;
+
+	/* Same SPI clock the Boot-ROM uses to load LFW and EC_RO */
+	MCHP_QMSPI0_MODE = (mode & ~(0xfful << MCHP_QMSPI_M_CLKDIV_BITPOS)) |
+		MCHP_QMSPI_M_CLKDIV_24M;
+
+	for (i = 0; i < CONFIG_RO_SIZE; i += n) {
+		n = MIN(SPI_QUAD_CHUNK_SIZE, CONFIG_RO_SIZE - i);
+
+		__hw_clock_source_set(0); /* restart free run timer */
+		rc = spi_flash_quad_start(&buf[i], offset + i, n);
+		if (rc == EC_SUCCESS && i)
+			rc = lfw_crc32_block(buf, i - prev, prev);
+		if (rc == EC_SUCCESS)
+			rc = spi_flash_quad_wait();
+		if (rc == EC_SUCCESS && i)
+			rc = lfw_crc32_wait();
+		lfw_load_us += __hw_clock_source_read();
+		if (rc != EC_SUCCESS)
+			break;
+		prev = n;
+	}
+
+	MCHP_QMSPI0_MODE = mode;
+	if (rc != EC_SUCCESS) {
+		trace11(0, LFW, 0, "Quad read failed @ 0x%08x", offset + i);
+		return rc;
+	}
+
+	/* Last chunk, less the CRC32 itself */
+	__hw_clock_source_set(0);
+	rc = lfw_crc32_block(buf, i - prev, prev - 4);
+	if (rc == EC_SUCCESS)
+		rc = lfw_crc32_wait();
+	lfw_load_us += __hw_clock_source_read();
+
+	return rc;
+}
+#endif /* CONFIG_MCHP_LFW_QUAD_LOAD */
+
+/*
+ * Load EC_RO/RW image from local SPI flash.
+ * If CONFIG_MEC_TEST_EC_RORW_CRC was define the last 4 bytes
+ * of the binary is IEEE 802.3 CRC32 of the previous bytes.
+ * Use DMA channel 0 CRC32 HW to check data integrity.
+ *
+ * With CONFIG_MCHP_LFW_QUAD_LOAD the image is read with fast read quad
+ * output and checked against its CRC32, which pack_ec.py then always adds.
+ * Any failure falls back to loading it again with single I/O reads.
+ */
+int spi_image_load(uint32_t offset)
+{
+	uint8_t *buf = (uint8_t *) (CONFIG_RW_MEM_OFF +
+				    CONFIG_PROGRAM_MEMORY_BASE);
+#if defined(CONFIG_MCHP_LFW_DEBUG) || defined(CONFIG_MCHP_LFW_QUAD_LOAD)
+	uint32_t crc_calc, crc_exp;
+#endif
+
+	BUILD_ASSERT(CONFIG_RO_SIZE == CONFIG_RW_SIZE);
+
+	lfw_load_us = 0;
+
+#ifdef CONFIG_MCHP_LFW_QUAD_LOAD
+	if (spi_flash_quad_enabled() &&
+	    spi_image_load_quad(buf, offset) == EC_SUCCESS) {
+		crc_calc = MCHP_DMA_CH0_CRC32_DATA;
+		crc_exp = *((uint32_t *)&buf[CONFIG_RO_SIZE - 4]);
+		if (crc_calc == crc_exp)
+			return 0;
+		trace12(0, LFW, 0,
+			"Quad load CRC32 = 0x%08x  expected = 0x%08x",
+			crc_calc, crc_exp);
+	}
+	trace0(0, LFW, 0, "LFW single I/O load");
+#endif
+
+	/* Every byte of the image is read, no need to fill it first */
+	spi_image_load_single(buf, offset);
+
+#if defined(CONFIG_MCHP_LFW_DEBUG) || defined(CONFIG_MCHP_LFW_QUAD_LOAD)
+	dma_crc32_start(buf, (CONFIG_RO_SIZE - 4), 0);
+	lfw_crc32_wait();
 	crc_calc = MCHP_DMA_CH0_CRC32_DATA;
 	crc_exp = *((uint32_t *)&buf[CONFIG_RO_SIZE - 4]);
 	trace12(0, LFW, 0, "EC image CRC32 = 0x%08x  expected = 0x%08x",
@@ -261,6 +427,28 @@ void uart_puts(const char *str)
 	} while (*str);
 }
 
+static void uart_put_dec(uint32_t val)
+{
+	char str[11];
+	int i = sizeof(str) - 1;
+
+	str[i] = 0;
+	do {
+		str[--i] = '0' + val % 10;
+		val /= 10;
+	} while (val);
+	uart_puts(&str[i]);
+}
+
+/* EC image load time, part of the time from power on to EC main() */
+static void lfw_report_load(void)
+{
+	uart_puts("lfw load ");
+	uart_put_dec(lfw_load_us);
+	uart_puts(" us\n");
+	trace11(0, LFW, 0, "EC image load %d us", lfw_load_us);
+}
+
 int uart_getc(void)
 {
 	int ret = -1; 
@@ -474,6 +662,7 @@ void lfw_main(void)
 		init_addr = CONFIG_RW_MEM_OFF + CONFIG_PROGRAM_MEMORY_BASE;
 		spi_image_load(CONFIG_EC_WRITABLE_STORAGE_OFF +
 			       CONFIG_RW_STORAGE_OFF);
+		lfw_report_load();
 		break;
 	case EC_IMAGE_RO:
 		trace0(0, LFW, 0, "LFW EC_RO Load");
@@ -482,6 +671,7 @@ void lfw_main(void)
 		init_addr = CONFIG_RO_MEM_OFF + CONFIG_PROGRAM_MEMORY_BASE;
 		spi_image_load(CONFIG_EC_PROTECTED_STORAGE_OFF +
 			       CONFIG_RO_STORAGE_OFF);
+		lfw_report_load();
 		break;
 	default:
 		trace0(0, LFW, 0, "LFW default: use EC_RO loaded by BootROM");
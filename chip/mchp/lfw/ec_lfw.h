@@ -39,3 +39,6 @@ struct int_vector_t {
 };
 
 #define SPI_CHUNK_SIZE			1024
+/* Fast read quad output chunk, the CRC32 of one runs during the next */
+#define SPI_QUAD_CHUNK_SIZE		(16 * 1024)
+#define LFW_CRC32_TIMEOUT_US		(10 * MSEC)
@@ -934,12 +934,12 @@ DECLARE_IRQ(MCHP_IRQ_8042EM_IBF, kb_ibf_interrupt, 1);
  * output buffer. The 8042EM STATUS.OBF bit will clear when the
  * Host reads the data and assert its OBE signal to interrupt
  * aggregator. Clear aggregator 8042EM OBE R/WC status bit before
- * invoking task.
+ * refilling the output buffer.
  */
 void kb_obe_interrupt(void)
 {
 	MCHP_INT_SOURCE(MCHP_8042_GIRQ) = MCHP_8042_OBE_GIRQ_BIT;
-	task_wake(TASK_ID_KEYPROTO);
+	keyboard_host_read_done();
 }
 DECLARE_IRQ(MCHP_IRQ_8042EM_OBE, kb_obe_interrupt, 1);
 #endif
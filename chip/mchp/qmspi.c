@@ -182,10 +182,6 @@ static uint64_t qmspi_build_rx_descr(uint32_t raddr,
 
 #ifdef CONFIG_MCHP_QMSPI_TX_DMA
 
-#define QMSPI_ERR_ANY			0x80
-#define QMSPI_ERR_BAD_PTR		0x81
-#define QMSPI_ERR_OUT_OF_DESCR		0x85
-
 /*
  * bits[1:0] of word
  * 1 -> 0
@@ -417,6 +413,163 @@ uint8_t qmspi_xfr(const struct spi_device_t *spi_device,
 
 	return (uint8_t)(did & 0xFF);
 }
+
+#if defined(CONFIG_SPI_CHAIN) && !defined(LFW)
+/*
+ * Transactions queued for one descriptor chain. The transmit bytes of all
+ * of them are gathered into one buffer that the TX DMA channel feeds to
+ * the TX FIFO, and the receive buffers must follow each other in memory
+ * so the RX DMA channel fills them in one go. Each transaction takes at
+ * most one transmit and one receive descriptor, the last of which closes
+ * (de-asserts CS#). Only the last descriptor of the chain is marked last,
+ * so QMSPI reports done once, after all of them.
+ */
+#define QMSPI_CHAIN_TX_SIZE	64
+
+static struct {
+	uint32_t descr[MCHP_QMSPI_MAX_DESCR];
+	uint32_t rx_descr_mask;
+	int ndescr;
+	uint32_t ntx;
+	uint32_t nrx;
+	uint32_t rx_align;
+	uint8_t *rxdata;
+	uint8_t tx[QMSPI_CHAIN_TX_SIZE] __aligned(4);
+} chain;
+
+/* One descriptor of n bytes, or 0 if n does not fit in the units field */
+static uint32_t qmspi_chain_units(uint32_t n)
+{
+	if (n <= MCHP_QMSPI_C_MAX_UNITS)
+		return MCHP_QMSPI_C_XFRU_1B +
+			(n << MCHP_QMSPI_C_NUM_UNITS_BITPOS);
+	if ((n & 0x0f) == 0 && (n >> 4) <= MCHP_QMSPI_C_MAX_UNITS)
+		return MCHP_QMSPI_C_XFRU_16B +
+			((n >> 4) << MCHP_QMSPI_C_NUM_UNITS_BITPOS);
+	return 0;
+}
+
+void qmspi_chain_reset(void)
+{
+	chain.ndescr = 0;
+	chain.rx_descr_mask = 0;
+	chain.ntx = 0;
+	chain.nrx = 0;
+	chain.rx_align = 0;
+	chain.rxdata = NULL;
+}
+
+int qmspi_chain_add(const uint8_t *txdata, int txlen,
+		    uint8_t *rxdata, int rxlen)
+{
+	uint32_t ntx, nrx, dtx, drx;
+	int need;
+
+	ntx = (txlen > 0) ? (uint32_t)txlen : 0;
+	nrx = (rxlen > 0) ? (uint32_t)rxlen : 0;
+	if (!ntx && !nrx)
+		return EC_ERROR_INVAL;
+	if ((ntx && txdata == NULL) || (nrx && rxdata == NULL))
+		return EC_ERROR_INVAL;
+
+	dtx = ntx ? qmspi_chain_units(ntx) : 0;
+	drx = nrx ? qmspi_chain_units(nrx) : 0;
+	if ((ntx && !dtx) || (nrx && !drx))
+		return EC_ERROR_INVAL;
+
+	need = (ntx ? 1 : 0) + (nrx ? 1 : 0);
+	if (chain.ndescr + need > MCHP_QMSPI_MAX_DESCR ||
+	    chain.ntx + ntx > QMSPI_CHAIN_TX_SIZE)
+		return EC_ERROR_OVERFLOW;
+	/* The RX DMA channel only moves into one contiguous buffer */
+	if (nrx && chain.nrx && rxdata != chain.rxdata + chain.nrx)
+		return EC_ERROR_OVERFLOW;
+
+	if (ntx) {
+		memcpy(&chain.tx[chain.ntx], txdata, ntx);
+		chain.ntx += ntx;
+		chain.descr[chain.ndescr++] = dtx + MCHP_QMSPI_C_1X +
+			MCHP_QMSPI_C_TX_DATA + MCHP_QMSPI_C_TX_DMA_1B;
+	}
+
+	if (nrx) {
+		if (!chain.nrx) {
+			chain.rxdata = rxdata;
+			chain.rx_align = (uint32_t)rxdata;
+		}
+		chain.nrx += nrx;
+		chain.rx_align |= nrx;
+		chain.rx_descr_mask |= BIT(chain.ndescr);
+		chain.descr[chain.ndescr++] = drx + MCHP_QMSPI_C_1X +
+			MCHP_QMSPI_C_RX_EN;
+	}
+
+	chain.descr[chain.ndescr - 1] |= MCHP_QMSPI_C_CLOSE;
+
+	return EC_SUCCESS;
+}
+
+int qmspi_chain_start(const struct spi_device_t *spi_device)
+{
+	const struct dma_option *opdma;
+	uint32_t d, rx_dma, dma_cfg;
+	int i;
+
+	if (spi_device == NULL)
+		return EC_ERROR_PARAM1;
+	if (!chain.ndescr)
+		return EC_ERROR_INVAL;
+
+	qmspi_descr_mode_ready();
+
+	/* 4 byte RX DMA units only if every response allows them */
+	if (chain.rx_align & 0x03) {
+		dma_cfg = 1;
+		rx_dma = MCHP_QMSPI_C_RX_DMA_1B;
+	} else {
+		dma_cfg = 4;
+		rx_dma = MCHP_QMSPI_C_RX_DMA_4B;
+	}
+
+	for (i = 0; i < chain.ndescr; i++) {
+		d = chain.descr[i];
+		if (chain.rx_descr_mask & BIT(i))
+			d |= rx_dma;
+		if (i == chain.ndescr - 1)
+			d |= MCHP_QMSPI_C_DESCR_LAST;
+		else
+			d |= ((i + 1) << MCHP_QMSPI_C_NEXT_DESCR_BITPOS);
+		MCHP_QMSPI0_DESCR(i) = d;
+	}
+
+	if (chain.ntx) {
+		opdma = spi_dma_option(spi_device, SPI_DMA_OPTION_WR);
+		dma_clr_chan(opdma->channel);
+		dma_cfg_buffers(opdma->channel, chain.tx, chain.ntx,
+			(void *)MCHP_QMSPI0_TX_FIFO_ADDR);
+		dma_cfg_xfr(opdma->channel, 1,
+			MCHP_DMA_QMSPI0_TX_REQ_ID,
+			(DMA_FLAG_M2D + DMA_FLAG_INCR_MEM));
+		dma_run(opdma->channel);
+	}
+
+	if (chain.nrx) {
+		opdma = spi_dma_option(spi_device, SPI_DMA_OPTION_RD);
+		dma_clr_chan(opdma->channel);
+		dma_cfg_buffers(opdma->channel, chain.rxdata, chain.nrx,
+			(void *)MCHP_QMSPI0_RX_FIFO_ADDR);
+		dma_cfg_xfr(opdma->channel, dma_cfg,
+			MCHP_DMA_QMSPI0_RX_REQ_ID,
+			(DMA_FLAG_D2M + DMA_FLAG_INCR_MEM));
+		dma_run(opdma->channel);
+	}
+
+	/* b[2]=1 start, done is polled by qmspi_transaction_flush() */
+	qmspi_cfg_irq_start(0x04);
+
+	return EC_SUCCESS;
+}
+#endif /* #if defined(CONFIG_SPI_CHAIN) && !defined(LFW) */
 #endif /* #ifdef CONFIG_MCHP_QMSPI_TX_DMA */
 
 /*
@@ -56,11 +56,30 @@ void qmspi_cfg_irq_start(uint8_t flags);
  * returns last descriptor 0 <= index < MCHP_QMSPI_MAX_DESCR
  * or error (bit[7]==1)
  */
+#define QMSPI_ERR_ANY			0x80
+#define QMSPI_ERR_BAD_PTR		0x81
+#define QMSPI_ERR_OUT_OF_DESCR		0x85
+
 uint8_t qmspi_xfr(const struct spi_device_t *spi_device,
 			uint32_t np_flags,
 			const uint8_t *txdata, uint32_t ntx,
 			uint8_t *rxdata, uint32_t nrx);
 
+/*
+ * Descriptor chained transactions, as used by spi_transaction_chain().
+ * qmspi_chain_add() returns EC_ERROR_OVERFLOW once the transaction does
+ * not fit the current chain anymore: out of descriptors or transmit
+ * buffer, or its receive buffer does not follow the previous one.
+ * qmspi_chain_start() starts the whole chain, qmspi_transaction_flush()
+ * waits for it.
+ */
+void qmspi_chain_reset(void);
+
+int qmspi_chain_add(const uint8_t *txdata, int txlen,
+		    uint8_t *rxdata, int rxlen);
+
+int qmspi_chain_start(const struct spi_device_t *spi_device);
+
 #endif /* #ifndef _QMSPI_CHIP_H */
 /**   @}
  */
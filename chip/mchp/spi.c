@@ -206,6 +206,16 @@ int spi_transaction_flush(const struct spi_device_t *spi_device)
 	return rc;
 }
 
+#ifndef LFW
+void spi_port_lock(const struct spi_device_t *spi_device, int lock)
+{
+	if (lock)
+		spi_mutex_lock(spi_device->port);
+	else
+		spi_mutex_unlock(spi_device->port);
+}
+#endif
+
 /* Wait for async response received but do not de-assert chip select */
 int spi_transaction_wait(const struct spi_device_t *spi_device)
 {
@@ -264,6 +274,61 @@ int spi_transaction(const struct spi_device_t *spi_device,
 	return rc;
 }
 
+#if defined(CONFIG_SPI_CHAIN) && !defined(LFW)
+#ifndef CONFIG_MCHP_QMSPI_TX_DMA
+#error "CONFIG_SPI_CHAIN needs CONFIG_MCHP_QMSPI_TX_DMA"
+#endif
+/*
+ * QMSPI runs as many transactions as fit its descriptors per submission
+ * and reports done once for all of them. GP-SPI has no descriptors and
+ * runs them one at a time.
+ */
+int spi_transaction_chain(const struct spi_device_t *spi_device,
+			  const struct spi_xfer *xfer, int count)
+{
+	int i, n;
+	int rc = EC_SUCCESS;
+
+	if (spi_device == NULL)
+		return EC_ERROR_PARAM1;
+
+	spi_mutex_lock(spi_device->port);
+
+	for (i = 0; i < count && rc == EC_SUCCESS; i += n) {
+		if (spi_device->port != QMSPI0_PORT) {
+			n = 1;
+			rc = spi_transaction_async(spi_device,
+					xfer[i].txdata, xfer[i].txlen,
+					xfer[i].rxdata, xfer[i].rxlen);
+			if (rc == EC_SUCCESS)
+				rc = spi_transaction_flush(spi_device);
+			continue;
+		}
+
+		qmspi_chain_reset();
+		for (n = 0; i + n < count; n++) {
+			rc = qmspi_chain_add(xfer[i + n].txdata,
+					xfer[i + n].txlen,
+					xfer[i + n].rxdata,
+					xfer[i + n].rxlen);
+			if (rc != EC_SUCCESS)
+				break;
+		}
+		/* A transaction that fits no chain at all */
+		if (n == 0)
+			break;
+
+		rc = qmspi_chain_start(spi_device);
+		if (rc == EC_SUCCESS)
+			rc = qmspi_transaction_flush(spi_device);
+	}
+
+	spi_mutex_unlock(spi_device->port);
+
+	return rc;
+}
+#endif
+
 /**
  * Enable SPI port and associated controller
  *
@@ -540,7 +540,7 @@ def main():
   # compute CRC32 of EC_RW except for last 4 bytes
   # Store CRC32 in last 4 bytes
   if args.test_spi == True:
-    crc = zlib.crc32(bytes(payload_rw[:(payload_rw_len - 32)]))
+    crc = zlib.crc32(bytes(payload_rw[:(payload_rw_len - 4)]))
     crc_ofs = payload_rw_len - 4
     debug_print("EC_RW CRC32 = 0x{0:08x} at offset 0x{1:08x}".format(crc, crc_ofs))
     for i in range(4):
@@ -15,6 +15,7 @@
 #include "hooks.h"
 #include "host_command.h"
 #include "system.h"
+#include "task.h"
 #include "tcpm.h"
 #include "timer.h"
 #include "usb_pd.h"
@@ -74,6 +75,44 @@ BUILD_ASSERT(ARRAY_SIZE(supplier_priority) == CHARGE_SUPPLIER_COUNT);
 static struct charge_port_info available_charge[CHARGE_SUPPLIER_COUNT]
 					       [CHARGE_PORT_COUNT];
 
+/*
+ * Per-port summary of available_charge, used to select the best charge port
+ * without re-walking every supplier on every port on each refresh. A port's
+ * summary is only recomputed when its available_charge entries change.
+ */
+struct port_summary {
+	/* Priority / power of the best supplier, prio < 0 if no charge */
+	int prio;
+	int power;
+	/* Lowest / highest supplier index having the best priority / power */
+	int min_supplier;
+	int max_supplier;
+};
+static struct port_summary port_summary[CHARGE_PORT_COUNT];
+BUILD_ASSERT(CHARGE_PORT_COUNT < 32);
+static uint32_t summary_dirty = BIT(CHARGE_PORT_COUNT) - 1;
+
+/*
+ * Batched update nesting depth, and refresh deferred by an open batch, for
+ * each task. A task only touches its own entries, so no lock is needed and
+ * a batch never holds back refreshes requested by other tasks.
+ */
+static uint8_t batch_depth[TASK_ID_COUNT];
+static uint8_t batch_refresh_pending[TASK_ID_COUNT];
+
+/* Task whose batch state applies to the caller, or TASK_ID_INVALID */
+static task_id_t batch_task(void)
+{
+	if (!task_start_called() || in_interrupt_context())
+		return TASK_ID_INVALID;
+
+	return task_get_current();
+}
+
+/* Refresh statistics */
+static uint32_t refresh_count;
+static uint32_t refresh_time_us;
+
 /* Keep track of when the supplier on each port is registered. */
 static timestamp_t registration_time[CHARGE_PORT_COUNT];
 
@@ -201,6 +240,14 @@ static int charge_manager_spoof_dualrole_capability(void)
 }
 #endif /* !CONFIG_CHARGE_MANAGER_DRP_CHARGING */
 
+/**
+ * Flag the available charge of a port as changed since the last refresh.
+ */
+static void charge_manager_mark_dirty(int port)
+{
+	deprecated_atomic_or(&summary_dirty, BIT(port));
+}
+
 /**
  * Initialize available charge. Run before board init, so board init can
  * initialize data, if needed.
@@ -218,6 +265,7 @@ static void charge_manager_init(void)
 			available_charge[j][i].voltage =
 				CHARGE_VOLTAGE_UNINITIALIZED;
 		}
+		charge_manager_mark_dirty(i);
 		for (j = 0; j < CEIL_REQUESTOR_COUNT; ++j)
 			charge_ceil[i][j] = CHARGE_CEIL_NONE;
 		if (!is_pd_port(i))
@@ -560,6 +608,32 @@ static int charge_manager_get_ceil(int port)
 	return ceil;
 }
 
+static void charge_manager_update_summary(int port)
+{
+	struct port_summary *s = &port_summary[port];
+	int i, power;
+
+	s->prio = -1;
+	for (i = 0; i < CHARGE_SUPPLIER_COUNT; ++i) {
+		/* Skip this supplier if there is no available charge. */
+		if (available_charge[i][port].current == 0 ||
+		    available_charge[i][port].voltage == 0)
+			continue;
+
+		power = POWER(available_charge[i][port]);
+		if (s->prio < 0 || supplier_priority[i] < s->prio ||
+		    (supplier_priority[i] == s->prio && power > s->power)) {
+			s->prio = supplier_priority[i];
+			s->power = power;
+			s->min_supplier = i;
+			s->max_supplier = i;
+		} else if (supplier_priority[i] == s->prio &&
+			   power == s->power) {
+			s->max_supplier = i;
+		}
+	}
+}
+
 /**
  * Select the 'best' charge port, as defined by the supplier heirarchy and the
  * ability of the port to provide power.
@@ -572,82 +646,64 @@ static void charge_manager_get_best_charge_port(int *new_port,
 {
 	int supplier = CHARGE_SUPPLIER_NONE;
 	int port = CHARGE_PORT_NONE;
-	int best_port_power = -1, candidate_port_power;
-	int i, j;
+	const struct port_summary *s, *best = NULL;
+	uint32_t dirty;
+	int j;
+
+	/* Bring the summary of any port changed since last time up to date */
+	dirty = deprecated_atomic_read_clear(&summary_dirty);
+	for (j = 0; dirty; ++j, dirty >>= 1)
+		if ((dirty & 1) && is_valid_port(j))
+			charge_manager_update_summary(j);
 
 	/* Skip port selection on OVERRIDE_DONT_CHARGE. */
 	if (override_port != OVERRIDE_DONT_CHARGE) {
 		/*
 		 * Charge supplier selection logic:
-		 * 1. Prefer higher priority supply.
-		 * 2. Prefer higher power over lower in case priority is tied.
-		 * 3. Prefer current charge port over new port in case (1)
-		 *    and (2) are tied.
-		 * available_charge can be changed at any time by other tasks,
-		 * so make no assumptions about its consistency.
+		 * 1. Prefer override port, if it has any charge.
+		 * 2. Prefer higher priority supply.
+		 * 3. Prefer higher power over lower in case priority is tied.
+		 * 4. Prefer current charge port over new port in case (2)
+		 *    and (3) are tied, otherwise prefer the lowest supplier
+		 *    then the lowest port.
+		 * Ties within a single port go to the lowest supplier, or to
+		 * the highest supplier on the current charge port.
 		 */
-		for (i = 0; i < CHARGE_SUPPLIER_COUNT; ++i)
+		if (is_valid_port(override_port) &&
+		    port_summary[override_port].prio >= 0) {
+			port = override_port;
+			best = &port_summary[port];
+		} else {
 			for (j = 0; j < CHARGE_PORT_COUNT; ++j) {
-				/* Skip this port if it is not valid. */
-				if (!is_valid_port(j))
-					continue;
-
-				/*
-				 * Skip this supplier if there is no
-				 * available charge.
-				 */
-				if (available_charge[i][j].current == 0 ||
-				    available_charge[i][j].voltage == 0)
-					continue;
-
-				/*
-				 * Don't select this port if we have a
-				 * charge on another override port.
-				 */
-				if (override_port != OVERRIDE_OFF &&
-				    override_port == port &&
-				    override_port != j)
+				s = &port_summary[j];
+				if (!is_valid_port(j) || s->prio < 0)
 					continue;
-
 #ifndef CONFIG_CHARGE_MANAGER_DRP_CHARGING
 				/*
 				 * Don't charge from a dual-role port unless
 				 * it is our override port.
 				 */
 				if (dualrole_capability[j] != CAP_DEDICATED &&
-				    override_port != j &&
 				    !charge_manager_spoof_dualrole_capability())
 					continue;
 #endif
-
-				candidate_port_power =
-					POWER(available_charge[i][j]);
-
-				/* Select if no supplier chosen yet. */
-				if (supplier == CHARGE_SUPPLIER_NONE ||
-				/* ..or if supplier priority is higher. */
-				    supplier_priority[i] <
-				    supplier_priority[supplier] ||
-				/* ..or if this is our override port. */
-				   (j == override_port &&
-				    port != override_port) ||
-				/* ..or if priority is tied and.. */
-				   (supplier_priority[i] ==
-				    supplier_priority[supplier] &&
-				/* candidate port can supply more power or.. */
-				   (candidate_port_power > best_port_power ||
-				/*
-				 * candidate port is the active port and can
-				 * supply the same amount of power.
-				 */
-				   (candidate_port_power == best_port_power &&
-				    charge_port == j)))) {
-					supplier = i;
+				if (best == NULL || s->prio < best->prio ||
+				    (s->prio == best->prio &&
+				     (s->power > best->power ||
+				      (s->power == best->power &&
+				       port != charge_port &&
+				       (j == charge_port ||
+					s->min_supplier <
+					best->min_supplier))))) {
+					best = s;
 					port = j;
-					best_port_power = candidate_port_power;
 				}
 			}
+		}
 
+		if (best)
+			supplier = port == charge_port ? best->max_supplier :
+							 best->min_supplier;
 	}
 
 #ifdef CONFIG_BATTERY
@@ -671,9 +727,9 @@ static void charge_manager_get_best_charge_port(int *new_port,
 
 /**
  * Charge manager refresh -- responsible for selecting the active charge port
- * and charge power. Called as a deferred task.
+ * and charge power.
  */
-static void charge_manager_refresh(void)
+static void charge_manager_do_refresh(void)
 {
 	/* Always initialize charge port on first pass */
 	static int active_charge_port_initialized;
@@ -716,6 +772,7 @@ static void charge_manager_refresh(void)
 			available_charge[i][new_port].current = 0;
 			available_charge[i][new_port].voltage = 0;
 		}
+		charge_manager_mark_dirty(new_port);
 	}
 
 	active_charge_port_initialized = 1;
@@ -843,8 +900,38 @@ static void charge_manager_refresh(void)
 		/* notify host of power info change */
 		pd_send_host_event(PD_EVENT_POWER_CHANGE);
 }
+
+/**
+ * Deferred wrapper around charge_manager_do_refresh(), accounting for the
+ * number of refreshes and the time spent in them.
+ */
+static void charge_manager_refresh(void)
+{
+	timestamp_t start = get_time();
+
+	charge_manager_do_refresh();
+	refresh_count++;
+	refresh_time_us += get_time().val - start.val;
+}
 DECLARE_DEFERRED(charge_manager_refresh);
 
+/**
+ * Schedule a refresh once the charge manager is seeded. Inside a batch of
+ * updates, the refresh is held until the batch ends.
+ */
+static void charge_manager_request_refresh(void)
+{
+	task_id_t task = batch_task();
+
+	if (!charge_manager_is_seeded())
+		return;
+
+	if (task < TASK_ID_COUNT && batch_depth[task])
+		batch_refresh_pending[task] = 1;
+	else
+		hook_call_deferred(&charge_manager_refresh_data, 0);
+}
+
 /**
  * Called when charge override times out waiting for power swap.
  */
@@ -943,6 +1030,7 @@ static void charge_manager_make_change(enum charge_manager_change_type change,
 	if (change == CHANGE_CHARGE) {
 		available_charge[supplier][port].current = charge->current;
 		available_charge[supplier][port].voltage = charge->voltage;
+		charge_manager_mark_dirty(port);
 		registration_time[port] = get_time();
 
 		/*
@@ -976,8 +1064,34 @@ static void charge_manager_make_change(enum charge_manager_change_type change,
 	 * to our charge port until we are certain we know what is
 	 * attached.
 	 */
-	if (charge_manager_is_seeded())
+	charge_manager_request_refresh();
+}
+
+void charge_manager_batch_begin(void)
+{
+	task_id_t task = batch_task();
+
+	if (task < TASK_ID_COUNT)
+		batch_depth[task]++;
+}
+
+void charge_manager_batch_end(void)
+{
+	task_id_t task = batch_task();
+
+	if (task >= TASK_ID_COUNT || !batch_depth[task])
+		return;
+
+	if (!--batch_depth[task] && batch_refresh_pending[task]) {
+		batch_refresh_pending[task] = 0;
 		hook_call_deferred(&charge_manager_refresh_data, 0);
+	}
+}
+
+void charge_manager_get_refresh_stats(uint32_t *count, uint32_t *time_us)
+{
+	*count = refresh_count;
+	*time_us = refresh_time_us;
 }
 
 void pd_set_input_current_limit(int port, uint32_t max_ma,
@@ -1033,6 +1147,7 @@ void typec_set_input_current_limit(int port, typec_current_t max_ma,
 		supplier = CHARGE_SUPPLIER_TYPEC_UNDER_1_5A;
 #endif /* CHARGE_MANAGER_BC12 */
 
+	charge_manager_batch_begin();
 	charge_manager_update_charge(supplier, port, &charge);
 
 	/*
@@ -1043,6 +1158,7 @@ void typec_set_input_current_limit(int port, typec_current_t max_ma,
 		if (supplier != typec_suppliers[i])
 			charge_manager_update_charge(typec_suppliers[i], port,
 						     NULL);
+	charge_manager_batch_end();
 }
 
 void charge_manager_update_charge(int supplier,
@@ -1076,8 +1192,7 @@ void charge_manager_leave_safe_mode(void)
 	CPRINTS("%s()", __func__);
 	cflush();
 	left_safe_mode = 1;
-	if (charge_manager_is_seeded())
-		hook_call_deferred(&charge_manager_refresh_data, 0);
+	charge_manager_request_refresh();
 }
 #endif
 
@@ -1088,8 +1203,8 @@ void charge_manager_set_ceil(int port, enum ceil_requestor requestor, int ceil)
 
 	if (charge_ceil[port][requestor] != ceil) {
 		charge_ceil[port][requestor] = ceil;
-		if (port == charge_port && charge_manager_is_seeded())
-			hook_call_deferred(&charge_manager_refresh_data, 0);
+		if (port == charge_port)
+			charge_manager_request_refresh();
 	}
 }
 
@@ -1130,9 +1245,7 @@ int charge_manager_set_override(int port)
 	if (port < 0 || is_sink(port)) {
 		if (override_port != port) {
 			override_port = port;
-			if (charge_manager_is_seeded())
-				hook_call_deferred(
-					&charge_manager_refresh_data, 0);
+			charge_manager_request_refresh();
 		}
 	}
 	/*
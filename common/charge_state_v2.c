@@ -152,6 +152,34 @@ static int battery_was_removed;
 static int problems_exist;
 static int debugging;
 
+#ifdef CONFIG_CHARGE_STATE_ADAPTIVE_POLL
+/*
+ * Charger loop inputs when they last changed significantly. While they stay
+ * within CHARGE_ADAPTIVE_*_MV/MA the loop doubles its sleep period.
+ */
+static struct {
+	int ac;
+	enum charge_state_v2 state;
+	enum ec_charge_control_mode chg_ctl_mode;
+	int batt_voltage;
+	int batt_current;
+	int batt_temperature;
+	int batt_state_of_charge;
+	int desired_input_current;
+	int requested_voltage;
+	int requested_current;
+} poll_anchor;
+static int poll_stable_loops;
+
+/* Loop wakeup and AC plug reaction statistics */
+static uint32_t poll_wakeups;
+static timestamp_t poll_stats_start;
+static timestamp_t ac_change_time;
+static uint64_t ac_latency_total;
+static uint32_t ac_latency_max;
+static uint32_t ac_latency_count;
+#endif
+
 
 /* Track problems in communicating with the battery or charger */
 enum problem_type {
@@ -1086,6 +1114,22 @@ static const char * const batt_pres[] = {
 	"NO", "YES", "NOT_SURE",
 };
 
+#ifdef CONFIG_CHARGE_STATE_ADAPTIVE_POLL
+static void dump_charge_poll_stats(void)
+{
+	uint64_t elapsed = get_time().val - poll_stats_start.val;
+
+	ccprintf("poll.*:\n");
+	ccprintf("\tstable_loops = %d\n", poll_stable_loops);
+	ccprintf("\twakeups = %u (%u/hour)\n", poll_wakeups,
+		 elapsed ? (uint32_t)(poll_wakeups * HOUR / elapsed) : 0);
+	ccprintf("\tac_latency = avg %u max %u us (%u events)\n",
+		 ac_latency_count ?
+			(uint32_t)(ac_latency_total / ac_latency_count) : 0,
+		 ac_latency_max, ac_latency_count);
+}
+#endif
+
 static void dump_charge_state(void)
 {
 #define DUMP(FLD, FMT) ccprintf(#FLD " = " FMT "\n", curr.FLD)
@@ -1155,6 +1199,10 @@ static void dump_charge_state(void)
 		 battery_seems_to_be_disconnected);
 	ccprintf("battery_was_removed = %d\n", battery_was_removed);
 	ccprintf("debug output = %s\n", debugging ? "on" : "off");
+#ifdef CONFIG_CHARGE_STATE_ADAPTIVE_POLL
+	cflush();
+	dump_charge_poll_stats();
+#endif
 #undef DUMP
 }
 
@@ -1378,6 +1426,10 @@ int set_chg_ctrl_mode(enum ec_charge_control_mode mode)
 		manual_voltage = 0;
 	}
 
+	/* Apply the new mode now rather than on the next (long) poll */
+	if (IS_ENABLED(CONFIG_CHARGE_STATE_ADAPTIVE_POLL))
+		task_wake(TASK_ID_CHARGER);
+
 	return EC_SUCCESS;
 }
 
@@ -1652,7 +1704,15 @@ static void charge_wakeup(void)
 	task_wake(TASK_ID_CHARGER);
 }
 DECLARE_HOOK(HOOK_CHIPSET_RESUME, charge_wakeup, HOOK_PRIO_DEFAULT);
-DECLARE_HOOK(HOOK_AC_CHANGE, charge_wakeup, HOOK_PRIO_DEFAULT);
+
+static void charge_ac_change(void)
+{
+#ifdef CONFIG_CHARGE_STATE_ADAPTIVE_POLL
+	ac_change_time = get_time();
+#endif
+	charge_wakeup();
+}
+DECLARE_HOOK(HOOK_AC_CHANGE, charge_ac_change, HOOK_PRIO_DEFAULT);
 
 #ifdef CONFIG_EC_EC_COMM_BATTERY_MASTER
 /* Reset the base on S5->S0 transition. */
@@ -1690,6 +1750,77 @@ static int get_desired_input_current(enum battery_present batt_present,
 	}
 }
 
+#ifdef CONFIG_CHARGE_STATE_ADAPTIVE_POLL
+static void charge_poll_set_anchor(void)
+{
+	poll_anchor.ac = curr.ac;
+	poll_anchor.state = curr.state;
+	poll_anchor.chg_ctl_mode = chg_ctl_mode;
+	poll_anchor.batt_voltage = curr.batt.voltage;
+	poll_anchor.batt_current = curr.batt.current;
+	poll_anchor.batt_temperature = curr.batt.temperature;
+	poll_anchor.batt_state_of_charge = curr.batt.state_of_charge;
+	poll_anchor.desired_input_current = curr.desired_input_current;
+	poll_anchor.requested_voltage = curr.requested_voltage;
+	poll_anchor.requested_current = curr.requested_current;
+}
+
+static int charge_poll_is_stable(void)
+{
+	return poll_anchor.ac == curr.ac &&
+	       poll_anchor.state == curr.state &&
+	       poll_anchor.chg_ctl_mode == chg_ctl_mode &&
+	       poll_anchor.desired_input_current ==
+			curr.desired_input_current &&
+	       poll_anchor.requested_voltage == curr.requested_voltage &&
+	       poll_anchor.requested_current == curr.requested_current &&
+	       poll_anchor.batt_state_of_charge == curr.batt.state_of_charge &&
+	       ABS(poll_anchor.batt_temperature - curr.batt.temperature) <
+			CHARGE_ADAPTIVE_TEMP_DK &&
+	       ABS(poll_anchor.batt_voltage - curr.batt.voltage) <
+			CHARGE_ADAPTIVE_VOLTAGE_MV &&
+	       ABS(poll_anchor.batt_current - curr.batt.current) <
+			CHARGE_ADAPTIVE_CURRENT_MA;
+}
+
+/*
+ * Stretch the state's default sleep period while nothing interesting
+ * changes. A critical battery keeps the default period so shutdown
+ * deadlines are still met. Returns the period to use for this iteration.
+ */
+static int charge_poll_adapt(int sleep_usec, int battery_critical)
+{
+	int i;
+
+	poll_wakeups++;
+
+	if (ac_change_time.val && curr.ac == prev_ac) {
+		uint32_t latency = get_time().val - ac_change_time.val;
+
+		ac_latency_total += latency;
+		ac_latency_max = MAX(ac_latency_max, latency);
+		ac_latency_count++;
+		ac_change_time.val = 0;
+	}
+
+	if (problems_exist || battery_critical || !charge_poll_is_stable()) {
+		charge_poll_set_anchor();
+		poll_stable_loops = 0;
+		return sleep_usec;
+	}
+
+	poll_stable_loops++;
+	if (sleep_usec >= CHARGE_ADAPTIVE_MAX_SLEEP_USEC)
+		return sleep_usec;
+
+	for (i = 0; i < poll_stable_loops &&
+		    sleep_usec < CHARGE_ADAPTIVE_MAX_SLEEP_USEC; i++)
+		sleep_usec *= 2;
+
+	return MIN(sleep_usec, CHARGE_ADAPTIVE_MAX_SLEEP_USEC);
+}
+#endif /* CONFIG_CHARGE_STATE_ADAPTIVE_POLL */
+
 /* Main loop */
 void charger_task(void *u)
 {
@@ -1741,6 +1872,10 @@ void charger_task(void *u)
 
 	battery_level_shutdown = board_set_battery_level_shutdown();
 
+#ifdef CONFIG_CHARGE_STATE_ADAPTIVE_POLL
+	poll_stats_start = get_time();
+#endif
+
 	while (1) {
 
 		/* Let's see what's going on... */
@@ -2219,6 +2354,10 @@ wait_for_it:
 		else if (sleep_usec > CHARGE_MAX_SLEEP_USEC)
 			sleep_usec = CHARGE_MAX_SLEEP_USEC;
 
+#ifdef CONFIG_CHARGE_STATE_ADAPTIVE_POLL
+		sleep_usec = charge_poll_adapt(sleep_usec, battery_critical);
+#endif
+
 		/*
 		 * If battery is critical, ensure that the sleep time is not
 		 * very long since we might want to hibernate or cut-off
@@ -2525,6 +2664,9 @@ int charge_set_input_current_limit(int ma, int mv)
 	/* Limit input current limit to max limit for this board */
 	ma = MIN(ma, CONFIG_CHARGER_MAX_INPUT_CURRENT);
 #endif
+	if (IS_ENABLED(CONFIG_CHARGE_STATE_ADAPTIVE_POLL) &&
+	    curr.desired_input_current != ma)
+		task_wake(TASK_ID_CHARGER);
 	curr.desired_input_current = ma;
 #ifdef CONFIG_EC_EC_COMM_BATTERY_MASTER
 	/* Wake up charger task to allocate current between lid and base. */
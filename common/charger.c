@@ -13,6 +13,7 @@
 #include "dptf.h"
 #include "host_command.h"
 #include "printf.h"
+#include "timer.h"
 #include "util.h"
 #include "hooks.h"
 
@@ -23,6 +24,80 @@
 /* DPTF current limit, -1 = none */
 static int dptf_limit_ma = -1;
 
+enum charger_set_field {
+	CHG_SET_VOLTAGE,
+	CHG_SET_CURRENT,
+	CHG_SET_INPUT_CURRENT,
+
+	CHG_SET_COUNT
+};
+
+#ifdef CONFIG_CHARGER_SKIP_REDUNDANT_WRITES
+/* Rewrite cached settings at least this often, in case the charger reset */
+#define CHARGER_SET_CACHE_REFRESH_US MINUTE
+
+/* Values last programmed into each charger */
+static struct {
+	int value[CHG_SET_COUNT];
+	uint8_t valid;
+	timestamp_t expire;
+} set_cache[CHARGER_NUM];
+
+static uint32_t elided_writes;
+
+void charger_invalidate_set_cache(void)
+{
+	int chgnum;
+
+	for (chgnum = 0; chgnum < CHARGER_NUM; chgnum++)
+		set_cache[chgnum].valid = 0;
+}
+DECLARE_HOOK(HOOK_CHIPSET_RESUME, charger_invalidate_set_cache,
+	     HOOK_PRIO_DEFAULT);
+
+/* Return non-zero if the charger already holds this value */
+static int charger_set_cache_hit(int chgnum, enum charger_set_field field,
+				 int value)
+{
+	if (timestamp_expired(set_cache[chgnum].expire, NULL))
+		set_cache[chgnum].valid = 0;
+
+	if (!(set_cache[chgnum].valid & BIT(field)) ||
+	    set_cache[chgnum].value[field] != value)
+		return 0;
+
+	elided_writes++;
+	return 1;
+}
+
+static void charger_set_cache_update(int chgnum, enum charger_set_field field,
+				     int value, int rv)
+{
+	if (rv != EC_SUCCESS) {
+		set_cache[chgnum].valid &= ~BIT(field);
+		return;
+	}
+
+	if (!set_cache[chgnum].valid)
+		set_cache[chgnum].expire.val =
+			get_time().val + CHARGER_SET_CACHE_REFRESH_US;
+	set_cache[chgnum].value[field] = value;
+	set_cache[chgnum].valid |= BIT(field);
+}
+#else
+static inline int charger_set_cache_hit(int chgnum,
+					enum charger_set_field field, int value)
+{
+	return 0;
+}
+
+static inline void charger_set_cache_update(int chgnum,
+					    enum charger_set_field field,
+					    int value, int rv)
+{
+}
+#endif /* CONFIG_CHARGER_SKIP_REDUNDANT_WRITES */
+
 void dptf_set_charging_current_limit(int ma)
 {
 	dptf_limit_ma = ma >= 0 ? ma : -1;
@@ -182,6 +257,12 @@ void print_charger_debug(int chgnum)
 		ccprintf("%5d\n", dptf_limit_ma);
 	else
 		ccputs("disabled\n");
+
+#ifdef CONFIG_CHARGER_SKIP_REDUNDANT_WRITES
+	/* register writes skipped because the value was already set */
+	print_item_name("Elided:");
+	ccprintf("%5u\n", elided_writes);
+#endif
 }
 
 static int command_charger(int argc, char **argv)
@@ -245,6 +326,8 @@ static void charger_chips_init(void)
 {
 	int chip;
 
+	charger_invalidate_set_cache();
+
 	for (chip = 0; chip < board_get_charger_chip_count(); chip++) {
 		if (chg_chips[chip].drv->init)
 			chg_chips[chip].drv->init(chip);
@@ -263,6 +346,8 @@ enum ec_error_list charger_post_init(void)
 		return EC_ERROR_INVAL;
 	}
 
+	charger_invalidate_set_cache();
+
 	if (chg_chips[chgnum].drv->post_init)
 		rv = chg_chips[chgnum].drv->post_init(chgnum);
 
@@ -397,9 +482,14 @@ enum ec_error_list charger_set_current(int chgnum, int current)
 		return EC_ERROR_INVAL;
 	}
 
+	if (charger_set_cache_hit(chgnum, CHG_SET_CURRENT, current))
+		return EC_SUCCESS;
+
 	if (chg_chips[chgnum].drv->set_current)
 		rv = chg_chips[chgnum].drv->set_current(chgnum, current);
 
+	charger_set_cache_update(chgnum, CHG_SET_CURRENT, current, rv);
+
 	return rv;
 }
 
@@ -430,9 +520,14 @@ enum ec_error_list charger_set_voltage(int chgnum, int voltage)
 		return EC_ERROR_INVAL;
 	}
 
+	if (charger_set_cache_hit(chgnum, CHG_SET_VOLTAGE, voltage))
+		return EC_SUCCESS;
+
 	if (chg_chips[chgnum].drv->set_voltage)
 		rv = chg_chips[chgnum].drv->set_voltage(chgnum, voltage);
 
+	charger_set_cache_update(chgnum, CHG_SET_VOLTAGE, voltage, rv);
+
 	return rv;
 }
 
@@ -484,10 +579,16 @@ enum ec_error_list charger_set_input_current(int chgnum, int input_current)
 		return EC_ERROR_INVAL;
 	}
 
+	if (charger_set_cache_hit(chgnum, CHG_SET_INPUT_CURRENT, input_current))
+		return EC_SUCCESS;
+
 	if (chg_chips[chgnum].drv->set_input_current)
 		rv = chg_chips[chgnum].drv->set_input_current(chgnum,
 							      input_current);
 
+	charger_set_cache_update(chgnum, CHG_SET_INPUT_CURRENT, input_current,
+				 rv);
+
 	return rv;
 }
 
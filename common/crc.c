@@ -5,6 +5,7 @@
 /* CRC-32 implementation with USB constants */
 
 #include "common.h"
+#include "crc.h"
 
 /* Constants matching USB3 and USB PD definitions */
 #define CRC32_INITIAL 0xFFFFFFFF
@@ -56,12 +57,73 @@ static const uint32_t crc32_tab[] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+#ifdef CONFIG_SW_CRC_SLICE8
+/*
+ * Slicing-by-8 tables: crc32_tab8[k][i] is the CRC of byte i followed by
+ * k + 1 zero bytes. Built from crc32_tab on first use.
+ */
+static uint32_t crc32_tab8[7][256];
+static int crc32_tab8_ready;
+
+static void crc32_tab8_init(void)
+{
+	uint32_t c;
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		c = crc32_tab[i];
+		for (k = 0; k < 7; k++) {
+			c = crc32_tab[c & 0xFF] ^ (c >> 8);
+			crc32_tab8[k][i] = c;
+		}
+	}
+	crc32_tab8_ready = 1;
+}
+
+/* Eight bytes per step from a 4-byte aligned p, little endian CPUs only */
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t *p, int n)
+{
+	const uint32_t *w = (const uint32_t *)p;
+	uint32_t lo, hi;
+
+	if (!crc32_tab8_ready)
+		crc32_tab8_init();
+
+	for (; n; n--) {
+		lo = *w++ ^ crc;
+		hi = *w++;
+		crc = crc32_tab8[6][lo & 0xFF] ^
+		      crc32_tab8[5][(lo >> 8) & 0xFF] ^
+		      crc32_tab8[4][(lo >> 16) & 0xFF] ^
+		      crc32_tab8[3][lo >> 24] ^
+		      crc32_tab8[2][hi & 0xFF] ^
+		      crc32_tab8[1][(hi >> 8) & 0xFF] ^
+		      crc32_tab8[0][(hi >> 16) & 0xFF] ^
+		      crc32_tab[hi >> 24];
+	}
+
+	return crc;
+}
+#endif
+
 static uint32_t crc32_hash(uint32_t crc, const void *buf, int size)
 {
 	const uint8_t *p;
 
 	p = buf;
 
+#ifdef CONFIG_SW_CRC_SLICE8
+	if (size >= 16) {
+		while ((uintptr_t)p & 3) {
+			crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+			size--;
+		}
+		crc = crc32_slice8(crc, p, size / 8);
+		p += size & ~7;
+		size &= 7;
+	}
+#endif
+
 	while (size--) {
 		crc ^= *p++;
 		crc = crc32_tab[crc & 0xFF] ^ (crc >> 8);
@@ -90,11 +152,21 @@ void crc32_ctx_hash8(uint32_t *crc, uint8_t val)
 	*crc = crc32_hash(*crc, &val, sizeof(val));
 }
 
+void crc32_ctx_hash(uint32_t *crc, const void *buf, int len)
+{
+	*crc = crc32_hash(*crc, buf, len);
+}
+
 uint32_t crc32_ctx_result(uint32_t *crc)
 {
 	return *crc ^ 0xFFFFFFFF;
 }
 
+uint32_t crc32_buf(const void *buf, int len)
+{
+	return crc32_hash(CRC32_INITIAL, buf, len) ^ 0xFFFFFFFF;
+}
+
 /* Accumulator for the CRC */
 static uint32_t crc_;
 
@@ -112,6 +112,19 @@ static void set_enabled(int fan, int enable)
 		gpio_set_level(fans[fan].conf->enable_gpio, enable);
 }
 
+void fan_set_duty_needed(int fan, int duty)
+{
+	if (!is_thermal_control_enabled(fan))
+		return;
+
+	if (fan_get_rpm_mode(FAN_CH(fan)))
+		fan_set_rpm_mode(FAN_CH(fan), 0);
+	if (duty && !fan_get_enabled(FAN_CH(fan)))
+		set_enabled(fan, 1);
+
+	fan_set_duty(FAN_CH(fan), duty);
+}
+
 test_export_static void set_thermal_control_enabled(int fan, int enable)
 {
 	thermal_control_enabled[fan] = enable;
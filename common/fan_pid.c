@@ -0,0 +1,228 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * Closed-loop fan controller.
+ *
+ * A PID loop regulates the hottest sensor, normalized to its fan band, to a
+ * setpoint and asks for a fan speed. The speed is turned into a duty cycle
+ * through a duty -> RPM map that is learned from the tachometer whenever the
+ * duty cycle has held long enough for the fan to settle, so the fan gets the
+ * right duty cycle up front instead of hunting for it.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "fan.h"
+#include "fan_pid.h"
+#include "timer.h"
+#include "util.h"
+
+struct fan_pid_tunables fan_pid_tunables = {
+	.setpoint = 500,
+	.kp = 16 << FAN_PID_GAIN_SHIFT,
+	.ki = 1 << FAN_PID_GAIN_SHIFT,
+	.kd = 16 << FAN_PID_GAIN_SHIFT,
+	.duty_min = 10,
+	.learn_settle = 3,
+};
+
+void fan_pid_reset(struct fan_pid *pid, int rpm_max)
+{
+	int i;
+
+	memset(pid, 0, sizeof(*pid));
+	pid->rpm_max = rpm_max;
+	for (i = 0; i < FAN_PID_MAP_SIZE; i++)
+		pid->rpm_map[i] = rpm_max * i / (FAN_PID_MAP_SIZE - 1);
+}
+
+int fan_pid_normalize(int temp, int temp_off, int temp_max)
+{
+	if (temp_max <= temp_off)
+		return 0;
+
+	return (temp - temp_off) * 1000 / (temp_max - temp_off);
+}
+
+int fan_pid_rpm_to_duty(const struct fan_pid *pid, int rpm)
+{
+	int lo, hi, i;
+
+	if (rpm <= 0)
+		return 0;
+
+	for (i = 1; i < FAN_PID_MAP_SIZE; i++)
+		if (rpm <= pid->rpm_map[i])
+			break;
+	if (i == FAN_PID_MAP_SIZE)
+		return 100;
+
+	lo = pid->rpm_map[i - 1];
+	hi = pid->rpm_map[i];
+	if (hi <= lo)
+		return (i - 1) * FAN_PID_MAP_STEP;
+
+	return (i - 1) * FAN_PID_MAP_STEP +
+	       DIV_ROUND_UP((rpm - lo) * FAN_PID_MAP_STEP, hi - lo);
+}
+
+/*
+ * Move the two map points around a settled duty cycle halfway towards the
+ * measured speed, weighted by how close the duty cycle is to each of them,
+ * and keep the map monotonic.
+ */
+static void fan_pid_learn(struct fan_pid *pid, int duty, int rpm)
+{
+	int k = duty / FAN_PID_MAP_STEP;
+	int w = duty % FAN_PID_MAP_STEP;
+	int *map = pid->rpm_map;
+	int err, i;
+
+	if (k >= FAN_PID_MAP_SIZE - 1) {
+		k = FAN_PID_MAP_SIZE - 2;
+		w = FAN_PID_MAP_STEP;
+	}
+
+	err = rpm - (map[k] + (map[k + 1] - map[k]) * w / FAN_PID_MAP_STEP);
+	map[k] += err * (FAN_PID_MAP_STEP - w) / (2 * FAN_PID_MAP_STEP);
+	map[k + 1] += err * w / (2 * FAN_PID_MAP_STEP);
+
+	map[0] = MAX(map[0], 0);
+	for (i = 1; i < FAN_PID_MAP_SIZE; i++)
+		map[i] = MAX(map[i], map[i - 1]);
+}
+
+int fan_pid_update(struct fan_pid *pid, int temp, int rpm_actual, int dt_ms)
+{
+	const struct fan_pid_tunables *t = &fan_pid_tunables;
+	int max = pid->rpm_max << FAN_PID_GAIN_SHIFT;
+	int err = temp - t->setpoint;
+	int p, i, d, out, duty;
+
+	if (dt_ms <= 0)
+		dt_ms = 1000;
+
+	/* Learn from the previous output, once the fan has settled on it */
+	if (pid->duty_held >= t->learn_settle && pid->duty >= t->duty_min &&
+	    rpm_actual > 0)
+		fan_pid_learn(pid, pid->duty, rpm_actual);
+
+	/* Derivative on the measurement, so setpoint changes don't kick */
+	d = 0;
+	if (pid->updated)
+		d = t->kd * ((temp - pid->last_temp) * 1000 / dt_ms);
+	pid->last_temp = temp;
+	pid->updated = 1;
+
+	p = t->kp * err;
+	i = pid->integral + (int)((int64_t)t->ki * err * dt_ms / 1000);
+
+	/* Don't wind up while the output is saturated by the error */
+	out = p + i + d;
+	if (!(out > max && err > 0) && !(out < 0 && err < 0))
+		pid->integral = CLAMP(i, 0, max);
+
+	out = CLAMP(p + pid->integral + d, 0, max);
+	pid->rpm_target = out >> FAN_PID_GAIN_SHIFT;
+
+	duty = fan_pid_rpm_to_duty(pid, pid->rpm_target);
+	if (duty < t->duty_min)
+		duty = duty < t->duty_min / 2 ? 0 : t->duty_min;
+
+	if (duty == pid->duty)
+		pid->duty_held++;
+	else
+		pid->duty_held = 0;
+	pid->duty = duty;
+
+	return duty;
+}
+
+#ifdef CONFIG_FANS
+static struct fan_pid fan_pid_state[CONFIG_FANS];
+static int fan_pid_enabled;
+static timestamp_t fan_pid_last_update[CONFIG_FANS];
+
+int fan_pid_is_enabled(void)
+{
+	return fan_pid_enabled;
+}
+
+void fan_pid_enable(int enable)
+{
+	int fan;
+
+	if (!enable == !fan_pid_enabled)
+		return;
+
+	fan_pid_enabled = enable;
+	for (fan = 0; fan < fan_get_count(); fan++) {
+		if (enable) {
+			fan_pid_reset(&fan_pid_state[fan],
+				      fans[fan].rpm->rpm_max);
+			fan_pid_last_update[fan].val = 0;
+		} else if (is_thermal_control_enabled(fan)) {
+			/* Hand the fan back to RPM control */
+			fan_set_rpm_mode(FAN_CH(fan), 1);
+		}
+	}
+}
+
+const struct fan_pid *fan_pid_get(int fan)
+{
+	return &fan_pid_state[fan];
+}
+
+void fan_pid_set_temp_needed(int fan, int temp)
+{
+	struct fan_pid *pid = &fan_pid_state[fan];
+	timestamp_t now = get_time();
+	int dt_ms = 0;
+
+	if (!is_thermal_control_enabled(fan))
+		return;
+
+	if (fan_pid_last_update[fan].val)
+		dt_ms = (now.val - fan_pid_last_update[fan].val) / MSEC;
+	fan_pid_last_update[fan] = now;
+
+	fan_set_duty_needed(fan, fan_pid_update(pid, temp,
+			    fan_get_rpm_actual(FAN_CH(fan)), dt_ms));
+}
+
+static int cc_fanpid(int argc, char **argv)
+{
+	const struct fan_pid_tunables *t = &fan_pid_tunables;
+	const struct fan_pid *pid;
+	int fan, i;
+
+	if (argc > 1) {
+		if (!parse_bool(argv[1], &i))
+			return EC_ERROR_PARAM1;
+		fan_pid_enable(i);
+	}
+
+	ccprintf("Closed loop %s, setpoint %d kp %d ki %d kd %d (/%d)\n",
+		 fan_pid_enabled ? "on" : "off", t->setpoint, t->kp, t->ki,
+		 t->kd, 1 << FAN_PID_GAIN_SHIFT);
+	if (!fan_pid_enabled)
+		return EC_SUCCESS;
+
+	for (fan = 0; fan < fan_get_count(); fan++) {
+		pid = &fan_pid_state[fan];
+		ccprintf("Fan %d: target %d rpm, duty %d%%\n  map:", fan,
+			 pid->rpm_target, pid->duty);
+		for (i = 0; i < FAN_PID_MAP_SIZE; i++)
+			ccprintf(" %d", pid->rpm_map[i]);
+		ccprintf("\n");
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(fanpid, cc_fanpid,
+			"[on|off]",
+			"Get/set closed-loop fan control");
+#endif /* CONFIG_FANS */
@@ -956,7 +956,39 @@ int flash_set_protect(uint32_t mask, uint32_t flags)
 	return retval;
 }
 
-#ifdef CONFIG_FLASH_DEFERRED_ERASE
+#if defined(CONFIG_FLASH_DEFERRED_ERASE) && defined(CONFIG_SPI_FLASH_ASYNC)
+/*
+ * Start the erase and return, the flash driver polls it from the hook task
+ * so that neither the host command nor the hook task wait on it.
+ */
+static enum ec_status flash_erase_async(int offset, int size)
+{
+	int rv;
+
+#ifndef CONFIG_FLASH_MULTIPLE_REGION
+	if (!flash_range_ok(offset, size, CONFIG_FLASH_ERASE_SIZE))
+		return EC_RES_INVALID_PARAM;
+#endif
+
+	flash_abort_or_invalidate_hash(offset, size);
+
+	rv = flash_physical_erase_async(offset, size);
+	if (rv == EC_ERROR_BUSY)
+		return EC_RES_BUSY;
+
+	return rv ? EC_RES_ERROR : EC_RES_SUCCESS;
+}
+
+static enum ec_status flash_erase_async_result(void)
+{
+	int rv = flash_physical_erase_result();
+
+	if (rv == EC_ERROR_BUSY)
+		return EC_RES_BUSY;
+
+	return rv ? EC_RES_ERROR : EC_RES_SUCCESS;
+}
+#elif defined(CONFIG_FLASH_DEFERRED_ERASE)
 static volatile enum ec_status erase_rc = EC_RES_SUCCESS;
 static struct ec_params_flash_erase_v1 erase_info;
 
@@ -971,6 +1003,73 @@ static void flash_erase_deferred(void)
 DECLARE_DEFERRED(flash_erase_deferred);
 #endif
 
+#ifdef CONFIG_FLASH_POSTED_WRITE
+/* Longest wait for the previous posted write, a few page programs */
+#define FLASH_POSTED_WRITE_TIMEOUT	(100 * MSEC)
+#define FLASH_POSTED_WRITE_POLL_US	100
+
+/* Data of the posted write being programmed */
+static uint8_t posted_data[EC_FLASH_WRITE_POSTED_SIZE] __aligned(4);
+static int posted_pending;
+
+/*
+ * Wait for the posted write in progress, if any, so that flash can be
+ * accessed again, and return its result. The host normally collects that
+ * with the next posted write; any other flash command that comes first
+ * fails with it instead.
+ */
+int flash_posted_write_wait(void)
+{
+	timestamp_t deadline;
+	int rv;
+
+	if (!posted_pending)
+		return EC_SUCCESS;
+
+	deadline.val = get_time().val + FLASH_POSTED_WRITE_TIMEOUT;
+	while ((rv = flash_physical_write_result()) == EC_ERROR_BUSY) {
+		if (timestamp_expired(deadline, NULL))
+			return EC_ERROR_TIMEOUT;
+		usleep(FLASH_POSTED_WRITE_POLL_US);
+	}
+
+	posted_pending = 0;
+	return rv;
+}
+
+static enum ec_status flash_write_posted(int offset, int size,
+					 const uint8_t *data)
+{
+	int rv;
+
+	if (flash_posted_write_wait())
+		return EC_RES_ERROR;
+
+	if (!size)
+		return EC_RES_SUCCESS;
+
+	if (size > sizeof(posted_data))
+		return EC_RES_INVALID_PARAM;
+
+#ifndef CONFIG_FLASH_MULTIPLE_REGION
+	if (!flash_range_ok(offset, size, CONFIG_FLASH_WRITE_SIZE))
+		return EC_RES_INVALID_PARAM;
+#endif
+
+	flash_abort_or_invalidate_hash(offset, size);
+
+	memcpy(posted_data, data, size);
+	rv = flash_physical_write_async(offset, size, (const char *)posted_data);
+	if (rv == EC_ERROR_BUSY)
+		return EC_RES_BUSY;
+	if (rv)
+		return EC_RES_ERROR;
+
+	posted_pending = 1;
+	return EC_RES_SUCCESS;
+}
+#endif
+
 /*****************************************************************************/
 /* Console commands */
 
@@ -1208,19 +1307,6 @@ DECLARE_CONSOLE_COMMAND(flashwp, command_flash_wp,
 /*****************************************************************************/
 /* Host commands */
 
-/*
- * All internal EC code assumes that offsets are provided relative to
- * physical address zero of storage. In some cases, the region of storage
- * belonging to the EC is not physical address zero - a non-zero fmap_base
- * indicates so. Since fmap_base is not yet handled correctly by external
- * code, we must perform the adjustment in our host command handlers -
- * adjust all offsets so they are relative to the beginning of the storage
- * region belonging to the EC. TODO(crbug.com/529365): Handle fmap_base
- * correctly in flashrom, dump_fmap, etc. and remove EC_FLASH_REGION_START.
- */
-#define EC_FLASH_REGION_START MIN(CONFIG_EC_PROTECTED_STORAGE_OFF, \
-				  CONFIG_EC_WRITABLE_STORAGE_OFF)
-
 static enum ec_status flash_command_get_info(struct host_cmd_handler_args *args)
 {
 	const struct ec_params_flash_info_2 *p_2 = args->params;
@@ -1324,6 +1410,9 @@ static enum ec_status flash_command_read(struct host_cmd_handler_args *args)
 	if (p->size > args->response_max)
 		return EC_RES_OVERFLOW;
 
+	if (flash_posted_write_wait())
+		return EC_RES_ERROR;
+
 	if (flash_read(offset, p->size, args->response))
 		return EC_RES_ERROR;
 
@@ -1340,6 +1429,7 @@ DECLARE_HOST_COMMAND(EC_CMD_FLASH_READ,
  *
  * Version 0 and 1 are equivalent from the EC-side; the only difference is
  * that the host can only send 64 bytes of data at a time in version 0.
+ * Version 2 is a posted write, see EC_VER_FLASH_WRITE_POSTED.
  */
 static enum ec_status flash_command_write(struct host_cmd_handler_args *args)
 {
@@ -1357,14 +1447,29 @@ static enum ec_status flash_command_write(struct host_cmd_handler_args *args)
 		return EC_RES_ACCESS_DENIED;
 #endif
 
+#ifdef CONFIG_FLASH_POSTED_WRITE
+	if (args->version == EC_VER_FLASH_WRITE_POSTED)
+		return flash_write_posted(offset, p->size,
+					  (const uint8_t *)(p + 1));
+#endif
+
+	if (flash_posted_write_wait())
+		return EC_RES_ERROR;
+
 	if (flash_write(offset, p->size, (const uint8_t *)(p + 1)))
 		return EC_RES_ERROR;
 
 	return EC_RES_SUCCESS;
 }
+#ifdef CONFIG_FLASH_POSTED_WRITE
+#define FLASH_WRITE_VER_POSTED EC_VER_MASK(EC_VER_FLASH_WRITE_POSTED)
+#else
+#define FLASH_WRITE_VER_POSTED 0
+#endif
 DECLARE_HOST_COMMAND(EC_CMD_FLASH_WRITE,
 		     flash_command_write,
-		     EC_VER_MASK(0) | EC_VER_MASK(EC_VER_FLASH_WRITE));
+		     EC_VER_MASK(0) | EC_VER_MASK(EC_VER_FLASH_WRITE) |
+		     FLASH_WRITE_VER_POSTED);
 
 #ifndef CONFIG_FLASH_MULTIPLE_REGION
 /*
@@ -1401,6 +1506,9 @@ static enum ec_status flash_command_erase(struct host_cmd_handler_args *args)
 		return EC_RES_ACCESS_DENIED;
 #endif
 
+	if (flash_posted_write_wait())
+		return EC_RES_ERROR;
+
 	switch (cmd) {
 	case FLASH_ERASE_SECTOR:
 #if defined(HAS_TASK_HOSTCMD) && defined(CONFIG_HOST_COMMAND_STATUS)
@@ -1411,7 +1519,14 @@ static enum ec_status flash_command_erase(struct host_cmd_handler_args *args)
 			return EC_RES_ERROR;
 
 		break;
-#ifdef CONFIG_FLASH_DEFERRED_ERASE
+#if defined(CONFIG_FLASH_DEFERRED_ERASE) && defined(CONFIG_SPI_FLASH_ASYNC)
+	case FLASH_ERASE_SECTOR_ASYNC:
+		rc = flash_erase_async(offset, p->size);
+		break;
+	case FLASH_ERASE_GET_RESULT:
+		rc = flash_erase_async_result();
+		break;
+#elif defined(CONFIG_FLASH_DEFERRED_ERASE)
 	case FLASH_ERASE_SECTOR_ASYNC:
 		rc = erase_rc;
 		if (rc == EC_RES_SUCCESS) {
@@ -15,6 +15,7 @@
 #include "i8042_protocol.h"
 #include "keyboard_8042_sharedlib.h"
 #include "keyboard_config.h"
+#include "keyboard_latency.h"
 #include "keyboard_protocol.h"
 #include "lightbar.h"
 #include "lpc.h"
@@ -81,9 +82,30 @@ enum {
 struct data_byte {
 	uint8_t chan;
 	uint8_t byte;
+	/* Latency trace of the keystroke this byte ends, or 0 */
+	uint8_t trace;
 };
 
-static struct queue const to_host = QUEUE_NULL(16, struct data_byte);
+static struct queue const to_host =
+	QUEUE_NULL(CONFIG_KEYBOARD_TO_HOST_QUEUE_SIZE, struct data_byte);
+
+/* to_host statistics, shown with the keyboard log */
+static uint32_t to_host_overflows;	/* Scan codes dropped, queue full */
+static uint32_t to_host_stalls;		/* Extra IRQs sent for unread bytes */
+static uint32_t to_host_peak;		/* Most bytes queued at once */
+
+/*
+ * Latency trace of the byte in the output buffer, and of the last one the
+ * host read with when it was sent and read. Touched from the OBE interrupt,
+ * so the task only uses them with interrupts off.
+ */
+struct obf_trace {
+	uint8_t trace;
+	uint32_t sent;
+	uint32_t read;
+};
+static struct obf_trace obf_trace;
+static struct obf_trace read_trace;
 
 /* Queue command/data from the host */
 enum {
@@ -183,6 +205,8 @@ struct kblog_t {
 	 * A = byte actually sent to host via LPC as AUX
 	 *
 	 * x = to_host queue was cleared
+	 * o = to_host queue full, scan code of this many bytes dropped
+	 * S = host left a byte unread, extra IRQ sent; this many bytes queued
 	 *
 	 * The to-host head and tail pointers are logged pre-wrapping to the
 	 * queue size.  This means that they continually increment as units
@@ -197,9 +221,9 @@ static struct kblog_t *kblog_buf;	/* Log buffer; NULL if not logging */
 static int kblog_len;			/* Current log length */
 
 /**
- * Add event to keyboard log.
+ * Add event to keyboard log, from the OBE interrupt or with interrupts off.
  */
-static void kblog_put(char type, uint8_t byte)
+static void kblog_put_locked(char type, uint8_t byte)
 {
 	if (kblog_buf && kblog_len < MAX_KBLOG) {
 		kblog_buf[kblog_len].type = type;
@@ -208,6 +232,20 @@ static void kblog_put(char type, uint8_t byte)
 	}
 }
 
+/**
+ * Add event to keyboard log. The OBE interrupt logs too, so take the log
+ * with interrupts off.
+ */
+static void kblog_put(char type, uint8_t byte)
+{
+	if (!kblog_buf)
+		return;
+
+	interrupt_disable();
+	kblog_put_locked(type, byte);
+	interrupt_enable();
+}
+
 /*****************************************************************************/
 
 void keyboard_host_write(int data, int is_cmd)
@@ -262,9 +300,10 @@ static void aux_enable_irq(int enable)
  * @param len		Number of bytes to send to the host
  * @param to_host	Data to send
  * @param chan		Channel to send data on
+ * @param trace		Latency trace of the keystroke, or 0
  */
-static void i8042_send_to_host(int len, const uint8_t *bytes,
-			       uint8_t chan)
+static void i8042_send_traced(int len, const uint8_t *bytes, uint8_t chan,
+			      int trace)
 {
 	int i;
 	struct data_byte data;
@@ -280,8 +319,16 @@ static void i8042_send_to_host(int len, const uint8_t *bytes,
 		for (i = 0; i < len; i++) {
 			data.chan = chan;
 			data.byte = bytes[i];
+			data.trace = i == len - 1 ? trace : 0;
 			queue_add_unit(&to_host, &data);
 		}
+		to_host_peak = MAX(to_host_peak,
+				   (uint32_t)queue_count(&to_host));
+		keyboard_latency_stamp(trace, KBLAT_QUEUED);
+	} else {
+		kblog_put('o', len);
+		to_host_overflows++;
+		keyboard_latency_drop(trace);
 	}
 	mutex_unlock(&to_host_mutex);
 
@@ -289,6 +336,12 @@ static void i8042_send_to_host(int len, const uint8_t *bytes,
 	task_wake(TASK_ID_KEYPROTO);
 }
 
+static void i8042_send_to_host(int len, const uint8_t *bytes,
+			       uint8_t chan)
+{
+	i8042_send_traced(len, bytes, chan, 0);
+}
+
 /* Change to set 1 if the I8042_XLATE flag is set. */
 static enum scancode_set_list acting_code_set(enum scancode_set_list set)
 {
@@ -349,7 +402,9 @@ static enum ec_error_list matrix_callback(int8_t row, int8_t col,
 					  enum scancode_set_list code_set,
 					  uint8_t *scan_code, int32_t *len)
 {
+#ifndef CONFIG_KEYBOARD_BOARD_SCANCODES
 	uint16_t make_code;
+#endif
 
 	ASSERT(scan_code);
 	ASSERT(len);
@@ -357,6 +412,17 @@ static enum ec_error_list matrix_callback(int8_t row, int8_t col,
 	if (row >= KEYBOARD_ROWS || col >= keyboard_cols)
 		return EC_ERROR_INVAL;
 
+#ifdef CONFIG_KEYBOARD_BOARD_SCANCODES
+	code_set = acting_code_set(code_set);
+	if (!is_supported_code_set(code_set)) {
+		CPRINTS("KB scancode set %d unsupported", code_set);
+		return EC_ERROR_UNIMPLEMENTED;
+	}
+
+	return keyboard_board_scancode(row, col, pressed,
+				       code_set == SCANCODE_SET_1,
+				       scan_code, len);
+#else
 	make_code = get_scancode_set2(row, col);
 
 #ifdef CONFIG_KEYBOARD_SCANCODE_CALLBACK
@@ -381,6 +447,7 @@ static enum ec_error_list matrix_callback(int8_t row, int8_t col,
 
 	scancode_bytes(make_code, pressed, code_set, scan_code, len);
 	return EC_SUCCESS;
+#endif
 }
 
 /**
@@ -406,7 +473,10 @@ void keyboard_clear_buffer(void)
 	CPRINTS("KB Clear Buffer");
 	mutex_lock(&to_host_mutex);
 	kblog_put('x', queue_count(&to_host));
+	/* The OBE interrupt takes bytes off the queue too */
+	interrupt_disable();
 	queue_init(&to_host);
+	interrupt_enable();
 	mutex_unlock(&to_host_mutex);
 	lpc_keyboard_clear_buffer();
 }
@@ -435,6 +505,7 @@ void keyboard_state_changed(int row, int col, int is_pressed)
 	uint8_t scan_code[MAX_SCAN_CODE_LEN];
 	int32_t len = 0;
 	enum ec_error_list ret;
+	int trace = keyboard_latency_start();
 
 #ifdef CONFIG_KEYBOARD_DEBUG
 	char mylabel = get_keycap_label(row, col);
@@ -450,8 +521,13 @@ void keyboard_state_changed(int row, int col, int is_pressed)
 			      &len);
 	if (ret == EC_SUCCESS) {
 		ASSERT(len > 0);
+		keyboard_latency_stamp(trace, KBLAT_SCANCODE);
 		if (keystroke_enabled)
-			i8042_send_to_host(len, scan_code, CHAN_KBD);
+			i8042_send_traced(len, scan_code, CHAN_KBD, trace);
+		else
+			keyboard_latency_drop(trace);
+	} else {
+		keyboard_latency_drop(trace);
 	}
 
 	if (is_pressed) {
@@ -892,10 +968,92 @@ static void i8042_handle_from_host(void)
 	}
 }
 
+/**
+ * Note the traced byte in the output buffer as read by the host. Called with
+ * the output buffer empty, from the OBE interrupt or with interrupts off.
+ */
+static void i8042_obf_read(void)
+{
+	if (!obf_trace.trace)
+		return;
+
+	read_trace = obf_trace;
+	read_trace.read = get_time().le.lo;
+	obf_trace.trace = 0;
+}
+
+/**
+ * Move the next byte from the to_host queue to the output buffer, if the host
+ * has emptied it. Called from the OBE interrupt or with interrupts off.
+ *
+ * @return 1 if a byte was sent, else 0.
+ */
+static int i8042_send_next(void)
+{
+	struct data_byte entry;
+
+	if (lpc_keyboard_has_char() || queue_is_empty(&to_host))
+		return 0;
+
+	i8042_obf_read();
+
+	/* Get a char from buffer. */
+	kblog_put_locked('n', to_host.state->head);
+	queue_remove_unit(&to_host, &entry);
+
+	/* Write to host. */
+	if (entry.chan == CHAN_AUX && IS_ENABLED(CONFIG_8042_AUX)) {
+		kblog_put_locked('A', entry.byte);
+		lpc_aux_put_char(entry.byte, i8042_aux_irq_enabled);
+	} else {
+		kblog_put_locked('K', entry.byte);
+		lpc_keyboard_put_char(entry.byte, i8042_keyboard_irq_enabled);
+	}
+
+	if (entry.trace) {
+		obf_trace.trace = entry.trace;
+		obf_trace.sent = get_time().le.lo;
+	}
+
+	return 1;
+}
+
+void keyboard_host_read_done(void)
+{
+	i8042_obf_read();
+	i8042_send_next();
+
+	/* Only the task can fold the keystroke into the latency statistics */
+	if (IS_ENABLED(CONFIG_KEYBOARD_LATENCY) && read_trace.trace)
+		task_wake(TASK_ID_KEYPROTO);
+}
+
+/**
+ * Stamp the keystroke the host has read, if any.
+ */
+static void i8042_stamp_read(void)
+{
+	struct obf_trace t;
+
+	interrupt_disable();
+	/* Chips that don't call keyboard_host_read_done() */
+	if (!lpc_keyboard_has_char())
+		i8042_obf_read();
+	t = read_trace;
+	read_trace.trace = 0;
+	interrupt_enable();
+
+	if (t.trace) {
+		keyboard_latency_stamp_at(t.trace, KBLAT_SENT, t.sent);
+		keyboard_latency_stamp_at(t.trace, KBLAT_READ, t.read);
+	}
+}
+
 void keyboard_protocol_task(void *u)
 {
 	int wait = -1;
 	int retries = 0;
+	size_t head = to_host.state->head;
 
 	reset_rate_and_delay();
 
@@ -905,10 +1063,12 @@ void keyboard_protocol_task(void *u)
 
 		while (1) {
 			timestamp_t t = get_time();
-			struct data_byte entry;
 #ifdef CONFIG_KEYBOARD_DEBUG
 			cflush();
 #endif
+			if (IS_ENABLED(CONFIG_KEYBOARD_LATENCY))
+				i8042_stamp_read();
+
 			/* Handle typematic */
 			if (!typematic_len) {
 				/* Typematic disabled; wait for enable */
@@ -934,6 +1094,16 @@ void keyboard_protocol_task(void *u)
 			if (queue_is_empty(&to_host))
 				break;
 
+			/*
+			 * The host is keeping up as long as the queue moves,
+			 * whether the OBE interrupt or this task sent the
+			 * bytes.
+			 */
+			if (to_host.state->head != head) {
+				head = to_host.state->head;
+				retries = 0;
+			}
+
 			/* Handle data waiting for host */
 			if (lpc_keyboard_has_char()) {
 				/* If interrupts disabled, nothing we can do */
@@ -953,27 +1123,20 @@ void keyboard_protocol_task(void *u)
 				 * somehow missed the first one.
 				 */
 				CPRINTS("KB extra IRQ");
+				kblog_put('S', queue_count(&to_host));
+				to_host_stalls++;
 				lpc_keyboard_resume_irq();
 				retries = 0;
 				break;
 			}
 
-			/* Get a char from buffer. */
-			kblog_put('n', to_host.state->head);
-			queue_remove_unit(&to_host, &entry);
-
-			/* Write to host. */
-			if (entry.chan == CHAN_AUX &&
-			    IS_ENABLED(CONFIG_8042_AUX)) {
-				kblog_put('A', entry.byte);
-				lpc_aux_put_char(entry.byte,
-						 i8042_aux_irq_enabled);
-			} else {
-				kblog_put('K', entry.byte);
-				lpc_keyboard_put_char(
-					entry.byte, i8042_keyboard_irq_enabled);
-			}
-			retries = 0;
+			/*
+			 * Prime the output buffer; the OBE interrupt sends the
+			 * rest of the queue as the host reads each byte.
+			 */
+			interrupt_disable();
+			i8042_send_next();
+			interrupt_enable();
 		}
 	}
 }
@@ -1165,10 +1328,16 @@ DECLARE_CONSOLE_COMMAND(ctrlram, command_controller_ram,
 
 static int command_keyboard_log(int argc, char **argv)
 {
+	struct kblog_t *buf;
 	int i;
 
 	/* If no args, print log */
 	if (argc == 1) {
+		ccprintf("to_host: %d/%d queued, peak %d, "
+			 "%d overflows, %d stalls\n",
+			 (int)queue_count(&to_host),
+			 CONFIG_KEYBOARD_TO_HOST_QUEUE_SIZE,
+			 to_host_peak, to_host_overflows, to_host_stalls);
 		ccprintf("KBC log (len=%d):\n", kblog_len);
 		for (i = 0; kblog_buf && i < kblog_len; ++i) {
 			ccprintf("%c.%02x ",
@@ -1187,20 +1356,28 @@ static int command_keyboard_log(int argc, char **argv)
 		return EC_ERROR_PARAM1;
 
 	if (i) {
+		to_host_overflows = 0;
+		to_host_stalls = 0;
+		to_host_peak = 0;
 		if (!kblog_buf) {
 			int rv = SHARED_MEM_ACQUIRE_CHECK(
-				sizeof(*kblog_buf) * MAX_KBLOG,
-				(char **)&kblog_buf);
+				sizeof(*kblog_buf) * MAX_KBLOG, (char **)&buf);
 			if (rv != EC_SUCCESS)
-				kblog_buf = NULL;
+				return rv;
+			interrupt_disable();
 			kblog_len = 0;
-			return rv;
+			kblog_buf = buf;
+			interrupt_enable();
 		}
 	} else {
-		kblog_len = 0;
-		if (kblog_buf)
-			shared_mem_release(kblog_buf);
+		/* Stop the OBE interrupt logging before freeing the log */
+		interrupt_disable();
+		buf = kblog_buf;
 		kblog_buf = NULL;
+		kblog_len = 0;
+		interrupt_enable();
+		if (buf)
+			shared_mem_release(buf);
 	}
 
 	return EC_SUCCESS;
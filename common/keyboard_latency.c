@@ -0,0 +1,219 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * Keypress latency tracing.
+ *
+ * Each keystroke gets a trace that follows its scan code through the 8042
+ * path. The trace is stamped at every trace point, and folded into per trace
+ * point statistics once the host has read the scan code.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "keyboard_latency.h"
+#include "task.h"
+#include "timer.h"
+#include "util.h"
+
+/* Keystrokes that can be on their way to the host at once */
+#define KBLAT_TRACES 8
+
+struct kblat_trace {
+	/* Trace id, 0 if the slot is free */
+	uint8_t id;
+	uint32_t edge;
+	uint32_t t[KBLAT_STAGE_COUNT];
+};
+
+static struct kblat_trace traces[KBLAT_TRACES];
+static struct kblat_stats stats[KBLAT_STAGE_COUNT];
+static uint32_t last_us[KBLAT_STAGE_COUNT];
+static uint32_t completed;
+static uint32_t lost;
+static uint8_t next_id;
+static struct mutex kblat_lock;
+
+/* Edge behind the next keystroke, only set from the keyboard scan task */
+static uint32_t pending_edge;
+static int edge_pending;
+
+static struct kblat_trace *kblat_find(int trace)
+{
+	struct kblat_trace *t;
+
+	t = &traces[trace % KBLAT_TRACES];
+	return t->id == trace ? t : NULL;
+}
+
+static void kblat_add(struct kblat_stats *s, uint32_t us)
+{
+	int bucket = us ? 31 - __builtin_clz(us) : 0;
+
+	if (!s->count || us < s->min_us)
+		s->min_us = us;
+	s->max_us = MAX(s->max_us, us);
+	s->total_us += us;
+	s->count++;
+	bucket = MIN(bucket, KBLAT_HIST_BUCKETS - 1);
+	if (s->hist[bucket] < UINT16_MAX)
+		s->hist[bucket]++;
+}
+
+void keyboard_latency_edge(uint32_t time)
+{
+	pending_edge = time;
+	edge_pending = 1;
+}
+
+int keyboard_latency_start(void)
+{
+	uint32_t now = get_time().le.lo;
+	struct kblat_trace *t;
+	int id;
+
+	mutex_lock(&kblat_lock);
+
+	if (++next_id == 0)
+		next_id = 1;
+	id = next_id;
+	t = &traces[id % KBLAT_TRACES];
+	if (t->id)
+		lost++;
+
+	memset(t, 0, sizeof(*t));
+	t->id = id;
+	t->edge = edge_pending ? pending_edge : now;
+	t->t[KBLAT_REPORT] = now;
+	edge_pending = 0;
+
+	mutex_unlock(&kblat_lock);
+
+	return id;
+}
+
+void keyboard_latency_stamp(int trace, enum kblat_stage stage)
+{
+	keyboard_latency_stamp_at(trace, stage, get_time().le.lo);
+}
+
+void keyboard_latency_stamp_at(int trace, enum kblat_stage stage,
+			       uint32_t now)
+{
+	struct kblat_trace *t;
+	int i;
+
+	if (!trace)
+		return;
+
+	mutex_lock(&kblat_lock);
+
+	t = kblat_find(trace);
+	if (!t) {
+		mutex_unlock(&kblat_lock);
+		return;
+	}
+
+	t->t[stage] = now;
+	if (stage == KBLAT_READ) {
+		for (i = 0; i < KBLAT_STAGE_COUNT; i++) {
+			last_us[i] = t->t[i] - t->edge;
+			kblat_add(&stats[i], last_us[i]);
+		}
+		completed++;
+		t->id = 0;
+	}
+
+	mutex_unlock(&kblat_lock);
+}
+
+void keyboard_latency_drop(int trace)
+{
+	struct kblat_trace *t;
+
+	if (!trace)
+		return;
+
+	mutex_lock(&kblat_lock);
+	t = kblat_find(trace);
+	if (t)
+		t->id = 0;
+	mutex_unlock(&kblat_lock);
+}
+
+void keyboard_latency_get(enum kblat_stage stage, struct kblat_stats *s)
+{
+	mutex_lock(&kblat_lock);
+	*s = stats[stage];
+	mutex_unlock(&kblat_lock);
+}
+
+uint32_t keyboard_latency_last(uint32_t us[KBLAT_STAGE_COUNT])
+{
+	uint32_t n;
+
+	mutex_lock(&kblat_lock);
+	memcpy(us, last_us, sizeof(last_us));
+	n = completed;
+	mutex_unlock(&kblat_lock);
+
+	return n;
+}
+
+uint32_t keyboard_latency_lost(void)
+{
+	return lost;
+}
+
+void keyboard_latency_reset(void)
+{
+	mutex_lock(&kblat_lock);
+	memset(stats, 0, sizeof(stats));
+	memset(last_us, 0, sizeof(last_us));
+	completed = 0;
+	lost = 0;
+	mutex_unlock(&kblat_lock);
+}
+
+#ifdef CONFIG_CMD_KEYBOARD
+static const char * const kblat_stage_name[] = {
+	[KBLAT_REPORT] = "report",
+	[KBLAT_SCANCODE] = "scancode",
+	[KBLAT_QUEUED] = "queued",
+	[KBLAT_SENT] = "sent",
+	[KBLAT_READ] = "read",
+};
+BUILD_ASSERT(ARRAY_SIZE(kblat_stage_name) == KBLAT_STAGE_COUNT);
+
+static int command_kblatency(int argc, char **argv)
+{
+	struct kblat_stats s;
+	int i, j;
+
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "reset"))
+			return EC_ERROR_PARAM1;
+		keyboard_latency_reset();
+		return EC_SUCCESS;
+	}
+
+	ccprintf("%d keystrokes, %d lost; us from matrix edge\n",
+		 completed, lost);
+	ccprintf("stage      min   avg   max  histogram (2^n us)\n");
+	for (i = 0; i < KBLAT_STAGE_COUNT; i++) {
+		keyboard_latency_get(i, &s);
+		ccprintf("%-8s %5d %5d %5d ", kblat_stage_name[i], s.min_us,
+			 s.count ? (int)(s.total_us / s.count) : 0, s.max_us);
+		for (j = 0; j < KBLAT_HIST_BUCKETS; j++)
+			ccprintf(" %d", s.hist[j]);
+		ccprintf("\n");
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(kblatency, command_kblatency,
+			"[reset]",
+			"Show or clear keypress latency statistics");
+#endif
@@ -13,6 +13,7 @@
 #include "hooks.h"
 #include "host_command.h"
 #include "keyboard_config.h"
+#include "keyboard_latency.h"
 #include "keyboard_protocol.h"
 #include "keyboard_raw.h"
 #include "keyboard_scan.h"
@@ -97,12 +98,27 @@ static uint32_t boot_key_value = BOOT_KEY_NONE;
 
 uint8_t keyboard_cols = KEYBOARD_COLS_MAX;
 
+/*
+ * Key matrix, one byte of rows per column, padded to whole 64-bit words so
+ * that masking, change detection and ghost checks work on eight columns at a
+ * time. Columns past keyboard_cols are always zero.
+ */
+#define KB_MATRIX_WORDS DIV_ROUND_UP(KEYBOARD_COLS_MAX, 8)
+
+union kb_matrix {
+	uint8_t col[KB_MATRIX_WORDS * 8];
+	uint64_t w[KB_MATRIX_WORDS];
+};
+
+BUILD_ASSERT(KEYBOARD_ROWS <= 8);
+BUILD_ASSERT(KEYBOARD_COLS_MAX <= 32);
+
 /* Debounced key matrix */
-static uint8_t __bss_slow debounced_state[KEYBOARD_COLS_MAX];
+static union kb_matrix __bss_slow debounced_state;
 /* Mask of keys being debounced */
-static uint8_t __bss_slow debouncing[KEYBOARD_COLS_MAX];
+static union kb_matrix __bss_slow debouncing;
 /* Keys simulated-pressed */
-static uint8_t __bss_slow simulated_key[KEYBOARD_COLS_MAX];
+static union kb_matrix __bss_slow simulated_key;
 #ifdef CONFIG_KEYBOARD_LANGUAGE_ID
 static uint8_t __bss_slow keyboard_id[KEYBOARD_IDS];
 #endif
@@ -112,8 +128,39 @@ static uint32_t __bss_slow scan_time[SCAN_TIME_COUNT];
 /* Current scan_time[] index */
 static int __bss_slow scan_time_index;
 
-/* Index into scan_time[] when each key started debouncing */
-static uint8_t __bss_slow scan_edge_index[KEYBOARD_COLS_MAX][KEYBOARD_ROWS];
+/*
+ * Keys in flux: each edge that is reported starts a debounce window for that
+ * key alone, sized by the direction of the edge. Only these keys are looked
+ * at again until their window closes; every other key is handled by the
+ * word-wide compare of the matrix.
+ */
+#define KB_FLUX_MAX 16
+
+struct kb_flux {
+	/* Time the edge was seen */
+	uint32_t time;
+	uint8_t col;
+	uint8_t row;
+	uint8_t pressed;
+};
+
+static struct kb_flux __bss_slow kb_flux[KB_FLUX_MAX];
+static int __bss_slow kb_flux_count;
+
+/*
+ * Debounced edges, in the order they are reported. The board's hook and the
+ * keyboard protocol each read them at their own position; every scan
+ * queues at most KB_FLUX_MAX edges and both readers catch up on it.
+ */
+#define KB_EVENTS_MAX 32
+BUILD_ASSERT(KB_EVENTS_MAX >= KB_FLUX_MAX);
+BUILD_ASSERT(POWER_OF_TWO(KB_EVENTS_MAX));
+
+static struct keyboard_scan_event __bss_slow kb_events[KB_EVENTS_MAX];
+/* Position of the next edge to be queued */
+static uint32_t __bss_slow kb_events_head;
+/* Position of the next edge to report to the keyboard protocol */
+static uint32_t __bss_slow kb_events_reported;
 
 /* Minimum delay between keyboard scans based on current clock frequency */
 static uint32_t __bss_slow post_scan_clock_us;
@@ -209,15 +256,15 @@ static void simulate_key(int row, int col, int pressed)
 {
 	int old_polls;
 
-	if ((simulated_key[col] & BIT(row)) == ((pressed ? 1 : 0) << row))
+	if ((simulated_key.col[col] & BIT(row)) == ((pressed ? 1 : 0) << row))
 		return;  /* No change */
 
-	simulated_key[col] ^= BIT(row);
+	simulated_key.col[col] ^= BIT(row);
 
 	/* Keep track of polls now that we've got keys simulated */
 	old_polls = kbd_polls;
 
-	print_state(simulated_key, "simulated ");
+	print_state(simulated_key.col, "simulated ");
 
 	/* Force a poll even though no keys are pressed */
 	force_poll = 1;
@@ -235,21 +282,77 @@ static void simulate_key(int row, int col, int pressed)
 	ensure_keyboard_scanned(kbd_polls);
 }
 
+/*
+ * Transpose eight columns of a matrix word into one byte of columns per row,
+ * or back: bit 8 * i + j swaps with bit 8 * j + i.
+ */
+static uint64_t kb_transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x ^= t ^ (t << 28);
+
+	return x;
+}
+
+/**
+ * Convert a matrix to one bitmask of columns per row.
+ *
+ * @param m		Matrix
+ * @param rows		Destination, KEYBOARD_ROWS long
+ */
+static void kb_matrix_to_rows(const union kb_matrix *m, uint32_t *rows)
+{
+	uint64_t x;
+	int i, r;
+
+	memset(rows, 0, KEYBOARD_ROWS * sizeof(*rows));
+	for (i = 0; i < KB_MATRIX_WORDS; i++) {
+		if (!m->w[i])
+			continue;
+		x = kb_transpose8(m->w[i]);
+		for (r = 0; r < KEYBOARD_ROWS; r++)
+			rows[r] |= (uint32_t)((x >> (8 * r)) & 0xff) << (8 * i);
+	}
+}
+
+static void kb_rows_to_matrix(const uint32_t *rows, union kb_matrix *m)
+{
+	uint64_t x;
+	int i, r;
+
+	for (i = 0; i < KB_MATRIX_WORDS; i++) {
+		x = 0;
+		for (r = 0; r < KEYBOARD_ROWS; r++)
+			x |= (uint64_t)((rows[r] >> (8 * i)) & 0xff) << (8 * r);
+		m->w[i] = kb_transpose8(x);
+	}
+}
+
 /**
  * Read the raw keyboard matrix state.
  *
  * Used in pre-init, so must not make task-switching-dependent calls; udelay()
  * is ok because it's a spin-loop.
  *
- * @param state		Destination for new state (must be KEYBOARD_COLS_MAX
- *			long).
+ * @param state		Destination for new state.
  *
  * @return 1 if at least one key is pressed, else zero.
  */
-static int read_matrix(uint8_t *state)
+static int read_matrix(union kb_matrix *state)
 {
-	int c;
-	int pressed = 0;
+	union kb_matrix mask = { .col = { 0 } };
+	uint32_t rows[KEYBOARD_ROWS];
+	uint32_t group, merged;
+	uint64_t pressed = 0;
+	int c, r, r2;
+
+	memset(state, 0, sizeof(*state));
 
 	/* 1. Read input pins */
 	for (c = 0; c < keyboard_cols; c++) {
@@ -261,7 +364,7 @@ static int read_matrix(uint8_t *state)
 		 * Note, scanning is enabled on boot by default.
 		 */
 		if (!keyboard_scan_is_enabled()) {
-			state[c] = 0;
+			state->col[c] = 0;
 			continue;
 		}
 
@@ -270,52 +373,56 @@ static int read_matrix(uint8_t *state)
 		udelay(keyscan_config.output_settle_us);
 
 		/* Read the row state */
-		state[c] = keyboard_raw_read_rows();
+		state->col[c] = keyboard_raw_read_rows();
 
 		/* Use simulated keyscan sequence instead if testing active */
 		if (IS_ENABLED(CONFIG_KEYBOARD_TEST))
-			state[c] = keyscan_seq_get_scan(c, state[c]);
+			state->col[c] = keyscan_seq_get_scan(c, state->col[c]);
 	}
 
-	/* 2. Detect transitional ghost */
-	for (c = 0; c < keyboard_cols; c++) {
-		int c2;
-
-		for (c2 = 0; c2 < c; c2++) {
-			/*
-			 * If two columns shares at least one key but their
-			 * states are different, maybe the state changed between
-			 * two "keyboard_raw_read_rows"s. If this happened,
-			 * update both columns to the union of them.
-			 *
-			 * Note that in theory we need to rescan from col 0 if
-			 * anything is updated, to make sure the newly added
-			 * bits does not introduce more inconsistency.
-			 * Let's ignore this rare case for now.
-			 */
-			if ((state[c] & state[c2]) && (state[c] != state[c2])) {
-				uint8_t merged = state[c] | state[c2];
-
-				state[c] = state[c2] = merged;
+	/*
+	 * 2. Detect transitional ghost
+	 *
+	 * If two columns share at least one key but their states are
+	 * different, maybe the state changed between two
+	 * "keyboard_raw_read_rows"s. If this happened, update both columns to
+	 * the union of them. In terms of rows: every column in a row with
+	 * more than one key gets each row any of them has. Repeat until
+	 * nothing changes, since newly added keys can join more columns.
+	 */
+	kb_matrix_to_rows(state, rows);
+	for (merged = 0, r = 0; r < KEYBOARD_ROWS; r++) {
+		group = rows[r];
+		if (!(group & (group - 1)))
+			continue;
+		for (r2 = 0; r2 < KEYBOARD_ROWS; r2++) {
+			if ((rows[r2] & group) && (rows[r2] & group) != group) {
+				rows[r2] |= group;
+				merged = 1;
+				/* A row before r may have just grown */
+				if (r2 < r)
+					r = -1;
 			}
 		}
 	}
+	if (merged)
+		kb_rows_to_matrix(rows, state);
 
 	/* 3. Fix result */
-	for (c = 0; c < keyboard_cols; c++) {
+	memcpy(mask.col, keyscan_config.actual_key_mask, keyboard_cols);
+	for (c = 0; c < KB_MATRIX_WORDS; c++) {
 		/* Add in simulated keypresses */
-		state[c] |= simulated_key[c];
+		state->w[c] |= simulated_key.w[c];
 
 		/*
 		 * Keep track of what keys appear to be pressed.  Even if they
 		 * don't exist in the matrix, they'll keep triggering
 		 * interrupts, so we can't leave scanning mode.
 		 */
-		pressed |= state[c];
+		pressed |= state->w[c];
 
 		/* Mask off keys that don't exist on the actual keyboard */
-		state[c] &= keyscan_config.actual_key_mask[c];
-
+		state->w[c] &= mask.w[c];
 	}
 
 	keyboard_raw_drive_column(KEYBOARD_COLUMN_NONE);
@@ -474,24 +581,26 @@ static int check_runtime_keys(const uint8_t *state)
  *
  * @return 1 if ghosting detected, else 0.
  */
-static int has_ghosting(const uint8_t *state)
+static int has_ghosting(const union kb_matrix *state)
 {
-	int c, c2;
+	uint32_t rows[KEYBOARD_ROWS];
+	uint32_t common;
+	int r, r2;
 
-	for (c = 0; c < keyboard_cols; c++) {
-		if (!state[c])
+	/*
+	 * Ghosting happens if 2 columns share at least 2 keys, which is the
+	 * same as 2 rows sharing at least 2 keys. There are fewer rows than
+	 * columns, and a row is a single word, so check the rows: AND them
+	 * together and see if more than one bit is set. x&(x-1) is non-zero
+	 * only if x has more than one bit set.
+	 */
+	kb_matrix_to_rows(state, rows);
+	for (r = 0; r < KEYBOARD_ROWS; r++) {
+		if (!(rows[r] & (rows[r] - 1)))
 			continue;
 
-		for (c2 = c + 1; c2 < keyboard_cols; c2++) {
-			/*
-			 * A little bit of cleverness here.  Ghosting happens
-			 * if 2 columns share at least 2 keys.  So we OR the
-			 * columns together and then see if more than one bit
-			 * is set.  x&(x-1) is non-zero only if x has more than
-			 * one bit set.
-			 */
-			uint8_t common = state[c] & state[c2];
-
+		for (r2 = r + 1; r2 < KEYBOARD_ROWS; r2++) {
+			common = rows[r] & rows[r2];
 			if (common & (common - 1))
 				return 1;
 		}
@@ -500,6 +609,41 @@ static int has_ghosting(const uint8_t *state)
 	return 0;
 }
 
+uint32_t keyboard_scan_event_head(void)
+{
+	return kb_events_head;
+}
+
+int keyboard_scan_get_event(uint32_t *pos, struct keyboard_scan_event *ev)
+{
+	if (*pos == kb_events_head)
+		return 0;
+
+	/* Skip what has been overwritten */
+	if (kb_events_head - *pos > KB_EVENTS_MAX)
+		*pos = kb_events_head - KB_EVENTS_MAX;
+
+	*ev = kb_events[*pos & (KB_EVENTS_MAX - 1)];
+	(*pos)++;
+	return 1;
+}
+
+__overridable void keyboard_board_scan_events(void)
+{
+}
+
+static void queue_event(const struct kb_flux *f)
+{
+	struct keyboard_scan_event *ev =
+		&kb_events[kb_events_head & (KB_EVENTS_MAX - 1)];
+
+	ev->time = f->time;
+	ev->col = f->col;
+	ev->row = f->row;
+	ev->pressed = f->pressed;
+	kb_events_head++;
+}
+
 /**
  * Update keyboard state using low-level interface to read keyboard.
  *
@@ -507,12 +651,15 @@ static int has_ghosting(const uint8_t *state)
  *
  * @return 1 if any key is still pressed, 0 if no key is pressed.
  */
-static int check_keys_changed(uint8_t *state)
+static int check_keys_changed(union kb_matrix *state)
 {
 	int any_pressed = 0;
-	int c, i;
+	int i, w, bit;
 	int any_change = 0;
-	static uint8_t __bss_slow new_state[KEYBOARD_COLS_MAX];
+	static union kb_matrix __bss_slow new_state;
+	struct keyboard_scan_event ev;
+	struct kb_flux *f;
+	uint64_t diff;
 	uint32_t tnow = get_time().le.lo;
 
 	/* Save the current scan time */
@@ -521,55 +668,71 @@ static int check_keys_changed(uint8_t *state)
 	scan_time[scan_time_index] = tnow;
 
 	/* Read the raw key state */
-	any_pressed = read_matrix(new_state);
+	any_pressed = read_matrix(&new_state);
+
+	/* Close the debounce windows that have run out */
+	for (i = 0; i < kb_flux_count; ) {
+		f = &kb_flux[i];
+		if (tnow - f->time < (f->pressed ?
+				      keyscan_config.debounce_down_us :
+				      keyscan_config.debounce_up_us)) {
+			i++;
+			continue;
+		}
+		debouncing.col[f->col] &= ~BIT(f->row);
+		*f = kb_flux[--kb_flux_count];
+	}
 
 	/* Ignore if so many keys are pressed that we're ghosting. */
-	if (has_ghosting(new_state))
-		return any_pressed;
+	if (has_ghosting(&new_state))
+		goto done;
 
-	/* Check for changes between previous scan and this one */
-	for (c = 0; c < keyboard_cols; c++) {
-		int diff;
+	/*
+	 * Check for changes between previous scan and this one, unless
+	 * debounce is in effect for the key.
+	 */
+	for (w = 0; w < KB_MATRIX_WORDS; w++) {
+		diff = (new_state.w[w] ^ state->w[w]) & ~debouncing.w[w];
 
-		/* Clear debouncing flag, if sufficient time has elapsed. */
-		for (i = 0; i < KEYBOARD_ROWS && debouncing[c]; i++) {
-			if (!(debouncing[c] & BIT(i)))
-				continue;
-			if (tnow - scan_time[scan_edge_index[c][i]] <
-			    (state[c] ? keyscan_config.debounce_down_us :
-					keyscan_config.debounce_up_us))
-				continue;  /* Not done debouncing */
-			debouncing[c] &= ~BIT(i);
-		}
+		while (diff) {
+			bit = __builtin_ctzll(diff);
+			diff &= diff - 1;
 
-		/* Recognize change in state, unless debounce in effect. */
-		diff = (new_state[c] ^ state[c]) & ~debouncing[c];
-		if (!diff)
-			continue;
-		for (i = 0; i < KEYBOARD_ROWS; i++) {
-			if (!(diff & BIT(i)))
-				continue;
-			scan_edge_index[c][i] = scan_time_index;
-			any_change = 1;
+			/* Leave the edge for a later scan if too much is in flux */
+			if (kb_flux_count == KB_FLUX_MAX)
+				break;
 
-			/* Inform keyboard module if scanning is enabled */
-			if (keyboard_scan_is_enabled()) {
-				/* This is no-op for protocols that require a
-				 * full keyboard matrix (e.g., MKBP).
-				 */
-				keyboard_state_changed(
-					i, c, !!(new_state[c] & BIT(i)));
-			}
+			f = &kb_flux[kb_flux_count++];
+			f->time = tnow;
+			f->col = w * 8 + bit / 8;
+			f->row = bit % 8;
+			f->pressed = !!(new_state.col[f->col] & BIT(f->row));
+			debouncing.col[f->col] |= BIT(f->row);
+
+			/*
+			 * Note: In order to "remember" what was last reported
+			 * (up or down), the state bits are only updated if
+			 * the edge was not suppressed due to debouncing.
+			 */
+			state->col[f->col] ^= BIT(f->row);
+			queue_event(f);
+			any_change = 1;
 		}
+	}
 
-		/* For any keyboard events just sent, turn on debouncing. */
-		debouncing[c] |= diff;
+	if (any_change)
+		keyboard_board_scan_events();
+
+	/* Inform keyboard module if scanning is enabled */
+	while (keyboard_scan_get_event(&kb_events_reported, &ev)) {
+		if (!keyboard_scan_is_enabled())
+			continue;
 		/*
-		 * Note: In order to "remember" what was last reported
-		 * (up or down), the state bits are only updated if the
-		 * edge was not suppressed due to debouncing.
+		 * This is no-op for protocols that require a full keyboard
+		 * matrix (e.g., MKBP).
 		 */
-		state[c] ^= diff;
+		keyboard_latency_edge(ev.time);
+		keyboard_state_changed(ev.row, ev.col, ev.pressed);
 	}
 
 	if (any_change) {
@@ -580,7 +743,7 @@ static int check_keys_changed(uint8_t *state)
 #endif
 
 		if (print_state_changes)
-			print_state(state, "state");
+			print_state(state->col, "state");
 
 #ifdef CONFIG_KEYBOARD_PRINT_SCAN_TIMES
 		/* Print delta times from now back to each previous scan */
@@ -596,17 +759,20 @@ static int check_keys_changed(uint8_t *state)
 
 #ifdef CONFIG_KEYBOARD_RUNTIME_KEYS
 		/* Swallow special keys */
-		if (check_runtime_keys(state))
-			return 0;
+		if (check_runtime_keys(state->col)) {
+			any_pressed = 0;
+			goto done;
+		}
 #endif
 
 #ifdef CONFIG_KEYBOARD_PROTOCOL_MKBP
-		keyboard_fifo_add(state);
+		keyboard_fifo_add(state->col);
 #endif
 	}
 
 	kbd_polls++;
 
+done:
 	return any_pressed;
 }
 
@@ -713,7 +879,7 @@ uint32_t keyboard_scan_get_boot_keys(void)
 
 const uint8_t *keyboard_scan_get_state(void)
 {
-	return debounced_state;
+	return debounced_state.col;
 }
 
 void keyboard_scan_init(void)
@@ -725,7 +891,7 @@ void keyboard_scan_init(void)
 	keyboard_raw_drive_column(KEYBOARD_COLUMN_NONE);
 
 	/* Initialize raw state */
-	read_matrix(debounced_state);
+	read_matrix(&debounced_state);
 
 #ifdef CONFIG_KEYBOARD_LANGUAGE_ID
 	/* Check keyboard ID state */
@@ -734,7 +900,7 @@ void keyboard_scan_init(void)
 
 #ifdef CONFIG_KEYBOARD_BOOT_KEYS
 	/* Check for keys held down at boot */
-	boot_key_value = check_boot_key(debounced_state);
+	boot_key_value = check_boot_key(debounced_state.col);
 
 	/*
 	 * If any key other than Esc or Left_Shift was pressed, do not trigger
@@ -770,7 +936,7 @@ void keyboard_scan_task(void *u)
 	int wait_time;
 	uint32_t local_disable_scanning = 0;
 
-	print_state(debounced_state, "init state");
+	print_state(debounced_state.col, "init state");
 
 	keyboard_raw_task_start();
 
@@ -840,7 +1006,7 @@ void keyboard_scan_task(void *u)
 			start = get_time();
 
 			/* Check for keys down */
-			if (check_keys_changed(debounced_state)) {
+			if (check_keys_changed(&debounced_state)) {
 				poll_deadline.val = start.val
 					+ keyscan_config.poll_timeout_us;
 			} else if (timestamp_expired(poll_deadline, &start)) {
@@ -1037,8 +1203,8 @@ static int command_ksstate(int argc, char **argv)
 		}
 	}
 
-	print_state(debounced_state, "debounced ");
-	print_state(debouncing, "debouncing");
+	print_state(debounced_state.col, "debounced ");
+	print_state(debouncing.col, "debouncing");
 
 	ccprintf("Keyboard scan disable mask: 0x%08x\n",
 		 disable_scanning_mask);
@@ -1057,10 +1223,10 @@ static int command_keyboard_press(int argc, char **argv)
 
 		ccputs("Simulated keys:\n");
 		for (i = 0; i < keyboard_cols; ++i) {
-			if (simulated_key[i] == 0)
+			if (simulated_key.col[i] == 0)
 				continue;
 			for (j = 0; j < KEYBOARD_ROWS; ++j)
-				if (simulated_key[i] & BIT(j))
+				if (simulated_key.col[i] & BIT(j))
 					ccprintf("\t%d %d\n", i, j);
 		}
 
@@ -42,6 +42,24 @@ static int ge_mod(const struct rsa_public_key *key, const uint32_t *a)
 	return 1;  /* equal */
 }
 
+/**
+ * hi:lo = a * b + hi + lo
+ *
+ * The result always fits in 64 bits. Cores with the DSP extension
+ * (Cortex-M4/M7) do this in a single UMAAL.
+ */
+#ifdef __ARM_FEATURE_DSP
+#define UMAAL(lo, hi, a, b) \
+	__asm__("umaal %0, %1, %2, %3" \
+		: "+r"(lo), "+r"(hi) : "r"(a), "r"(b))
+#else
+#define UMAAL(lo, hi, a, b) do { \
+		uint64_t _t = mulaa32((a), (b), (lo), (hi)); \
+		(lo) = (uint32_t)_t; \
+		(hi) = (uint32_t)(_t >> 32); \
+	} while (0)
+#endif
+
 /**
  * Montgomery c[] += a * b[] / R % mod
  */
@@ -50,60 +68,31 @@ static void mont_mul_add(const struct rsa_public_key *key,
 			 const uint32_t a,
 			 const uint32_t *b)
 {
-	uint64_t A = mula32(a, b[0], c[0]);
-	uint32_t d0 = (uint32_t)A * key->n0inv;
-	uint64_t B = mula32(d0, key->n[0], A);
+	const uint32_t *n = key->n;
+	uint32_t a_lo = c[0], a_hi = 0;
+	uint32_t b_lo, b_hi = 0;
+	uint32_t d0;
 	uint32_t i;
 
-	for (i = 1; i < RSANUMWORDS; ++i) {
-		A = mulaa32(a, b[i], c[i], A >> 32);
-		B = mulaa32(d0, key->n[i], A, B >> 32);
-		c[i - 1] = (uint32_t)B;
-	}
-
-	A = (A >> 32) + (B >> 32);
-
-	c[i - 1] = (uint32_t)A;
-
-	if (A >> 32)
-		sub_mod(key, c);
-}
-
-#ifdef CONFIG_RSA_EXPONENT_3
-/**
- * Montgomery c[] += 0 * b[] / R % mod
- */
-static void mont_mul_add_0(const struct rsa_public_key *key,
-			 uint32_t *c,
-			 const uint32_t *b)
-{
-	uint32_t d0 = c[0] * key->n0inv;
-	uint64_t B = mula32(d0, key->n[0], c[0]);
-	uint32_t i;
+	UMAAL(a_lo, a_hi, a, b[0]);
+	d0 = a_lo * key->n0inv;
+	b_lo = a_lo;
+	UMAAL(b_lo, b_hi, d0, n[0]);
 
+	/* Carries stay in a_hi and b_hi, two UMAALs per word */
 	for (i = 1; i < RSANUMWORDS; ++i) {
-		B = mulaa32(d0, key->n[i], c[i], B >> 32);
-		c[i - 1] = (uint32_t)B;
+		a_lo = c[i];
+		UMAAL(a_lo, a_hi, a, b[i]);
+		b_lo = a_lo;
+		UMAAL(b_lo, b_hi, d0, n[i]);
+		c[i - 1] = b_lo;
 	}
 
-	c[i - 1] = B >> 32;
-}
+	c[i - 1] = a_hi + b_hi;
 
-/* Montgomery c[] = a[] * 1 / R % key. */
-static void mont_mul_1(const struct rsa_public_key *key,
-		       uint32_t *c,
-		       const uint32_t *a)
-{
-	int i;
-
-	for (i = 0; i < RSANUMWORDS; ++i)
-		c[i] = 0;
-
-	mont_mul_add(key, c, 1, a);
-	for (i = 1; i < RSANUMWORDS; ++i)
-		mont_mul_add_0(key, c, a);
+	if (c[i - 1] < a_hi)
+		sub_mod(key, c);
 }
-#endif
 
 /**
  * Montgomery c[] = a[] * b[] / R % mod
@@ -136,7 +125,7 @@ static void mod_pow(const struct rsa_public_key *key, uint8_t *inout,
 	uint32_t *a = workbuf32;
 	uint32_t *a_r = a + RSANUMWORDS;
 	uint32_t *aa_r = a_r + RSANUMWORDS;
-	uint32_t *aaa = aa_r;  /* Re-use location. */
+	uint32_t *aaa;
 	int i;
 
 	/* Convert from big endian byte array to little endian word array. */
@@ -152,15 +141,20 @@ static void mod_pow(const struct rsa_public_key *key, uint8_t *inout,
 	/* TODO(drinkcat): This operation could be precomputed to save time. */
 	mont_mul(key, a_r, a, key->rr);  /* a_r = a * RR / R mod M */
 #ifdef CONFIG_RSA_EXPONENT_3
-	mont_mul(key, aa_r, a_r, a_r);
-	mont_mul(key, a, aa_r, a_r);
-	mont_mul_1(key, aaa, a);
+	/*
+	 * Exponent 3: a * a_r / R is a^2 out of the Montgomery domain, so one
+	 * more multiplication by a_r gives a^3 without converting back.
+	 */
+	mont_mul(key, aa_r, a_r, a);   /* aa_r = a_r * a / R mod M */
+	mont_mul(key, a, aa_r, a_r);   /* a = aa_r * a_r / R mod M */
+	aaa = a;
 #else
 	/* Exponent 65537 */
 	for (i = 0; i < 16; i += 2) {
 		mont_mul(key, aa_r, a_r, a_r); /* aa_r = a_r * a_r / R mod M */
 		mont_mul(key, a_r, aa_r, aa_r);/* a_r = aa_r * aa_r / R mod M */
 	}
+	aaa = aa_r;
 	mont_mul(key, aaa, a_r, a);  /* aaa = a_r * a / R mod M */
 #endif
 
@@ -8,11 +8,13 @@
 
 #include "common.h"
 #include "console.h"
+#include "hooks.h"
 #include "host_command.h"
 #include "shared_mem.h"
 #include "spi.h"
 #include "spi_flash.h"
 #include "spi_flash_reg.h"
+#include "task.h"
 #include "timer.h"
 #include "util.h"
 #include "watchdog.h"
@@ -29,9 +31,97 @@
  */
 #define SPI_FLASH_TIMEOUT_USEC	(800*MSEC)
 
+/* Read transactions chained per submission, see spi_transaction_chain() */
+#define SPI_FLASH_READ_CHAIN	8
+
 /* Internal buffer used by SPI flash driver */
 static uint8_t buf[SPI_FLASH_MAX_MESSAGE_SIZE];
 
+#ifdef CONFIG_SPI_FLASH_ASYNC
+/*
+ * Status polling interval while an erase or program started by
+ * spi_flash_erase_async() or spi_flash_write_async() runs
+ */
+#define SPI_FLASH_ASYNC_POLL_USEC	(2 * MSEC)
+
+/* Erase or program run by spi_flash_async_step() */
+static struct {
+	unsigned int offset;
+	unsigned int bytes;
+	/* Data to program, NULL to erase */
+	const uint8_t *data;
+	/* Deadline for the unit in progress */
+	timestamp_t deadline;
+	/* EC_ERROR_BUSY while running, then the result */
+	int rv;
+} async_op = { .rv = EC_SUCCESS };
+
+/* The flash is busy with an asynchronous operation */
+#define SPI_FLASH_ASYNC_BUSY() (async_op.rv == EC_ERROR_BUSY)
+
+/*
+ * Synchronous reads, erases and writes in progress. No asynchronous
+ * operation starts while there are any.
+ */
+static int sync_ops;
+
+/**
+ * Wait for the erase or program started by spi_flash_erase_async() or
+ * spi_flash_write_async(), then claim the flash for a synchronous call until
+ * spi_flash_sync_end().
+ *
+ * The operation is run by the hook task, which cannot wait for itself:
+ * there, and in interrupt context, this fails with EC_ERROR_BUSY instead.
+ *
+ * @return EC_SUCCESS once the flash is claimed, EC_ERROR_BUSY as above, or
+ * EC_ERROR_TIMEOUT if the operation made no progress for
+ * SPI_FLASH_TIMEOUT_USEC.
+ */
+static int spi_flash_sync_begin(void)
+{
+	timestamp_t deadline;
+	unsigned int bytes;
+
+	while (1) {
+		interrupt_disable();
+		if (!SPI_FLASH_ASYNC_BUSY()) {
+			sync_ops++;
+			interrupt_enable();
+			return EC_SUCCESS;
+		}
+		interrupt_enable();
+
+		if (in_interrupt_context() || task_get_current() == TASK_ID_HOOKS)
+			return EC_ERROR_BUSY;
+
+		bytes = async_op.bytes;
+		deadline.val = get_time().val + SPI_FLASH_TIMEOUT_USEC;
+		while (SPI_FLASH_ASYNC_BUSY() && async_op.bytes == bytes) {
+			if (timestamp_expired(deadline, NULL))
+				return EC_ERROR_TIMEOUT;
+			usleep(SPI_FLASH_ASYNC_POLL_USEC);
+		}
+	}
+}
+
+/* Release the flash claimed by spi_flash_sync_begin() */
+static void spi_flash_sync_end(void)
+{
+	interrupt_disable();
+	sync_ops--;
+	interrupt_enable();
+}
+#else
+static inline int spi_flash_sync_begin(void)
+{
+	return EC_SUCCESS;
+}
+
+static inline void spi_flash_sync_end(void)
+{
+}
+#endif
+
 /**
  * Waits for chip to finish current operation. Must be called after
  * erase/write operations to ensure successive commands are executed.
@@ -149,12 +239,52 @@ int spi_flash_set_status(int reg1, int reg2)
  *
  * @return EC_SUCCESS, or non-zero if any error.
  */
+#ifdef CONFIG_SPI_CHAIN
+int spi_flash_read(uint8_t *buf_usr, unsigned int offset, unsigned int bytes)
+{
+	struct spi_xfer xfer[SPI_FLASH_READ_CHAIN];
+	uint8_t cmd[SPI_FLASH_READ_CHAIN][4];
+	int i, n, read_size, spi_addr;
+	int ret = EC_SUCCESS;
+
+	if (offset + bytes > CONFIG_FLASH_SIZE)
+		return EC_ERROR_INVAL;
+	ret = spi_flash_sync_begin();
+	if (ret)
+		return ret;
+
+	for (i = 0; i < bytes && ret == EC_SUCCESS; ) {
+		/* One read command per chunk, all chained in one go */
+		for (n = 0; n < SPI_FLASH_READ_CHAIN && i < bytes;
+		     n++, i += read_size) {
+			spi_addr = offset + i;
+			read_size = MIN((bytes - i), SPI_FLASH_MAX_READ_SIZE);
+			cmd[n][0] = SPI_FLASH_READ;
+			cmd[n][1] = (spi_addr >> 16) & 0xFF;
+			cmd[n][2] = (spi_addr >> 8) & 0xFF;
+			cmd[n][3] = spi_addr & 0xFF;
+			xfer[n].txdata = cmd[n];
+			xfer[n].txlen = 4;
+			xfer[n].rxdata = buf_usr + i;
+			xfer[n].rxlen = read_size;
+		}
+		ret = spi_transaction_chain(SPI_FLASH_DEVICE, xfer, n);
+		if (i < bytes)
+			msleep(1);
+	}
+	spi_flash_sync_end();
+	return ret;
+}
+#else
 int spi_flash_read(uint8_t *buf_usr, unsigned int offset, unsigned int bytes)
 {
 	int i, read_size, ret, spi_addr;
 	uint8_t cmd[4];
 	if (offset + bytes > CONFIG_FLASH_SIZE)
 		return EC_ERROR_INVAL;
+	ret = spi_flash_sync_begin();
+	if (ret)
+		return ret;
 	cmd[0] = SPI_FLASH_READ;
 	for (i = 0; i < bytes; i += read_size) {
 		spi_addr = offset + i;
@@ -171,18 +301,63 @@ int spi_flash_read(uint8_t *buf_usr, unsigned int offset, unsigned int bytes)
 			break;
 		msleep(1);
 	}
+	spi_flash_sync_end();
 	return ret;
 }
+#endif
+
+#ifdef CONFIG_SPI_FLASH_READ_ASYNC
+int spi_flash_read_start(uint8_t *buf_usr, unsigned int offset,
+			 unsigned int bytes)
+{
+	/*
+	 * May still be going out once this returns, so only fill it in
+	 * while holding the port lock.
+	 */
+	static uint8_t cmd[4];
+	int ret;
+
+	if (offset + bytes > CONFIG_FLASH_SIZE)
+		return EC_ERROR_INVAL;
+	ret = spi_flash_sync_begin();
+	if (ret)
+		return ret;
+
+	spi_port_lock(SPI_FLASH_DEVICE, 1);
+	cmd[0] = SPI_FLASH_READ;
+	cmd[1] = (offset >> 16) & 0xFF;
+	cmd[2] = (offset >> 8) & 0xFF;
+	cmd[3] = offset & 0xFF;
+	ret = spi_transaction_async(SPI_FLASH_DEVICE, cmd, 4, buf_usr, bytes);
+	if (ret != EC_SUCCESS) {
+		spi_port_lock(SPI_FLASH_DEVICE, 0);
+		spi_flash_sync_end();
+	}
+
+	return ret;
+}
+
+int spi_flash_read_finish(void)
+{
+	int ret;
+
+	ret = spi_transaction_flush(SPI_FLASH_DEVICE);
+	spi_port_lock(SPI_FLASH_DEVICE, 0);
+	spi_flash_sync_end();
+
+	return ret;
+}
+#endif
 
 /**
- * Erase a block of SPI flash.
+ * Start erasing a block of SPI flash, without waiting for it.
  *
  * @param offset Flash offset to start erasing
  * @param block Block size in kb (4 or 32)
  *
  * @return EC_SUCCESS, or non-zero if any error.
  */
-static int spi_flash_erase_block(unsigned int offset, unsigned int block)
+static int spi_flash_erase_block_start(unsigned int offset, unsigned int block)
 {
 	uint8_t cmd[4];
 	int rv = EC_SUCCESS;
@@ -206,7 +381,22 @@ static int spi_flash_erase_block(unsigned int offset, unsigned int block)
 	cmd[2] = (offset >> 8) & 0xFF;
 	cmd[3] = offset & 0xFF;
 
-	rv = spi_transaction(SPI_FLASH_DEVICE, cmd, 4, NULL, 0);
+	return spi_transaction(SPI_FLASH_DEVICE, cmd, 4, NULL, 0);
+}
+
+/**
+ * Erase a block of SPI flash.
+ *
+ * @param offset Flash offset to start erasing
+ * @param block Block size in kb (4 or 32)
+ *
+ * @return EC_SUCCESS, or non-zero if any error.
+ */
+static int spi_flash_erase_block(unsigned int offset, unsigned int block)
+{
+	int rv;
+
+	rv = spi_flash_erase_block_start(offset, block);
 	if (rv)
 		return rv;
 
@@ -234,12 +424,16 @@ int spi_flash_erase(unsigned int offset, unsigned int bytes)
 	if (offset % 4096 || bytes % 4096)
 		return EC_ERROR_INVAL;
 
+	rv = spi_flash_sync_begin();
+	if (rv)
+		return rv;
+
 	/* Largest unit is block (32kb) */
 	if (offset % (32 * 1024) == 0) {
 		while (bytes != (bytes % (32 * 1024))) {
 			rv = spi_flash_erase_block(offset, 32);
 			if (rv)
-				return rv;
+				goto out;
 
 			bytes -= 32 * 1024;
 			offset += 32 * 1024;
@@ -255,15 +449,49 @@ int spi_flash_erase(unsigned int offset, unsigned int bytes)
 	while (bytes != (bytes % (4 * 1024))) {
 		rv = spi_flash_erase_block(offset, 4);
 		if (rv)
-			return rv;
+			goto out;
 
 		bytes -= 4 * 1024;
 		offset += 4 * 1024;
 	}
 
+out:
+	spi_flash_sync_end();
 	return rv;
 }
 
+/**
+ * Start programming one flash page, without waiting for it.
+ *
+ * @param offset Flash offset to write
+ * @param bytes Number of bytes to write, not past the end of the page
+ * @param data Data to write to flash
+ *
+ * @return EC_SUCCESS, or non-zero if any error.
+ */
+static int spi_flash_page_program_start(unsigned int offset,
+					unsigned int bytes,
+					const uint8_t *data)
+{
+	int rv;
+
+	/* Enable writing to SPI flash */
+	rv = spi_flash_write_enable();
+	if (rv)
+		return rv;
+
+	/* Copy data to send buffer; buffers may overlap */
+	memmove(buf + 4, data, bytes);
+
+	/* Compose instruction */
+	buf[0] = SPI_FLASH_PAGE_PRGRM;
+	buf[1] = (offset) >> 16;
+	buf[2] = (offset) >> 8;
+	buf[3] = offset;
+
+	return spi_transaction(SPI_FLASH_DEVICE, buf, 4 + bytes, NULL, 0);
+}
+
 /**
  * Write to SPI flash. Assumes already erased.
  * Limited to SPI_FLASH_MAX_WRITE_SIZE by chip.
@@ -284,6 +512,10 @@ int spi_flash_write(unsigned int offset, unsigned int bytes,
 	    bytes > SPI_FLASH_MAX_WRITE_SIZE)
 		return EC_ERROR_INVAL;
 
+	rv = spi_flash_sync_begin();
+	if (rv)
+		return rv;
+
 	while (bytes > 0) {
 		watchdog_reload();
 		/* Write length can not go beyond the end of the flash page */
@@ -293,26 +525,11 @@ int spi_flash_write(unsigned int offset, unsigned int bytes,
 		/* Wait for previous operation to complete */
 		rv = spi_flash_wait();
 		if (rv)
-			return rv;
-
-		/* Enable writing to SPI flash */
-		rv = spi_flash_write_enable();
-		if (rv)
-			return rv;
-
-		/* Copy data to send buffer; buffers may overlap */
-		memmove(buf + 4, data, write_size);
+			goto out;
 
-		/* Compose instruction */
-		buf[0] = SPI_FLASH_PAGE_PRGRM;
-		buf[1] = (offset) >> 16;
-		buf[2] = (offset) >> 8;
-		buf[3] = offset;
-
-		rv = spi_transaction(SPI_FLASH_DEVICE,
-				     buf, 4 + write_size, NULL, 0);
+		rv = spi_flash_page_program_start(offset, write_size, data);
 		if (rv)
-			return rv;
+			goto out;
 
 		data += write_size;
 		offset += write_size;
@@ -320,8 +537,119 @@ int spi_flash_write(unsigned int offset, unsigned int bytes,
 	}
 
 	/* Wait for previous operation to complete */
-	return spi_flash_wait();
+	rv = spi_flash_wait();
+out:
+	spi_flash_sync_end();
+	return rv;
+}
+
+#ifdef CONFIG_SPI_FLASH_ASYNC
+static void spi_flash_async_step(void);
+DECLARE_DEFERRED(spi_flash_async_step);
+
+/*
+ * Run from the hook task: once the flash is no longer busy, start the next
+ * block erase or page program, then come back to poll the status. Each
+ * step is only a couple of short SPI transactions.
+ */
+static void spi_flash_async_step(void)
+{
+	unsigned int size;
+	int rv;
+
+	if (spi_flash_get_status1() & SPI_FLASH_SR1_BUSY) {
+		if (timestamp_expired(async_op.deadline, NULL))
+			async_op.rv = EC_ERROR_TIMEOUT;
+		else
+			hook_call_deferred(&spi_flash_async_step_data,
+					   SPI_FLASH_ASYNC_POLL_USEC);
+		return;
+	}
+
+	if (!async_op.bytes) {
+		async_op.rv = EC_SUCCESS;
+		return;
+	}
+
+	if (async_op.data) {
+		size = MIN(async_op.bytes, SPI_FLASH_MAX_WRITE_SIZE -
+			   (async_op.offset & (SPI_FLASH_MAX_WRITE_SIZE - 1)));
+		rv = spi_flash_page_program_start(async_op.offset, size,
+						  async_op.data);
+		async_op.data += size;
+	} else {
+		/* Largest unit is block (32kb) */
+		if (async_op.offset % (32 * 1024) == 0 &&
+		    async_op.bytes >= 32 * 1024)
+			size = 32 * 1024;
+		else
+			size = 4 * 1024;
+		rv = spi_flash_erase_block_start(async_op.offset, size / 1024);
+	}
+	if (rv) {
+		async_op.rv = rv;
+		return;
+	}
+
+	async_op.offset += size;
+	async_op.bytes -= size;
+	async_op.deadline.val = get_time().val + SPI_FLASH_TIMEOUT_USEC;
+	hook_call_deferred(&spi_flash_async_step_data,
+			   async_op.data ? SPI_FLASH_SLEEP_USEC :
+			   SPI_FLASH_ASYNC_POLL_USEC);
+}
+
+static int spi_flash_async_start(unsigned int offset, unsigned int bytes,
+				 const uint8_t *data)
+{
+	int rv = EC_SUCCESS;
+
+	interrupt_disable();
+	if (SPI_FLASH_ASYNC_BUSY() || sync_ops) {
+		rv = EC_ERROR_BUSY;
+	} else {
+		async_op.offset = offset;
+		async_op.bytes = bytes;
+		async_op.data = data;
+		async_op.deadline.val = get_time().val + SPI_FLASH_TIMEOUT_USEC;
+		async_op.rv = EC_ERROR_BUSY;
+	}
+	interrupt_enable();
+
+	if (rv == EC_SUCCESS)
+		hook_call_deferred(&spi_flash_async_step_data, 0);
+
+	return rv;
+}
+
+int spi_flash_erase_async(unsigned int offset, unsigned int bytes)
+{
+	/* Invalid input */
+	if (offset + bytes > CONFIG_FLASH_SIZE)
+		return EC_ERROR_INVAL;
+
+	/* Not aligned to sector (4kb) */
+	if (offset % 4096 || bytes % 4096)
+		return EC_ERROR_INVAL;
+
+	return spi_flash_async_start(offset, bytes, NULL);
+}
+
+int spi_flash_write_async(unsigned int offset, unsigned int bytes,
+			  const uint8_t *data)
+{
+	/* Invalid input */
+	if (!data || offset + bytes > CONFIG_FLASH_SIZE)
+		return EC_ERROR_INVAL;
+
+	return spi_flash_async_start(offset, bytes, data);
+}
+
+int spi_flash_async_result(void)
+{
+	return async_op.rv;
 }
+#endif
 
 /**
  * Gets the SPI flash JEDEC ID (manufacturer ID, memory type, and capacity)
@@ -651,6 +979,59 @@ DECLARE_CONSOLE_COMMAND(spi_flashread, command_spi_flashread,
 	"offset bytes",
 	"Read flash");
 
+/* Read size of each spi_flash_read() call in spi_flashspeed */
+#define SPI_FLASH_SPEED_CHUNK	4096
+
+static int command_spi_flashspeed(int argc, char **argv)
+{
+	int offset = 0;
+	int bytes = CONFIG_FLASH_SIZE;
+	int done, len, rv, mbps;
+	uint32_t us;
+	timestamp_t start;
+	char *data;
+
+	rv = parse_offset_size(argc, argv, 1, &offset, &bytes);
+	if (rv)
+		return rv;
+	if (offset + bytes > CONFIG_FLASH_SIZE)
+		return EC_ERROR_INVAL;
+
+	spi_enable(CONFIG_SPI_FLASH_PORT, 1);
+
+	rv = spi_flash_wait();
+	if (rv)
+		return rv;
+
+	rv = shared_mem_acquire(SPI_FLASH_SPEED_CHUNK, &data);
+	if (rv)
+		return rv;
+
+	start = get_time();
+	for (done = 0; done < bytes; done += len) {
+		watchdog_reload();
+		len = MIN(bytes - done, SPI_FLASH_SPEED_CHUNK);
+		rv = spi_flash_read((uint8_t *)data, offset + done, len);
+		if (rv)
+			break;
+	}
+	us = get_time().val - start.val;
+
+	shared_mem_release(data);
+	if (rv)
+		return rv;
+
+	/* KB and MB are both 1024 based, MB/s in hundredths */
+	mbps = (uint64_t)bytes * SECOND * 100 / (1024 * 1024) / MAX(us, 1);
+	ccprintf("Read %d bytes in %d us: %d KB/s (%d.%02d MB/s)\n", bytes, us,
+		 (int)((uint64_t)bytes * SECOND / 1024 / MAX(us, 1)),
+		 mbps / 100, mbps % 100);
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(spi_flashspeed, command_spi_flashspeed,
+	"[offset bytes]",
+	"Time reading flash");
+
 static int command_spi_flashread_sr(int argc, char **argv)
 {
 	spi_enable(CONFIG_SPI_FLASH_PORT, 1);
@@ -26,6 +26,125 @@ int temp_sensor_read(enum temp_sensor_id id, int *temp_ptr)
 	return sensor->read(sensor->idx, temp_ptr);
 }
 
+#ifdef CONFIG_TEMP_SENSOR_SCHEDULE
+/*
+ * Each sensor is sampled on its own period and phase from a deferred
+ * function, one sensor per call, so the hook task is only ever held for a
+ * single sensor's bus latency instead of all of them back to back.
+ */
+static struct {
+	/* Time the next sample is due */
+	uint64_t next;
+	/* Latest sample */
+	uint64_t sampled_at;
+	int temp;
+	int rv;
+	/* Time taken by the latest sample, and the worst one seen, in us */
+	uint32_t latency;
+	uint32_t latency_max;
+} sched[TEMP_SENSOR_COUNT];
+
+/* Hook task time spent sampling over the current / previous second */
+static uint64_t busy_window_start;
+static uint32_t busy_us, busy_us_last;
+
+static uint32_t sample_period_us(int id)
+{
+	if (!temp_sensors[id].period_ms)
+		return SECOND;
+
+	return temp_sensors[id].period_ms * MSEC;
+}
+
+static void temp_sensor_sample_one(int id)
+{
+	const struct temp_sensor_t *sensor = temp_sensors + id;
+	uint64_t start = get_time().val;
+	int rv = EC_SUCCESS;
+	int t;
+
+	if (sensor->update)
+		rv = sensor->update(sensor->idx);
+	if (rv == EC_SUCCESS)
+		rv = sensor->read(sensor->idx, &t);
+
+	sched[id].sampled_at = start;
+	sched[id].rv = rv;
+	if (rv == EC_SUCCESS)
+		sched[id].temp = t;
+
+	sched[id].latency = get_time().val - start;
+	sched[id].latency_max = MAX(sched[id].latency_max,
+				    sched[id].latency);
+
+	if (start - busy_window_start >= SECOND) {
+		busy_us_last = busy_us;
+		busy_us = 0;
+		busy_window_start = start;
+	}
+	busy_us += sched[id].latency;
+
+	/* Stay on the sensor's phase, skipping samples missed entirely */
+	sched[id].next += sample_period_us(id);
+	if (sched[id].next <= start)
+		sched[id].next = start + sample_period_us(id);
+}
+
+static void temp_sensor_sample(void);
+DECLARE_DEFERRED(temp_sensor_sample);
+
+static void temp_sensor_sample(void)
+{
+	uint64_t now = get_time().val;
+	uint64_t next = UINT64_MAX;
+	int i, due = -1;
+
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++)
+		if (sched[i].next <= now &&
+		    (due < 0 || sched[i].next < sched[due].next))
+			due = i;
+
+	if (due >= 0) {
+		temp_sensor_sample_one(due);
+		now = get_time().val;
+	}
+
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++)
+		next = MIN(next, sched[i].next);
+
+	hook_call_deferred(&temp_sensor_sample_data,
+			   next > now ? next - now : 0);
+}
+
+static void temp_sensor_schedule_init(void)
+{
+	uint64_t now = get_time().val;
+	int i;
+
+	for (i = 0; i < TEMP_SENSOR_COUNT; i++) {
+		sched[i].next = now + temp_sensors[i].phase_ms * MSEC;
+		sched[i].rv = EC_ERROR_NOT_POWERED;
+	}
+	hook_call_deferred(&temp_sensor_sample_data, 0);
+}
+DECLARE_HOOK(HOOK_INIT, temp_sensor_schedule_init, HOOK_PRIO_DEFAULT);
+
+int temp_sensor_read_latest(enum temp_sensor_id id, int *temp_ptr)
+{
+	if (id < 0 || id >= TEMP_SENSOR_COUNT)
+		return EC_ERROR_INVAL;
+
+	if (get_time().val - sched[id].sampled_at >
+	    TEMP_SENSOR_MAX_AGE_PERIODS * sample_period_us(id))
+		return EC_ERROR_TIMEOUT;
+
+	if (sched[id].rv == EC_SUCCESS)
+		*temp_ptr = sched[id].temp;
+
+	return sched[id].rv;
+}
+#endif /* CONFIG_TEMP_SENSOR_SCHEDULE */
+
 static void update_mapped_memory(void)
 {
 	int i, t;
@@ -139,6 +258,36 @@ DECLARE_CONSOLE_COMMAND(temps, command_temps,
 			NULL,
 			"Print temp sensors");
 
+#ifdef CONFIG_TEMP_SENSOR_SCHEDULE
+static int command_tempsched(int argc, char **argv)
+{
+	uint64_t now = get_time().val;
+	uint32_t burst = 0;
+	int i;
+
+	ccprintf("  %-20s period phase   age  last(us)  max(us)\n", "");
+	for (i = 0; i < TEMP_SENSOR_COUNT; ++i) {
+		ccprintf("  %-20s %6d %5d %5d %9d %8d\n", temp_sensors[i].name,
+			 sample_period_us(i) / MSEC, temp_sensors[i].phase_ms,
+			 (int)((now - sched[i].sampled_at) / MSEC),
+			 sched[i].latency, sched[i].latency_max);
+		burst += sched[i].latency;
+	}
+
+	/*
+	 * The burst is how long the hook task would be held sampling every
+	 * sensor back to back; the scheduler only holds it for one sensor.
+	 */
+	ccprintf("Hook task: %d us/s sampling, %d us burst if unscheduled\n",
+		 busy_us_last, burst);
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(tempsched, command_tempsched,
+			NULL,
+			"Print temp sensor sampling schedule and latency");
+#endif
+
 /*****************************************************************************/
 /* Host commands */
 
@@ -11,12 +11,17 @@
 #include <stdlib.h>
 #endif
 
+#ifdef EMU_BUILD
+#include <time.h>
+#endif
+
 #include "console.h"
 #include "hooks.h"
 #include "host_command.h"
 #include "system.h"
 #include "task.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
 struct test_util_tag {
@@ -173,6 +178,22 @@ uint32_t prng_no_seed(void)
 	return seed = prng(seed);
 }
 
+#ifdef EMU_BUILD
+/* get_time() is simulated on the emulator, time the host instead */
+uint64_t test_bench_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#else
+uint64_t test_bench_ns(void)
+{
+	return get_time().val * 1000;
+}
+#endif
+
 static void restore_state(void)
 {
 	const struct test_util_tag *tag;
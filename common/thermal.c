@@ -11,6 +11,7 @@
 #include "common.h"
 #include "console.h"
 #include "fan.h"
+#include "fan_pid.h"
 #include "hooks.h"
 #include "host_command.h"
 #include "temp_sensor.h"
@@ -62,6 +63,9 @@ static void thermal_control(void)
 #ifdef CONFIG_CUSTOM_FAN_CONTROL
 	int temp[TEMP_SENSOR_COUNT];
 #endif
+#ifdef CONFIG_FAN_PID_CONTROL
+	int temp_norm_max = -1000;
+#endif
 
 	/* Get ready to count things */
 	memset(count_over, 0, sizeof(count_over));
@@ -75,7 +79,7 @@ static void thermal_control(void)
 	for (i = 0; i < TEMP_SENSOR_COUNT; ++i) {
 
 		/* read one */
-		rv = temp_sensor_read(i, &t);
+		rv = temp_sensor_read_latest(i, &t);
 
 #ifdef CONFIG_CUSTOM_FAN_CONTROL
 		/* Store all sensors value */
@@ -114,6 +118,11 @@ static void thermal_control(void)
 				fmax = f;
 
 			temp_fan_configured = 1;
+#ifdef CONFIG_FAN_PID_CONTROL
+			temp_norm_max = MAX(temp_norm_max, fan_pid_normalize(
+				t, thermal_params[i].temp_fan_off,
+				thermal_params[i].temp_fan_max));
+#endif
 		}
 	}
 
@@ -184,6 +193,13 @@ static void thermal_control(void)
 
 	if (temp_fan_configured) {
 #ifdef CONFIG_FANS
+#ifdef CONFIG_FAN_PID_CONTROL
+		if (fan_pid_is_enabled()) {
+			for (i = 0; i < fan_get_count(); i++)
+				fan_pid_set_temp_needed(i, temp_norm_max);
+			return;
+		}
+#endif
 #ifdef CONFIG_CUSTOM_FAN_CONTROL
 		for (i = 0; i < fan_get_count(); i++) {
 			if (!is_thermal_control_enabled(i))
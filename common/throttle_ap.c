@@ -77,6 +77,11 @@ void throttle_ap(enum throttle_level level,
 
 }
 
+uint32_t throttle_ap_get_request(enum throttle_type type)
+{
+	return throttle_request[type];
+}
+
 static void prochot_input_deferred(void)
 {
 	int prochot_in;
@@ -13,6 +13,7 @@
 #include "host_command.h"
 #include "sha256.h"
 #include "shared_mem.h"
+#include "spi_flash.h"
 #include "stdbool.h"
 #include "system.h"
 #include "task.h"
@@ -33,11 +34,25 @@ struct vboot_hash_tag {
 #define VBOOT_HASH_SYSJUMP_TAG 0x5648 /* "VH" */
 #define VBOOT_HASH_SYSJUMP_VERSION 1
 
+#if defined(CONFIG_SPI_FLASH_READ_ASYNC) && !defined(CONFIG_MAPPED_STORAGE)
+/*
+ * Each chunk is read in READ_SIZE pieces into two buffers, so that the next
+ * piece comes in from the SPI flash while the CPU hashes the current one.
+ */
+#define CHUNK_SIZE 4096       /* Bytes to hash per deferred call */
+#define READ_SIZE 1024        /* Bytes per SPI flash read */
+#define HASH_PIPELINE
+#else
 #define CHUNK_SIZE 1024       /* Bytes to hash per deferred call */
+#endif
 #define WORK_INTERVAL_US 100  /* Delay between deferred calls */
 
+#ifdef HASH_PIPELINE
+SHARED_MEM_CHECK_SIZE(2 * READ_SIZE);
+#else
 /* Check that CHUNK_SIZE fits in shared memory. */
 SHARED_MEM_CHECK_SIZE(CHUNK_SIZE);
+#endif
 
 static uint32_t data_offset;
 static uint32_t data_size;
@@ -45,6 +60,8 @@ static uint32_t curr_pos;
 static const uint8_t *hash;   /* Hash, or NULL if not valid */
 static int want_abort;
 static int in_progress;
+static timestamp_t hash_start_time;
+static uint32_t hash_time_us; /* Time taken by the last completed hash */
 #define VBOOT_HASH_DEFERRED	true
 #define VBOOT_HASH_BLOCKING	false
 
@@ -75,6 +92,47 @@ DECLARE_DEFERRED(vboot_hash_next_chunk);
 
 #ifndef CONFIG_MAPPED_STORAGE
 
+#ifdef HASH_PIPELINE
+/*
+ * Hash <size> bytes at flash offset <offset>, reading each piece in the
+ * background while hashing the one before it.
+ */
+static int read_and_hash_pipelined(char *buf, int offset, int size)
+{
+	char *cur = buf, *next;
+	int n = MIN(READ_SIZE, size);
+	int n_next;
+	int rv;
+
+	rv = spi_flash_read_start((uint8_t *)cur, offset, n);
+	if (rv == EC_SUCCESS)
+		rv = spi_flash_read_finish();
+
+	while (rv == EC_SUCCESS) {
+		offset += n;
+		size -= n;
+		n_next = MIN(READ_SIZE, size);
+		next = (cur == buf) ? buf + READ_SIZE : buf;
+
+		if (n_next)
+			rv = spi_flash_read_start((uint8_t *)next, offset,
+						  n_next);
+		if (rv != EC_SUCCESS)
+			break;
+
+		SHA256_update(&ctx, (const uint8_t *)cur, n);
+		if (!n_next)
+			break;
+
+		rv = spi_flash_read_finish();
+		cur = next;
+		n = n_next;
+	}
+
+	return rv;
+}
+#endif
+
 static int read_and_hash_chunk(int offset, int size)
 {
 	char *buf;
@@ -83,7 +141,11 @@ static int read_and_hash_chunk(int offset, int size)
 	if (size == 0)
 		return EC_SUCCESS;
 
+#ifdef HASH_PIPELINE
+	rv = shared_mem_acquire(2 * READ_SIZE, &buf);
+#else
 	rv = shared_mem_acquire(size, &buf);
+#endif
 	if (rv == EC_ERROR_BUSY) {
 		/* Couldn't update hash right now; try again later */
 		hook_call_deferred(&vboot_hash_next_chunk_data,
@@ -94,10 +156,14 @@ static int read_and_hash_chunk(int offset, int size)
 		return rv;
 	}
 
+#ifdef HASH_PIPELINE
+	rv = read_and_hash_pipelined(buf, offset, size);
+#else
 	rv = flash_read(offset, size, buf);
 	if (rv == EC_SUCCESS)
 		SHA256_update(&ctx, (const uint8_t *)buf, size);
-	else
+#endif
+	if (rv != EC_SUCCESS)
 		vboot_hash_abort();
 
 	shared_mem_release(buf);
@@ -125,6 +191,17 @@ static void hash_next_chunk(size_t size)
 #endif
 }
 
+/**
+ * Store the final hash and the time it took.
+ */
+static void vboot_hash_done(void)
+{
+	hash = SHA256_final(&ctx);
+	hash_time_us = get_time().val - hash_start_time.val;
+	CPRINTS("hash done %ph in %d us", HEX_BUF(hash, SHA256_PRINT_SIZE),
+		hash_time_us);
+}
+
 static void vboot_hash_all_chunks(void)
 {
 	do {
@@ -133,8 +210,7 @@ static void vboot_hash_all_chunks(void)
 		curr_pos += size;
 	} while (curr_pos < data_size);
 
-	hash = SHA256_final(&ctx);
-	CPRINTS("hash done %ph", HEX_BUF(hash, SHA256_PRINT_SIZE));
+	vboot_hash_done();
 	in_progress = 0;
 	clock_enable_module(MODULE_FAST_CPU, 0);
 
@@ -162,9 +238,7 @@ static void vboot_hash_next_chunk(void)
 
 	curr_pos += size;
 	if (curr_pos >= data_size) {
-		/* Store the final hash */
-		hash = SHA256_final(&ctx);
-		CPRINTS("hash done %ph", HEX_BUF(hash, SHA256_PRINT_SIZE));
+		vboot_hash_done();
 
 		in_progress = 0;
 
@@ -224,6 +298,7 @@ static int vboot_hash_start(uint32_t offset, uint32_t size,
 
 	/* Restart the hash computation */
 	CPRINTS("hash start 0x%08x 0x%08x", offset, size);
+	hash_start_time = get_time();
 	SHA256_init(&ctx);
 	if (nonce_size)
 		SHA256_update(&ctx, nonce, nonce_size);
@@ -380,6 +455,8 @@ static int command_hash(int argc, char **argv)
 			ccprintf("%ph\n", HEX_BUF(hash, SHA256_DIGEST_SIZE));
 		else
 			ccprintf("(invalid)\n");
+		if (hash)
+			ccprintf("Time:   %d us\n", hash_time_us);
 
 		return EC_SUCCESS;
 	}
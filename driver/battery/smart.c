@@ -44,6 +44,104 @@ static int battery_supports_pec(void)
 	return supports_pec;
 }
 
+#ifdef CONFIG_BATTERY_SMART_CACHE
+/* Register was read once and stays valid until the cache is invalidated */
+#define SB_CACHE_STATIC		UINT32_MAX
+#define SB_CACHE_REGS		(SB_SERIAL_NUMBER + 1)
+#define SB_CACHE_STRING_LEN	32
+
+/*
+ * Validity window of each cached SBS word register. Registers with a zero
+ * window are always read from the battery. Voltage, current and status
+ * follow the fastest charger poll period; capacity and cycle count data
+ * only move over minutes, so they are refreshed much less often.
+ */
+static const uint32_t sb_cache_window[SB_CACHE_REGS] = {
+	[SB_BATTERY_MODE]		= MINUTE,
+	[SB_TEMPERATURE]		= 2 * SECOND,
+	[SB_VOLTAGE]			= 200 * MSEC,
+	[SB_CURRENT]			= 200 * MSEC,
+	[SB_AVERAGE_CURRENT]		= SECOND,
+	[SB_RELATIVE_STATE_OF_CHARGE]	= SECOND,
+	[SB_REMAINING_CAPACITY]		= SECOND,
+	[SB_FULL_CHARGE_CAPACITY]	= 30 * SECOND,
+	[SB_CHARGING_CURRENT]		= SECOND,
+	[SB_CHARGING_VOLTAGE]		= SECOND,
+	[SB_BATTERY_STATUS]		= 200 * MSEC,
+	[SB_CYCLE_COUNT]		= MINUTE,
+	[SB_DESIGN_CAPACITY]		= SB_CACHE_STATIC,
+	[SB_DESIGN_VOLTAGE]		= SB_CACHE_STATIC,
+	[SB_MANUFACTURE_DATE]		= SB_CACHE_STATIC,
+	[SB_SERIAL_NUMBER]		= SB_CACHE_STATIC,
+};
+
+static struct {
+	uint32_t read_at;
+	uint16_t value;
+	uint8_t valid;
+} sb_cache[SB_CACHE_REGS];
+
+static char sb_cache_chemistry[SB_CACHE_STRING_LEN];
+static uint32_t sb_cache_hits;
+static uint32_t sb_cache_misses;
+
+void sb_cache_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < SB_CACHE_REGS; i++)
+		sb_cache[i].valid = 0;
+	sb_cache_chemistry[0] = '\0';
+}
+
+static void sb_cache_invalidate_reg(int cmd)
+{
+	/* Capacity units follow the mode register, so drop everything */
+	if (cmd == SB_BATTERY_MODE)
+		sb_cache_invalidate();
+	else if (cmd >= 0 && cmd < SB_CACHE_REGS)
+		sb_cache[cmd].valid = 0;
+}
+
+static int sb_read_cached(int cmd, int *param)
+{
+	uint32_t window = sb_cache_window[cmd];
+	uint32_t now = get_time().le.lo;
+	int rv;
+
+#ifdef CONFIG_BATTERY_CUT_OFF
+	if (battery_is_cut_off())
+		return EC_RES_ACCESS_DENIED;
+#endif
+
+	if (!window)
+		return sb_read(cmd, param);
+
+	if (sb_cache[cmd].valid && (window == SB_CACHE_STATIC ||
+				    now - sb_cache[cmd].read_at < window)) {
+		sb_cache_hits++;
+		*param = sb_cache[cmd].value;
+		return EC_SUCCESS;
+	}
+
+	sb_cache_misses++;
+	rv = sb_read(cmd, param);
+	if (rv) {
+		sb_cache[cmd].valid = 0;
+		return rv;
+	}
+
+	sb_cache[cmd].value = *param;
+	sb_cache[cmd].read_at = now;
+	sb_cache[cmd].valid = 1;
+
+	return EC_SUCCESS;
+}
+#else
+static inline void sb_cache_invalidate_reg(int cmd) {}
+#define sb_read_cached sb_read
+#endif /* CONFIG_BATTERY_SMART_CACHE */
+
 test_mockable int sb_read(int cmd, int *param)
 {
 	uint16_t addr_flags = BATTERY_ADDR_FLAGS;
@@ -75,6 +173,8 @@ test_mockable int sb_write(int cmd, int param)
 	if (battery_supports_pec())
 		addr_flags |= I2C_FLAG_PEC;
 
+	sb_cache_invalidate_reg(cmd);
+
 	return i2c_write16(I2C_PORT_BATTERY, addr_flags, cmd, param);
 }
 
@@ -140,13 +240,15 @@ int sb_write_block(int reg, const uint8_t *val, int len)
 	if (battery_supports_pec())
 		addr_flags |= I2C_FLAG_PEC;
 
+	sb_cache_invalidate_reg(SB_BATTERY_MODE);
+
 	/* TODO: implement smbus_write_block. */
 	return i2c_write_block(I2C_PORT_BATTERY, addr_flags, reg, val, len);
 }
 
 int battery_get_mode(int *mode)
 {
-	return sb_read(SB_BATTERY_MODE, mode);
+	return sb_read_cached(SB_BATTERY_MODE, mode);
 }
 
 /**
@@ -179,7 +281,7 @@ int battery_remaining_capacity(int *capacity)
 	if (rv)
 		return rv;
 
-	return sb_read(SB_REMAINING_CAPACITY, capacity);
+	return sb_read_cached(SB_REMAINING_CAPACITY, capacity);
 }
 
 int battery_full_charge_capacity(int *capacity)
@@ -188,7 +290,7 @@ int battery_full_charge_capacity(int *capacity)
 	if (rv)
 		return rv;
 
-	return sb_read(SB_FULL_CHARGE_CAPACITY, capacity);
+	return sb_read_cached(SB_FULL_CHARGE_CAPACITY, capacity);
 }
 
 int battery_time_to_empty(int *minutes)
@@ -209,13 +311,13 @@ int battery_time_to_full(int *minutes)
 /* Read battery status */
 int battery_status(int *status)
 {
-	return sb_read(SB_BATTERY_STATUS, status);
+	return sb_read_cached(SB_BATTERY_STATUS, status);
 }
 
 /* Battery charge cycle count */
 int battery_cycle_count(int *count)
 {
-	return sb_read(SB_CYCLE_COUNT, count);
+	return sb_read_cached(SB_CYCLE_COUNT, count);
 }
 
 int battery_design_capacity(int *capacity)
@@ -224,7 +326,7 @@ int battery_design_capacity(int *capacity)
 	if (rv)
 		return rv;
 
-	return sb_read(SB_DESIGN_CAPACITY, capacity);
+	return sb_read_cached(SB_DESIGN_CAPACITY, capacity);
 }
 
 /* Designed battery output voltage
@@ -232,13 +334,13 @@ int battery_design_capacity(int *capacity)
  */
 int battery_design_voltage(int *voltage)
 {
-	return sb_read(SB_DESIGN_VOLTAGE, voltage);
+	return sb_read_cached(SB_DESIGN_VOLTAGE, voltage);
 }
 
 /* Read serial number */
 int battery_serial_number(int *serial)
 {
-	return sb_read(SB_SERIAL_NUMBER, serial);
+	return sb_read_cached(SB_SERIAL_NUMBER, serial);
 }
 
 test_mockable int battery_time_at_rate(int rate, int *minutes)
@@ -287,7 +389,7 @@ test_mockable int battery_manufacture_date(int *year, int *month, int *day)
 	int rv;
 	int ymd;
 
-	rv = sb_read(SB_MANUFACTURE_DATE, &ymd);
+	rv = sb_read_cached(SB_MANUFACTURE_DATE, &ymd);
 	if (rv)
 		return rv;
 
@@ -315,7 +417,23 @@ test_mockable int battery_device_name(char *dest, int size)
 /* Read battery type/chemistry */
 test_mockable int battery_device_chemistry(char *dest, int size)
 {
+#ifdef CONFIG_BATTERY_SMART_CACHE
+	int rv;
+
+	if (!sb_cache_chemistry[0]) {
+		rv = sb_read_string(SB_DEVICE_CHEMISTRY, sb_cache_chemistry,
+				    sizeof(sb_cache_chemistry));
+		if (rv) {
+			sb_cache_chemistry[0] = '\0';
+			return rv;
+		}
+	}
+	strzcpy(dest, sb_cache_chemistry, size);
+
+	return EC_SUCCESS;
+#else
 	return sb_read_string(SB_DEVICE_CHEMISTRY, dest, size);
+#endif
 }
 
 #ifdef CONFIG_CMD_PWR_AVG
@@ -324,7 +442,7 @@ int battery_get_avg_current(void)
 	int current;
 
 	/* This is a signed 16-bit value. */
-	sb_read(SB_AVERAGE_CURRENT, &current);
+	sb_read_cached(SB_AVERAGE_CURRENT, &current);
 	return (int16_t)current;
 }
 
@@ -337,7 +455,7 @@ int battery_get_avg_voltage(void)
 {
 	int voltage = -EC_ERROR_UNKNOWN;
 
-	sb_read(SB_VOLTAGE, &voltage);
+	sb_read_cached(SB_VOLTAGE, &voltage);
 	return voltage;
 }
 #endif /* CONFIG_CMD_PWR_AVG */
@@ -365,7 +483,7 @@ void battery_get_params(struct batt_params *batt)
 	struct batt_params batt_new = {0};
 	int v;
 
-	if (sb_read(SB_TEMPERATURE, &batt_new.temperature)
+	if (sb_read_cached(SB_TEMPERATURE, &batt_new.temperature)
 			&& fake_temperature < 0)
 		batt_new.flags |= BATT_FLAG_BAD_TEMPERATURE;
 
@@ -373,23 +491,24 @@ void battery_get_params(struct batt_params *batt)
 	if (fake_temperature >= 0)
 		batt_new.temperature = fake_temperature;
 
-	if (sb_read(SB_RELATIVE_STATE_OF_CHARGE, &batt_new.state_of_charge)
+	if (sb_read_cached(SB_RELATIVE_STATE_OF_CHARGE,
+			   &batt_new.state_of_charge)
 	    && fake_state_of_charge < 0)
 		batt_new.flags |= BATT_FLAG_BAD_STATE_OF_CHARGE;
 
-	if (sb_read(SB_VOLTAGE, &batt_new.voltage))
+	if (sb_read_cached(SB_VOLTAGE, &batt_new.voltage))
 		batt_new.flags |= BATT_FLAG_BAD_VOLTAGE;
 
 	/* This is a signed 16-bit value. */
-	if (sb_read(SB_CURRENT, &v))
+	if (sb_read_cached(SB_CURRENT, &v))
 		batt_new.flags |= BATT_FLAG_BAD_CURRENT;
 	else
 		batt_new.current = (int16_t)v;
 
-	if (sb_read(SB_CHARGING_VOLTAGE, &batt_new.desired_voltage))
+	if (sb_read_cached(SB_CHARGING_VOLTAGE, &batt_new.desired_voltage))
 		batt_new.flags |= BATT_FLAG_BAD_DESIRED_VOLTAGE;
 
-	if (sb_read(SB_CHARGING_CURRENT, &batt_new.desired_current))
+	if (sb_read_cached(SB_CHARGING_CURRENT, &batt_new.desired_current))
 		batt_new.flags |= BATT_FLAG_BAD_DESIRED_CURRENT;
 
 	if (battery_remaining_capacity(&batt_new.remaining_capacity))
@@ -422,6 +541,12 @@ void battery_get_params(struct batt_params *batt)
 		batt_new.is_present = BP_NOT_SURE;
 #endif
 
+#ifdef CONFIG_BATTERY_SMART_CACHE
+	/* A new pack may be inserted; don't report the old pack's data */
+	if (batt_new.is_present != BP_YES)
+		sb_cache_invalidate();
+#endif
+
 	/*
 	 * Charging allowed if both desired voltage and current are nonzero
 	 * and battery isn't full (and we read them all correctly).
@@ -476,8 +601,8 @@ int battery_wait_for_stable(void)
 	CPRINTS("Wait for battery stabilized during %d",
 			 BATTERY_NO_RESPONSE_TIMEOUT);
 	while (get_time().val < wait_timeout) {
-		/* Starting pinging battery */
-		if (battery_status(&status) == EC_SUCCESS) {
+		/* Starting pinging battery, bypassing the register cache */
+		if (sb_read(SB_BATTERY_STATUS, &status) == EC_SUCCESS) {
 			/* Battery is stable */
 			CPRINTS("battery responded with status %x", status);
 			return EC_SUCCESS;
@@ -535,6 +660,35 @@ DECLARE_CONSOLE_COMMAND(batttempfake, command_batttempfake,
 			"Set fake battery temperature in deciKelvin (2731 = 273.1 K = 0 deg C)");
 #endif
 
+#ifdef CONFIG_BATTERY_SMART_CACHE
+static int command_battcache(int argc, char **argv)
+{
+	uint32_t now = get_time().le.lo;
+	int i;
+
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "flush"))
+			return EC_ERROR_PARAM1;
+		sb_cache_invalidate();
+	}
+
+	ccprintf("hits %u misses %u\n", sb_cache_hits, sb_cache_misses);
+	for (i = 0; i < SB_CACHE_REGS; i++) {
+		if (!sb_cache[i].valid)
+			continue;
+		ccprintf("  0x%02x: 0x%04x age %u ms\n", i, sb_cache[i].value,
+			 (now - sb_cache[i].read_at) / MSEC);
+	}
+	if (sb_cache_chemistry[0])
+		ccprintf("  chemistry: %s\n", sb_cache_chemistry);
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(battcache, command_battcache,
+			"[flush]",
+			"Show or flush the smart battery register cache");
+#endif /* CONFIG_BATTERY_SMART_CACHE */
+
 #ifdef CONFIG_CMD_BATT_MFG_ACCESS
 static int command_batt_mfg_access_read(int argc, char **argv)
 {
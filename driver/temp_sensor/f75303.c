@@ -64,6 +64,23 @@ int f75303_get_val(int idx, int *temp)
 	return EC_SUCCESS;
 }
 
+#ifdef CONFIG_TEMP_SENSOR_SCHEDULE
+static const uint8_t f75303_temp_reg[F75303_IDX_COUNT] = {
+	[F75303_IDX_LOCAL] = F75303_TEMP_LOCAL,
+	[F75303_IDX_REMOTE1] = F75303_TEMP_REMOTE1,
+	[F75303_IDX_REMOTE2] = F75303_TEMP_REMOTE2,
+};
+
+int f75303_update_val(int idx)
+{
+	if (idx < 0 || F75303_IDX_COUNT <= idx)
+		return EC_ERROR_INVAL;
+	if (!f75303_enabled)
+		return EC_SUCCESS;
+
+	return get_temp(f75303_temp_reg[idx], &temps[idx]);
+}
+#else
 static void f75303_sensor_poll(void)
 {
 	if (f75303_enabled) {
@@ -73,6 +90,7 @@ static void f75303_sensor_poll(void)
 	}
 }
 DECLARE_HOOK(HOOK_SECOND, f75303_sensor_poll, HOOK_PRIO_TEMP_SENSOR);
+#endif
 
 static int f75303_set_fake_temp(int argc, char **argv)
 {
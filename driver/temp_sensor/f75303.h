@@ -38,6 +38,16 @@ enum f75303_index {
  */
 int f75303_get_val(int idx, int *temp);
 
+/**
+ * Read a sensor into the value returned by f75303_get_val(). Used with
+ * CONFIG_TEMP_SENSOR_SCHEDULE instead of polling every sensor once a second.
+ *
+ * @param idx	Index to read.
+ *
+ * @return EC_SUCCESS if successful, non-zero if error.
+ */
+int f75303_update_val(int idx);
+
 /**
  * Set if the underlying polling task will read the sensor
  * or if it will skip, as the rail this sensor is on
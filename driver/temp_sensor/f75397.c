@@ -64,6 +64,22 @@ int f75397_get_val(int idx, int *temp)
 	return EC_SUCCESS;
 }
 
+#ifdef CONFIG_TEMP_SENSOR_SCHEDULE
+static const uint8_t f75397_temp_reg[F75397_IDX_COUNT] = {
+	[F75397_IDX_LOCAL] = F75397_TEMP_LOCAL,
+	[F75397_IDX_REMOTE1] = F75397_TEMP_REMOTE1,
+};
+
+int f75397_update_val(int idx)
+{
+	if (idx < 0 || F75397_IDX_COUNT <= idx)
+		return EC_ERROR_INVAL;
+	if (!f75397_enabled)
+		return EC_SUCCESS;
+
+	return get_temp(f75397_temp_reg[idx], &temps[idx]);
+}
+#else
 static void f75397_sensor_poll(void)
 {
 	if (f75397_enabled) {
@@ -72,6 +88,7 @@ static void f75397_sensor_poll(void)
 	}
 }
 DECLARE_HOOK(HOOK_SECOND, f75397_sensor_poll, HOOK_PRIO_TEMP_SENSOR);
+#endif
 
 static int f75397_set_fake_temp(int argc, char **argv)
 {
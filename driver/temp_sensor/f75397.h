@@ -32,6 +32,16 @@ enum f75397_index {
  */
 int f75397_get_val(int idx, int *temp);
 
+/**
+ * Read a sensor into the value returned by f75397_get_val(). Used with
+ * CONFIG_TEMP_SENSOR_SCHEDULE instead of polling every sensor once a second.
+ *
+ * @param idx	Index to read.
+ *
+ * @return EC_SUCCESS if successful, non-zero if error.
+ */
+int f75397_update_val(int idx);
+
 /**
  * Set if the underlying polling task will read the sensor
  * or if it will skip, as the rail this sensor is on
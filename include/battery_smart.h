@@ -167,5 +167,12 @@ int sb_write_block(int reg, const uint8_t *val, int len);
 /* Read manufactures access data from the battery */
 int sb_read_mfgacc(int cmd, int block, uint8_t *data, int len);
 
+#ifdef CONFIG_BATTERY_SMART_CACHE
+/* Drop all cached battery registers so the next reads hit the battery */
+void sb_cache_invalidate(void);
+#else
+static inline void sb_cache_invalidate(void) {}
+#endif
+
 #endif /* __CROS_EC_BATTERY_SMART_H */
 
@@ -94,6 +94,29 @@ enum dualrole_capabilities {
  */
 void charge_manager_update_dualrole(int port, enum dualrole_capabilities cap);
 
+/**
+ * Start a batch of charge updates. Until the matching
+ * charge_manager_batch_end(), updates are applied but the port / supplier
+ * selection is not refreshed. Batches may be nested. A batch belongs to the
+ * calling task and only holds back refreshes requested by that task; outside
+ * of task context (interrupts, before the scheduler starts) it has no effect.
+ */
+void charge_manager_batch_begin(void);
+
+/**
+ * End a batch of charge updates, scheduling a single refresh if any update
+ * made within the outermost batch requires one.
+ */
+void charge_manager_batch_end(void);
+
+/**
+ * Get charge manager refresh statistics.
+ *
+ * @param count		Number of refreshes run since boot.
+ * @param time_us	Total time spent in refreshes, in us.
+ */
+void charge_manager_get_refresh_stats(uint32_t *count, uint32_t *time_us);
+
 /**
  * Tell charge_manager to leave safe mode and switch to standard port / ILIM
  * selection logic.
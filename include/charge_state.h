@@ -24,6 +24,18 @@
 #define CHARGE_MAX_SLEEP_USEC          MINUTE
 #endif
 
+/*
+ * With CONFIG_CHARGE_STATE_ADAPTIVE_POLL, the longest a stable charger loop
+ * may sleep, and how far battery readings (mV, mA, deci-Kelvin) may drift
+ * before it's no longer considered stable.
+ */
+#ifndef CHARGE_ADAPTIVE_MAX_SLEEP_USEC
+#define CHARGE_ADAPTIVE_MAX_SLEEP_USEC (SECOND * 5)
+#endif
+#define CHARGE_ADAPTIVE_VOLTAGE_MV     50
+#define CHARGE_ADAPTIVE_CURRENT_MA     100
+#define CHARGE_ADAPTIVE_TEMP_DK        10
+
 /* Power states */
 enum charge_state {
 	/* Meta-state; unchanged from previous time through task loop */
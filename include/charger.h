@@ -187,6 +187,17 @@ int charger_closest_voltage(int voltage);
 /* Power state machine post init */
 enum ec_error_list charger_post_init(void);
 
+#ifdef CONFIG_CHARGER_SKIP_REDUNDANT_WRITES
+/*
+ * Forget the values last programmed into the chargers, so the next
+ * charger_set_* calls write the registers again. Call this whenever a
+ * charger may have lost its settings.
+ */
+void charger_invalidate_set_cache(void);
+#else
+static inline void charger_invalidate_set_cache(void) {}
+#endif
+
 /* Get charger information. */
 const struct charger_info *charger_get_info(void);
 
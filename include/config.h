@@ -514,6 +514,14 @@
  */
 #undef CONFIG_BATTERY_SMART
 
+/*
+ * Cache smart battery register reads. Every SBS word register gets its own
+ * validity window so fast moving values (voltage, current, status) are read
+ * on each charger poll while slow ones (full charge capacity, cycle count,
+ * design data) are only re-read every few tens of seconds.
+ */
+#undef CONFIG_BATTERY_SMART_CACHE
+
 /* Chemistry of the battery device */
 #undef CONFIG_BATTERY_DEVICE_CHEMISTRY
 
@@ -541,6 +549,16 @@
 /* If the battery is too hot or too cold, stop charging */
 #undef CONFIG_BATTERY_CHECK_CHARGE_TEMP_LIMITS
 
+/*
+ * Keep a RAM history of battery / charger samples, taken every
+ * CONFIG_BATTERY_HISTORY_INTERVAL seconds and delta-encoded into
+ * CONFIG_BATTERY_HISTORY_ENTRIES entries, which the host can read back in
+ * bulk. Implemented by the board.
+ */
+#undef CONFIG_BATTERY_HISTORY
+#define CONFIG_BATTERY_HISTORY_ENTRIES 512
+#define CONFIG_BATTERY_HISTORY_INTERVAL 10
+
 /*
  * Support battery cut-off as host command and console command.
  *
@@ -641,6 +659,14 @@
  */
 #undef CONFIG_CHARGE_STATE_DEBUG
 
+/*
+ * Let charger_task() back off its polling period while battery voltage,
+ * current, AC and input limits are stable. The period doubles on every
+ * quiet iteration up to CHARGE_ADAPTIVE_MAX_SLEEP_USEC. AC, PD input
+ * limit and charge control mode changes wake the task immediately.
+ */
+#undef CONFIG_CHARGE_STATE_ADAPTIVE_POLL
+
 /* Include support for Bluetooth LE */
 #undef CONFIG_BLUETOOTH_LE
 
@@ -928,6 +954,14 @@
 /* Board has a custom discharge mode. */
 #undef CONFIG_CHARGER_DISCHARGE_ON_AC_CUSTOM
 
+/*
+ * Remember the charge voltage, charge current and input current last
+ * programmed into each charger and skip writes that would not change them.
+ * The cache is dropped on charger (re)init, post init and chipset resume,
+ * and at least once a minute so the charger is periodically reconciled.
+ */
+#undef CONFIG_CHARGER_SKIP_REDUNDANT_WRITES
+
 /*
  * Board specific flag used to disable external ILIM pin used to determine input
  * current limit. When defined, the input current limit is decided only by
@@ -1711,6 +1745,14 @@
  */
 #undef CONFIG_FAN_UPDATE_PERIOD
 
+/*
+ * Let thermal control run the fans from a closed-loop PID controller with a
+ * learned duty -> RPM map, instead of the open-loop temperature ramp. The
+ * controller is switched on with the fanpid console command or
+ * EC_CMD_FAN_PID_CONTROL.
+ */
+#undef CONFIG_FAN_PID_CONTROL
+
 /*****************************************************************************/
 /* Flash configuration */
 
@@ -1727,6 +1769,12 @@
 #undef CONFIG_FLASH_ERASE_SIZE
 /* Allow deferred (async) flash erase */
 #undef CONFIG_FLASH_DEFERRED_ERASE
+/*
+ * Allow posted flash writes, version 2 of EC_CMD_FLASH_WRITE: programming
+ * runs from the hook task while the host sends the next chunk. Needs
+ * flash_physical_write_async() from the chip.
+ */
+#undef CONFIG_FLASH_POSTED_WRITE
 /* Flash must be selected for write/erase operations to succeed. */
 #undef CONFIG_FLASH_SELECT_REQUIRED
 
@@ -2224,6 +2272,12 @@
 /* Enable the software routine for CRC computation */
 #undef CONFIG_SW_CRC
 
+/*
+ * Hash buffers eight bytes at a time in the software CRC-32 routine. Costs
+ * 7 KiB of RAM for the tables.
+ */
+#undef CONFIG_SW_CRC_SLICE8
+
 /*****************************************************************************/
 
 /* Enable system hibernate */
@@ -2593,6 +2647,12 @@
 /*  Print keyboard scan time intervals. */
 #undef CONFIG_KEYBOARD_PRINT_SCAN_TIMES
 
+/*
+ * Trace each keypress through the 8042 path, from the matrix edge to the
+ * host reading the scan code, and keep latency statistics per trace point.
+ */
+#undef CONFIG_KEYBOARD_LATENCY
+
 /*
  * Support for extra runtime key combinations (e.g. alt+volup+h/r for hibernate
  * and warm reboot, respectively).
@@ -2623,6 +2683,19 @@
  */
 #undef CONFIG_KEYBOARD_SCANCODE_CALLBACK
 
+/*
+ * Number of bytes the 8042 emulation can queue for the host, a power of two.
+ * The default fits a few scan codes; boards that play back macros or see
+ * fast typematic repeat may want more.
+ */
+#define CONFIG_KEYBOARD_TO_HOST_QUEUE_SIZE 16
+
+/*
+ * Board supplies keyboard_board_scancode() to make the 8042 scan code bytes
+ * for a key, in place of the set 2 matrix and the scan code callback.
+ */
+#undef CONFIG_KEYBOARD_BOARD_SCANCODES
+
 /*
  * Call board-supplied keyboard_suppress_noise() function when the debounced
  * keyboard state changes.  Some boards use this to send a signal to the audio
@@ -2931,6 +3004,14 @@
 /* Microchip LPC enable debug messages */
 #undef CONFIG_MCHP_DEBUG_LPC
 
+/*
+ * Microchip LFW loads EC_RO/RW with fast read quad output (0x6B) and DMA,
+ * when the SPI flash Quad Enable bit is set, and checks the CRC32 that
+ * pack_ec.py stores in the last 4 bytes of each image. Falls back to single
+ * I/O reads on any error.
+ */
+#undef CONFIG_MCHP_LFW_QUAD_LOAD
+
 /* Microchip I2C controller slave addresses */
 #undef CONFIG_MCHP_I2C0_SLAVE_ADDRS
 #undef CONFIG_MCHP_I2C1_SLAVE_ADDRS
@@ -3366,6 +3447,13 @@
 /* Unroll some loops in SHA256_transform for better performance. */
 #undef CONFIG_SHA256_UNROLLED
 
+/*
+ * Fully unroll SHA256_transform, with the message schedule in a 16 word
+ * window, tuned for Cortex-M4. Faster than CONFIG_SHA256_UNROLLED, but
+ * takes about 4 KB more flash.
+ */
+#undef CONFIG_SHA256_FULL_UNROLL
+
 /* Emulate the CLZ (Count Leading Zeros) in software for CPU lacking support */
 #undef CONFIG_SOFTWARE_CLZ
 
@@ -3402,6 +3490,26 @@
 /* Support SPI flash */
 #undef CONFIG_SPI_FLASH
 
+/*
+ * SPI controller chains several transactions into one submission, see
+ * spi_transaction_chain(). spi_flash_read() uses it for reads that take
+ * more than one transaction.
+ */
+#undef CONFIG_SPI_CHAIN
+
+/*
+ * SPI flash reads can run in the background, see spi_flash_read_start().
+ * Needs spi_transaction_async() and spi_port_lock() from the chip.
+ */
+#undef CONFIG_SPI_FLASH_READ_ASYNC
+
+/*
+ * SPI flash erases and writes can run in the background, polled from the
+ * hook task, see spi_flash_erase_async(). With CONFIG_FLASH_DEFERRED_ERASE
+ * the host's async flash erase uses them and no task waits on the flash.
+ */
+#undef CONFIG_SPI_FLASH_ASYNC
+
 /* Support SPI flash protection register translation */
 #undef CONFIG_SPI_FLASH_REGS
 
@@ -3638,6 +3746,13 @@
 /* Compile common code for temperature sensor support */
 #undef CONFIG_TEMP_SENSOR
 
+/*
+ * Sample each temperature sensor from a scheduler with its own period and
+ * phase (see struct temp_sensor_t), instead of polling every sensor from the
+ * once-a-second hook. Thermal control uses the latest samples.
+ */
+#undef CONFIG_TEMP_SENSOR_SCHEDULE
+
 /* Support particular temperature sensor chips */
 #undef CONFIG_TEMP_SENSOR_ADT7481	/* ADT 7481 sensor, on I2C bus */
 #undef CONFIG_TEMP_SENSOR_BD99992GW	/* BD99992GW PMIC, on I2C bus */
@@ -3678,6 +3793,17 @@
  */
 #undef CONFIG_TEMP_SENSOR_POWER_GPIO
 
+/*
+ * Keep a RAM history of one sample per second of every temperature sensor,
+ * the fan, the throttle state and the CPU power limits, for the last
+ * CONFIG_THERMAL_HISTORY_ENTRIES seconds, plus the last
+ * CONFIG_THERMAL_HISTORY_EVENTS threshold crossings and throttle changes.
+ * Implemented by the board.
+ */
+#undef CONFIG_THERMAL_HISTORY
+#define CONFIG_THERMAL_HISTORY_ENTRIES 300
+#define CONFIG_THERMAL_HISTORY_EVENTS 32
+
 /* Compile common code for throttling the CPU based on the temp sensors */
 #undef CONFIG_THROTTLE_AP
 
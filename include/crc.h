@@ -34,8 +34,19 @@ void crc32_ctx_hash16(uint32_t *ctx, uint16_t val);
 
 void crc32_ctx_hash8(uint32_t *ctx, uint8_t val);
 
+void crc32_ctx_hash(uint32_t *ctx, const void *buf, int len);
+
 uint32_t crc32_ctx_result(uint32_t *ctx);
 
+/**
+ * CRC-32 of a buffer.
+ *
+ * @param buf		Data
+ * @param len		Length of data in bytes
+ * @return The final CRC-32, as crc32_ctx_result().
+ */
+uint32_t crc32_buf(const void *buf, int len);
+
 #endif /* CONFIG_HW_CRC */
 
 #endif /* __CROS_EC_CRC_H */
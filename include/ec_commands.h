@@ -1583,6 +1583,17 @@ struct ec_params_flash_read {
 /* Version 0 of the flash command supported only 64 bytes of data */
 #define EC_FLASH_WRITE_VER0_SIZE 64
 
+/*
+ * Version 2 is a posted write: the EC copies the data, starts programming
+ * it and responds, so that the host sends the next chunk while the flash
+ * is busy. Each version 2 write first waits for the previous one and
+ * fails if that did; a version 2 write of size 0 only collects the result.
+ */
+#define EC_VER_FLASH_WRITE_POSTED 2
+
+/* Most data in one posted write */
+#define EC_FLASH_WRITE_POSTED_SIZE 256
+
 /**
  * struct ec_params_flash_write - Parameters for the flash write command.
  * @offset: Byte offset to write.
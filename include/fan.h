@@ -56,6 +56,15 @@ extern const struct fan_t fans[];
  */
 void fan_set_percent_needed(int fan, int pct);
 
+/**
+ * Set the duty cycle needed by a closed-loop thermal controller, switching
+ * the fan to duty cycle control while leaving it under thermal control.
+ *
+ * @param fan   Fan number (index into fans[])
+ * @param duty  Duty cycle (0 - 100)
+ */
+void fan_set_duty_needed(int fan, int duty);
+
 /**
  * This function translates the percentage of cooling needed into a target RPM.
  * The default implementation should be sufficient for most needs, but
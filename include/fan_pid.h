@@ -0,0 +1,123 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Closed-loop fan controller */
+
+#ifndef __CROS_EC_FAN_PID_H
+#define __CROS_EC_FAN_PID_H
+
+#include "common.h"
+
+/* Duty cycle steps of the learned duty -> RPM map */
+#define FAN_PID_MAP_STEP	10
+#define FAN_PID_MAP_SIZE	(100 / FAN_PID_MAP_STEP + 1)
+
+/* Fixed point shift of the PID gains */
+#define FAN_PID_GAIN_SHIFT	8
+
+/*
+ * Controller tunables, shared by all fans. Temperatures are normalized per
+ * sensor to per-mille of its temp_fan_off..temp_fan_max band, and the hottest
+ * sensor is regulated to the setpoint.
+ */
+struct fan_pid_tunables {
+	/* Normalized temperature to regulate to, in per-mille */
+	int setpoint;
+	/* RPM per per-mille of error, << FAN_PID_GAIN_SHIFT */
+	int kp;
+	/* RPM per per-mille of error per second, << FAN_PID_GAIN_SHIFT */
+	int ki;
+	/* RPM per per-mille per second of change, << FAN_PID_GAIN_SHIFT */
+	int kd;
+	/* Lowest duty cycle the fan reliably spins at, in % */
+	int duty_min;
+	/* Seconds the duty cycle must hold before the map learns from it */
+	int learn_settle;
+};
+
+extern struct fan_pid_tunables fan_pid_tunables;
+
+struct fan_pid {
+	/* Integral term, in RPM << FAN_PID_GAIN_SHIFT */
+	int integral;
+	/* Previous normalized temperature, valid after the first update */
+	int last_temp;
+	int updated;
+	/* Highest RPM the controller asks for */
+	int rpm_max;
+	/* Current output */
+	int rpm_target;
+	int duty;
+	/* Updates the duty cycle has been held for */
+	int duty_held;
+	/* Learned RPM at each FAN_PID_MAP_STEP duty cycle step */
+	int rpm_map[FAN_PID_MAP_SIZE];
+};
+
+/**
+ * Reset a fan controller, seeding the duty -> RPM map with a straight line.
+ *
+ * @param pid		Controller
+ * @param rpm_max	RPM of the fan at 100% duty cycle
+ */
+void fan_pid_reset(struct fan_pid *pid, int rpm_max);
+
+/**
+ * Normalize a temperature to per-mille of a sensor's fan band.
+ *
+ * @param temp		Temperature (K)
+ * @param temp_off	Temperature at which the fan would be off (K)
+ * @param temp_max	Temperature at which the fan would be at max (K)
+ * @return Normalized temperature, may be below 0 or above 1000.
+ */
+int fan_pid_normalize(int temp, int temp_off, int temp_max);
+
+/**
+ * Look up the duty cycle expected to give a fan speed in the learned map.
+ *
+ * @param pid		Controller
+ * @param rpm		Fan speed
+ * @return Duty cycle in %.
+ */
+int fan_pid_rpm_to_duty(const struct fan_pid *pid, int rpm);
+
+/**
+ * Run one controller update.
+ *
+ * @param pid		Controller
+ * @param temp		Normalized temperature of the hottest sensor
+ * @param rpm_actual	Measured fan speed, used to learn the map
+ * @param dt_ms		Time since the previous update, in ms
+ * @return Duty cycle to apply, in %.
+ */
+int fan_pid_update(struct fan_pid *pid, int temp, int rpm_actual, int dt_ms);
+
+/**
+ * Run the controller of a fan, and apply its duty cycle.
+ *
+ * @param fan		Fan number (index into fans[])
+ * @param temp		Normalized temperature of the hottest sensor
+ */
+void fan_pid_set_temp_needed(int fan, int temp);
+
+/**
+ * Get the controller of a fan.
+ *
+ * @param fan		Fan number (index into fans[])
+ */
+const struct fan_pid *fan_pid_get(int fan);
+
+/**
+ * Check whether thermal control uses the closed-loop controller.
+ */
+int fan_pid_is_enabled(void);
+
+/**
+ * Switch thermal control between the closed-loop controller and the
+ * default fan ramp.
+ */
+void fan_pid_enable(int enable);
+
+#endif  /* __CROS_EC_FAN_PID_H */
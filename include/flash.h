@@ -96,6 +96,19 @@ int flash_bank_erase_size(int bank);
 #define PSTATE_BANK_COUNT		0
 #endif  /* CONFIG_FLASH_PSTATE && CONFIG_FLASH_PSTATE_BANK */
 
+/*
+ * All internal EC code assumes that offsets are provided relative to
+ * physical address zero of storage. In some cases, the region of storage
+ * belonging to the EC is not physical address zero - a non-zero fmap_base
+ * indicates so. Since fmap_base is not yet handled correctly by external
+ * code, we must perform the adjustment in our host command handlers -
+ * adjust all offsets so they are relative to the beginning of the storage
+ * region belonging to the EC. TODO(crbug.com/529365): Handle fmap_base
+ * correctly in flashrom, dump_fmap, etc. and remove EC_FLASH_REGION_START.
+ */
+#define EC_FLASH_REGION_START MIN(CONFIG_EC_PROTECTED_STORAGE_OFF, \
+				  CONFIG_EC_WRITABLE_STORAGE_OFF)
+
 #ifdef CONFIG_ROLLBACK
 /*
  * ROLLBACK region offset and size in units of flash banks.
@@ -153,6 +166,46 @@ int flash_physical_write(int offset, int size, const char *data);
  */
 int flash_physical_erase(int offset, int size);
 
+/**
+ * Start erasing physical flash and return; chip-specific.
+ *
+ * Offset and size must be a multiple of CONFIG_FLASH_ERASE_SIZE.
+ *
+ * @param offset	Flash offset to erase.
+ * @param size	        Number of bytes to erase.
+ * @return EC_SUCCESS if the erase started, EC_ERROR_BUSY if one is
+ * already running, or other non-zero error code.
+ */
+int flash_physical_erase_async(int offset, int size);
+
+/**
+ * Get the result of the last flash_physical_erase_async(); chip-specific.
+ *
+ * @return EC_ERROR_BUSY while erasing, then EC_SUCCESS or the error.
+ */
+int flash_physical_erase_result(void);
+
+/**
+ * Start writing physical flash and return; chip-specific.
+ *
+ * Offset and size must be a multiple of CONFIG_FLASH_WRITE_SIZE.
+ *
+ * @param offset	Flash offset to write.
+ * @param size	        Number of bytes to write.
+ * @param data          Data to write to flash, kept until the write is
+ *                      done.  Must be 32-bit aligned.
+ * @return EC_SUCCESS if the write started, EC_ERROR_BUSY if an erase or
+ * write is already running, or other non-zero error code.
+ */
+int flash_physical_write_async(int offset, int size, const char *data);
+
+/**
+ * Get the result of the last flash_physical_write_async(); chip-specific.
+ *
+ * @return EC_ERROR_BUSY while writing, then EC_SUCCESS or the error.
+ */
+int flash_physical_write_result(void);
+
 /**
  * Read physical write protect setting for a flash bank.
  *
@@ -370,6 +423,19 @@ const char *flash_read_pstate_mac_addr(void);
  */
 int flash_write_pstate_mac_addr(const char *mac_addr);
 
+/**
+ * Wait for the posted write (EC_VER_FLASH_WRITE_POSTED) in progress, if any.
+ * Host commands that access flash must call this first.
+ *
+ * @return EC_SUCCESS, or the error of the posted write, which is returned
+ * only once.
+ */
+#ifdef CONFIG_FLASH_POSTED_WRITE
+int flash_posted_write_wait(void);
+#else
+static inline int flash_posted_write_wait(void) { return EC_SUCCESS; }
+#endif
+
 /**
  * Lock or unlock HW necessary for mapped storage read.
  *
@@ -495,6 +495,15 @@ enum ec_status i2c_get_protocol_info(struct host_cmd_handler_args *args);
 void i2c_data_received(int port, uint8_t *buf, int len);
 int i2c_set_response(int port, uint8_t *buf, int len);
 
+/**
+ * Send the response from data instead of buf. Only valid from
+ * i2c_set_response(); data must not go away before the transfer ends.
+ *
+ * @param port: I2C port number, as passed to i2c_set_response()
+ * @param data:	Response, of the size i2c_set_response() returns
+ */
+void i2c_slave_set_response_buffer(int port, const uint8_t *data);
+
 /*
  * Initialize i2c master controller. Automatically called at board boot
  * if CONFIG_I2C_MASTER is defined.
@@ -35,6 +35,14 @@ void keyboard_host_write(int data, int is_cmd);
  */
 int keyboard_host_write_avaliable(void);
 
+/**
+ * Notify the keyboard module that the host has read the output buffer, so
+ * the next queued byte can go out without waiting for the keyboard task.
+ *
+ * Note: This is called in interrupt context by the LPC interrupt handler.
+ */
+void keyboard_host_read_done(void);
+
 /*
  * Board specific callback function when a key state is changed.
  *
@@ -52,6 +60,26 @@ int keyboard_host_write_avaliable(void);
 enum ec_error_list keyboard_scancode_callback(uint16_t *make_code,
 					      int8_t pressed);
 
+/**
+ * Make the scan code bytes for a key event from board tables.
+ *
+ * Used instead of get_scancode_set2() and keyboard_scancode_callback() with
+ * CONFIG_KEYBOARD_BOARD_SCANCODES, so a board can keep its keys in the form
+ * that is quickest for it to turn into bytes.
+ *
+ * Returning anything but EC_SUCCESS drops the key event.
+ *
+ * @param row		Key row
+ * @param col		Key column
+ * @param pressed	Is the key being pressed (1) or released (0).
+ * @param set1		Make set 1 codes if non-zero, else set 2.
+ * @param scan_code	Filled in with the scan code bytes.
+ * @param len		Filled in with the number of bytes.
+ */
+enum ec_error_list keyboard_board_scancode(int8_t row, int8_t col,
+					   int8_t pressed, int set1,
+					   uint8_t *scan_code, int32_t *len);
+
 /**
  * Send aux data to host from interrupt context.
  *
@@ -0,0 +1,111 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * Keypress latency trace points, from the matrix edge seen by the keyboard
+ * scanner to the host reading the last scan code byte from port 0x60.
+ */
+
+#ifndef __CROS_EC_KEYBOARD_LATENCY_H
+#define __CROS_EC_KEYBOARD_LATENCY_H
+
+#include "common.h"
+
+/* Trace points, timed from the matrix edge */
+enum kblat_stage {
+	/* Edge handed to keyboard_state_changed() */
+	KBLAT_REPORT,
+	/* Scan code bytes made, after the Fn layer */
+	KBLAT_SCANCODE,
+	/* Scan code bytes in the to_host queue */
+	KBLAT_QUEUED,
+	/* Last byte written to the 8042 output buffer */
+	KBLAT_SENT,
+	/* Host has read the last byte */
+	KBLAT_READ,
+	KBLAT_STAGE_COUNT,
+};
+
+/* Histogram bucket n counts latencies of [2^n, 2^(n+1)) us, the last all above */
+#define KBLAT_HIST_BUCKETS 16
+
+struct kblat_stats {
+	uint32_t count;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint64_t total_us;
+	uint16_t hist[KBLAT_HIST_BUCKETS];
+};
+
+#ifdef CONFIG_KEYBOARD_LATENCY
+/**
+ * Set the time of the matrix edge behind the next keyboard_state_changed().
+ *
+ * @param time		Low word of get_time() when the edge was seen
+ */
+void keyboard_latency_edge(uint32_t time);
+
+/**
+ * Start tracing a keystroke, stamping KBLAT_REPORT.
+ *
+ * @return Trace to pass along with the scan code, or 0 if none.
+ */
+int keyboard_latency_start(void);
+
+/**
+ * Stamp a trace point of a keystroke. Stamping KBLAT_READ completes the
+ * trace and adds it to the statistics.
+ *
+ * @param trace		Trace from keyboard_latency_start(), or 0
+ * @param stage		Trace point reached
+ */
+void keyboard_latency_stamp(int trace, enum kblat_stage stage);
+
+/**
+ * Stamp a trace point reached earlier, as keyboard_latency_stamp().
+ *
+ * @param time		Low word of get_time() when the trace point was reached
+ */
+void keyboard_latency_stamp_at(int trace, enum kblat_stage stage,
+			       uint32_t time);
+
+/**
+ * Drop a keystroke that will not reach the host.
+ */
+void keyboard_latency_drop(int trace);
+
+/**
+ * Get the statistics of a trace point.
+ */
+void keyboard_latency_get(enum kblat_stage stage, struct kblat_stats *stats);
+
+/**
+ * Get the latencies of the most recently completed keystroke.
+ *
+ * @param us		Filled in with each trace point's latency
+ * @return Number of keystrokes completed so far.
+ */
+uint32_t keyboard_latency_last(uint32_t us[KBLAT_STAGE_COUNT]);
+
+/**
+ * Get the number of keystrokes whose trace was lost before the host read
+ * them, because too many were in flight.
+ */
+uint32_t keyboard_latency_lost(void);
+
+/**
+ * Clear the statistics.
+ */
+void keyboard_latency_reset(void);
+#else
+static inline void keyboard_latency_edge(uint32_t time) {}
+static inline int keyboard_latency_start(void) { return 0; }
+static inline void keyboard_latency_stamp(int trace, enum kblat_stage stage) {}
+static inline void keyboard_latency_stamp_at(int trace, enum kblat_stage stage,
+					     uint32_t time) {}
+static inline void keyboard_latency_drop(int trace) {}
+#endif
+
+#endif  /* __CROS_EC_KEYBOARD_LATENCY_H */
@@ -83,6 +83,39 @@ static inline uint32_t keyboard_scan_get_boot_keys(void)
  */
 const uint8_t *keyboard_scan_get_state(void);
 
+/* A debounced key edge */
+struct keyboard_scan_event {
+	/* Scan time the edge was first seen at, in us */
+	uint32_t time;
+	uint8_t col;
+	uint8_t row;
+	uint8_t pressed;
+};
+
+/**
+ * Return the position of the next key edge to be queued. A reader starting
+ * there sees every later edge.
+ */
+uint32_t keyboard_scan_event_head(void);
+
+/**
+ * Read the next debounced key edge. Each reader keeps its own position and
+ * sees the edges in the order they were debounced; a reader that falls more
+ * than a queue length behind skips the oldest ones.
+ *
+ * @param pos		Reader position, advanced past the edge read
+ * @param ev		Edge read
+ * @return 1 if an edge was read, 0 if the reader is up to date.
+ */
+int keyboard_scan_get_event(uint32_t *pos, struct keyboard_scan_event *ev);
+
+/**
+ * Board hook, called from the keyboard scan task with new key edges queued
+ * before they are reported to the keyboard protocol. Reads them with
+ * keyboard_scan_get_event().
+ */
+__override_proto void keyboard_board_scan_events(void);
+
 enum kb_scan_disable_masks {
 	/* Reasons why keyboard scanning should be disabled */
 	KB_SCAN_DISABLE_LID_CLOSED   = (1<<0),
@@ -105,6 +105,29 @@ int spi_transaction_flush(const struct spi_device_t *spi_device);
 /* Wait for async response received but do not de-assert chip select */
 int spi_transaction_wait(const struct spi_device_t *spi_device);
 
+/*
+ * Lock or unlock the SPI port of a device, as spi_transaction() does, to
+ * keep other tasks off the port across spi_transaction_async() and
+ * spi_transaction_flush().
+ */
+void spi_port_lock(const struct spi_device_t *spi_device, int lock);
+
+/* One transaction of spi_transaction_chain(), CS# is de-asserted after it */
+struct spi_xfer {
+	const uint8_t *txdata;
+	int txlen;
+	uint8_t *rxdata;
+	int rxlen;
+};
+
+/*
+ * Issue several transactions back to back, as many at a time as the
+ * controller can chain into one submission. The port is locked as for
+ * spi_transaction().
+ */
+int spi_transaction_chain(const struct spi_device_t *spi_device,
+			  const struct spi_xfer *xfer, int count);
+
 /*
  * Get SPI protocol information. This function is called in runtime if board's
  * host command transport is SPI.
@@ -22,6 +22,7 @@
 #define SPI_FLASH_ERASE_64KB		0xD8
 #define SPI_FLASH_ERASE_CHIP		0xC7
 #define SPI_FLASH_READ			0x03
+#define SPI_FLASH_READ_QUAD_OUT		0x6B
 #define SPI_FLASH_PAGE_PRGRM		0x02
 #define SPI_FLASH_REL_PWRDWN		0xAB
 #define SPI_FLASH_MFR_DEV_ID		0x90
@@ -95,17 +96,40 @@ int spi_flash_set_status(int reg1, int reg2);
  * @param offset Flash offset to start reading from
  * @param bytes Number of bytes to read. Limited by receive buffer to 256.
  *
- * @return EC_SUCCESS, or non-zero if any error.
+ * @return EC_SUCCESS, or non-zero if any error; EC_ERROR_BUSY in the hook
+ * task while spi_flash_erase_async() or spi_flash_write_async() runs.
  */
 int spi_flash_read(uint8_t *buf, unsigned int offset, unsigned int bytes);
 
+/**
+ * Start reading SPI flash in the background. The SPI port stays locked
+ * until spi_flash_read_finish(), which must be called next.
+ *
+ * @param buf Buffer to write flash contents, kept until the read finishes
+ * @param offset Flash offset to start reading from
+ * @param bytes Number of bytes to read
+ *
+ * @return EC_SUCCESS, or non-zero if the read did not start; EC_ERROR_BUSY
+ * as spi_flash_read().
+ */
+int spi_flash_read_start(uint8_t *buf, unsigned int offset,
+			 unsigned int bytes);
+
+/**
+ * Wait for the read started by spi_flash_read_start().
+ *
+ * @return EC_SUCCESS, or non-zero if any error.
+ */
+int spi_flash_read_finish(void);
+
 /**
  * Erase SPI flash.
  *
  * @param offset Flash offset to start erasing
  * @param bytes Number of bytes to erase
  *
- * @return EC_SUCCESS, or non-zero if any error.
+ * @return EC_SUCCESS, or non-zero if any error; EC_ERROR_BUSY in the hook
+ * task while spi_flash_erase_async() or spi_flash_write_async() runs.
  */
 int spi_flash_erase(unsigned int offset, unsigned int bytes);
 
@@ -117,11 +141,50 @@ int spi_flash_erase(unsigned int offset, unsigned int bytes);
  * @param bytes Number of bytes to write
  * @param data Data to write to flash
  *
- * @return EC_SUCCESS, or non-zero if any error.
+ * @return EC_SUCCESS, or non-zero if any error; EC_ERROR_BUSY in the hook
+ * task while spi_flash_erase_async() or spi_flash_write_async() runs.
  */
 int spi_flash_write(unsigned int offset, unsigned int bytes,
 	const uint8_t *data);
 
+/**
+ * Start erasing SPI flash and return. The erase goes on from the hook task.
+ * Until it is done, spi_flash_read(), spi_flash_read_start(),
+ * spi_flash_erase() and spi_flash_write() wait for it, for as long as it
+ * keeps making progress. The hook task cannot wait for itself, so called
+ * from there (e.g. from a deferred function) they fail with EC_ERROR_BUSY.
+ *
+ * @param offset Flash offset to start erasing
+ * @param bytes Number of bytes to erase
+ *
+ * @return EC_SUCCESS if the erase started, EC_ERROR_BUSY if another one
+ * is still running or one of the calls above is in progress, or non-zero on
+ * other errors.
+ */
+int spi_flash_erase_async(unsigned int offset, unsigned int bytes);
+
+/**
+ * Start writing to SPI flash and return, as spi_flash_erase_async().
+ * Assumes already erased.
+ *
+ * @param offset Flash offset to write
+ * @param bytes Number of bytes to write
+ * @param data Data to write to flash, kept until the write is done
+ *
+ * @return EC_SUCCESS if the write started, EC_ERROR_BUSY as
+ * spi_flash_erase_async(), or non-zero on other errors.
+ */
+int spi_flash_write_async(unsigned int offset, unsigned int bytes,
+			  const uint8_t *data);
+
+/**
+ * Get the result of the last spi_flash_erase_async() or
+ * spi_flash_write_async().
+ *
+ * @return EC_ERROR_BUSY while it runs, then EC_SUCCESS or its error.
+ */
+int spi_flash_async_result(void);
+
 /**
  * Gets the SPI flash JEDEC ID (manufacturer ID, memory type, and capacity)
  *
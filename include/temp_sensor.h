@@ -37,6 +37,17 @@ struct temp_sensor_t {
 	int (*read)(int idx, int *temp_ptr);
 	/* Index among the same kind of sensors. */
 	int idx;
+#ifdef CONFIG_TEMP_SENSOR_SCHEDULE
+	/*
+	 * Refresh the value returned by read(), e.g. start a bus transaction;
+	 * return non-zero if error. Optional.
+	 */
+	int (*update)(int idx);
+	/* Sampling period in ms, 0 for the default of one second. */
+	uint16_t period_ms;
+	/* Delay of the first sample after init in ms, to stagger sensors. */
+	uint16_t phase_ms;
+#endif
 };
 
 #ifdef CONFIG_TEMP_SENSOR
@@ -57,4 +68,27 @@ extern const struct temp_sensor_t temp_sensors[];
  */
 int temp_sensor_read(enum temp_sensor_id id, int *temp_ptr);
 
+#ifdef CONFIG_TEMP_SENSOR_SCHEDULE
+/**
+ * Get the temperature (in degrees K) from the latest scheduled sample of the
+ * sensor, without touching the sensor.
+ *
+ * @param id		Sensor ID
+ * @param temp_ptr	Destination for temperature
+ *
+ * @return EC_SUCCESS, EC_ERROR_TIMEOUT if the latest sample is older than
+ * TEMP_SENSOR_MAX_AGE_PERIODS sampling periods, or the sampling error.
+ */
+int temp_sensor_read_latest(enum temp_sensor_id id, int *temp_ptr);
+
+/* Sampling periods after which a scheduled sample is considered stale */
+#define TEMP_SENSOR_MAX_AGE_PERIODS 3
+#else
+static inline int temp_sensor_read_latest(enum temp_sensor_id id,
+					  int *temp_ptr)
+{
+	return temp_sensor_read(id, temp_ptr);
+}
+#endif
+
 #endif  /* __CROS_EC_TEMP_SENSOR_H */
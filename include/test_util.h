@@ -191,6 +191,9 @@ uint32_t prng(uint32_t seed);
 
 uint32_t prng_no_seed(void);
 
+/* Elapsed real time in ns, for benchmarks */
+uint64_t test_bench_ns(void);
+
 /* Number of failed tests */
 extern int __test_error_count;
 
@@ -65,11 +65,24 @@ void throttle_ap(enum throttle_level level,
  */
 void throttle_ap_prochot_input_interrupt(enum gpio_signal signal);
 
+/**
+ * Get the throttling currently requested.
+ *
+ * @param type          Type of throttling
+ * @return Bitmask of the sources requesting it, BIT(enum throttle_sources).
+ */
+uint32_t throttle_ap_get_request(enum throttle_type type);
+
 #else
 static inline void throttle_ap(enum throttle_level level,
 			       enum throttle_type type,
 			       enum throttle_sources source)
 {}
+
+static inline uint32_t throttle_ap_get_request(enum throttle_type type)
+{
+	return 0;
+}
 #endif
 
 #endif	/* __CROS_EC_THROTTLE_AP_H */
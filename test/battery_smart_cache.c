@@ -0,0 +1,129 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test the smart battery register cache used by battery_get_params().
+ */
+
+#include "battery.h"
+#include "battery_smart.h"
+#include "common.h"
+#include "console.h"
+#include "i2c.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+/* Test state */
+static int fail_on;
+static int read_count;
+struct batt_params batt;
+
+void battery_compensate_params(struct batt_params *batt)
+{
+}
+
+void board_battery_compensate_params(struct batt_params *batt)
+{
+}
+
+static void reset_and_fail_on(int n)
+{
+	memset(&batt, 0, sizeof(typeof(batt)));
+	read_count = 0;
+	fail_on = n;
+}
+
+/* Mocked functions */
+int sb_read(int cmd, int *param)
+{
+	read_count++;
+	if (read_count == fail_on)
+		return EC_ERROR_UNKNOWN;
+
+	return i2c_read16(I2C_PORT_BATTERY, BATTERY_ADDR_FLAGS,
+			  cmd, param);
+}
+int sb_write(int cmd, int param)
+{
+	return i2c_write16(I2C_PORT_BATTERY, BATTERY_ADDR_FLAGS,
+			   cmd, param);
+}
+
+/* Tests */
+static int test_cache_hits(void)
+{
+	sb_cache_invalidate();
+	reset_and_fail_on(0);
+	battery_get_params(&batt);
+	TEST_ASSERT(!(batt.flags & BATT_FLAG_BAD_ANY));
+	TEST_ASSERT(read_count > 0);
+
+	/* Every register is still inside its validity window */
+	reset_and_fail_on(0);
+	battery_get_params(&batt);
+	TEST_ASSERT(!(batt.flags & BATT_FLAG_BAD_ANY));
+	TEST_EQ(read_count, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_fast_fields_refresh(void)
+{
+	sb_cache_invalidate();
+	reset_and_fail_on(0);
+	battery_get_params(&batt);
+
+	/* Only voltage, current and status expire after one charger poll */
+	msleep(250);
+	reset_and_fail_on(0);
+	battery_get_params(&batt);
+	TEST_ASSERT(!(batt.flags & BATT_FLAG_BAD_ANY));
+	TEST_EQ(read_count, 3, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_invalidate(void)
+{
+	int num_reads;
+
+	sb_cache_invalidate();
+	reset_and_fail_on(0);
+	battery_get_params(&batt);
+	num_reads = read_count;
+
+	sb_cache_invalidate();
+	reset_and_fail_on(0);
+	battery_get_params(&batt);
+	TEST_EQ(read_count, num_reads, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_failure_not_cached(void)
+{
+	sb_cache_invalidate();
+
+	/* The first register read fails and must be retried next time */
+	reset_and_fail_on(1);
+	battery_get_params(&batt);
+	TEST_ASSERT(batt.flags & BATT_FLAG_BAD_TEMPERATURE);
+
+	reset_and_fail_on(0);
+	battery_get_params(&batt);
+	TEST_ASSERT(!(batt.flags & BATT_FLAG_BAD_ANY));
+	TEST_EQ(read_count, 1, "%d");
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	RUN_TEST(test_cache_hits);
+	RUN_TEST(test_fast_fields_refresh);
+	RUN_TEST(test_invalidate);
+	RUN_TEST(test_failure_not_cached);
+
+	test_print_result();
+}
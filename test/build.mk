@@ -15,6 +15,7 @@ test-list-host = accel_cal
 test-list-host += aes
 test-list-host += base32
 test-list-host += battery_get_params_smart
+test-list-host += battery_smart_cache
 test-list-host += bklight_lid
 test-list-host += bklight_passthru
 test-list-host += body_detection
@@ -30,12 +31,14 @@ test-list-host += crc32
 test-list-host += entropy
 test-list-host += extpwr_gpio
 test-list-host += fan
+test-list-host += fan_pid
 test-list-host += flash
 test-list-host += float
 test-list-host += fp
 test-list-host += fpsensor
 test-list-host += fpsensor_crypto
 test-list-host += fpsensor_state
+test-list-host += fwk_flash_storage
 test-list-host += gyro_cal
 test-list-host += hooks
 test-list-host += host_command
@@ -46,8 +49,9 @@ test-list-host += is_enabled
 test-list-host += is_enabled_error
 test-list-host += kasa
 test-list-host += kb_8042
+test-list-host += kb_layers
 test-list-host += kb_mkbp
-#test-list-host += kb_scan	# crbug.com/976974
+test-list-host += kb_scan
 test-list-host += lid_sw
 test-list-host += lightbar
 test-list-host += mag_cal
@@ -69,7 +73,10 @@ test-list-host += rtc
 test-list-host += sbs_charging_v2
 test-list-host += sha256
 test-list-host += sha256_unrolled
+test-list-host += sha256_full_unroll
+test-list-host += sha256bench
 test-list-host += shmalloc
+test-list-host += spi_flash_async
 test-list-host += static_if
 test-list-host += static_if_error
 test-list-host += system
@@ -123,6 +130,7 @@ accel_cal-y=accel_cal.o
 aes-y=aes.o
 base32-y=base32.o
 battery_get_params_smart-y=battery_get_params_smart.o
+battery_smart_cache-y=battery_smart_cache.o
 bklight_lid-y=bklight_lid.o
 bklight_passthru-y=bklight_passthru.o
 body_detection-y=body_detection.o body_detection_data_literals.o motion_common.o
@@ -138,12 +146,14 @@ crc32-y=crc32.o
 entropy-y=entropy.o
 extpwr_gpio-y=extpwr_gpio.o
 fan-y=fan.o
+fan_pid-y=fan_pid.o
 flash-y=flash.o
 flash_physical-y=flash_physical.o
 flash_write_protect-y=flash_write_protect.o
 fpsensor-y=fpsensor.o
 fpsensor_crypto-y=fpsensor_crypto.o
 fpsensor_state-y=fpsensor_state.o
+fwk_flash_storage-y=fwk_flash_storage.o ../baseboard/fwk/flash_storage.o
 gyro_cal-y=gyro_cal.o
 hooks-y=hooks.o
 host_command-y=host_command.o
@@ -152,6 +162,7 @@ inductive_charging-y=inductive_charging.o
 interrupt-y=interrupt.o
 is_enabled-y=is_enabled.o
 kb_8042-y=kb_8042.o
+kb_layers-y=kb_layers.o ../board/hx30/keyboard_customization.o
 kb_mkbp-y=kb_mkbp.o
 kb_scan-y=kb_scan.o
 lid_sw-y=lid_sw.o
@@ -182,7 +193,10 @@ sbs_charging-y=sbs_charging.o
 sbs_charging_v2-y=sbs_charging_v2.o
 sha256-y=sha256.o
 sha256_unrolled-y=sha256.o
+sha256_full_unroll-y=sha256.o
+sha256bench-y=sha256bench.o
 shmalloc-y=shmalloc.o
+spi_flash_async-y=spi_flash_async.o
 static_if-y=static_if.o
 stm32f_rtc-y=stm32f_rtc.o
 stress-y=stress.o
@@ -226,3 +240,21 @@ is_enabled_error-y=is_enabled_error.o.cmd
 
 host-static_if_error: TEST_SCRIPT=static_if_error.sh
 static_if_error-y=static_if_error.o.cmd
+
+# fwk_flash_storage builds the fwk baseboard flags log against a mock flash
+ifeq ($(PROJECT),fwk_flash_storage)
+includes-y+=baseboard/fwk
+dirs-y+=baseboard/fwk
+endif
+
+# kb_layers runs the hx30 key layers against the tables of its generator
+ifeq ($(PROJECT),kb_layers)
+includes-y+=board/hx30
+dirs-y+=board/hx30
+cmd_kb_layers = python3 $< > $@
+$(out)/RO/test/kb_layers.o \
+$(out)/RO/board/hx30/keyboard_customization.o: $(out)/keyboard_layers.h
+
+$(out)/keyboard_layers.h: board/hx30/gen_keyboard_layers.py
+	$(call quiet,kb_layers,GEN    )
+endif
@@ -9,6 +9,7 @@
 #include "charge_manager.h"
 #include "common.h"
 #include "ec_commands.h"
+#include "hooks.h"
 #include "test_util.h"
 #include "timer.h"
 #include "usb_pd.h"
@@ -787,6 +788,115 @@ static int test_unknown_dualrole_capability(void)
 	return EC_SUCCESS;
 }
 
+/*
+ * Simulate a PD attach the way a PD task reports it: Type-C current, then the
+ * PD contract, ceiling and dual-role capability, with a bus transaction in
+ * between each step.
+ */
+static void simulate_pd_attach(int port, int current, int batched)
+{
+	struct charge_port_info charge;
+
+	if (batched)
+		charge_manager_batch_begin();
+
+	charge.current = 1500;
+	charge.voltage = 5000;
+	charge_manager_update_charge(CHARGE_SUPPLIER_TEST4, port, &charge);
+	charge_manager_set_ceil(port, 0, 1500);
+	msleep(1);
+
+	charge.current = current;
+	charge.voltage = 20000;
+	charge_manager_update_charge(CHARGE_SUPPLIER_TEST2, port, &charge);
+	charge_manager_set_ceil(port, 0, current);
+	msleep(1);
+
+	charge_manager_update_dualrole(port, CAP_DEDICATED);
+
+	if (batched)
+		charge_manager_batch_end();
+	wait_for_charge_manager_refresh();
+}
+
+static int run_attach_benchmark(int batched, uint32_t *refreshes,
+				uint32_t *time_us)
+{
+	const int attaches = 20;
+	uint32_t count0, time0, count1, time1;
+	int i, port;
+
+	*refreshes = 0;
+	*time_us = 0;
+	for (i = 0; i < attaches; ++i) {
+		port = i % board_get_usb_pd_port_count();
+		initialize_charge_table(0, 5000, CHARGE_CEIL_NONE);
+		charge_manager_get_refresh_stats(&count0, &time0);
+		simulate_pd_attach(port, 1000 + i * 100, batched);
+		charge_manager_get_refresh_stats(&count1, &time1);
+		TEST_ASSERT(active_charge_port == port);
+		TEST_ASSERT(active_charge_limit == 1000 + i * 100);
+		*refreshes += count1 - count0;
+		*time_us += time1 - time0;
+	}
+
+	ccprintf("%s: %d.%02d refreshes, %d us per attach\n",
+		 batched ? "batched" : "unbatched",
+		 *refreshes / attaches, (*refreshes * 100 / attaches) % 100,
+		 *time_us / attaches);
+
+	return EC_SUCCESS;
+}
+
+static int test_batched_attach(void)
+{
+	uint32_t refreshes, time_us;
+	uint32_t batched_refreshes, batched_time_us;
+
+	TEST_ASSERT(run_attach_benchmark(0, &refreshes, &time_us) ==
+		    EC_SUCCESS);
+	TEST_ASSERT(run_attach_benchmark(1, &batched_refreshes,
+					 &batched_time_us) == EC_SUCCESS);
+
+	/* A batched attach results in exactly one refresh. */
+	TEST_ASSERT(batched_refreshes == 20);
+	TEST_ASSERT(batched_refreshes < refreshes);
+
+	return EC_SUCCESS;
+}
+
+static void set_ceil_from_hook(void)
+{
+	charge_manager_set_ceil(active_charge_port, 0, 500);
+}
+DECLARE_DEFERRED(set_ceil_from_hook);
+
+static int test_batch_other_task(void)
+{
+	int port;
+
+	initialize_charge_table(1000, 5000, 1000);
+	port = active_charge_port;
+	TEST_ASSERT(active_charge_limit == 1000);
+
+	/* A batch open in this task doesn't hold back the hook task */
+	charge_manager_batch_begin();
+	hook_call_deferred(&set_ceil_from_hook_data, 0);
+	wait_for_charge_manager_refresh();
+	TEST_ASSERT(port == active_charge_port);
+	TEST_ASSERT(active_charge_limit == 500);
+
+	/* Updates from this task are still held until the batch ends */
+	charge_manager_set_ceil(port, 0, 2000);
+	wait_for_charge_manager_refresh();
+	TEST_ASSERT(active_charge_limit == 500);
+	charge_manager_batch_end();
+	wait_for_charge_manager_refresh();
+	TEST_ASSERT(active_charge_limit == 1000);
+
+	return EC_SUCCESS;
+}
+
 void run_test(int argc, char **argv)
 {
 	test_reset();
@@ -800,6 +910,8 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_dual_role);
 	RUN_TEST(test_rejected_port);
 	RUN_TEST(test_unknown_dualrole_capability);
+	RUN_TEST(test_batched_attach);
+	RUN_TEST(test_batch_other_task);
 
 	test_print_result();
 }
@@ -9,7 +9,11 @@
 #include "console.h"
 #include "crc.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
+#include "watchdog.h"
+
+static uint8_t buf[64 * 1024];
 
 // test that static version matches context version
 static int test_static_version(void)
@@ -63,6 +67,85 @@ static int test_kat0(void)
 	return EC_SUCCESS;
 }
 
+/* CRC-32 one byte at a time, as the reference for the buffer paths */
+static uint32_t crc32_ref(const uint8_t *p, int len)
+{
+	uint32_t crc;
+
+	crc32_ctx_init(&crc);
+	while (len--)
+		crc32_ctx_hash8(&crc, *p++);
+
+	return crc32_ctx_result(&crc);
+}
+
+// buffer paths match the byte loop at any alignment and length
+static int test_buf(void)
+{
+	static const int lens[] = {0, 1, 7, 15, 16, 17, 63, 1023, 1024, 1027,
+				   4096};
+	uint32_t crc;
+	int i, ofs;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	for (ofs = 0; ofs < 4; ofs++) {
+		for (i = 0; i < ARRAY_SIZE(lens); i++) {
+			TEST_ASSERT(crc32_buf(buf + ofs, lens[i]) ==
+				    crc32_ref(buf + ofs, lens[i]));
+
+			/* Split in two calls */
+			crc32_ctx_init(&crc);
+			crc32_ctx_hash(&crc, buf + ofs, lens[i] / 3);
+			crc32_ctx_hash(&crc, buf + ofs + lens[i] / 3,
+				       lens[i] - lens[i] / 3);
+			TEST_ASSERT(crc32_ctx_result(&crc) ==
+				    crc32_ref(buf + ofs, lens[i]));
+		}
+	}
+
+	return EC_SUCCESS;
+}
+
+static int test_buf_kat(void)
+{
+	const char input[] = "The quick brown fox jumps over the lazy dog";
+
+	TEST_ASSERT(crc32_buf(input, strlen(input)) == 0x414fa339);
+
+	return EC_SUCCESS;
+}
+
+static void bench(const char *name, const void *p, int len, int runs)
+{
+	uint64_t t0;
+	uint32_t us;
+	int i;
+
+	t0 = test_bench_ns();
+	for (i = 0; i < runs; i++) {
+		crc32_buf(p, len);
+		watchdog_reload();
+	}
+	us = (test_bench_ns() - t0) / 1000;
+
+	ccprintf("crc32 %-5s %6d bytes x %3d: %7d us, %6d KB/s\n", name, len,
+		 runs, us, us ? (int)((uint64_t)len * runs * 1000000 / 1024 / us) :
+		 0);
+}
+
+// throughput of crc32_buf() for small, large and full image buffers
+static int test_bench(void)
+{
+	bench("4K", buf, 4 * 1024, 64);
+	bench("64K", buf, sizeof(buf), 4);
+	bench("image", (const void *)(CONFIG_PROGRAM_MEMORY_BASE +
+				      CONFIG_RW_MEM_OFF), CONFIG_RW_SIZE, 1);
+
+	return EC_SUCCESS;
+}
+
 void run_test(int argc, char **argv)
 {
 	test_reset();
@@ -70,6 +153,9 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_static_version);
 	RUN_TEST(test_8);
 	RUN_TEST(test_kat0);
+	RUN_TEST(test_buf);
+	RUN_TEST(test_buf_kat);
+	RUN_TEST(test_bench);
 
 	test_print_result();
 }
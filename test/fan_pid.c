@@ -0,0 +1,266 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test the closed-loop fan controller against a simulated fan and heatsink.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "fan_pid.h"
+#include "math_util.h"
+#include "test_util.h"
+#include "util.h"
+
+/* Simulation step and controller period, in ms */
+#define SIM_STEP_MS	100
+#define CTRL_PERIOD_MS	1000
+
+#define FAN_RPM_MAX	6000
+
+/* Fan band of the simulated sensor, in degrees C */
+#define TEMP_FAN_OFF	40.0
+#define TEMP_FAN_MAX	70.0
+#define TEMP_AMBIENT	25.0
+
+/* Heatsink: heat capacity in J/K, conductance in W/K with the fan off/max */
+#define HEAT_CAPACITY	30.0
+#define G_STILL		0.5
+#define G_FAN		2.0
+
+/* Time constant of the fan spinning up or down, in ms */
+#define FAN_TAU_MS	1500.0
+
+/*
+ * Settled within this many per-mille of the setpoint: one degree C, which is
+ * also the resolution of the sensor.
+ */
+#define SETTLE_BAND	33
+
+/*
+ * True steady-state fan speed at each 10% duty cycle step. Not linear, and
+ * the fan stalls below 8% duty cycle.
+ */
+static const int true_rpm[FAN_PID_MAP_SIZE] = {
+	0, 1300, 2100, 2800, 3400, 3950, 4450, 4900, 5300, 5650, 6000,
+};
+
+struct sim {
+	double temp;
+	double rpm;
+	int duty;
+};
+
+struct step_result {
+	/* Per-mille above the setpoint */
+	int overshoot;
+	/* ms from the load step until within SETTLE_BAND for good */
+	int settle_ms;
+	/* Normalized temperature at the end */
+	int final;
+};
+
+static double true_duty_to_rpm(int duty)
+{
+	int k, w;
+
+	if (duty < 8)
+		return 0;
+	if (duty >= 100)
+		return true_rpm[FAN_PID_MAP_SIZE - 1];
+
+	k = duty / FAN_PID_MAP_STEP;
+	w = duty % FAN_PID_MAP_STEP;
+	return true_rpm[k] +
+	       (double)(true_rpm[k + 1] - true_rpm[k]) * w / FAN_PID_MAP_STEP;
+}
+
+static int sim_norm(const struct sim *s)
+{
+	/* Sensors report whole degrees */
+	return ((int)(s->temp + 0.5) - (int)TEMP_FAN_OFF) * 1000 /
+	       (int)(TEMP_FAN_MAX - TEMP_FAN_OFF);
+}
+
+static void sim_step(struct sim *s, double power)
+{
+	double g = G_STILL + G_FAN * s->rpm / FAN_RPM_MAX;
+	double dt = SIM_STEP_MS / 1000.0;
+
+	s->rpm += (true_duty_to_rpm(s->duty) - s->rpm) * SIM_STEP_MS /
+		  FAN_TAU_MS;
+	s->temp += (power - g * (s->temp - TEMP_AMBIENT)) * dt / HEAT_CAPACITY;
+}
+
+/*
+ * Duty cycle of the open-loop ramp the default thermal control uses: fan
+ * speed linear in temperature, duty cycle linear in fan speed.
+ */
+static int ramp_duty(int norm)
+{
+	int pct = CLAMP(norm / 10, 0, 100);
+	int rpm = pct ? 1300 + (FAN_RPM_MAX - 1300) * pct / 100 : 0;
+
+	return DIV_ROUND_UP(rpm * 100, FAN_RPM_MAX);
+}
+
+/*
+ * Run the plant for duration_ms at a given power, with either the PID
+ * controller or the open-loop ramp, and measure how the temperature settles
+ * around the setpoint.
+ */
+static void run(struct sim *s, struct fan_pid *pid, double power,
+		int duration_ms, struct step_result *r)
+{
+	int setpoint = fan_pid_tunables.setpoint;
+	int t, norm;
+
+	r->overshoot = 0;
+	r->settle_ms = 0;
+
+	for (t = 0; t < duration_ms; t += SIM_STEP_MS) {
+		if (t % CTRL_PERIOD_MS == 0) {
+			norm = sim_norm(s);
+			if (pid)
+				s->duty = fan_pid_update(pid, norm, (int)s->rpm,
+							 CTRL_PERIOD_MS);
+			else
+				s->duty = ramp_duty(norm);
+		}
+		sim_step(s, power);
+
+		norm = sim_norm(s);
+		r->overshoot = MAX(r->overshoot, norm - setpoint);
+		if (ABS(norm - setpoint) > SETTLE_BAND)
+			r->settle_ms = t + SIM_STEP_MS;
+	}
+	r->final = sim_norm(s);
+}
+
+static void sim_idle(struct sim *s)
+{
+	s->temp = TEMP_AMBIENT;
+	s->rpm = 0;
+	s->duty = 0;
+}
+
+test_static int test_map_lookup(void)
+{
+	struct fan_pid pid;
+
+	fan_pid_reset(&pid, FAN_RPM_MAX);
+
+	TEST_EQ(fan_pid_rpm_to_duty(&pid, 0), 0, "%d");
+	TEST_EQ(fan_pid_rpm_to_duty(&pid, 600), 10, "%d");
+	TEST_EQ(fan_pid_rpm_to_duty(&pid, 3000), 50, "%d");
+	TEST_EQ(fan_pid_rpm_to_duty(&pid, 3001), 51, "%d");
+	TEST_EQ(fan_pid_rpm_to_duty(&pid, FAN_RPM_MAX), 100, "%d");
+	TEST_EQ(fan_pid_rpm_to_duty(&pid, FAN_RPM_MAX + 1), 100, "%d");
+
+	TEST_EQ(fan_pid_normalize(313, 313, 343), 0, "%d");
+	TEST_EQ(fan_pid_normalize(328, 313, 343), 500, "%d");
+	TEST_EQ(fan_pid_normalize(343, 343, 343), 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+test_static int test_idle_fan_off(void)
+{
+	struct fan_pid pid;
+	struct sim s;
+	struct step_result r;
+
+	fan_pid_reset(&pid, FAN_RPM_MAX);
+	sim_idle(&s);
+
+	/* 6 W settles below the fan band with the fan off */
+	run(&s, &pid, 6.0, 300 * 1000, &r);
+	TEST_EQ(s.duty, 0, "%d");
+	TEST_LT(r.final, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+test_static int test_load_step(void)
+{
+	struct fan_pid pid;
+	struct sim s;
+	struct step_result pid_r, ramp_r;
+	int i;
+
+	/* Open-loop ramp, for comparison */
+	sim_idle(&s);
+	run(&s, NULL, 6.0, 300 * 1000, &ramp_r);
+	run(&s, NULL, 40.0, 600 * 1000, &ramp_r);
+
+	fan_pid_reset(&pid, FAN_RPM_MAX);
+	sim_idle(&s);
+	run(&s, &pid, 6.0, 300 * 1000, &pid_r);
+	run(&s, &pid, 40.0, 600 * 1000, &pid_r);
+
+	ccprintf("6 -> 40 W step: pid settles in %d ms, overshoot %d, "
+		 "final %d; ramp final %d (setpoint %d)\n",
+		 pid_r.settle_ms, pid_r.overshoot, pid_r.final, ramp_r.final,
+		 fan_pid_tunables.setpoint);
+	ccprintf("map:");
+	for (i = 0; i < FAN_PID_MAP_SIZE; i++)
+		ccprintf(" %d", pid.rpm_map[i]);
+	ccprintf("\n");
+
+	/* Regulated to the setpoint, where the ramp leaves an offset */
+	TEST_LE(ABS(pid_r.final - fan_pid_tunables.setpoint), SETTLE_BAND,
+		"%d");
+	TEST_LT(pid_r.settle_ms, 60 * 1000, "%d");
+	TEST_LE(pid_r.overshoot, 2 * SETTLE_BAND, "%d");
+	TEST_GT(ABS(ramp_r.final - fan_pid_tunables.setpoint), SETTLE_BAND,
+		"%d");
+
+	/* Back down, the fan is allowed to stop again */
+	run(&s, &pid, 6.0, 600 * 1000, &pid_r);
+	TEST_EQ(s.duty, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+test_static int test_map_learns(void)
+{
+	struct fan_pid pid;
+	struct sim s;
+	struct step_result r;
+	int duty, err_before, err_after;
+
+	fan_pid_reset(&pid, FAN_RPM_MAX);
+	sim_idle(&s);
+	run(&s, &pid, 40.0, 600 * 1000, &r);
+
+	/* The settled duty cycle is now predicted from the real fan curve */
+	duty = s.duty;
+	TEST_GE(duty, fan_pid_tunables.duty_min, "%d");
+	err_after = ABS((int)true_duty_to_rpm(duty) -
+			(pid.rpm_map[duty / 10] +
+			 (pid.rpm_map[duty / 10 + 1] - pid.rpm_map[duty / 10]) *
+			 (duty % 10) / 10));
+	err_before = ABS((int)true_duty_to_rpm(duty) -
+			 FAN_RPM_MAX * duty / 100);
+	ccprintf("map error at %d%%: %d rpm, was %d rpm\n", duty, err_after,
+		 err_before);
+	TEST_LT(err_after, 100, "%d");
+	TEST_LT(err_after, err_before, "%d");
+
+	/* And the map stays monotonic */
+	for (duty = 1; duty < FAN_PID_MAP_SIZE; duty++)
+		TEST_GE(pid.rpm_map[duty], pid.rpm_map[duty - 1], "%d");
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+
+	RUN_TEST(test_map_lookup);
+	RUN_TEST(test_idle_fan_off);
+	RUN_TEST(test_load_step);
+	RUN_TEST(test_map_learns);
+
+	test_print_result();
+}
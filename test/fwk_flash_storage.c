@@ -0,0 +1,250 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests the fwk flash flags log against a mock of NOR flash: erase sets a
+ * sector to 0xFF, programming only clears bits, a write is at most 256 bytes
+ * (split at page boundaries, as the driver does) and can be cut short to
+ * model a power loss.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "flash_storage.h"
+#include "spi_flash.h"
+#include "test_util.h"
+#include "util.h"
+
+#define PAGE_SIZE 256
+
+/* The flags region, the only part of the flash the log may touch */
+static uint8_t nor[SPI_FLAGS_REGION_SIZE];
+static int erases[SPI_FLAGS_SECTORS];
+static int bad_access;
+
+/* Bytes left before a page program fails part way, or -1 */
+static int fail_after = -1;
+
+/* Flags as last known to be in flash, and as updated since */
+static uint8_t committed[FLASH_FLAGS_MAX];
+static uint8_t updated[FLASH_FLAGS_MAX];
+
+/* The low bits of prng_no_seed() repeat with a short period */
+static uint32_t rnd(void)
+{
+	return prng_no_seed() >> 16;
+}
+
+void spi_mux_control(int enable)
+{
+}
+
+static int in_region(unsigned int offset, unsigned int bytes)
+{
+	if (offset < SPI_FLAGS_REGION ||
+	    offset + bytes > SPI_FLAGS_REGION + SPI_FLAGS_REGION_SIZE) {
+		bad_access = 1;
+		return 0;
+	}
+	return 1;
+}
+
+int spi_flash_read(uint8_t *buf, unsigned int offset, unsigned int bytes)
+{
+	if (!in_region(offset, bytes))
+		return EC_ERROR_INVAL;
+
+	memcpy(buf, nor + offset - SPI_FLAGS_REGION, bytes);
+	return EC_SUCCESS;
+}
+
+int spi_flash_erase(unsigned int offset, unsigned int bytes)
+{
+	if (!in_region(offset, bytes) || offset % SPI_FLAGS_SECTOR_SIZE ||
+	    bytes % SPI_FLAGS_SECTOR_SIZE) {
+		bad_access = 1;
+		return EC_ERROR_INVAL;
+	}
+
+	memset(nor + offset - SPI_FLAGS_REGION, 0xff, bytes);
+	erases[(offset - SPI_FLAGS_REGION) / SPI_FLAGS_SECTOR_SIZE]++;
+	return EC_SUCCESS;
+}
+
+int spi_flash_write(unsigned int offset, unsigned int bytes,
+		    const uint8_t *data)
+{
+	int i;
+
+	if (!in_region(offset, bytes) || bytes > PAGE_SIZE) {
+		bad_access = 1;
+		return EC_ERROR_INVAL;
+	}
+
+	for (i = 0; i < bytes; i++) {
+		if (fail_after == 0)
+			return EC_ERROR_UNKNOWN;
+		if (fail_after > 0)
+			fail_after--;
+		nor[offset - SPI_FLAGS_REGION + i] &= data[i];
+	}
+	return EC_SUCCESS;
+}
+
+static void reset_flash(void)
+{
+	memset(nor, 0xff, sizeof(nor));
+	memset(erases, 0, sizeof(erases));
+	memset(committed, 0, sizeof(committed));
+	memset(updated, 0, sizeof(updated));
+	bad_access = 0;
+	fail_after = -1;
+}
+
+/* Load the flags from flash, as on boot, and check them */
+static int reload_and_check(const uint8_t *expect)
+{
+	int i;
+
+	TEST_ASSERT(flash_storage_initialize() == EC_SUCCESS);
+	for (i = 0; i < FLASH_FLAGS_MAX; i++)
+		TEST_ASSERT(flash_storage_get(i) == expect[i]);
+
+	return EC_SUCCESS;
+}
+
+static int test_blank(void)
+{
+	reset_flash();
+	TEST_ASSERT(reload_and_check(committed) == EC_SUCCESS);
+
+	/* Nothing changed, nothing written */
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	TEST_EQ(erases[0], 0, "%d");
+	TEST_EQ(bad_access, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_import_legacy(void)
+{
+	struct ec_flash_flags_info old = {
+		.magic = FLASH_FLAGS_MAGIC,
+		.length = sizeof(old) - 8,
+		.version = FLASH_FLAGS_VERSION,
+		.update_number = 7,
+	};
+
+	reset_flash();
+	old.flags[FLASH_FLAGS_ACPOWERON] = 1;
+	old.flags[FLASH_FLAGS_STANDALONE] = 1;
+	memcpy(nor, &old, sizeof(old));
+	memcpy(committed, old.flags, sizeof(committed));
+
+	TEST_ASSERT(reload_and_check(committed) == EC_SUCCESS);
+
+	/* The first commit starts the log past the old structure */
+	TEST_EQ(flash_storage_update(2, 0x5a), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	committed[2] = 0x5a;
+	TEST_EQ(erases[0], 0, "%d");
+	TEST_EQ(erases[1], 1, "%d");
+	TEST_ASSERT(reload_and_check(committed) == EC_SUCCESS);
+	TEST_EQ(bad_access, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_updates(void)
+{
+	int i, idx, min, max;
+
+	reset_flash();
+	TEST_ASSERT(reload_and_check(committed) == EC_SUCCESS);
+
+	for (i = 0; i < 5000; i++) {
+		idx = rnd() % FLASH_FLAGS_MAX;
+		updated[idx] = rnd();
+		TEST_ASSERT(flash_storage_update(idx, updated[idx]) ==
+			    EC_SUCCESS);
+		TEST_ASSERT(flash_storage_commit() == EC_SUCCESS);
+		memcpy(committed, updated, sizeof(committed));
+		if (rnd() % 4 == 0)
+			TEST_ASSERT(reload_and_check(committed) == EC_SUCCESS);
+	}
+	TEST_ASSERT(reload_and_check(committed) == EC_SUCCESS);
+	TEST_EQ(bad_access, 0, "%d");
+
+	/* Erases go round the ring */
+	min = max = erases[0];
+	for (i = 1; i < SPI_FLAGS_SECTORS; i++) {
+		min = MIN(min, erases[i]);
+		max = MAX(max, erases[i]);
+	}
+	ccprintf("5000 commits, sector erases %d-%d\n", min, max);
+	TEST_ASSERT(min > 0);
+	TEST_ASSERT(max - min <= 1);
+
+	return EC_SUCCESS;
+}
+
+/*
+ * Cut page programs short at random, as a power loss would, and boot again.
+ * Every flag must come back either as committed before or as updated.
+ */
+static int test_torn_writes(void)
+{
+	int i, j, idx, n, rv, torn = 0;
+
+	reset_flash();
+	TEST_ASSERT(reload_and_check(committed) == EC_SUCCESS);
+
+	for (i = 0; i < 5000; i++) {
+		n = 1 + rnd() % 4;
+		for (j = 0; j < n; j++) {
+			idx = rnd() % FLASH_FLAGS_MAX;
+			updated[idx] = rnd();
+			flash_storage_update(idx, updated[idx]);
+		}
+
+		if (rnd() % 8 == 0)
+			fail_after = rnd() % (n * 4 + 16);
+		rv = flash_storage_commit();
+		fail_after = -1;
+
+		if (rv == EC_SUCCESS) {
+			memcpy(committed, updated, sizeof(committed));
+			continue;
+		}
+
+		torn++;
+		TEST_ASSERT(flash_storage_initialize() == EC_SUCCESS);
+		for (j = 0; j < FLASH_FLAGS_MAX; j++) {
+			rv = flash_storage_get(j);
+			TEST_ASSERT(rv == committed[j] || rv == updated[j]);
+			committed[j] = updated[j] = rv;
+		}
+	}
+	ccprintf("%d torn commits\n", torn);
+	TEST_ASSERT(torn > 0);
+
+	/* The log still takes commits after all that */
+	flash_storage_update(0, 0xa5);
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	committed[0] = 0xa5;
+	TEST_ASSERT(reload_and_check(committed) == EC_SUCCESS);
+	TEST_EQ(bad_access, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	RUN_TEST(test_blank);
+	RUN_TEST(test_import_legacy);
+	RUN_TEST(test_updates);
+	RUN_TEST(test_torn_writes);
+
+	test_print_result();
+}
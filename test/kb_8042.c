@@ -11,6 +11,7 @@
 #include "gpio.h"
 #include "i8042_protocol.h"
 #include "keyboard_8042.h"
+#include "keyboard_latency.h"
 #include "keyboard_protocol.h"
 #include "keyboard_scan.h"
 #include "lpc.h"
@@ -22,10 +23,14 @@
 
 static const char *action[2] = {"release", "press"};
 
-#define BUF_SIZE 16
+#define BUF_SIZE 32
 static char lpc_char_buf[BUF_SIZE];
 static unsigned int lpc_char_cnt;
 
+/* Host that leaves bytes in the output buffer until told to read them */
+static int slow_host;
+static int obf_full;
+
 /*****************************************************************************/
 /* Mock functions */
 
@@ -34,9 +39,15 @@ int lid_is_open(void)
 	return 1;
 }
 
+int lpc_keyboard_has_char(void)
+{
+	return obf_full;
+}
+
 void lpc_keyboard_put_char(uint8_t chr, int send_irq)
 {
 	lpc_char_buf[lpc_char_cnt++] = chr;
+	obf_full = slow_host;
 }
 
 /*****************************************************************************/
@@ -195,6 +206,50 @@ static int test_scancode_set2(void)
 	return EC_SUCCESS;
 }
 
+static int test_host_read_drain(void)
+{
+	static const char burst[] =
+		"\x01\x81\x01\x81\x01\x81\x01\x81\x01\x81\x01\x81"
+		"\xe0\x4d\xe0\xcd\xe0\x4d\xe0\xcd\xe0\x4d\xe0\xcd";
+	const int len = sizeof(burst) - 1;
+	int i;
+
+	enable_keystroke(1);
+
+	/* More than the default queue holds, while the host is busy */
+	lpc_char_cnt = 0;
+	slow_host = 1;
+	for (i = 0; i < 6; i++) {
+		press_key(1, 1, 1);
+		press_key(1, 1, 0);
+	}
+	for (i = 0; i < 3; i++) {
+		press_key(12, 6, 1);
+		press_key(12, 6, 0);
+	}
+	msleep(30);
+	TEST_EQ(lpc_char_cnt, 1, "%d");
+
+	/* Each host read refills the output buffer without the task */
+	for (i = 1; i < len; i++) {
+		obf_full = 0;
+		keyboard_host_read_done();
+		TEST_EQ(lpc_char_cnt, i + 1, "%d");
+	}
+	slow_host = 0;
+	obf_full = 0;
+	keyboard_host_read_done();
+	msleep(30);
+
+	TEST_EQ(lpc_char_cnt, len, "%d");
+	TEST_ASSERT_ARRAY_EQ(burst, lpc_char_buf, len);
+
+	/* More keystrokes were in flight than can be traced */
+	keyboard_latency_reset();
+
+	return EC_SUCCESS;
+}
+
 static int test_power_button(void)
 {
 	gpio_set_level(GPIO_POWER_BUTTON_L, 1);
@@ -227,6 +282,90 @@ static int test_power_button(void)
 	return EC_SUCCESS;
 }
 
+/*
+ * Benchmark: type through the keyboard scanner with simulated keys, one
+ * edge at a time, and report latency percentiles per trace point.
+ */
+#define LATENCY_EVENTS 40
+
+static const uint8_t latency_keys[][2] = {
+	/* col, row */
+	{1, 1}, {2, 4}, {3, 2}, {6, 0}, {8, 3},
+};
+
+static void sort_u32(uint32_t *v, int n)
+{
+	int i, j;
+	uint32_t t;
+
+	for (i = 1; i < n; i++) {
+		t = v[i];
+		for (j = i; j > 0 && v[j - 1] > t; j--)
+			v[j] = v[j - 1];
+		v[j] = t;
+	}
+}
+
+static int test_keypress_latency(void)
+{
+	static const char * const names[KBLAT_STAGE_COUNT] = {
+		"report", "scancode", "queued", "sent", "read",
+	};
+	static uint32_t samples[KBLAT_STAGE_COUNT][LATENCY_EVENTS];
+	struct ec_params_mkbp_simulate_key p;
+	uint32_t us[KBLAT_STAGE_COUNT];
+	uint32_t done;
+	int i, j, k;
+
+	enable_keystroke(1);
+	keyboard_latency_reset();
+
+	for (i = 0; i < LATENCY_EVENTS; i++) {
+		k = (i / 2) % ARRAY_SIZE(latency_keys);
+		p.col = latency_keys[k][0];
+		p.row = latency_keys[k][1];
+		p.pressed = !(i & 1);
+
+		done = keyboard_latency_last(us);
+		lpc_char_cnt = 0;
+		TEST_ASSERT(test_send_host_command(EC_CMD_MKBP_SIMULATE_KEY, 0,
+						   &p, sizeof(p), NULL, 0) ==
+			    EC_RES_SUCCESS);
+		for (j = 0; j < 100; j++) {
+			if (keyboard_latency_last(us) != done)
+				break;
+			msleep(1);
+		}
+		TEST_ASSERT(keyboard_latency_last(us) == done + 1);
+		TEST_ASSERT(lpc_char_cnt > 0);
+
+		for (j = 0; j < KBLAT_STAGE_COUNT; j++) {
+			/* Trace points are reached in order */
+			if (j)
+				TEST_ASSERT(us[j] >= us[j - 1]);
+			samples[j][i] = us[j];
+		}
+
+		/* Let the key debounce before the next edge */
+		msleep(35);
+	}
+	TEST_EQ(keyboard_latency_lost(), 0, "%d");
+
+	ccprintf("keypress latency over %d edges, us from matrix edge:\n",
+		 LATENCY_EVENTS);
+	ccprintf("stage      p50   p90   p99   max\n");
+	for (j = 0; j < KBLAT_STAGE_COUNT; j++) {
+		sort_u32(samples[j], LATENCY_EVENTS);
+		ccprintf("%-8s %5d %5d %5d %5d\n", names[j],
+			 samples[j][LATENCY_EVENTS / 2],
+			 samples[j][LATENCY_EVENTS * 9 / 10],
+			 samples[j][LATENCY_EVENTS * 99 / 100],
+			 samples[j][LATENCY_EVENTS - 1]);
+	}
+
+	return EC_SUCCESS;
+}
+
 static int test_sysjump(void)
 {
 	set_scancode(2);
@@ -332,10 +471,12 @@ void run_test(int argc, char **argv)
 		RUN_TEST(test_single_key_press);
 		RUN_TEST(test_disable_keystroke);
 		RUN_TEST(test_typematic);
+		RUN_TEST(test_host_read_drain);
 		RUN_TEST(test_scancode_set2);
 		RUN_TEST(test_power_button);
 		RUN_TEST(test_ec_cmd_get_keybd_config);
 		RUN_TEST(test_vivaldi_top_keys);
+		RUN_TEST(test_keypress_latency);
 		RUN_TEST(test_sysjump);
 	} else {
 		RUN_TEST(test_sysjump_cont);
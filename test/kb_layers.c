@@ -0,0 +1,685 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Runs the hx30 key layers of board/hx30/keyboard_customization.c and checks
+ * every key against the scancode table and Fn switch statements they
+ * replaced, then times both.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "host_command.h"
+#include "host_command_customization.h"
+#include "i2c_hid_mediakeys.h"
+#include "keyboard_8042.h"
+#include "keyboard_8042_sharedlib.h"
+#include "keyboard_config.h"
+#include "keyboard_customization.h"
+#include "keyboard_scan.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+#include "keyboard_layers.h"
+
+/* Key events timed per path and code set */
+#define BENCH_EVENTS 1000000
+
+/* Keys of the hx30 matrix, as row, col */
+#define FN_ROW 2
+#define FN_COL 2
+#define ESC_ROW 7
+#define ESC_COL 5
+#define F1_ROW 3
+#define F1_COL 5
+#define F7_ROW 2
+#define F7_COL 10
+#define DOWN_ROW 1
+#define DOWN_COL 8
+#define SPACE_ROW 1
+#define SPACE_COL 4
+
+/* Host OS state, for pos_get_state() */
+static int pos_state = 1;
+
+int pos_get_state(void)
+{
+	return pos_state;
+}
+
+/* Last update_hid_key() call, as key << 1 | pressed, or -1 */
+static int hid_last = -1;
+
+int update_hid_key(enum media_key key, bool pressed)
+{
+	hid_last = key << 1 | pressed;
+	return EC_SUCCESS;
+}
+
+uint8_t keyboard_cols = KEYBOARD_COLS_MAX;
+
+/* Key edges for the board's Fn layer, as the keyboard scan queues them */
+static struct keyboard_scan_event events[8];
+static uint32_t events_head;
+
+uint32_t keyboard_scan_event_head(void)
+{
+	return events_head;
+}
+
+int keyboard_scan_get_event(uint32_t *pos, struct keyboard_scan_event *ev)
+{
+	if (*pos == events_head)
+		return 0;
+
+	*ev = events[*pos % ARRAY_SIZE(events)];
+	(*pos)++;
+	return 1;
+}
+
+/* A key edge through the Fn layer and then the 8042 path */
+static int new_key(int row, int col, int pressed, int set1,
+		   uint8_t *scan_code, int32_t *len)
+{
+	struct keyboard_scan_event *ev =
+		&events[events_head % ARRAY_SIZE(events)];
+
+	ev->time = get_time().le.lo;
+	ev->col = col;
+	ev->row = row;
+	ev->pressed = pressed;
+	events_head++;
+	keyboard_board_scan_events();
+
+	return keyboard_board_scancode(row, col, pressed, set1, scan_code,
+				       len);
+}
+
+/*
+ * The set 2 matrix and Fn switch statements the layers replaced. Break,
+ * pause, Win+P and the backlight only check that the key is not passed on.
+ */
+static uint16_t old_set2[KEYBOARD_COLS_MAX][KEYBOARD_ROWS] = {
+	{0x0021, 0x007B, 0x0079, 0x0072, 0x007A, 0x0071, 0x0069, 0xe04A},
+	{0xe071, 0xe070, 0x007D, 0xe01f, 0x006c, 0xe06c, 0xe07d, 0x0077},
+	{0x0015, 0x0070, 0x00ff, 0x000D, 0x000E, 0x0016, 0x0067, 0x001c},
+	{0xe011, 0x0011, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000},
+	{0xe05a, 0x0029, 0x0024, 0x000c, 0x0058, 0x0026, 0x0004, 0xe07a},
+	{0x0022, 0x001a, 0x0006, 0x0005, 0x001b, 0x001e, 0x001d, 0x0076},
+	{0x002A, 0x0032, 0x0034, 0x002c, 0x002e, 0x0025, 0x002d, 0x002b},
+	{0x003a, 0x0031, 0x0033, 0x0035, 0x0036, 0x003d, 0x003c, 0x003b},
+	{0x0049, 0xe072, 0x005d, 0x0044, 0x0009, 0x0046, 0x0078, 0x004b},
+	{0x0059, 0x0012, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000},
+	{0x0041, 0x007c, 0x0083, 0x000b, 0x0003, 0x003e, 0x0043, 0x0042},
+	{0x0013, 0x0064, 0x0075, 0x0001, 0x0051, 0x0061, 0xe06b, 0xe02f},
+	{0xe014, 0x0014, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000},
+	{0x004a, 0xe075, 0x004e, 0x0007, 0x0045, 0x004d, 0x0054, 0x004c},
+	{0x0052, 0x005a, 0xe03c, 0xe069, 0x0055, 0x0066, 0x005b, 0x0023},
+	{0x006a, 0x000a, 0xe074, 0xe054, 0x0000, 0x006b, 0x0073, 0x0074},
+};
+
+#define OLD_FN_PRESSED BIT(0)
+#define OLD_FN_LOCKED BIT(1)
+static uint8_t old_fn;
+static uint32_t old_table_media;
+static uint32_t old_table;
+static int old_factory;
+
+static int old_table_media_set(int8_t pressed, uint32_t fn_bit)
+{
+	if (pressed) {
+		old_table_media |= fn_bit;
+		return true;
+	} else if (!pressed && (old_table_media & fn_bit)) {
+		old_table_media &= ~fn_bit;
+		return true;
+	}
+
+	return false;
+}
+
+static int old_table_set(int8_t pressed, uint32_t fn_bit)
+{
+	if (pressed && (old_fn & OLD_FN_PRESSED)) {
+		old_table |= fn_bit;
+		return true;
+	} else if (!pressed && (old_table & fn_bit)) {
+		old_table &= ~fn_bit;
+		return true;
+	}
+
+	return false;
+}
+
+static int old_hotkey_f1_f12(uint16_t *key_code, int8_t pressed)
+{
+	if (!(old_fn & OLD_FN_LOCKED) && (old_fn & OLD_FN_PRESSED))
+		return EC_SUCCESS;
+	else if (old_fn & OLD_FN_LOCKED && !(old_fn & OLD_FN_PRESSED) &&
+		 !old_table_media)
+		return EC_SUCCESS;
+	else if (!old_table_media && !pressed)
+		return EC_SUCCESS;
+
+	switch (*key_code) {
+	case SCANCODE_F1:
+		if (old_table_media_set(pressed, BIT(0)))
+			*key_code = SCANCODE_VOLUME_MUTE;
+		break;
+	case SCANCODE_F2:
+		if (old_table_media_set(pressed, BIT(1)))
+			*key_code = SCANCODE_VOLUME_DOWN;
+		break;
+	case SCANCODE_F3:
+		if (old_table_media_set(pressed, BIT(2)))
+			*key_code = SCANCODE_VOLUME_UP;
+		break;
+	case SCANCODE_F4:
+		if (old_table_media_set(pressed, BIT(3)))
+			*key_code = SCANCODE_PREV_TRACK;
+		break;
+	case SCANCODE_F5:
+		if (old_table_media_set(pressed, BIT(4)))
+			*key_code = 0xe034;
+		break;
+	case SCANCODE_F6:
+		if (old_table_media_set(pressed, BIT(5)))
+			*key_code = SCANCODE_NEXT_TRACK;
+		break;
+	case SCANCODE_F7:
+		if (old_table_media_set(pressed, BIT(6))) {
+			update_hid_key(HID_KEY_DISPLAY_BRIGHTNESS_DN, pressed);
+			return EC_ERROR_UNIMPLEMENTED;
+		}
+		break;
+	case SCANCODE_F8:
+		if (old_table_media_set(pressed, BIT(7))) {
+			update_hid_key(HID_KEY_DISPLAY_BRIGHTNESS_UP, pressed);
+			return EC_ERROR_UNIMPLEMENTED;
+		}
+		break;
+	case SCANCODE_F9:
+		if (old_table_media_set(pressed, BIT(8)))
+			return EC_ERROR_UNIMPLEMENTED;
+		break;
+	case SCANCODE_F10:
+		if (old_table_media_set(pressed, BIT(9))) {
+			update_hid_key(HID_KEY_AIRPLANE_MODE, pressed);
+			return EC_ERROR_UNIMPLEMENTED;
+		}
+		break;
+	case SCANCODE_F11:
+		if (old_table_media_set(pressed, BIT(10)))
+			*key_code = 0xe07c;
+		break;
+	case SCANCODE_F12:
+		if (old_table_media_set(pressed, BIT(11)))
+			*key_code = 0xe050;
+		break;
+	}
+	return EC_SUCCESS;
+}
+
+static int old_hotkey_special_key(uint16_t *key_code, int8_t pressed)
+{
+	switch (*key_code) {
+	case SCANCODE_DELETE:
+		if (old_table_set(pressed, BIT(12)))
+			*key_code = 0xe070;
+		break;
+	case SCANCODE_K:
+		if (old_table_set(pressed, BIT(13)))
+			*key_code = SCANCODE_SCROLL_LOCK;
+		break;
+	case SCANCODE_LEFT:
+		if (old_table_set(pressed, BIT(14)))
+			*key_code = 0xe06c;
+		break;
+	case SCANCODE_RIGHT:
+		if (old_table_set(pressed, BIT(15)))
+			*key_code = 0xe069;
+		break;
+	case SCANCODE_UP:
+		if (old_table_set(pressed, BIT(16)))
+			*key_code = 0xe07d;
+		break;
+	case SCANCODE_DOWN:
+		if (old_table_set(pressed, BIT(17)))
+			*key_code = 0xe07a;
+		break;
+	}
+	return EC_SUCCESS;
+}
+
+static int old_functional_hotkey(uint16_t *key_code, int8_t pressed)
+{
+	switch (*key_code) {
+	case SCANCODE_ESC:
+		if (old_table_set(pressed, BIT(18))) {
+			if (pressed)
+				old_fn ^= OLD_FN_LOCKED;
+			return EC_ERROR_UNIMPLEMENTED;
+		}
+		break;
+	case SCANCODE_B:
+		if (old_table_set(pressed, BIT(19)))
+			return EC_ERROR_UNIMPLEMENTED;
+		break;
+	case SCANCODE_P:
+		if (old_table_set(pressed, BIT(20)))
+			return EC_ERROR_UNIMPLEMENTED;
+		break;
+	case SCANCODE_SPACE:
+		if (old_table_set(pressed, BIT(21)))
+			return EC_ERROR_UNIMPLEMENTED;
+		break;
+	}
+	return EC_SUCCESS;
+}
+
+static int old_scancode_callback(uint16_t *make_code, int8_t pressed)
+{
+	int r;
+
+	if (old_factory)
+		return EC_SUCCESS;
+
+	if (*make_code == SCANCODE_FN) {
+		if (pressed)
+			old_fn |= OLD_FN_PRESSED;
+		else
+			old_fn &= ~OLD_FN_PRESSED;
+		return EC_ERROR_UNIMPLEMENTED;
+	}
+
+	if (!pos_get_state())
+		return EC_SUCCESS;
+
+	r = old_hotkey_f1_f12(make_code, pressed);
+	if (r != EC_SUCCESS)
+		return r;
+
+	if (!(old_fn & OLD_FN_PRESSED) && !old_table)
+		return EC_SUCCESS;
+
+	r = old_hotkey_special_key(make_code, pressed);
+	if (r != EC_SUCCESS)
+		return r;
+
+	return old_functional_hotkey(make_code, pressed);
+}
+
+/* A key edge through the old matrix_callback() and scancode_bytes() */
+static int old_key(int row, int col, int pressed, int set1,
+		   uint8_t *scan_code, int32_t *len)
+{
+	uint16_t make_code = old_set2[col][row];
+	int r;
+
+	*len = 0;
+
+	r = old_scancode_callback(&make_code, pressed);
+	if (r != EC_SUCCESS)
+		return r;
+
+	if (!make_code)
+		return EC_ERROR_UNIMPLEMENTED;
+
+	if (make_code >= 0x0100) {
+		scan_code[(*len)++] = make_code >> 8;
+		make_code &= 0xff;
+	}
+
+	if (set1) {
+		make_code = scancode_translate_set2_to_1(make_code);
+		scan_code[(*len)++] = pressed ? make_code : (make_code | 0x80);
+	} else {
+		if (!pressed)
+			scan_code[(*len)++] = 0xf0;
+		scan_code[(*len)++] = make_code;
+	}
+
+	return EC_SUCCESS;
+}
+
+/* Send a key edge both ways and compare the bytes and HID reports */
+static int key(int row, int col, int pressed, int set1)
+{
+	uint8_t old_code[4], new_code[4];
+	int32_t old_len, new_len;
+	int old_rv, new_rv, old_hid;
+
+	hid_last = -1;
+	old_rv = old_key(row, col, pressed, set1, old_code, &old_len);
+	old_hid = hid_last;
+
+	hid_last = -1;
+	new_rv = new_key(row, col, pressed, set1, new_code, &new_len);
+
+	if (old_rv != new_rv || old_hid != hid_last ||
+	    (old_rv == EC_SUCCESS && (old_len != new_len ||
+	     memcmp(old_code, new_code, old_len)))) {
+		ccprintf("Key %d:%d %s set %d differs\n", row, col,
+			 pressed ? "down" : "up", set1 ? 1 : 2);
+		return EC_ERROR_UNKNOWN;
+	}
+
+	return EC_SUCCESS;
+}
+
+/* Press and release every key but Fn, in both code sets */
+static int every_key(void)
+{
+	int col, row, set1;
+
+	for (col = 0; col < KEYBOARD_COLS_MAX; col++) {
+		for (row = 0; row < KEYBOARD_ROWS; row++) {
+			if (row == FN_ROW && col == FN_COL)
+				continue;
+			for (set1 = 0; set1 < 2; set1++) {
+				TEST_ASSERT(key(row, col, 1, set1) ==
+					    EC_SUCCESS);
+				TEST_ASSERT(key(row, col, 0, set1) ==
+					    EC_SUCCESS);
+			}
+		}
+	}
+
+	return EC_SUCCESS;
+}
+
+static int fn(int pressed)
+{
+	return key(FN_ROW, FN_COL, pressed, 0);
+}
+
+/* Toggle Fn lock with Fn + Esc */
+static int fn_lock(void)
+{
+	TEST_ASSERT(fn(1) == EC_SUCCESS);
+	TEST_ASSERT(key(ESC_ROW, ESC_COL, 1, 0) ==
+		    EC_SUCCESS);
+	TEST_ASSERT(key(ESC_ROW, ESC_COL, 0, 0) ==
+		    EC_SUCCESS);
+	TEST_ASSERT(fn(0) == EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+/* Check the bytes made for a key edge */
+static int expect(int row, int col, int pressed, const uint8_t *code,
+		  int len)
+{
+	uint8_t scan_code[4];
+	int32_t n;
+
+	TEST_EQ(new_key(row, col, pressed, 0, scan_code, &n), EC_SUCCESS,
+		"%d");
+	TEST_EQ(n, len, "%d");
+	TEST_ASSERT_ARRAY_EQ(scan_code, code, len);
+
+	return EC_SUCCESS;
+}
+
+static int test_layer_codes(void)
+{
+	const struct kb_layer *l;
+	int layer, col, n;
+
+	for (layer = 0; layer < KB_LAYER_COUNT; layer++) {
+		l = &kb_layers[layer];
+		n = 0;
+		for (col = 0; col < KEYBOARD_COLS_MAX; col++) {
+			TEST_ASSERT(l->rank[col] == n);
+			n += __builtin_popcount(l->mask[col]);
+		}
+	}
+
+	return EC_SUCCESS;
+}
+
+/* F-row media keys and plain keys */
+static int test_media_layer(void)
+{
+	return every_key();
+}
+
+static int test_fn_layer(void)
+{
+	TEST_ASSERT(fn(1) == EC_SUCCESS);
+	TEST_ASSERT(every_key() == EC_SUCCESS);
+	TEST_ASSERT(fn(0) == EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+static int test_fn_locked(void)
+{
+	TEST_ASSERT(fn_lock() == EC_SUCCESS);
+
+	/* F-row keys */
+	TEST_ASSERT(every_key() == EC_SUCCESS);
+
+	/* Fn flips the media keys back on */
+	TEST_ASSERT(fn(1) == EC_SUCCESS);
+	TEST_ASSERT(every_key() == EC_SUCCESS);
+	TEST_ASSERT(fn(0) == EC_SUCCESS);
+
+	TEST_ASSERT(fn_lock() == EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+/* Every key is passed through until the host OS is up, but Fn */
+static int test_pre_os(void)
+{
+	pos_state = 0;
+	TEST_ASSERT(every_key() == EC_SUCCESS);
+	TEST_ASSERT(fn(1) == EC_SUCCESS);
+	TEST_ASSERT(every_key() == EC_SUCCESS);
+	TEST_ASSERT(fn(0) == EC_SUCCESS);
+	pos_state = 1;
+
+	return EC_SUCCESS;
+}
+
+/* A release goes through the layer of its press, whatever Fn did since */
+static int test_fn_latch(void)
+{
+	static const uint8_t mute_down[] = { 0xe0, 0x23 };
+	static const uint8_t mute_up[] = { 0xe0, 0xf0, 0x23 };
+	static const uint8_t page_down_down[] = { 0xe0, 0x7a };
+	static const uint8_t page_down_up[] = { 0xe0, 0xf0, 0x7a };
+	uint8_t scan_code[4];
+	int32_t len;
+
+	/* F1 is mute when pressed without Fn */
+	TEST_ASSERT(expect(F1_ROW, F1_COL, 1, mute_down, 2) == EC_SUCCESS);
+	TEST_EQ(new_key(FN_ROW, FN_COL, 1, 0, scan_code, &len),
+		EC_ERROR_UNIMPLEMENTED, "%d");
+	TEST_ASSERT(expect(F1_ROW, F1_COL, 0, mute_up, 3) == EC_SUCCESS);
+
+	/* Down is page down when pressed with Fn */
+	TEST_ASSERT(expect(DOWN_ROW, DOWN_COL, 1, page_down_down, 2) ==
+		    EC_SUCCESS);
+	TEST_EQ(new_key(FN_ROW, FN_COL, 0, 0, scan_code, &len),
+		EC_ERROR_UNIMPLEMENTED, "%d");
+	TEST_ASSERT(expect(DOWN_ROW, DOWN_COL, 0, page_down_up, 3) ==
+		    EC_SUCCESS);
+
+	/* F7 reports a brightness release */
+	hid_last = -1;
+	TEST_EQ(new_key(F7_ROW, F7_COL, 1, 0, scan_code, &len),
+		EC_ERROR_UNIMPLEMENTED, "%d");
+	TEST_EQ(hid_last, HID_KEY_DISPLAY_BRIGHTNESS_DN << 1 | 1, "%d");
+	TEST_EQ(new_key(FN_ROW, FN_COL, 1, 0, scan_code, &len),
+		EC_ERROR_UNIMPLEMENTED, "%d");
+	TEST_EQ(new_key(F7_ROW, F7_COL, 0, 0, scan_code, &len),
+		EC_ERROR_UNIMPLEMENTED, "%d");
+	TEST_EQ(hid_last, HID_KEY_DISPLAY_BRIGHTNESS_DN << 1, "%d");
+	TEST_EQ(new_key(FN_ROW, FN_COL, 0, 0, scan_code, &len),
+		EC_ERROR_UNIMPLEMENTED, "%d");
+
+	return EC_SUCCESS;
+}
+
+/* Keys changed by EC_CMD_UPDATE_KEYBOARD_MATRIX */
+static int test_patch(void)
+{
+	static const struct {
+		uint8_t row, col;
+		uint16_t code;
+	} patch[] = {
+		/* A into B */
+		{ 7, 2, SCANCODE_B },
+		/* F1 into Esc, out of the media layer */
+		{ F1_ROW, F1_COL, SCANCODE_ESC },
+		/* Space into Fn */
+		{ SPACE_ROW, SPACE_COL, SCANCODE_FN },
+		/* An empty position */
+		{ 4, 15, SCANCODE_LEFT_WIN },
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(patch); i++) {
+		set_scancode_set2(patch[i].row, patch[i].col, patch[i].code);
+		old_set2[patch[i].col][patch[i].row] = patch[i].code;
+		TEST_EQ(get_scancode_set2(patch[i].row, patch[i].col),
+			patch[i].code, "0x%04x");
+	}
+
+	TEST_ASSERT(every_key() == EC_SUCCESS);
+
+	/* The patched Space works as Fn */
+	TEST_ASSERT(key(SPACE_ROW, SPACE_COL, 1, 0) == EC_SUCCESS);
+	TEST_ASSERT(every_key() == EC_SUCCESS);
+	TEST_ASSERT(key(SPACE_ROW, SPACE_COL, 0, 0) == EC_SUCCESS);
+
+	/* Setting the built-in code back drops the patch */
+	for (i = 0; i < ARRAY_SIZE(patch); i++) {
+		set_scancode_set2(patch[i].row, patch[i].col,
+				  kb_layer_base[patch[i].col][patch[i].row]
+				  .prefix << 8 |
+				  kb_layer_base[patch[i].col][patch[i].row]
+				  .set2);
+		old_set2[patch[i].col][patch[i].row] =
+			get_scancode_set2(patch[i].row, patch[i].col);
+	}
+	TEST_EQ(get_scancode_set2(SPACE_ROW, SPACE_COL), SCANCODE_SPACE, "0x%04x");
+	TEST_ASSERT(every_key() == EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+/* Factory mode sends Fn to the host as a fake key, and every key as is */
+static int test_factory(void)
+{
+	static const uint8_t fake_fn_down[] = { 0xe0, 0x16 };
+
+	factory_setting(1);
+	old_factory = 1;
+	old_set2[FN_COL][FN_ROW] = SCANCODE_FAKE_FN;
+
+	TEST_EQ(get_scancode_set2(FN_ROW, FN_COL), SCANCODE_FAKE_FN,
+		"0x%04x");
+	TEST_ASSERT(expect(FN_ROW, FN_COL, 1, fake_fn_down, 2) == EC_SUCCESS);
+	TEST_ASSERT(every_key() == EC_SUCCESS);
+	TEST_ASSERT(key(FN_ROW, FN_COL, 0, 1) == EC_SUCCESS);
+
+	factory_setting(0);
+	old_factory = 0;
+	old_set2[FN_COL][FN_ROW] = SCANCODE_FN;
+
+	TEST_EQ(get_scancode_set2(FN_ROW, FN_COL), SCANCODE_FN, "0x%04x");
+	TEST_ASSERT(test_fn_layer() == EC_SUCCESS);
+
+	return EC_SUCCESS;
+}
+
+/* Keys sent to the host as codes whether or not the media layer is on */
+static uint8_t bench_keys[KEYBOARD_COLS_MAX * KEYBOARD_ROWS][2];
+static int bench_key_count;
+
+static void find_bench_keys(void)
+{
+	const struct kb_layer *media = &kb_layers[KB_LAYER_MEDIA];
+	const struct kb_key *k;
+	int col, row, i;
+
+	for (col = 0; col < KEYBOARD_COLS_MAX; col++) {
+		for (row = 0; row < KEYBOARD_ROWS; row++) {
+			k = &kb_layer_base[col][row];
+			if (k->action != KB_ACT_NONE || (!k->prefix && !k->set2))
+				continue;
+			if (media->mask[col] & BIT(row)) {
+				i = media->rank[col] + __builtin_popcount(
+					media->mask[col] & (BIT(row) - 1));
+				if (media->keys[i].action != KB_ACT_NONE)
+					continue;
+			}
+			bench_keys[bench_key_count][0] = row;
+			bench_keys[bench_key_count][1] = col;
+			bench_key_count++;
+		}
+	}
+}
+
+static uint32_t bench(int (*make)(int, int, int, int, uint8_t *, int32_t *),
+		      int set1)
+{
+	uint8_t scan_code[4];
+	uint32_t x = 1, sum = 0;
+	uint64_t t0;
+	int32_t len;
+	int i, n;
+
+	t0 = test_bench_ns();
+	for (i = 0; i < BENCH_EVENTS; i += 2) {
+		x = x * 1103515245 + 12345;
+		n = (x >> 8) % bench_key_count;
+		make(bench_keys[n][0], bench_keys[n][1], 1, set1, scan_code,
+		     &len);
+		sum += len;
+		make(bench_keys[n][0], bench_keys[n][1], 0, set1, scan_code,
+		     &len);
+		sum += len;
+	}
+	/* Keep the calls from being dropped */
+	if (sum == 0)
+		ccprintf("no bytes\n");
+
+	return (test_bench_ns() - t0) * 100 / BENCH_EVENTS;
+}
+
+static void report(const char *set, uint32_t matrix, uint32_t layer)
+{
+	ccprintf("%s: switches %d.%02d ns/event, layers %d.%02d ns/event\n",
+		 set, matrix / 100, matrix % 100, layer / 100, layer % 100);
+}
+
+static int test_bench(void)
+{
+	find_bench_keys();
+	TEST_ASSERT(bench_key_count > 0);
+
+	report("set 2", bench(old_key, 0), bench(new_key, 0));
+	report("set 1", bench(old_key, 1), bench(new_key, 1));
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	RUN_TEST(test_layer_codes);
+	RUN_TEST(test_media_layer);
+	RUN_TEST(test_fn_layer);
+	RUN_TEST(test_fn_locked);
+	RUN_TEST(test_pre_os);
+	RUN_TEST(test_fn_latch);
+	RUN_TEST(test_patch);
+	RUN_TEST(test_factory);
+	RUN_TEST(test_bench);
+
+	test_print_result();
+}
@@ -98,6 +98,9 @@ void chipset_reset(void)
 #define mock_defined_key(k, p) mock_key(KEYBOARD_ROW_ ## k, \
 					KEYBOARD_COL_ ## k, \
 					p)
+#define mock_default_key(k, p) mock_key(KEYBOARD_DEFAULT_ROW_ ## k, \
+					KEYBOARD_DEFAULT_COL_ ## k, \
+					p)
 
 static void mock_key(int r, int c, int keydown)
 {
@@ -282,6 +285,36 @@ static int debounce_test(void)
 		mock_key(i, 1, 0);
 	task_wake_then_sleep_1ms(TASK_ID_KEYSCAN);
 
+	/*
+	 * The debounce interval follows the direction of each key's own
+	 * edge, not whether other keys in its column are held: a release
+	 * bounce is ignored for the whole key-up interval.
+	 */
+	msleep(40);
+	old_count = fifo_add_count;
+	mock_key(1, 1, 1);
+	task_wake_then_sleep_1ms(TASK_ID_KEYSCAN);
+	CHECK_KEY_COUNT(old_count, 1);
+	msleep(12);
+	mock_key(2, 1, 1);
+	task_wake_then_sleep_1ms(TASK_ID_KEYSCAN);
+	CHECK_KEY_COUNT(old_count, 1);
+	msleep(12);
+	mock_key(2, 1, 0);
+	task_wake_then_sleep_1ms(TASK_ID_KEYSCAN);
+	CHECK_KEY_COUNT(old_count, 1);
+	/* Well within the key-up interval, but past the key-down one */
+	mock_key(2, 1, 1);
+	task_wake_then_sleep_1ms(TASK_ID_KEYSCAN);
+	TEST_ASSERT(fifo_add_count == old_count);
+	/* Once the interval is over, the key is still down and is reported */
+	msleep(20);
+	task_wake_then_sleep_1ms(TASK_ID_KEYSCAN);
+	CHECK_KEY_COUNT(old_count, 1);
+	mock_key(1, 1, 0);
+	mock_key(2, 1, 0);
+	task_wake_then_sleep_1ms(TASK_ID_KEYSCAN);
+
 	return EC_SUCCESS;
 }
 
@@ -330,21 +363,21 @@ static int runtime_key_test(void)
 {
 	/* Alt-VolUp-H triggers system hibernation */
 	mock_defined_key(LEFT_ALT, 1);
-	mock_defined_key(VOL_UP, 1);
+	mock_default_key(VOL_UP, 1);
 	mock_defined_key(KEY_H, 1);
 	TEST_ASSERT(wait_variable_set(&hibernated) == EC_SUCCESS);
 	mock_defined_key(LEFT_ALT, 0);
-	mock_defined_key(VOL_UP, 0);
+	mock_default_key(VOL_UP, 0);
 	mock_defined_key(KEY_H, 0);
 	TEST_ASSERT(expect_keychange() == EC_SUCCESS);
 
 	/* Alt-VolUp-R triggers chipset reset */
 	mock_defined_key(RIGHT_ALT, 1);
-	mock_defined_key(VOL_UP, 1);
+	mock_default_key(VOL_UP, 1);
 	mock_defined_key(KEY_R, 1);
 	TEST_ASSERT(wait_variable_set(&reset_called) == EC_SUCCESS);
 	mock_defined_key(RIGHT_ALT, 0);
-	mock_defined_key(VOL_UP, 0);
+	mock_default_key(VOL_UP, 0);
 	mock_defined_key(KEY_R, 0);
 	TEST_ASSERT(expect_keychange() == EC_SUCCESS);
 
@@ -352,10 +385,10 @@ static int runtime_key_test(void)
 	mock_defined_key(LEFT_ALT, 1);
 	mock_defined_key(KEY_H, 1);
 	mock_defined_key(KEY_R, 1);
-	mock_defined_key(VOL_UP, 1);
+	mock_default_key(VOL_UP, 1);
 	TEST_ASSERT(verify_variable_not_set(&hibernated) == EC_SUCCESS);
 	TEST_ASSERT(verify_variable_not_set(&reset_called) == EC_SUCCESS);
-	mock_defined_key(VOL_UP, 0);
+	mock_default_key(VOL_UP, 0);
 	mock_defined_key(KEY_R, 0);
 	mock_defined_key(KEY_H, 0);
 	mock_defined_key(LEFT_ALT, 0);
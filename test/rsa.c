@@ -9,7 +9,9 @@
 #include "common.h"
 #include "rsa.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
+#include "watchdog.h"
 
 #ifdef TEST_RSA3
 #include "rsa2048-3.h"
@@ -19,6 +21,31 @@
 
 static uint32_t rsa_workbuf[3 * RSANUMBYTES/4];
 
+/* Verifications timed by the benchmark */
+#define BENCH_RUNS 20
+
+static void bench_verify(void)
+{
+	uint64_t t0;
+	uint32_t us;
+	int i;
+
+	t0 = test_bench_ns();
+	for (i = 0; i < BENCH_RUNS; i++) {
+		rsa_verify(rsa_key, sig, hash, rsa_workbuf);
+		watchdog_reload();
+	}
+	us = (test_bench_ns() - t0) / 1000;
+
+	ccprintf("RSA-%d e=%s verify: %d us\n", CONFIG_RSA_KEY_SIZE,
+#ifdef CONFIG_RSA_EXPONENT_3
+		 "3",
+#else
+		 "65537",
+#endif
+		 us / BENCH_RUNS);
+}
+
 void run_test(int argc, char **argv)
 {
 	int good;
@@ -49,6 +76,8 @@ void run_test(int argc, char **argv)
 	}
 	ccprintf("RSA verify FAILED (as expected)\n");
 
+	bench_verify();
+
 	test_pass();
 }
 
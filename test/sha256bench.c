@@ -0,0 +1,112 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Benchmarks the SHA256 paths used by vboot_hash, rollback and fpsensor.
+ */
+
+#include "clock.h"
+#include "common.h"
+#include "console.h"
+#include "sha256.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+#include "watchdog.h"
+
+/* Hashed like an RW image by vboot_hash, in chunks from one buffer */
+#define IMAGE_SIZE (128 * 1024)
+#define IMAGE_CHUNK 4096
+
+/* Iterations of the short hashes */
+#define SHORT_RUNS 1000
+
+static uint8_t chunk[IMAGE_CHUNK];
+
+#if defined(CONFIG_SHA256_FULL_UNROLL)
+#define SHA256_VARIANT "fully unrolled"
+#elif defined(CONFIG_SHA256_UNROLLED)
+#define SHA256_VARIANT "unrolled"
+#else
+#define SHA256_VARIANT "generic"
+#endif
+
+static void report(const char *name, uint32_t us, int runs, int bytes)
+{
+	uint64_t ns = (uint64_t)us * 1000;
+	int ns_per_byte = ns / ((uint64_t)runs * bytes);
+
+	ccprintf("%-10s %7d us %5d bytes x %4d: %3d ns/byte", name, us, bytes,
+		 runs, ns_per_byte);
+#ifndef EMU_BUILD
+	/* CPU cycles, the host emulator has no real clock frequency */
+	ccprintf(", %4d cycles/byte",
+		 (int)(ns * (clock_get_freq() / 1000) / 1000000 /
+		       ((uint64_t)runs * bytes)));
+#endif
+	ccprintf("\n");
+}
+
+/* RW image hash: SHA256 over IMAGE_SIZE bytes, as in vboot_hash */
+static void bench_image(void)
+{
+	struct sha256_ctx ctx;
+	uint64_t t0;
+	int i;
+
+	t0 = test_bench_ns();
+	SHA256_init(&ctx);
+	for (i = 0; i < IMAGE_SIZE; i += IMAGE_CHUNK) {
+		SHA256_update(&ctx, chunk, IMAGE_CHUNK);
+		watchdog_reload();
+	}
+	SHA256_final(&ctx);
+	report("image", (test_bench_ns() - t0) / 1000, 1, IMAGE_SIZE);
+}
+
+/* Rollback secret update: SHA256 of the secret and 32 bytes of entropy */
+static void bench_rollback(void)
+{
+	struct sha256_ctx ctx;
+	uint64_t t0;
+	int i;
+
+	t0 = test_bench_ns();
+	for (i = 0; i < SHORT_RUNS; i++) {
+		SHA256_init(&ctx);
+		SHA256_update(&ctx, chunk, SHA256_DIGEST_SIZE);
+		SHA256_update(&ctx, &chunk[SHA256_DIGEST_SIZE], 32);
+		SHA256_final(&ctx);
+	}
+	report("rollback", (test_bench_ns() - t0) / 1000, SHORT_RUNS,
+	       SHA256_DIGEST_SIZE + 32);
+}
+
+/* fpsensor HKDF: HMAC over a 32 byte key and an info block plus counter */
+static void bench_hmac(void)
+{
+	uint8_t out[SHA256_DIGEST_SIZE];
+	uint64_t t0;
+	int i;
+
+	t0 = test_bench_ns();
+	for (i = 0; i < SHORT_RUNS; i++)
+		hmac_SHA256(out, chunk, SHA256_DIGEST_SIZE,
+			    &chunk[SHA256_DIGEST_SIZE], 33);
+	report("hmac", (test_bench_ns() - t0) / 1000, SHORT_RUNS, 33);
+}
+
+void run_test(int argc, char **argv)
+{
+	int i;
+
+	for (i = 0; i < sizeof(chunk); i++)
+		chunk[i] = i * 7;
+
+	ccprintf("SHA256 transform: %s\n", SHA256_VARIANT);
+	bench_image();
+	bench_rollback();
+	bench_hmac();
+
+	test_pass();
+}
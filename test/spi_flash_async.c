@@ -0,0 +1,253 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests the asynchronous SPI flash erase against a mock flash that stays
+ * busy for the typical W25Q80 erase and program times, and measures how
+ * late the hook task runs deferred functions meanwhile.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "hooks.h"
+#include "spi.h"
+#include "spi_flash.h"
+#include "spi_flash_reg.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+/* Typical W25Q80 times */
+#define ERASE_4KB_USEC (45 * MSEC)
+#define ERASE_32KB_USEC (120 * MSEC)
+#define PAGE_PROGRAM_USEC 700
+
+/* Period of the hook latency probe */
+#define PROBE_USEC MSEC
+
+static uint64_t busy_until;
+static int erased;
+/* Commands other than a status read sent while the flash was busy */
+static int cmds_while_busy;
+/* Erase started in the middle of a page program, and its result */
+static int erase_in_program;
+static int erase_in_program_rv;
+
+int spi_transaction(const struct spi_device_t *spi_device,
+		    const uint8_t *txdata, int txlen,
+		    uint8_t *rxdata, int rxlen)
+{
+	uint64_t now = get_time().val;
+
+	if (txdata[0] == SPI_FLASH_READ_SR1) {
+		rxdata[0] = now < busy_until ? SPI_FLASH_SR1_BUSY : 0;
+		return EC_SUCCESS;
+	}
+
+	if (now < busy_until) {
+		cmds_while_busy++;
+		return EC_SUCCESS;
+	}
+
+	switch (txdata[0]) {
+	case SPI_FLASH_ERASE_4KB:
+		busy_until = now + ERASE_4KB_USEC;
+		erased += 4 * 1024;
+		break;
+	case SPI_FLASH_ERASE_32KB:
+		busy_until = now + ERASE_32KB_USEC;
+		erased += 32 * 1024;
+		break;
+	case SPI_FLASH_PAGE_PRGRM:
+		busy_until = now + PAGE_PROGRAM_USEC;
+		if (erase_in_program) {
+			erase_in_program = 0;
+			erase_in_program_rv = spi_flash_erase_async(0, 4096);
+		}
+		break;
+	case SPI_FLASH_READ:
+		memset(rxdata, 0xff, rxlen);
+		break;
+	}
+	return EC_SUCCESS;
+}
+
+/* Latest a deferred function ran after it was due, while probing */
+static uint64_t probe_due;
+static int probing;
+static int max_late;
+
+static void probe(void);
+DECLARE_DEFERRED(probe);
+
+static void probe(void)
+{
+	uint64_t now = get_time().val;
+
+	if (probe_due)
+		max_late = MAX(max_late, (int)(now - probe_due));
+	if (!probing)
+		return;
+
+	probe_due = now + PROBE_USEC;
+	hook_call_deferred(&probe_data, PROBE_USEC);
+}
+
+static void start_probe(void)
+{
+	probe_due = 0;
+	max_late = 0;
+	probing = 1;
+	hook_call_deferred(&probe_data, 0);
+}
+
+static void stop_probe(void)
+{
+	probing = 0;
+	/* Let the last probe run */
+	msleep(2 * PROBE_USEC / MSEC);
+}
+
+static int wait_async_done(void)
+{
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		if (spi_flash_async_result() != EC_ERROR_BUSY)
+			break;
+		msleep(20);
+	}
+	return spi_flash_async_result();
+}
+
+static void reset_flash(void)
+{
+	busy_until = 0;
+	erased = 0;
+	cmds_while_busy = 0;
+	erase_in_program = 0;
+}
+
+/*
+ * Erase the whole flash, as the host does with the RW image: only the
+ * status polls and the block erase commands run from the hook task.
+ */
+static int test_hook_latency(void)
+{
+	int idle;
+	timestamp_t start;
+
+	reset_flash();
+
+	start_probe();
+	msleep(200);
+	stop_probe();
+	idle = max_late;
+
+	start_probe();
+	start = get_time();
+	TEST_EQ(spi_flash_erase_async(0, CONFIG_FLASH_SIZE), EC_SUCCESS, "%d");
+	TEST_EQ(wait_async_done(), EC_SUCCESS, "%d");
+	stop_probe();
+
+	ccprintf("Erase of %d KB in %d ms, deferred call late by at most "
+		 "%d us idle, %d us while erasing\n", CONFIG_FLASH_SIZE / 1024,
+		 (int)((get_time().val - start.val) / MSEC), idle, max_late);
+	TEST_EQ(erased, CONFIG_FLASH_SIZE, "%d");
+	TEST_EQ(cmds_while_busy, 0, "%d");
+	/* A block erase is 120 ms, the hook task must not wait for it */
+	TEST_LT(max_late, 20 * MSEC, "%d");
+
+	return EC_SUCCESS;
+}
+
+/* Other tasks wait for the erase and then go on */
+static int test_sync_waits(void)
+{
+	uint8_t data[16];
+	timestamp_t start;
+
+	reset_flash();
+
+	start = get_time();
+	TEST_EQ(spi_flash_erase_async(0, 64 * 1024), EC_SUCCESS, "%d");
+	TEST_EQ(spi_flash_read(data, 0, sizeof(data)), EC_SUCCESS, "%d");
+	TEST_EQ(spi_flash_async_result(), EC_SUCCESS, "%d");
+	TEST_GE((int)(get_time().val - start.val), 2 * ERASE_32KB_USEC, "%d");
+
+	TEST_EQ(spi_flash_erase_async(64 * 1024, 32 * 1024), EC_SUCCESS, "%d");
+	TEST_EQ(spi_flash_write(0, sizeof(data), data), EC_SUCCESS, "%d");
+	TEST_EQ(spi_flash_async_result(), EC_SUCCESS, "%d");
+
+	TEST_EQ(spi_flash_erase_async(0, 4 * 1024), EC_SUCCESS, "%d");
+	TEST_EQ(spi_flash_erase(4 * 1024, 4 * 1024), EC_SUCCESS, "%d");
+	TEST_EQ(spi_flash_async_result(), EC_SUCCESS, "%d");
+
+	TEST_EQ(erased, 104 * 1024, "%d");
+	TEST_EQ(cmds_while_busy, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int hook_read_rv;
+
+static void hook_read(void)
+{
+	uint8_t data[16];
+
+	hook_read_rv = spi_flash_read(data, 0, sizeof(data));
+}
+DECLARE_DEFERRED(hook_read);
+
+/* The hook task runs the erase, it cannot wait for it */
+static int test_busy_in_hook(void)
+{
+	reset_flash();
+	hook_read_rv = -1;
+
+	TEST_EQ(spi_flash_erase_async(0, 32 * 1024), EC_SUCCESS, "%d");
+	hook_call_deferred(&hook_read_data, 0);
+	msleep(20);
+	TEST_EQ(hook_read_rv, EC_ERROR_BUSY, "%d");
+	TEST_EQ(wait_async_done(), EC_SUCCESS, "%d");
+
+	hook_call_deferred(&hook_read_data, 0);
+	msleep(20);
+	TEST_EQ(hook_read_rv, EC_SUCCESS, "%d");
+	TEST_EQ(cmds_while_busy, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+/* No erase starts while a synchronous write runs, here across two pages */
+static int test_async_waits_for_sync(void)
+{
+	uint8_t data[SPI_FLASH_MAX_WRITE_SIZE];
+
+	reset_flash();
+	memset(data, 0, sizeof(data));
+
+	erase_in_program = 1;
+	erase_in_program_rv = -1;
+	TEST_EQ(spi_flash_write(128, sizeof(data), data), EC_SUCCESS, "%d");
+	TEST_EQ(erase_in_program_rv, EC_ERROR_BUSY, "%d");
+	TEST_EQ(spi_flash_async_result(), EC_SUCCESS, "%d");
+	TEST_EQ(erased, 0, "%d");
+
+	TEST_EQ(spi_flash_erase_async(0, 4096), EC_SUCCESS, "%d");
+	TEST_EQ(wait_async_done(), EC_SUCCESS, "%d");
+	TEST_EQ(erased, 4096, "%d");
+	TEST_EQ(cmds_while_busy, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+void run_test(int argc, char **argv)
+{
+	RUN_TEST(test_hook_latency);
+	RUN_TEST(test_sync_waits);
+	RUN_TEST(test_busy_in_hook);
+	RUN_TEST(test_async_waits_for_sync);
+
+	test_print_result();
+}
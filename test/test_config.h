@@ -49,8 +49,25 @@
 #define CONFIG_MALLOC
 #endif
 
+#ifdef TEST_FWK_FLASH_STORAGE
+void spi_mux_control(int enable);
+#endif
+
+#ifdef TEST_KB_LAYERS
+#define CONFIG_KEYBOARD_PROTOCOL_8042
+#define CONFIG_KEYBOARD_CUSTOMIZATION
+#define CONFIG_KEYBOARD_CUSTOMIZATION_COMBINATION_KEY
+#define CONFIG_KEYBOARD_BOARD_SCANCODES
+#define CONFIG_FACTORY_SUPPORT
+#define CONFIG_SIMULATE_KEYCODE
+#undef CONFIG_KEYBOARD_VIVALDI
+#endif
+
 #ifdef TEST_KB_8042
 #define CONFIG_KEYBOARD_PROTOCOL_8042
+#define CONFIG_KEYBOARD_LATENCY
+#undef CONFIG_KEYBOARD_TO_HOST_QUEUE_SIZE
+#define CONFIG_KEYBOARD_TO_HOST_QUEUE_SIZE 32
 #endif
 
 #ifdef TEST_KB_MKBP
@@ -221,6 +238,7 @@ enum sensor_id {
 
 #ifdef TEST_CRC32
 #define CONFIG_SW_CRC
+#define CONFIG_SW_CRC_SLICE8
 #endif
 
 #ifdef TEST_RSA
@@ -248,10 +266,27 @@ enum sensor_id {
 #define CONFIG_SHA256_UNROLLED
 #endif
 
+#ifdef TEST_SHA256_FULL_UNROLL
+#define CONFIG_SHA256
+#define CONFIG_SHA256_FULL_UNROLL
+#endif
+
+#ifdef TEST_SHA256BENCH
+#define CONFIG_SHA256
+#define CONFIG_SHA256_FULL_UNROLL
+#endif
+
 #ifdef TEST_SHMALLOC
 #define CONFIG_MALLOC
 #endif
 
+#ifdef TEST_SPI_FLASH_ASYNC
+#define CONFIG_SPI_FLASH
+#define CONFIG_SPI_FLASH_ASYNC
+#define CONFIG_SPI_FLASH_PORT 0
+#define CONFIG_SPI_FLASH_W25Q80
+#endif
+
 #ifdef TEST_SBS_CHARGING_V2
 #define CONFIG_BATTERY
 #define CONFIG_BATTERY_MOCK
@@ -286,6 +321,10 @@ int ncp15wb_calculate_temp(uint16_t adc);
 #define CONFIG_FANS 1
 #endif
 
+#ifdef TEST_FAN_PID
+#define CONFIG_FAN_PID_CONTROL
+#endif
+
 #ifdef TEST_BUTTON
 #define CONFIG_KEYBOARD_PROTOCOL_8042
 #undef CONFIG_KEYBOARD_VIVALDI
@@ -304,6 +343,18 @@ int ncp15wb_calculate_temp(uint16_t adc);
 #define I2C_PORT_CHARGER 0
 #endif
 
+#ifdef TEST_BATTERY_SMART_CACHE
+#define CONFIG_BATTERY_MOCK
+#define CONFIG_BATTERY_SMART
+#define CONFIG_BATTERY_SMART_CACHE
+#define CONFIG_CHARGER_INPUT_CURRENT 4032
+#define CONFIG_I2C
+#define CONFIG_I2C_MASTER
+#define I2C_PORT_MASTER 0
+#define I2C_PORT_BATTERY 0
+#define I2C_PORT_CHARGER 0
+#endif
+
 #ifdef TEST_CEC
 #define CONFIG_CEC
 #endif
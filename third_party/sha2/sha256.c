@@ -115,6 +115,91 @@ void SHA256_init(struct sha256_ctx *ctx)
 	ctx->tot_len = 0;
 }
 
+#ifdef CONFIG_SHA256_FULL_UNROLL
+
+/*
+ * Fully unrolled rounds for Cortex-M4 and similar cores. The message
+ * schedule is a rolling 16 word window on the stack, and the eight working
+ * variables rotate through the macro arguments instead of being moved, so
+ * that the compiler can keep them in registers. The rotates fold into the
+ * EOR instructions as ROR-shifted operands.
+ */
+#define SHA256_W(j)	w[(j) & 15]
+
+static inline uint32_t sha256_be32(const uint8_t *str)
+{
+	return ((uint32_t)str[0] << 24) | ((uint32_t)str[1] << 16) |
+		((uint32_t)str[2] << 8) | str[3];
+}
+
+#define SHA256_LOAD(j)	(SHA256_W(j) = sha256_be32(&sub_block[(j) << 2]))
+
+#define SHA256_SCHED(j)							\
+	(SHA256_W(j) += SHA256_F4(SHA256_W((j) - 2)) + SHA256_W((j) - 7)\
+			+ SHA256_F3(SHA256_W((j) - 15)))
+
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, j, wj)			\
+	{								\
+		t1 = h + SHA256_F2(e) + CH(e, f, g) + sha256_k[j] + (wj);\
+		d += t1;						\
+		h = t1 + SHA256_F1(a) + MAJ(a, b, c);			\
+	}
+
+#define SHA256_ROUNDS8(j, W)						\
+	{								\
+		SHA256_ROUND(a, b, c, d, e, f, g, h, (j) + 0, W((j) + 0));\
+		SHA256_ROUND(h, a, b, c, d, e, f, g, (j) + 1, W((j) + 1));\
+		SHA256_ROUND(g, h, a, b, c, d, e, f, (j) + 2, W((j) + 2));\
+		SHA256_ROUND(f, g, h, a, b, c, d, e, (j) + 3, W((j) + 3));\
+		SHA256_ROUND(e, f, g, h, a, b, c, d, (j) + 4, W((j) + 4));\
+		SHA256_ROUND(d, e, f, g, h, a, b, c, (j) + 5, W((j) + 5));\
+		SHA256_ROUND(c, d, e, f, g, h, a, b, (j) + 6, W((j) + 6));\
+		SHA256_ROUND(b, c, d, e, f, g, h, a, (j) + 7, W((j) + 7));\
+	}
+
+static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
+			     unsigned int block_nb)
+{
+	uint32_t w[16];
+	uint32_t a, b, c, d, e, f, g, h;
+	uint32_t t1;
+	const uint8_t *sub_block;
+	unsigned int i;
+
+	for (i = 0; i < block_nb; i++) {
+		sub_block = message + (i << 6);
+
+		a = ctx->h[0];
+		b = ctx->h[1];
+		c = ctx->h[2];
+		d = ctx->h[3];
+		e = ctx->h[4];
+		f = ctx->h[5];
+		g = ctx->h[6];
+		h = ctx->h[7];
+
+		SHA256_ROUNDS8(0, SHA256_LOAD);
+		SHA256_ROUNDS8(8, SHA256_LOAD);
+		SHA256_ROUNDS8(16, SHA256_SCHED);
+		SHA256_ROUNDS8(24, SHA256_SCHED);
+		SHA256_ROUNDS8(32, SHA256_SCHED);
+		SHA256_ROUNDS8(40, SHA256_SCHED);
+		SHA256_ROUNDS8(48, SHA256_SCHED);
+		SHA256_ROUNDS8(56, SHA256_SCHED);
+
+		ctx->h[0] += a;
+		ctx->h[1] += b;
+		ctx->h[2] += c;
+		ctx->h[3] += d;
+		ctx->h[4] += e;
+		ctx->h[5] += f;
+		ctx->h[6] += g;
+		ctx->h[7] += h;
+	}
+}
+
+#else /* !CONFIG_SHA256_FULL_UNROLL */
+
 static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
 			     unsigned int block_nb)
 {
@@ -182,6 +267,8 @@ static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
 	}
 }
 
+#endif /* CONFIG_SHA256_FULL_UNROLL */
+
 void SHA256_update(struct sha256_ctx *ctx, const uint8_t *data, uint32_t len)
 {
 	unsigned int block_nb;
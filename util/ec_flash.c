@@ -10,11 +10,20 @@
 #include <string.h>
 
 #include "comm-host.h"
+#include "ec_flash.h"
 #include "misc_util.h"
+#include "sha256.h"
 #include "timer.h"
 
+/* Board specific host commands, when built for a board that has them */
+#if defined(__has_include)
+#if __has_include("host_command_customization.h")
+#include "host_command_customization.h"
+#endif
+#endif
+
 static const uint32_t ERASE_ASYNC_TIMEOUT = 10 * SECOND;
-static const uint32_t ERASE_ASYNC_WAIT = 500 * MSEC;
+static const uint32_t ERASE_ASYNC_WAIT = 50 * MSEC;
 static const int FLASH_ERASE_BUSY_RV = -EECRESULT - EC_RES_BUSY;
 
 int ec_flash_read(uint8_t *buf, int offset, int size)
@@ -39,7 +48,130 @@ int ec_flash_read(uint8_t *buf, int offset, int size)
 	return 0;
 }
 
-int ec_flash_verify(const uint8_t *buf, int offset, int size)
+#ifdef EC_CMD_FLASH_BLOCK_HASH
+/* Block size of the hashes compared by ec_flash_verify() */
+#define VERIFY_BLOCK_SIZE 0x1000
+
+static int flash_block_hash_supported(void)
+{
+	return ec_cmd_version_supported(EC_CMD_FLASH_BLOCK_HASH, 0);
+}
+
+int ec_flash_block_hash(uint8_t *hash, int offset, int size, int block_size)
+{
+	struct ec_params_flash_block_hash p;
+	struct ec_response_flash_block_hash *r =
+		(struct ec_response_flash_block_hash *)ec_inbuf;
+	int done = 0;
+	int n = 0;
+	int left, rv;
+
+	/* The EC hashes as many blocks as it can per command */
+	while (done < size) {
+		left = (size - done + block_size - 1) / block_size;
+		p.offset = offset + done;
+		p.size = size - done;
+		p.block_size = block_size;
+		rv = ec_command(EC_CMD_FLASH_BLOCK_HASH, 0, &p, sizeof(p),
+				ec_inbuf, ec_max_insize);
+		if (rv < 0)
+			return rv;
+		/* Never more blocks than are left, hash is sized for those */
+		if (rv < (int)sizeof(*r) || !r->count || r->count > left ||
+		    rv < (int)(sizeof(*r) + r->count * EC_FLASH_BLOCK_HASH_SIZE)) {
+			fprintf(stderr, "Bad block hash response at offset %d\n",
+				done);
+			return -1;
+		}
+		memcpy(hash + n * EC_FLASH_BLOCK_HASH_SIZE, r->hash,
+		       r->count * EC_FLASH_BLOCK_HASH_SIZE);
+		n += r->count;
+		done += r->count * block_size;
+	}
+
+	return n;
+}
+
+/* Hash buf the way EC_CMD_FLASH_BLOCK_HASH hashes flash */
+static void hash_blocks(uint8_t *hash, const uint8_t *buf, int size,
+			int block_size)
+{
+	struct sha256_ctx ctx;
+	int i;
+
+	for (i = 0; i < size; i += block_size) {
+		SHA256_init(&ctx);
+		SHA256_update(&ctx, buf + i, MIN(block_size, size - i));
+		memcpy(hash, SHA256_final(&ctx), EC_FLASH_BLOCK_HASH_SIZE);
+		hash += EC_FLASH_BLOCK_HASH_SIZE;
+	}
+}
+
+/*
+ * Compare the EC's block hashes of a region with those of buf.
+ *
+ * @return Number of blocks that differ, negative on failure.
+ */
+static int flash_diff_blocks(uint8_t *differs, const uint8_t *buf,
+			     int offset, int size, int block_size)
+{
+	int blocks = (size + block_size - 1) / block_size;
+	uint8_t *hash;
+	int rv, i;
+	int n = 0;
+
+	hash = malloc(2 * blocks * EC_FLASH_BLOCK_HASH_SIZE);
+	if (!hash) {
+		fprintf(stderr, "Unable to allocate buffer.\n");
+		return -1;
+	}
+
+	rv = ec_flash_block_hash(hash, offset, size, block_size);
+	if (rv < 0) {
+		free(hash);
+		return rv;
+	}
+
+	hash_blocks(hash + blocks * EC_FLASH_BLOCK_HASH_SIZE, buf, size,
+		    block_size);
+	for (i = 0; i < blocks; i++) {
+		differs[i] = !!memcmp(hash + i * EC_FLASH_BLOCK_HASH_SIZE,
+				      hash + (blocks + i) *
+				      EC_FLASH_BLOCK_HASH_SIZE,
+				      EC_FLASH_BLOCK_HASH_SIZE);
+		n += differs[i];
+	}
+
+	free(hash);
+	return n;
+}
+
+static int flash_verify_hash(const uint8_t *buf, int offset, int size)
+{
+	int blocks = (size + VERIFY_BLOCK_SIZE - 1) / VERIFY_BLOCK_SIZE;
+	uint8_t *differs = malloc(blocks);
+	int rv, i;
+
+	if (!differs) {
+		fprintf(stderr, "Unable to allocate buffer.\n");
+		return -1;
+	}
+
+	rv = flash_diff_blocks(differs, buf, offset, size, VERIFY_BLOCK_SIZE);
+	for (i = 0; rv > 0 && i < blocks; i++) {
+		if (differs[i]) {
+			fprintf(stderr, "Mismatch in block at offset 0x%x\n",
+				i * VERIFY_BLOCK_SIZE);
+			break;
+		}
+	}
+
+	free(differs);
+	return rv > 0 ? -1 : rv;
+}
+#endif /* EC_CMD_FLASH_BLOCK_HASH */
+
+static int flash_verify_read(const uint8_t *buf, int offset, int size)
 {
 	uint8_t *rbuf = malloc(size);
 	int rv;
@@ -70,6 +202,15 @@ int ec_flash_verify(const uint8_t *buf, int offset, int size)
 	return 0;
 }
 
+int ec_flash_verify(const uint8_t *buf, int offset, int size)
+{
+#ifdef EC_CMD_FLASH_BLOCK_HASH
+	if (flash_block_hash_supported())
+		return flash_verify_hash(buf, offset, size);
+#endif
+	return flash_verify_read(buf, offset, size);
+}
+
 /**
  * @param info_response  pointer to response that will be filled on success
  * @return Zero or positive on success, negative on failure
@@ -132,22 +273,40 @@ static int get_flash_write_size(void)
 	return write_size;
 }
 
-int ec_flash_write(const uint8_t *buf, int offset, int size)
+/**
+ * @return Version of EC_CMD_FLASH_WRITE to use
+ */
+static int get_flash_write_version(void)
 {
-	struct ec_params_flash_write *p =
-		(struct ec_params_flash_write *)ec_outbuf;
+	if (ec_cmd_version_supported(EC_CMD_FLASH_WRITE,
+				     EC_VER_FLASH_WRITE_POSTED))
+		return EC_VER_FLASH_WRITE_POSTED;
+	if (ec_cmd_version_supported(EC_CMD_FLASH_WRITE, EC_VER_FLASH_WRITE))
+		return EC_VER_FLASH_WRITE;
+	return 0;
+}
+
+/**
+ * @return Bytes per EC_CMD_FLASH_WRITE on success, negative on failure
+ */
+static int get_flash_write_step(int version)
+{
+	/* ec_max_outsize is from EC_CMD_GET_PROTOCOL_INFO, if supported */
+	int pdata_max_size = (int)(ec_max_outsize -
+				   sizeof(struct ec_params_flash_write));
 	int write_size;
-	int pdata_max_size = (int)(ec_max_outsize - sizeof(*p));
 	int step;
-	int rv;
-	int i;
 
 	/*
-	 * Determine whether we can use version 1 of the EC_CMD_FLASH_WRITE
-	 * command with more data, or only version 0.
+	 * Version 0 of the EC_CMD_FLASH_WRITE command only takes 64 bytes,
+	 * and the EC buffers at most EC_FLASH_WRITE_POSTED_SIZE bytes of a
+	 * posted write.
 	 */
-	if (!ec_cmd_version_supported(EC_CMD_FLASH_WRITE, EC_VER_FLASH_WRITE))
+	if (version == 0)
 		pdata_max_size = EC_FLASH_WRITE_VER0_SIZE;
+	else if (version == EC_VER_FLASH_WRITE_POSTED)
+		pdata_max_size = MIN(pdata_max_size,
+				     EC_FLASH_WRITE_POSTED_SIZE);
 
 	write_size = get_flash_write_size();
 	if (write_size < 0)
@@ -168,17 +327,44 @@ int ec_flash_write(const uint8_t *buf, int offset, int size)
 		return -1;
 	}
 
-	/* Write data in chunks */
-	printf("Write size %d...\n", step);
+	return step;
+}
+
+/*
+ * With posted writes the EC programs each chunk while the next one is on
+ * its way, and reports a failure with the next write. A last posted write
+ * of size 0 collects the result of the final chunk.
+ */
+static int flash_write_chunks(const uint8_t *buf, int offset, int size,
+			      int step, int version)
+{
+	struct ec_params_flash_write *p =
+		(struct ec_params_flash_write *)ec_outbuf;
+	int posted = (version == EC_VER_FLASH_WRITE_POSTED);
+	int rv;
+	int i;
 
 	for (i = 0; i < size; i += step) {
 		p->offset = offset + i;
 		p->size = MIN(size - i, step);
 		memcpy(p + 1, buf + i, p->size);
-		rv = ec_command(EC_CMD_FLASH_WRITE, 0, p, sizeof(*p) + p->size,
+		rv = ec_command(EC_CMD_FLASH_WRITE, version, p,
+				sizeof(*p) + p->size, NULL, 0);
+		if (rv < 0) {
+			fprintf(stderr, "Write error at offset %d\n",
+				posted && i ? i - step : i);
+			return rv;
+		}
+	}
+
+	if (posted && size) {
+		p->offset = offset + size;
+		p->size = 0;
+		rv = ec_command(EC_CMD_FLASH_WRITE, version, p, sizeof(*p),
 				NULL, 0);
 		if (rv < 0) {
-			fprintf(stderr, "Write error at offset %d\n", i);
+			fprintf(stderr, "Write error at offset %d\n",
+				(size - 1) / step * step);
 			return rv;
 		}
 	}
@@ -186,6 +372,22 @@ int ec_flash_write(const uint8_t *buf, int offset, int size)
 	return 0;
 }
 
+int ec_flash_write(const uint8_t *buf, int offset, int size)
+{
+	int version, step;
+
+	version = get_flash_write_version();
+	step = get_flash_write_step(version);
+	if (step < 0)
+		return step;
+
+	/* Write data in chunks */
+	printf("Write size %d%s...\n", step,
+	       version == EC_VER_FLASH_WRITE_POSTED ? ", posted" : "");
+
+	return flash_write_chunks(buf, offset, size, step, version);
+}
+
 int ec_flash_erase(int offset, int size)
 {
 	struct ec_params_flash_erase p;
@@ -229,3 +431,98 @@ int ec_flash_erase_async(int offset, int size)
 	}
 	return rv;
 }
+
+#ifdef EC_CMD_FLASH_BLOCK_HASH
+/**
+ * @return Erase size on success, negative on failure
+ */
+static int get_flash_erase_size(void)
+{
+	struct ec_response_flash_info info_response = { 0 };
+	int rv;
+
+	if (!ec_cmd_version_supported(EC_CMD_FLASH_INFO, 0))
+		return -1;
+
+	rv = get_flash_info_v0(&info_response);
+	if (rv < 0)
+		return rv;
+
+	return info_response.erase_block_size;
+}
+
+int ec_flash_update(const uint8_t *buf, int offset, int size, int *changed)
+{
+	int erase_size, version, step, blocks, start, end;
+	uint8_t *differs;
+	int rv;
+
+	if (!flash_block_hash_supported()) {
+		fprintf(stderr, "EC does not support block hashes.\n");
+		return -1;
+	}
+
+	erase_size = get_flash_erase_size();
+	if (erase_size <= 0)
+		return -1;
+
+	if (offset % erase_size || size % erase_size) {
+		fprintf(stderr, "Region not aligned to erase size %d\n",
+			erase_size);
+		return -1;
+	}
+
+	version = get_flash_write_version();
+	step = get_flash_write_step(version);
+	if (step < 0)
+		return step;
+
+	blocks = size / erase_size;
+	differs = malloc(blocks);
+	if (!differs) {
+		fprintf(stderr, "Unable to allocate buffer.\n");
+		return -1;
+	}
+
+	rv = flash_diff_blocks(differs, buf, offset, size, erase_size);
+	if (rv < 0)
+		goto out;
+	*changed = rv;
+
+	/* Erase, program and verify each run of changed blocks */
+	for (start = 0; start < blocks; start = end) {
+		if (!differs[start]) {
+			end = start + 1;
+			continue;
+		}
+		for (end = start; end < blocks && differs[end]; end++)
+			;
+
+		rv = ec_flash_erase(offset + start * erase_size,
+				    (end - start) * erase_size);
+		if (rv < 0) {
+			fprintf(stderr, "Erase error at offset %d\n",
+				start * erase_size);
+			goto out;
+		}
+
+		rv = flash_write_chunks(buf + start * erase_size,
+					offset + start * erase_size,
+					(end - start) * erase_size, step,
+					version);
+		if (rv < 0)
+			goto out;
+
+		rv = flash_verify_hash(buf + start * erase_size,
+				       offset + start * erase_size,
+				       (end - start) * erase_size);
+		if (rv < 0)
+			goto out;
+	}
+	rv = 0;
+
+out:
+	free(differs);
+	return rv;
+}
+#endif /* EC_CMD_FLASH_BLOCK_HASH */
@@ -59,4 +59,29 @@ int ec_flash_erase(int offset, int size);
  */
 int ec_flash_erase_async(int offset, int size);
 
+/**
+ * Get the SHA256 of each block of EC flash memory
+ *
+ * @param hash		Destination, EC_FLASH_BLOCK_HASH_SIZE bytes per block
+ * @param offset	Offset in EC flash of the first block
+ * @param size		Number of bytes to hash, the last block may be short
+ * @param block_size	Number of bytes per block
+ *
+ * @return Number of blocks hashed, negative if error.
+ */
+int ec_flash_block_hash(uint8_t *hash, int offset, int size, int block_size);
+
+/**
+ * Update EC flash memory, erasing and writing only the erase blocks whose
+ * hash differs from the source buffer, then verifying them by hash
+ *
+ * @param buf		Source buffer
+ * @param offset	Offset in EC flash to update, erase block aligned
+ * @param size		Number of bytes to update, erase block aligned
+ * @param changed	Set to the number of erase blocks rewritten
+ *
+ * @return 0 if success, negative if error.
+ */
+int ec_flash_update(const uint8_t *buf, int offset, int size, int *changed);
+
 #endif
@@ -32,6 +32,13 @@
 #include "panic.h"
 #include "usb_pd.h"
 
+/* Board specific host commands, when built for a board that has them */
+#if defined(__has_include)
+#if __has_include("host_command_customization.h")
+#include "host_command_customization.h"
+#endif
+#endif
+
 /* Maximum flash size (16 MB, conservative) */
 #define MAX_FLASH_SIZE 0x1000000
 
@@ -142,6 +149,10 @@ const char help_str[] =
 	"      Reads from EC flash to a file\n"
 	"  flashwrite <offset> <infile>\n"
 	"      Writes to EC flash from a file\n"
+#ifdef EC_CMD_FLASH_BLOCK_HASH
+	"  flashupdate <offset> <infile>\n"
+	"      Rewrites only the EC flash blocks that differ from a file\n"
+#endif
 	"  forcelidopen <enable>\n"
 	"      Forces the lid switch to open position\n"
 	"  fpcontext\n"
@@ -192,6 +203,8 @@ const char help_str[] =
 	"      Get keyboard ID of supported keyboards\n"
 	"  kbinfo\n"
 	"      Dump keyboard matrix dimensions\n"
+	"  kblatency [reset]\n"
+	"      Print (and clear) keypress latency statistics\n"
 	"  kbpress\n"
 	"      Simulate key press\n"
 	"  keyscan <beat_us> <filename>\n"
@@ -301,6 +314,8 @@ const char help_str[] =
 	"      Get the threshold temperature values from the thermal engine.\n"
 	"  thermalset <platform-specific args>\n"
 	"      Set the threshold temperature values for the thermal engine.\n"
+	"  thermalhistory [seconds]\n"
+	"      Print the recent thermal history and threshold crossings.\n"
 	"  tpselftest\n"
 	"      Run touchpad self test.\n"
 	"  tpframeget\n"
@@ -1355,12 +1370,31 @@ int cmd_flash_spi_info(int argc, char *argv[])
 	return 0;
 }
 
+/* Monotonic time in microseconds, for timing flash operations */
+static uint64_t flash_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* Report how long a flash transfer took and its throughput */
+static void print_flash_rate(int size, uint64_t start)
+{
+	uint64_t us = flash_time_us() - start;
+
+	printf("done in %d ms, %d KB/s.\n", (int)(us / 1000),
+	       (int)((uint64_t)size * 1000000 / 1024 / (us ? us : 1)));
+}
+
 int cmd_flash_read(int argc, char *argv[])
 {
 	int offset, size;
 	int rv;
 	char *e;
 	char *buf;
+	uint64_t start;
 
 	if (argc < 4) {
 		fprintf(stderr,
@@ -1386,19 +1420,17 @@ int cmd_flash_read(int argc, char *argv[])
 	}
 
 	/* Read data in chunks */
+	start = flash_time_us();
 	rv = ec_flash_read(buf, offset, size);
 	if (rv < 0) {
 		free(buf);
 		return rv;
 	}
+	print_flash_rate(size, start);
 
 	rv = write_file(argv[3], buf, size);
 	free(buf);
-	if (rv)
-		return rv;
-
-	printf("done.\n");
-	return 0;
+	return rv;
 }
 
 int cmd_flash_write(int argc, char *argv[])
@@ -1407,6 +1439,7 @@ int cmd_flash_write(int argc, char *argv[])
 	int rv;
 	char *e;
 	char *buf;
+	uint64_t start;
 
 	if (argc < 3) {
 		fprintf(stderr, "Usage: %s <offset> <filename>\n", argv[0]);
@@ -1427,6 +1460,7 @@ int cmd_flash_write(int argc, char *argv[])
 	printf("Writing to offset %d...\n", offset);
 
 	/* Write data in chunks */
+	start = flash_time_us();
 	rv = ec_flash_write(buf, offset, size);
 
 	free(buf);
@@ -1434,9 +1468,46 @@ int cmd_flash_write(int argc, char *argv[])
 	if (rv < 0)
 		return rv;
 
-	printf("done.\n");
+	print_flash_rate(size, start);
+	return 0;
+}
+
+#ifdef EC_CMD_FLASH_BLOCK_HASH
+int cmd_flash_update(int argc, char *argv[])
+{
+	int offset, size, changed;
+	int rv;
+	char *e;
+	char *buf;
+	uint64_t start;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <offset> <filename>\n", argv[0]);
+		return -1;
+	}
+
+	offset = strtol(argv[1], &e, 0);
+	if ((e && *e) || offset < 0 || offset > MAX_FLASH_SIZE) {
+		fprintf(stderr, "Bad offset.\n");
+		return -1;
+	}
+
+	buf = read_file(argv[2], &size);
+	if (!buf)
+		return -1;
+
+	printf("Updating %d bytes at offset %d...\n", size, offset);
+	start = flash_time_us();
+	rv = ec_flash_update((const uint8_t *)buf, offset, size, &changed);
+	free(buf);
+	if (rv < 0)
+		return rv;
+
+	printf("done in %d ms, %d blocks rewritten.\n",
+	       (int)((flash_time_us() - start) / 1000), changed);
 	return 0;
 }
+#endif
 
 int cmd_flash_erase(int argc, char *argv[])
 {
@@ -1444,6 +1515,7 @@ int cmd_flash_erase(int argc, char *argv[])
 	char *e;
 	int rv;
 	bool async = false;
+	uint64_t start;
 
 	if (argc < 3) {
 		fprintf(stderr, "Usage: %s <offset> <size>\n", argv[0]);
@@ -1466,6 +1538,7 @@ int cmd_flash_erase(int argc, char *argv[])
 	}
 
 	printf("Erasing %d bytes at offset %d...\n", size, offset);
+	start = flash_time_us();
 	if (async)
 		rv = ec_flash_erase_async(offset, size);
 	else
@@ -1473,7 +1546,7 @@ int cmd_flash_erase(int argc, char *argv[])
 	if (rv < 0)
 		return rv;
 
-	printf("done.\n");
+	printf("done in %d ms.\n", (int)((flash_time_us() - start) / 1000));
 	return 0;
 }
 
@@ -3248,6 +3321,168 @@ int cmd_thermal_set_threshold(int argc, char *argv[])
 }
 
 
+#ifdef EC_CMD_THERMAL_HISTORY
+static const char * const thermal_hist_event_names[] = {
+	[EC_THERMAL_HIST_EVENT_WARN] = "warn",
+	[EC_THERMAL_HIST_EVENT_HIGH] = "high",
+	[EC_THERMAL_HIST_EVENT_HALT] = "halt",
+	[EC_THERMAL_HIST_EVENT_FAN_OFF] = "fan_off",
+	[EC_THERMAL_HIST_EVENT_FAN_MAX] = "fan_max",
+	[EC_THERMAL_HIST_EVENT_FLAG] = "flag",
+	[EC_THERMAL_HIST_EVENT_POWER_LIMIT] = "power limit",
+};
+
+static const char * const thermal_hist_flag_names[] = {
+	"PROCHOT", "THROTTLE_HARD", "THROTTLE_SOFT", "AP_ON",
+};
+
+/*
+ * Read all entries or events, a page at a time, into a buffer allocated for
+ * them. Returns the number read, or a negative error.
+ */
+static int thermal_history_read(int read, int size, void **buf,
+				struct ec_response_thermal_history *hdr)
+{
+	struct ec_params_thermal_history p;
+	struct ec_response_thermal_history *r = ec_inbuf;
+	int n = 0, rv;
+
+	*buf = NULL;
+	p.read = read;
+	p.reserved = 0;
+	do {
+		p.offset = n;
+		rv = ec_command(EC_CMD_THERMAL_HISTORY, 0, &p, sizeof(p),
+				ec_inbuf, ec_max_insize);
+		if (rv < 0)
+			return rv;
+		if (rv < sizeof(*r) + r->count * size)
+			return -EC_RES_INVALID_RESPONSE;
+		if (!n) {
+			*hdr = *r;
+			*buf = malloc(MAX(r->total, 1) * size);
+			if (!*buf)
+				return -1;
+		}
+		/* The window moves on if a sample is taken while reading */
+		if (n + r->count > hdr->total)
+			break;
+		memcpy((uint8_t *)*buf + n * size, r->data, r->count * size);
+		n += r->count;
+	} while (r->count && n < hdr->total);
+
+	return n;
+}
+
+int cmd_thermal_history(int argc, char *argv[])
+{
+	struct ec_response_thermal_history hdr, ev_hdr;
+	struct ec_thermal_history_entry *entries = NULL;
+	struct ec_thermal_history_event *events = NULL;
+	int n_entries, n_events;
+	int seconds = 0, first = 0;
+	int i, j, t, rv = -1;
+	char *e;
+
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [seconds]\n", argv[0]);
+		return -1;
+	}
+	if (argc == 2) {
+		seconds = strtol(argv[1], &e, 0);
+		if ((e && *e) || seconds <= 0) {
+			fprintf(stderr, "Bad seconds.\n");
+			return -1;
+		}
+	}
+
+	n_entries = thermal_history_read(EC_THERMAL_HIST_READ_ENTRIES,
+					 sizeof(*entries), (void **)&entries,
+					 &hdr);
+	if (n_entries < 0) {
+		rv = n_entries;
+		goto out;
+	}
+	n_events = thermal_history_read(EC_THERMAL_HIST_READ_EVENTS,
+					sizeof(*events), (void **)&events,
+					&ev_hdr);
+	if (n_events < 0) {
+		rv = n_events;
+		goto out;
+	}
+
+	if (seconds && n_entries > seconds / MAX(hdr.interval, 1))
+		first = n_entries - seconds / MAX(hdr.interval, 1);
+
+	printf("%d entries every %ds, newest %d.%03ds ago\n\n",
+	       n_entries - first, hdr.interval, hdr.age / 1000,
+	       hdr.age % 1000);
+	printf("    time ");
+	for (i = 0; i < hdr.sensor_count; i++)
+		printf("  t%d", i);
+	printf("  duty   rpm  pl1  pl2  flags\n");
+
+	for (i = first; i < n_entries; i++) {
+		const struct ec_thermal_history_entry *en = &entries[i];
+
+		t = (i - n_entries + 1) * hdr.interval;
+		printf("%7ds ", t);
+		for (j = 0; j < hdr.sensor_count; j++) {
+			if (en->temp[j] == EC_THERMAL_HIST_TEMP_INVALID)
+				printf("   -");
+			else
+				printf(" %3d", en->temp[j]);
+		}
+		printf("  %3d%% %5d  %3d  %3d ", en->fan_duty,
+		       en->fan_rpm * EC_THERMAL_HIST_RPM_UNIT, en->pl1,
+		       en->pl2);
+		for (j = 0; j < ARRAY_SIZE(thermal_hist_flag_names); j++)
+			if (en->flags & BIT(j))
+				printf(" %s", thermal_hist_flag_names[j]);
+		printf("\n");
+	}
+
+	printf("\n%d events\n", n_events);
+	for (i = 0; i < n_events; i++) {
+		const struct ec_thermal_history_event *ev = &events[i];
+		int type = ev->type & EC_THERMAL_HIST_EVENT_TYPE_MASK;
+		int rising = ev->type & EC_THERMAL_HIST_EVENT_RISING;
+
+		t = ((int32_t)(ev->seq - hdr.seq)) * hdr.interval;
+		if (seconds && t < -seconds)
+			continue;
+		printf("%7ds  %-11s ", t,
+		       type < ARRAY_SIZE(thermal_hist_event_names) &&
+				thermal_hist_event_names[type] ?
+			       thermal_hist_event_names[type] :
+			       "unknown");
+		switch (type) {
+		case EC_THERMAL_HIST_EVENT_FLAG:
+			for (j = 0; j < ARRAY_SIZE(thermal_hist_flag_names);
+			     j++)
+				if (ev->limit & BIT(j))
+					printf("%s ", thermal_hist_flag_names[j]);
+			printf("%s\n", rising ? "set" : "cleared");
+			break;
+		case EC_THERMAL_HIST_EVENT_POWER_LIMIT:
+			printf("PL1 %d W, PL2 %d W\n", ev->value, ev->limit);
+			break;
+		default:
+			printf("sensor %d %s: %d C, limit %d C\n", ev->sensor,
+			       rising ? "above" : "below", ev->value,
+			       ev->limit);
+			break;
+		}
+	}
+	rv = 0;
+
+out:
+	free(entries);
+	free(events);
+	return rv;
+}
+#endif /* EC_CMD_THERMAL_HISTORY */
+
 static int get_num_fans(void)
 {
 	int idx, rv;
@@ -6343,6 +6578,45 @@ int cmd_kbpress(int argc, char *argv[])
 	return 0;
 }
 
+#ifdef EC_CMD_KEYBOARD_LATENCY
+static const char * const kblat_stage_names[EC_KBLAT_STAGES] = {
+	"report", "scancode", "queued", "sent", "read",
+};
+
+int cmd_keyboard_latency(int argc, char *argv[])
+{
+	struct ec_params_keyboard_latency p = { 0 };
+	struct ec_response_keyboard_latency r;
+	int rv, i, j;
+
+	if (argc > 2 || (argc == 2 && strcasecmp(argv[1], "reset"))) {
+		fprintf(stderr, "Usage: %s [reset]\n", argv[0]);
+		return -1;
+	}
+	if (argc == 2)
+		p.flags |= EC_KBLAT_RESET;
+
+	rv = ec_command(EC_CMD_KEYBOARD_LATENCY, 0, &p, sizeof(p),
+			&r, sizeof(r));
+	if (rv < 0)
+		return rv;
+
+	printf("%u keystrokes, %u lost; us from matrix edge\n", r.count,
+	       r.lost);
+	printf("%-8s %6s %6s %6s  histogram (2^n us)\n", "stage", "min",
+	       "avg", "max");
+	for (i = 0; i < EC_KBLAT_STAGES; i++) {
+		printf("%-8s %6u %6u %6u ", kblat_stage_names[i],
+		       r.stage[i].min_us, r.stage[i].avg_us, r.stage[i].max_us);
+		for (j = 0; j < EC_KBLAT_HIST_BUCKETS; j++)
+			printf(" %u", r.stage[i].hist[j]);
+		printf("\n");
+	}
+
+	return 0;
+}
+#endif /* EC_CMD_KEYBOARD_LATENCY */
+
 int cmd_keyboard_factory_test(int argc, char *argv[])
 {
 	struct ec_response_keyboard_factory_test r;
@@ -10063,6 +10337,9 @@ const struct command commands[] = {
 	{"flashprotect", cmd_flash_protect},
 	{"flashread", cmd_flash_read},
 	{"flashwrite", cmd_flash_write},
+#ifdef EC_CMD_FLASH_BLOCK_HASH
+	{"flashupdate", cmd_flash_update},
+#endif
 	{"flashinfo", cmd_flash_info},
 	{"flashspiinfo", cmd_flash_spi_info},
 	{"flashpd", cmd_flash_pd},
@@ -10094,6 +10371,9 @@ const struct command commands[] = {
 	{"kbfactorytest", cmd_keyboard_factory_test},
 	{"kbid", cmd_kbid},
 	{"kbinfo", cmd_kbinfo},
+#ifdef EC_CMD_KEYBOARD_LATENCY
+	{"kblatency", cmd_keyboard_latency},
+#endif
 	{"kbpress", cmd_kbpress},
 	{"keyconfig", cmd_keyconfig},
 	{"keyscan", cmd_keyscan},
@@ -10146,6 +10426,9 @@ const struct command commands[] = {
 	{"test", cmd_test},
 	{"thermalget", cmd_thermal_get_threshold},
 	{"thermalset", cmd_thermal_set_threshold},
+#ifdef EC_CMD_THERMAL_HISTORY
+	{"thermalhistory", cmd_thermal_history},
+#endif
 	{"tpselftest", cmd_tp_self_test},
 	{"tpframeget", cmd_tp_frame_get},
 	{"tmp006cal", cmd_tmp006cal},
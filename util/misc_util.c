@@ -12,6 +12,26 @@
 
 #include "comm-host.h"
 #include "misc_util.h"
+#include "panic.h"
+
+#if defined(CONFIG_DEBUG_ASSERT) && defined(CONFIG_DEBUG_ASSERT_REBOOTS)
+/* common/ code linked into host tools fails its asserts the host way */
+#ifdef CONFIG_DEBUG_ASSERT_BRIEF
+noreturn void panic_assert_fail(const char *fname, int linenum)
+{
+	fprintf(stderr, "ASSERTION FAILURE at %s:%d\n", fname, linenum);
+	abort();
+}
+#else
+noreturn void panic_assert_fail(const char *msg, const char *func,
+				const char *fname, int linenum)
+{
+	fprintf(stderr, "ASSERTION FAILURE '%s' in %s() at %s:%d\n",
+		msg, func, fname, linenum);
+	abort();
+}
+#endif
+#endif
 
 int write_file(const char *filename, const char *buf, int size)
 {